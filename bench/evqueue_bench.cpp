@@ -0,0 +1,140 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02111-1307 USA.           *
+ ***************************************************************************/
+
+/*
+ * Event queue microbenchmark
+ *
+ * Linked once against src/psxevents.cpp (binary heap) and once against
+ * bench/psxevents_old.cpp (the sorted array it replaced). Both binaries run
+ * the same pseudo-random add/remove/dispatch sequence, including periodic
+ * psxRegs.cycle resets, and print a hash of the dispatch order: the hashes
+ * must match, the ns/op figures are what's being compared. With the current
+ * event types, both run within measurement noise of each other.
+ *
+ * Usage: evqueue_{old,new} [ops]
+ */
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "psxevents.h"
+#include "plugins.h"
+#include "plugin_lib.h"
+#include "perfmon.h"
+
+psxRegisters psxRegs;
+PcsxConfig Config;
+const u32 FrameRate[2] = {60, 50};
+struct pmon_subsys_t pmon_subsys;
+struct pl_data_t pl_data;
+
+static unsigned long long dispatch_hash = 1469598103934665603ULL;
+static long dispatch_count;
+
+// FNV-1a over (event, cycle) of every dispatch
+static void record(int ev)
+{
+	dispatch_hash = (dispatch_hash ^ (ev + 1)) * 1099511628211ULL;
+	dispatch_hash = (dispatch_hash ^ psxRegs.cycle) * 1099511628211ULL;
+	dispatch_count++;
+}
+
+static unsigned rng_state = 12345;
+static unsigned rng(void)
+{
+	rng_state = rng_state * 1103515245 + 12345;
+	return rng_state >> 8;
+}
+
+// Event handlers the queue dispatches to
+#define HANDLER(func, ev) void func(void) { record(ev); }
+HANDLER(sioInterrupt,        PSXINT_SIO)
+HANDLER(cdrInterrupt,        PSXINT_CDR)
+HANDLER(cdrReadInterrupt,    PSXINT_CDREAD)
+HANDLER(gpuInterrupt,        PSXINT_GPUDMA)
+HANDLER(mdec1Interrupt,      PSXINT_MDECOUTDMA)
+HANDLER(spuInterrupt,        PSXINT_SPUDMA)
+HANDLER(mdec0Interrupt,      PSXINT_MDECINDMA)
+HANDLER(gpuotcInterrupt,     PSXINT_GPUOTCDMA)
+HANDLER(cdrDmaInterrupt,     PSXINT_CDRDMA)
+HANDLER(cdrLidSeekInterrupt, PSXINT_CDRLID)
+HANDLER(cdrPlayInterrupt,    PSXINT_CDRPLAY)
+HANDLER(sioSyncMcds,         PSXINT_SIO_SYNC_MCD)
+
+// Root counters reschedule themselves, like the real psxRcntUpdate()
+void psxRcntUpdate(void)
+{
+	record(PSXINT_RCNT);
+	psxEvqueueAdd(PSXINT_RCNT, 2000 + rng() % 500);
+}
+
+void psxRcntAdjustTimestamps(u32 prev_cycle_val) {}
+
+void CALLBACK SPU_async(unsigned int cycle, unsigned int flags)
+{
+	record(PSXINT_SPU_UPDATE);
+}
+
+int main(int argc, char **argv)
+{
+	long ops = (argc > 1) ? atol(argv[1]) : 5000000;
+	if (ops <= 0) {
+		printf("Usage: %s [ops]\n", argv[0]);
+		return 1;
+	}
+
+	Config.SpuUpdateFreq = 2;
+	psxEvqueueInit();
+	psxEvqueueAdd(PSXINT_RCNT, 1000);
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (long i = 0; i < ops; i++) {
+		unsigned r = rng();
+
+		// Pick among the events games schedule through psxEvqueueAdd(),
+		//  leaving the self-scheduling persistent ones to the queue
+		int ev = r % 14;
+		if (ev == PSXINT_RCNT)
+			ev = PSXINT_SPUIRQ;
+		if (ev == PSXINT_GPUBUSY || ev == PSXINT_NEWDRC_CHECK)
+			ev = PSXINT_SIO;
+
+		if ((r >> 4) % 4 == 0)
+			psxEvqueueRemove((psxEventNum)ev);
+		else
+			psxEvqueueAdd((psxEventNum)ev, (r >> 6) % 3000);
+
+		psxRegs.cycle += rng() % 200;
+
+		// Force a PSXINT_RESET_CYCLE_VAL soon, once per million ops
+		if (i % 1000000 == 7)
+			psxRegs.cycle = 2000000000u - 50;
+
+		while ((psxRegs.cycle - psxRegs.intCycle[PSXINT_NEXT_EVENT].sCycle) >=
+		       psxRegs.intCycle[PSXINT_NEXT_EVENT].cycle)
+			psxEvqueueDispatchAndRemoveFront(&psxRegs);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+
+	printf("hash %016llx  %ld ops  %ld dispatches  %.1f ns/op\n",
+	       dispatch_hash, ops, dispatch_count, ns / ops);
+	return 0;
+}
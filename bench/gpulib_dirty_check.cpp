@@ -0,0 +1,175 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02111-1307 USA.           *
+ ***************************************************************************/
+
+/*
+ * gpulib VRAM dirty tracking check
+ *
+ * Links src/gpu/gpulib/gpu.cpp against a renderer that only records the
+ * commands it is handed, and checks that every fill the renderer executes
+ * also lands in gpu.vram_dirty[], including fills issued while frameskip
+ * is dropping the rest of the command list. vout_update() skips rows that
+ * aren't dirty, so a missed mark shows up as stale lines on screen.
+ *
+ * Exits non-zero on failure.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "psxcommon.h"
+#include "plugin_lib.h"
+#include "perfmon.h"
+#include "gpu/gpulib/gpu.h"
+
+PcsxConfig Config;
+uint32_t hSyncCount, frame_counter;
+struct pmon_subsys_t pmon_subsys;
+struct pl_data_t pl_data;
+
+static int fills_rendered;
+
+// Renderer: consume complete commands, counting fills
+int do_cmd_list(uint32_t *list, int count, int *last_cmd)
+{
+	int pos = 0, cmd = -1;
+	while (pos < count) {
+		cmd = list[pos] >> 24;
+		int len = 1 + cmd_lengths[cmd];
+		if (pos + len > count) {
+			cmd = -1;
+			break;
+		}
+		if (cmd == 0x02)
+			fills_rendered++;
+		pos += len;
+	}
+	*last_cmd = cmd;
+	return pos;
+}
+
+int  renderer_init(void) { return 0; }
+void renderer_finish(void) {}
+void renderer_sync_ecmds(uint32_t *ecmds) {}
+void renderer_update_caches(int x, int y, int w, int h) {}
+void renderer_flush_queues(void) {}
+void renderer_set_interlace(int enable, int is_odd) {}
+void renderer_set_config(const gpulib_config_t *config) {}
+void renderer_notify_res_change(void) {}
+
+void gpu_thread_start(void) {}
+void gpu_thread_stop(void) {}
+void gpu_thread_sync(void) {}
+int  gpu_thread_do_cmd_list(uint32_t *list, int count, int *last_cmd) { return 0; }
+void gpu_thread_sync_ecmds(uint32_t *ecmds) {}
+
+int  vout_init(void) { return 0; }
+int  vout_finish(void) { return 0; }
+void vout_update(void) {}
+void vout_blank(void) {}
+void vout_set_config(const gpulib_config_t *config) {}
+
+void pl_clear_borders(void) {}
+void update_window_size(int w, int h, bool ntsc_fix) {}
+
+static int failures;
+
+// Check that rows y..y+h-1 have every column band covering x..x+w-1 dirty
+static void expect_dirty(const char *what, int x, int y, int w, int h)
+{
+	uint32_t bands = gpu_vram_bands(x, w);
+	for (int row = y; row < y + h; row++) {
+		if ((gpu.vram_dirty[row & 511] & bands) != bands) {
+			printf("FAIL: %s: row %d bands %04x, expected %04x\n",
+			       what, row, gpu.vram_dirty[row & 511], bands);
+			failures++;
+			return;
+		}
+	}
+	printf("ok:   %s\n", what);
+}
+
+static void expect_clean(const char *what)
+{
+	for (int row = 0; row < 512; row++) {
+		if (gpu.vram_dirty[row]) {
+			printf("FAIL: %s: row %d bands %04x, expected clean\n",
+			       what, row, gpu.vram_dirty[row]);
+			failures++;
+			return;
+		}
+	}
+	printf("ok:   %s\n", what);
+}
+
+static void send_fill(int x, int y, int w, int h)
+{
+	uint32_t list[3] = { 0x02000000, (uint32_t)((y << 16) | x), (uint32_t)((h << 16) | w) };
+	GPU_writeDataMem(list, 3);
+}
+
+// Skip drawing to a buffer outside the displayed area, as games do between
+//  flips when frameskip is active
+static void start_skipping(void)
+{
+	gpu.frameskip.active = 1;
+	GPU_writeData(0xe3000000 | (256 << 10));      // draw area starts at y=256
+	memset(gpu.vram_dirty, 0, sizeof(gpu.vram_dirty));
+	fills_rendered = 0;
+}
+
+int main(void)
+{
+	GPU_init();
+
+	// 320x240 display at 0,0
+	GPU_writeStatus(0x08000001);
+	GPU_writeStatus(0x05000000);
+
+	// Fill larger than the display: rendered immediately even when skipping
+	start_skipping();
+	send_fill(0, 256, 640, 256);
+	if (fills_rendered != 1) {
+		printf("FAIL: large fill during frameskip: rendered %d fills, expected 1\n", fills_rendered);
+		failures++;
+	}
+	expect_dirty("large fill during frameskip", 0, 256, 640, 256);
+
+	// Small fill: deferred until frameskip ends on next display flip
+	start_skipping();
+	send_fill(16, 272, 64, 32);
+	if (fills_rendered != 0) {
+		printf("FAIL: small fill during frameskip: rendered %d fills, expected 0\n", fills_rendered);
+		failures++;
+	}
+	expect_clean("small fill during frameskip, before flip");
+	gpu.frameskip.set = 1;                         // skip one frame at a time
+	frame_counter++;
+	GPU_writeStatus(0x05000000 | (256 << 10));    // flip, ends frameskip
+	expect_dirty("small fill during frameskip, after flip", 16, 272, 64, 32);
+
+	// Fill while not skipping
+	gpu.frameskip.active = 0;
+	memset(gpu.vram_dirty, 0, sizeof(gpu.vram_dirty));
+	send_fill(512, 0, 128, 16);
+	expect_dirty("fill without frameskip", 512, 0, 128, 16);
+
+	GPU_shutdown();
+
+	if (failures)
+		printf("%d check(s) failed\n", failures);
+	return failures ? 1 : 0;
+}
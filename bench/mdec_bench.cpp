@@ -0,0 +1,216 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02111-1307 USA.           *
+ ***************************************************************************/
+
+/*
+ * MDEC macroblock decoding benchmark
+ *
+ * Built twice from src/mdec.cpp: mdec_bench_scalar with MDEC_NO_SIMD, and
+ * mdec_bench with vector IDCT and color conversion where the target has
+ * them. Both decode the same RLE streams and print a hash of the decoded
+ * pixels, which must match, and the time per macroblock.
+ *
+ * Streams come from a capture file written by an emulator built with
+ * -DMDEC_CAPTURE: mdec_capture.bin holds every quantization table upload
+ * and decode command sent over DMA0, each as a u32 MDEC command word, a
+ * u32 word count and the data. Without a file, a synthetic 320x240 frame
+ * is decoded at both color depths instead.
+ *
+ * Usage: mdec_bench[_scalar] [capture file] [repeats]
+ */
+
+#include "mdec.cpp"
+
+#include <stdlib.h>
+#include <time.h>
+
+// Rest of the emulator, as far as mdec.cpp needs it
+PcsxConfig Config;
+psxRegisters psxRegs;
+s8 *psxM, *psxH;
+u8 **psxMemRLUT;
+struct pmon_subsys_t pmon_subsys;
+void psxEvqueueAdd(psxEventNum ev, u32 cycles_after) {}
+int freeze_rw(void *file, FreezeMode mode, void *buf, unsigned size) { return 0; }
+
+struct mdec_stream {
+	u32 cmd;
+	u32 words;
+	u16 *data;
+};
+
+static struct mdec_stream *streams;
+static int stream_count;
+
+static void add_stream(u32 cmd, u32 words, const void *data)
+{
+	streams = (struct mdec_stream *)realloc(streams, (stream_count + 1) * sizeof(*streams));
+	struct mdec_stream *st = &streams[stream_count++];
+	st->cmd = cmd;
+	st->words = words;
+	// Pad with end codes, so broken streams don't make rl2blk() run off
+	st->data = (u16 *)malloc(words * 4 + MDEC_MAX_RL * 2 * sizeof(u16));
+	memcpy(st->data, data, words * 4);
+	for (int i = 0; i < MDEC_MAX_RL * 2; i++)
+		st->data[words * 2 + i] = MDEC_END_OF_DATA;
+}
+
+static int load_capture(const char *path)
+{
+	FILE *f = fopen(path, "rb");
+	if (f == NULL) {
+		printf("Can't open %s\n", path);
+		return -1;
+	}
+
+	u32 hdr[2];
+	while (fread(hdr, sizeof(hdr), 1, f) == 1) {
+		void *data = malloc(hdr[1] * 4);
+		if (data == NULL || fread(data, 4, hdr[1], f) != hdr[1]) {
+			printf("Truncated capture file %s\n", path);
+			free(data);
+			fclose(f);
+			return -1;
+		}
+		add_stream(hdr[0], hdr[1], data);
+		free(data);
+	}
+	fclose(f);
+	return 0;
+}
+
+// Quantization table values like those of the PS1 libraries, zigzag order
+static const u8 std_iq[64] = {
+	 2, 16, 19, 22, 26, 27, 29, 34, 16, 16, 22, 24, 27, 29, 34, 37,
+	19, 22, 26, 27, 29, 34, 34, 38, 22, 22, 26, 27, 29, 34, 37, 40,
+	22, 26, 27, 29, 32, 35, 40, 48, 26, 27, 29, 32, 35, 40, 48, 58,
+	26, 27, 29, 34, 38, 46, 56, 69, 27, 29, 35, 38, 46, 56, 69, 83
+};
+
+// 300 macroblocks (320x240) where 15% of blocks hold only a DC coefficient
+//  and the rest up to 20 AC coefficients, thinning out at high frequencies
+static void make_synthetic(void)
+{
+	static u16 rl[300 * MDEC_MAX_RL];
+	u16 *p = rl;
+	u8 iq[128];
+
+	memcpy(iq, std_iq, 64);
+	memcpy(iq + 64, std_iq, 64);
+	add_stream(0x40000001, sizeof(iq) / 4, iq);
+
+	srand(1);
+	for (int b = 0; b < 300 * 6; b++) {
+		*p++ = ((1 + rand() % 8) << 10) | ((rand() % 512 - 256) & 0x3ff);
+		if (rand() % 100 >= 15) {
+			int n = 1 + rand() % 20, k = 0;
+			for (int i = 0; i < n; i++) {
+				int run = rand() % 3;
+				if (k + run + 1 > 63)
+					break;
+				k += run + 1;
+				int v = (rand() % 41 - 20) / (1 + k / 8);
+				*p++ = (run << 10) | ((v ? v : 1) & 0x3ff);
+			}
+		}
+		*p++ = MDEC_END_OF_DATA;
+	}
+	if ((p - rl) & 1)
+		*p++ = MDEC_END_OF_DATA;
+
+	u32 words = (p - rl) / 2;
+	add_stream(0x30000000 | words, words, rl);                 // 24-bit
+	add_stream(0x38000000 | words, words, rl);                 // 15-bit
+}
+
+static u8 image[16*16*3];
+static unsigned long long pixel_hash;
+
+// Decode all streams once, returns number of macroblocks decoded
+static long decode_all(bool hash)
+{
+	int blk[DSIZE2 * 6];
+	long macroblocks = 0;
+
+	for (int s = 0; s < stream_count; s++) {
+		struct mdec_stream *st = &streams[s];
+
+		if ((st->cmd >> 28) == 0x4) {
+			iqtab_init(iq_y, (u8 *)st->data);
+			iqtab_init(iq_uv, (u8 *)st->data + 64);
+			continue;
+		}
+
+		// Same end of data test as mdec1Interrupt()
+		boolean rgb15 = (st->cmd & MDEC0_RGB24) ? TRUE : FALSE;
+		int size = rgb15 ? SIZE_OF_16B_BLOCK : SIZE_OF_24B_BLOCK;
+		u16 *rl = st->data, *rl_end = st->data + st->words * 2;
+		while (rl < rl_end && SWAP16(*rl) != MDEC_END_OF_DATA) {
+			rl = mdec_decode(blk, rl, image, rgb15);
+			macroblocks++;
+			if (hash) {
+				for (int i = 0; i < size; i++)
+					pixel_hash = (pixel_hash ^ image[i]) * 1099511628211ULL;
+			}
+		}
+	}
+	return macroblocks;
+}
+
+int main(int argc, char **argv)
+{
+	const char *path = NULL;
+	int repeats = 100;
+
+	if (argc > 1)
+		path = argv[1];
+	if (argc > 2)
+		repeats = atoi(argv[2]);
+	if (repeats <= 0) {
+		printf("Usage: %s [capture file] [repeats]\n", argv[0]);
+		return 1;
+	}
+
+	if (path) {
+		if (load_capture(path) != 0)
+			return 1;
+	} else {
+		make_synthetic();
+	}
+
+	pixel_hash = 1469598103934665603ULL;
+	long macroblocks = decode_all(true);
+	if (macroblocks == 0) {
+		printf("No macroblocks to decode\n");
+		return 1;
+	}
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int r = 0; r < repeats; r++)
+		decode_all(false);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+
+#ifdef MDEC_USE_SIMD
+	const char *impl = "vector";
+#else
+	const char *impl = "scalar";
+#endif
+	printf("%s: hash %016llx  %ld macroblocks  %.0f ns/macroblock\n",
+	       impl, pixel_hash, macroblocks, ns / ((double)macroblocks * repeats));
+	return 0;
+}
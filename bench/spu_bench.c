@@ -0,0 +1,207 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02111-1307 USA.           *
+ ***************************************************************************/
+
+/*
+ * Offline SPU mixing benchmark
+ *
+ * Built twice from spu_pcsxrearmed: spu_bench_scalar with SPU_NO_SIMD, and
+ * spu_bench with vector mixing, reverb and output scaling where the target
+ * has them. Both play 24 voices of pseudo-random ADPCM data with noise
+ * and reverb on, FMod on for every other stretch, with pitch changes and
+ * key on/off in between, mix it all through do_samples() without any audio
+ * output, and print a hash of the output samples, which must match, and the
+ * CPU time taken.
+ *
+ * The input is synthetic, not captured from games, so the timings only
+ * compare builds against each other. No captured register streams exist
+ * in the tree to replay.
+ *
+ * With worker threads the run is first done without them, and the bench
+ * fails if the threaded hash differs from that one.
+ *
+ * Usage: spu_bench[_scalar] [threads] [interpolation] [steps]
+ */
+
+#include "spu.c"
+
+#include <time.h>
+
+// No audio output
+static int null_busy(void) { return 0; }
+static void null_feed(void *data, int bytes) {}
+static void null_finish(void) {}
+static struct out_driver null_out = { "null", NULL, null_finish, null_busy, null_feed };
+struct out_driver *out_current = &null_out;
+void SetupSound(void) {}
+
+static unsigned rng_state = 1;
+static unsigned rng(void)
+{
+	rng_state = rng_state * 1103515245 + 12345;
+	return rng_state >> 8;
+}
+
+static unsigned long long sample_hash;
+static long sample_count;
+
+// Hash output produced so far and rewind the buffer
+static void collect(void)
+{
+	short *p;
+	for (p = (short *)spu.pSpuBuffer; p < spu.pS; p++)
+		sample_hash = (sample_hash ^ (unsigned short)*p) * 1099511628211ULL;
+	sample_count += spu.pS - (short *)spu.pSpuBuffer;
+	spu.pS = (short *)spu.pSpuBuffer;
+}
+
+// Voices the pitch and key changes leave alone: noise and FMod ones
+static int changeable(int ch)
+{
+	return ch != 5 && ch != 9 && ch != 10;
+}
+
+// Mix 'steps' steps from power on, returns the output hash
+static unsigned long long run(int threads, int interpolation, int steps)
+{
+	unsigned cycle = 0;
+	int i, ch, step;
+
+	memset(&spu, 0, sizeof(spu));
+	memset(iFMod, 0, sizeof(iFMod));
+	rng_state = 1;
+	sample_hash = 1469598103934665603ULL;
+	sample_count = 0;
+
+	spu_config.iUseThread = threads;
+	spu_config.iVolume = 1024;
+	spu_config.iUseReverb = 1;
+	spu_config.iUseInterpolation = interpolation;
+	spu_config.iHaveConfiguration = 1;
+	SPUinit();
+
+	// Random ADPCM blocks, looping every 4KB
+	for (i = 0x1000; i < 0x80000; i += 16) {
+		unsigned char *b = spu.spuMemC + i;
+		int j;
+		b[0] = (rng() % 5) << 4 | (rng() % 16);
+		b[1] = 0;
+		for (j = 2; j < 16; j++)
+			b[j] = rng();
+		if ((i & 0xfff) == 0xff0)
+			b[1] = 3;
+		if ((i & 0xfff) == 0x000)
+			b[1] = 4;
+	}
+
+	SPUwriteRegister(H_SPUctrl, 0xc080 | (3 << 8), cycle);
+	SPUwriteRegister(H_SPUmvolL, 0x3fff, cycle);
+	SPUwriteRegister(H_SPUmvolR, 0x3fff, cycle);
+	SPUwriteRegister(H_SPUrvolL, 0x2000, cycle);
+	SPUwriteRegister(H_SPUrvolR, 0x2000, cycle);
+	SPUwriteRegister(H_SPUReverbAddr, 0xe000, cycle);
+	for (i = 0; i < 32; i += 2)
+		SPUwriteRegister(H_Reverb + i, 0x1000 + rng() % 0x1000, cycle);
+	SPUwriteRegister(H_Noise1, 1 << 5, cycle);
+	SPUwriteRegister(H_RVBon1, 0x5555, cycle);
+	SPUwriteRegister(H_RVBon2, 0x55, cycle);
+
+	for (ch = 0; ch < 24; ch++) {
+		int base = 0xc00 + ch * 16;
+		SPUwriteRegister(base + 0, rng() % 0x3fff, cycle);                  // volume
+		SPUwriteRegister(base + 2, rng() % 0x3fff, cycle);
+		SPUwriteRegister(base + 4, 0x400 + rng() % 0x1800, cycle);          // pitch
+		SPUwriteRegister(base + 6, (0x1000 + (rng() % 0x70) * 0x1000) >> 3, cycle);
+		SPUwriteRegister(base + 8, 0x80ff, cycle);                          // ADSR
+		SPUwriteRegister(base + 10, 0x1fc0 | (rng() % 32), cycle);
+	}
+	SPUwriteRegister(H_SPUon1, 0xffff, cycle);
+	SPUwriteRegister(H_SPUon2, 0xff, cycle);
+
+	clock_t start = clock();
+
+	for (step = 0; step < steps; step++) {
+		cycle += 768 * (16 + rng() % 300);
+
+		// FMod steps are always mixed on this thread, so alternate
+		if (step % 2000 == 0)
+			SPUwriteRegister(H_FMod1, (step / 2000 % 2) ? 0 : 1 << 9, cycle);
+
+		ch = rng() % 24;
+		if (rng() % 4 == 0 && changeable(ch))
+			SPUwriteRegister(0xc04 + ch * 16, 0x400 + rng() % 0x1800, cycle);
+		ch = rng() % 24;
+		if (rng() % 50 == 0 && changeable(ch))
+			SPUwriteRegister(ch < 16 ? H_SPUon1 : H_SPUon2, 1 << (ch & 15), cycle);
+		ch = rng() % 24;
+		if (rng() % 60 == 0 && changeable(ch))
+			SPUwriteRegister(ch < 16 ? H_SPUoff1 : H_SPUoff2, 1 << (ch & 15), cycle);
+
+		do_samples(cycle, 0);
+
+		// Output buffer holds a frame or so, drain it like SPUasync() does
+		if (step % 8 == 7) {
+			if (worker)
+				sync_worker_thread(1);
+			collect();
+		}
+	}
+	if (worker)
+		sync_worker_thread(1);
+	collect();
+
+	double secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+#ifdef SPU_USE_SIMD
+	const char *impl = "vector";
+#else
+	const char *impl = "scalar";
+#endif
+	printf("%s, %d thread(s), interpolation %d: hash %016llx  %ld samples  "
+	       "%.2fs CPU (%.1f x realtime)\n",
+	       impl, spu_config.iThreadAvail, interpolation, sample_hash,
+	       sample_count, secs, sample_count / 2 / 44100.0 / secs);
+
+	SPUshutdown();
+	return sample_hash;
+}
+
+int main(int argc, char **argv)
+{
+	int threads = (argc > 1) ? atoi(argv[1]) : 0;
+	int interpolation = (argc > 2) ? atoi(argv[2]) : 2;
+	int steps = (argc > 3) ? atoi(argv[3]) : 20000;
+	unsigned long long ref;
+
+	if (threads < 0 || threads > SPU_MAX_THREADS || interpolation < 0 ||
+	    interpolation > 3 || steps <= 0) {
+		printf("Usage: %s [threads 0..%d] [interpolation 0..3] [steps]\n",
+		       argv[0], SPU_MAX_THREADS);
+		return 1;
+	}
+
+	if (threads == 0) {
+		run(0, interpolation, steps);
+		return 0;
+	}
+
+	ref = run(0, interpolation, steps);
+	if (run(threads, interpolation, steps) != ref) {
+		printf("FAIL: hash differs from the unthreaded one\n");
+		return 1;
+	}
+	return 0;
+}
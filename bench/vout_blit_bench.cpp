@@ -0,0 +1,120 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02111-1307 USA.           *
+ ***************************************************************************/
+
+/*
+ * vout_port row blitter microbenchmark
+ *
+ * For each PS1 display width, times the scalar blitter and the one
+ * vout_get_blitter() selects, over rows of random 15-bit and 24-bit VRAM,
+ * and checks that both give identical output. Vector blitters are only
+ * built when the compiler targets SSSE3 or NEON, e.g. C_ARCH=-mssse3.
+ *
+ * Usage: vout_blit_bench [rows]
+ */
+
+#include "gpu/gpulib/vout_port.cpp"
+
+#include <stdlib.h>
+#include <time.h>
+
+// Rest of the emulator, as far as vout_port.cpp needs it
+PcsxConfig Config;
+struct psx_gpu gpu;
+gpu_unai_config_t gpu_unai_config_ext;
+struct pmon_subsys_t pmon_subsys;
+unsigned short *SCREEN;
+int SCREEN_WIDTH, SCREEN_HEIGHT;
+void video_flip(void) {}
+
+static u16 vram_rows[1024 * 512 + 4096] __attribute__((aligned(16)));
+static u16 out_scalar[400], out_chosen[400];
+
+static const struct {
+	int w;
+	bool smooth;
+	vout_blit_fn scalar;
+} widths[] = {
+	{ 256, false, GPU_BlitWWDWW },
+	{ 320, false, GPU_BlitWW },
+	{ 368, false, GPU_BlitWWWWWWWWS_Clip4 },
+	{ 384, false, GPU_BlitWWWWWS },
+	{ 512, false, GPU_BlitWWSWWSWS },
+	{ 512, true,  GPU_BlitWWSWWSWS_Smooth },
+	{ 640, false, GPU_BlitWS },
+	{ 640, true,  GPU_BlitWS_Smooth },
+};
+
+static double ns_per_row(vout_blit_fn fn, bool rgb24, int rows, u16 *dst)
+{
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < rows; i++)
+		fn(vram_rows + (i & 255) * 1024, dst, rgb24);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / rows;
+}
+
+int main(int argc, char **argv)
+{
+	int rows = (argc > 1) ? atoi(argv[1]) : 200000;
+	if (rows <= 0) {
+		printf("Usage: %s [rows]\n", argv[0]);
+		return 1;
+	}
+
+	srand(1);
+	for (unsigned i = 0; i < sizeof(vram_rows) / sizeof(vram_rows[0]); i++)
+		vram_rows[i] = rand();
+
+#ifdef VOUT_USE_SIMD
+	printf("vector blitters: on\n");
+#else
+	printf("vector blitters: off\n");
+#endif
+	printf("width        bpp   scalar ns/row   selected ns/row\n");
+
+	int mismatches = 0;
+	for (unsigned t = 0; t < sizeof(widths) / sizeof(widths[0]); t++) {
+		vout_blit_fn chosen = vout_get_blitter(widths[t].w, widths[t].smooth);
+
+		for (int rgb24 = 0; rgb24 < 2; rgb24++) {
+			for (int row = 0; row < 256; row++) {
+				const u16 *src = vram_rows + row * 1024 + (row & 1);
+				memset(out_scalar, 0xcc, sizeof(out_scalar));
+				memset(out_chosen, 0xcc, sizeof(out_chosen));
+				widths[t].scalar(src, out_scalar, rgb24);
+				chosen(src, out_chosen, rgb24);
+				if (memcmp(out_scalar, out_chosen, sizeof(out_scalar)) != 0)
+					mismatches++;
+			}
+
+			double scalar_ns = ns_per_row(widths[t].scalar, rgb24, rows, out_scalar);
+			printf("%d%-7s  %2d   %13.1f   ", widths[t].w,
+			       widths[t].smooth ? " smooth" : "", rgb24 ? 24 : 15, scalar_ns);
+			if (chosen == widths[t].scalar)
+				printf("%15s\n", "(scalar)");
+			else
+				printf("%15.1f\n", ns_per_row(chosen, rgb24, rows, out_chosen));
+		}
+	}
+
+	if (mismatches) {
+		printf("%d rows differ from scalar output\n", mismatches);
+		return 1;
+	}
+	return 0;
+}
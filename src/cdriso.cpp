@@ -26,6 +26,7 @@
 #include "cdrom.h"
 #include "cdriso.h"
 #include "ppf.h"
+#include "perfmon.h"
 
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
@@ -37,6 +38,14 @@
 #define ftello ftell
 #else // UNIX:
 #include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Map uncompressed images into memory, see cdimg_mmap_open()
+#define CDR_MMAP
+
+// Read sectors ahead on a separate thread, see cdra_read()
+#define CDR_READAHEAD
 #endif
 
 #include <sys/time.h>
@@ -44,6 +53,10 @@
 #include <errno.h>
 #include <zlib.h>
 
+#ifdef HAVE_CHD
+#include <libchdr/chd.h>
+#endif
+
 #define OFF_T_MSB ((off_t)1 << (sizeof(off_t) * 8 - 1))
 
 static FILE *cdHandle = NULL;
@@ -87,18 +100,77 @@ static unsigned int pregapOffset;
 #define cddaCurPos cdda_cur_sector
 
 // compressed image stuff
+#define COMPR_BUFF_SIZE		(CD_FRAMESIZE_RAW * 16 + 100)
+
+// Decompressed blocks are kept in an LRU cache of cdrIsoCacheSectors
+//  sectors, at least COMPR_MIN_BLOCKS blocks. Worker threads inflate
+//  COMPR_AHEAD_SECTORS following the last sector read ahead of time.
+#define COMPR_MIN_BLOCKS	8
+#define COMPR_AHEAD_SECTORS	64
+#define COMPR_WORKERS		2
+
+unsigned int cdrIsoCacheSectors = 512;
+
+enum { COMPR_READY, COMPR_BUSY, COMPR_ERROR };
+
+struct compr_entry {
+	int block;		// -1 if unused
+	int state;
+	unsigned int last_use;
+	unsigned char *data;	// 1 << block_shift frames of frame_size bytes
+};
+
+// What a thread needs to fill cache entries on its own
+struct compr_ctx {
+	unsigned char *buff_compressed;
+	z_stream z;
+#ifdef HAVE_CHD
+	chd_file *chd;
+#endif
+};
+
 typedef struct {
-	unsigned char buff_raw[16][CD_FRAMESIZE_RAW];
-	unsigned char buff_compressed[CD_FRAMESIZE_RAW * 16 + 100];
+	unsigned char buff_compressed[COMPR_BUFF_SIZE];
 	off_t *index_table;
 	unsigned int index_len;
 	unsigned int block_shift;
-	unsigned int current_block;
-	unsigned int sector_in_blk;
+	unsigned int frame_size;	// CD_FRAMESIZE_RAW, plus subcode for CHD
+#ifdef HAVE_CHD
+	chd_file *chd;			// index_table is unused if set
+#endif
+
+	struct compr_entry *cache;
+	unsigned int cache_len;
+	unsigned char *cache_data;
+	int *block_map;			// Block -> cache entry, or -1
+	unsigned int use_ctr;
+	struct compr_entry *cur_entry;	// Holds sector last read to cdbuffer
+	unsigned char *cur_sector;
+
+#ifdef CDR_READAHEAD
+	pthread_mutex_t lock;		// Protects all of the above cache state
+	pthread_mutex_t fill_lock;	// Protects buff_compressed
+	pthread_cond_t cond_work;	// Signalled when 'want' changes
+	pthread_cond_t cond_done;	// Signalled when a block was filled
+	pthread_t workers[COMPR_WORKERS];
+	int worker_count;
+	int want;			// First block workers should have ready
+	int ahead;			// Number of blocks from 'want' on
+	boolean exit_thread;
+	boolean threads_started;
+#endif
 } COMPR_IMG;
 
 static COMPR_IMG *compr_img;
 
+#ifdef CDR_READAHEAD
+#define COMPR_LOCK()		pthread_mutex_lock(&compr_img->lock)
+#define COMPR_UNLOCK()		pthread_mutex_unlock(&compr_img->lock)
+#else
+#define COMPR_LOCK()
+#define COMPR_UNLOCK()
+#endif
+
 int (*cdimg_read_func)(FILE *f, unsigned int base, void *dest, int sector);
 
 char* CDR__getDriveLetter(void);
@@ -1068,7 +1140,7 @@ static int handlepbp(const char *isofile) {
 		goto fail_io;
 
 	compr_img->block_shift = 4;
-	compr_img->current_block = (unsigned int)-1;
+	compr_img->frame_size = CD_FRAMESIZE_RAW;
 
 	compr_img->index_len = (0x100000 - 0x4000) / sizeof(index_entry);
 	compr_img->index_table = (off_t *)malloc((compr_img->index_len + 1) *
@@ -1150,7 +1222,7 @@ static int handlecbin(const char *isofile) {
 		goto fail_io;
 
 	compr_img->block_shift = 0;
-	compr_img->current_block = (unsigned int)-1;
+	compr_img->frame_size = CD_FRAMESIZE_RAW;
 
 	compr_img->index_len = ciso_hdr.total_bytes / ciso_hdr.block_size;
 	index_table = (unsigned int *)malloc((compr_img->index_len + 1) * sizeof(index_table[0]));
@@ -1189,6 +1261,108 @@ fail_io:
 	return -1;
 }
 
+#ifdef HAVE_CHD
+// Tracks in CHD are padded to a multiple of this many frames
+#define CHD_TRACK_PADDING	4
+
+// libchdr's CDROM_TRACK_METADATA_FORMAT and CDROM_TRACK_METADATA2_FORMAT,
+//  with string lengths limited to the buffers in handlechd()
+#define CHD_TRACK_META_FORMAT	"TRACK:%d TYPE:%63s SUBTYPE:%31s FRAMES:%d"
+#define CHD_TRACK_META2_FORMAT	"TRACK:%d TYPE:%63s SUBTYPE:%31s FRAMES:%d " \
+				"PREGAP:%d PGTYPE:%31s PGSUB:%31s POSTGAP:%d"
+
+static int handlechd(const char *isofile) {
+	const chd_header *header;
+	chd_file *chd = NULL;
+	unsigned int frame_offset = 0, disc_pos = 2 * 75;
+	unsigned int sectors_per_hunk;
+	int block_shift;
+
+	if (chd_open(isofile, CHD_OPEN_READ, NULL, &chd) != CHDERR_NONE)
+		return -1;
+
+	header = chd_get_header(chd);
+	sectors_per_hunk = header->hunkbytes / (CD_FRAMESIZE_RAW + SUB_FRAMESIZE);
+	for (block_shift = 0; (1u << block_shift) < sectors_per_hunk; block_shift++);
+	if (sectors_per_hunk == 0 || (1u << block_shift) != sectors_per_hunk ||
+	    header->hunkbytes != sectors_per_hunk * (CD_FRAMESIZE_RAW + SUB_FRAMESIZE)) {
+		printf("unsupported CHD hunk size %u\n", header->hunkbytes);
+		goto fail_io;
+	}
+
+	numtracks = 0;
+	memset(ti, 0, sizeof(ti));
+
+	while (numtracks < MAXTRACKS - 1) {
+		char meta[256], type[64], subtype[32], pgtype[32], pgsub[32];
+		int track = 0, frames = 0, pregap = 0, postgap = 0;
+		unsigned int file_start, length;
+		uint32_t meta_size;
+
+		type[0] = subtype[0] = pgtype[0] = pgsub[0] = '\0';
+		meta[sizeof(meta) - 1] = '\0';
+		if (chd_get_metadata(chd, CDROM_TRACK_METADATA2_TAG, numtracks, meta,
+				sizeof(meta) - 1, &meta_size, NULL, NULL) == CHDERR_NONE)
+			sscanf(meta, CHD_TRACK_META2_FORMAT, &track, type, subtype,
+				&frames, &pregap, pgtype, pgsub, &postgap);
+		else if (chd_get_metadata(chd, CDROM_TRACK_METADATA_TAG, numtracks, meta,
+				sizeof(meta) - 1, &meta_size, NULL, NULL) == CHDERR_NONE)
+			sscanf(meta, CHD_TRACK_META_FORMAT, &track, type, subtype,
+				&frames);
+		else
+			break;
+
+		numtracks++;
+		ti[numtracks].type = !strncmp(type, "AUDIO", 5) ? CDDA : DATA;
+
+		// Pregap is only in image if its type starts with 'V'
+		file_start = frame_offset;
+		length = frames;
+		if (pgtype[0] == 'V') {
+			file_start += pregap;
+			length -= pregap;
+		}
+
+		disc_pos += pregap;
+		sec2msf(disc_pos, ti[numtracks].start);
+		sec2msf(length, ti[numtracks].length);
+		ti[numtracks].start_offset = file_start * CD_FRAMESIZE_RAW;
+		disc_pos += length + postgap;
+
+		if (numtracks == 1 && strcmp(subtype, "NONE") != 0) {
+			subChanMixed = TRUE;
+			subChanRaw = !strcmp(subtype, "RW_RAW");
+		}
+
+		frame_offset += (frames + CHD_TRACK_PADDING - 1) & ~(CHD_TRACK_PADDING - 1);
+	}
+
+	if (numtracks == 0) {
+		printf("no tracks in CHD\n");
+		goto fail_io;
+	}
+
+	compr_img = (COMPR_IMG *)calloc(1, sizeof(*compr_img));
+	if (compr_img == NULL)
+		goto fail_io;
+
+	compr_img->chd = chd;
+	compr_img->block_shift = block_shift;
+	compr_img->frame_size = CD_FRAMESIZE_RAW + SUB_FRAMESIZE;
+	compr_img->index_len = header->hunkcount;
+
+	// CD audio is stored big-endian
+	cddaBigEndian = TRUE;
+
+	return 0;
+
+fail_io:
+	chd_close(chd);
+	numtracks = 0;
+	return -1;
+}
+#endif // HAVE_CHD
+
 // this function tries to get the .sub file of the given .img
 static int opensubfile(const char *isoname) {
 	char		subname[MAXPATHLEN];
@@ -1254,105 +1428,354 @@ static int cdread_sub_mixed(FILE *f, unsigned int base, void *dest, int sector)
 	return ret;
 }
 
-static int uncompress2(void *out, unsigned long *out_size, void *in, unsigned long in_size)
+static int uncompress2(z_stream *z, void *out, unsigned long *out_size, void *in, unsigned long in_size)
 {
-	static z_stream z;
 	int ret = 0;
 
-	if (z.zalloc == NULL) {
-		// XXX: one-time leak here..
-		z.next_in = Z_NULL;
-		z.avail_in = 0;
-		z.zalloc = Z_NULL;
-		z.zfree = Z_NULL;
-		z.opaque = Z_NULL;
-		ret = inflateInit2(&z, -15);
+	if (z->zalloc == NULL) {
+		z->next_in = Z_NULL;
+		z->avail_in = 0;
+		z->zalloc = Z_NULL;
+		z->zfree = Z_NULL;
+		z->opaque = Z_NULL;
+		ret = inflateInit2(z, -15);
 	}
 	else
-		ret = inflateReset(&z);
+		ret = inflateReset(z);
 	if (ret != Z_OK)
 		return ret;
 
-	z.next_in = (Bytef *)in;
-	z.avail_in = in_size;
-	z.next_out = (Bytef *)out;
-	z.avail_out = *out_size;
+	z->next_in = (Bytef *)in;
+	z->avail_in = in_size;
+	z->next_out = (Bytef *)out;
+	z->avail_out = *out_size;
 
-	ret = inflate(&z, Z_NO_FLUSH);
-	//inflateEnd(&z);
+	ret = inflate(z, Z_NO_FLUSH);
 
-	*out_size -= z.avail_out;
+	*out_size -= z->avail_out;
 	return ret == 1 ? 0 : ret;
 }
 
-static int cdread_compressed(FILE *f, unsigned int base, void *dest, int sector)
+static int compr_read_at(void *buf, size_t size, off_t offs)
+{
+#ifdef CDR_READAHEAD
+	// Workers read concurrently, so no shared file position
+	return pread(fileno(cdHandle), buf, size, offs) == (ssize_t)size ? 0 : -1;
+#else
+	if (fseeko(cdHandle, offs, SEEK_SET) != 0)
+		return -1;
+	return fread(buf, 1, size, cdHandle) == size ? 0 : -1;
+#endif
+}
+
+// Read and inflate a block into cache entry 'e'. Runs on emulation
+//  thread or a worker, each with its own context.
+static int compr_fill(struct compr_entry *e, int block, struct compr_ctx *ctx,
+		boolean verbose)
 {
 	unsigned long cdbuffer_size, cdbuffer_size_expect;
 	unsigned int size;
 	int is_compressed;
 	off_t start_byte;
-	int ret, block;
-
-	if (base)
-		sector += base / CD_FRAMESIZE_RAW;
-
-	block = sector >> compr_img->block_shift;
-	compr_img->sector_in_blk = sector & ((1 << compr_img->block_shift) - 1);
-
-	if (block == compr_img->current_block) {
-		//printf("hit sect %d\n", sector);
-		goto finish;
-	}
+	int ret;
 
-	if (sector >= compr_img->index_len * 16) {
-		printf("sector %d is past img end\n", sector);
-		return -1;
+#ifdef HAVE_CHD
+	if (ctx->chd != NULL) {
+		ret = chd_read(ctx->chd, block, e->data);
+		if (ret != CHDERR_NONE) {
+			if (verbose)
+				printf("chd_read failed with %d for hunk %d\n", ret, block);
+			return -1;
+		}
+		return 0;
 	}
+#endif
 
 	start_byte = compr_img->index_table[block] & ~OFF_T_MSB;
-	if (fseeko(cdHandle, start_byte, SEEK_SET) != 0) {
-		printf("seek error for block %d at %llx: ",
-			block, (long long)start_byte);
-		perror(NULL);
-		return -1;
-	}
-
 	is_compressed = !(compr_img->index_table[block] & OFF_T_MSB);
 	size = (compr_img->index_table[block + 1] & ~OFF_T_MSB) - start_byte;
-	if (size > sizeof(compr_img->buff_compressed)) {
-		printf("block %d is too large: %u\n", block, size);
+	if (size > COMPR_BUFF_SIZE) {
+		if (verbose)
+			printf("block %d is too large: %u\n", block, size);
 		return -1;
 	}
 
-	if (fread(is_compressed ? compr_img->buff_compressed : compr_img->buff_raw[0],
-				1, size, cdHandle) != size) {
-		printf("read error for block %d at %lx: ", block, start_byte);
-		perror(NULL);
+	if (compr_read_at(is_compressed ? ctx->buff_compressed : e->data, size, start_byte) != 0) {
+		if (verbose) {
+			printf("read error for block %d at %llx: ", block, (long long)start_byte);
+			perror(NULL);
+		}
 		return -1;
 	}
 
 	if (is_compressed) {
-		cdbuffer_size_expect = sizeof(compr_img->buff_raw[0]) << compr_img->block_shift;
+		cdbuffer_size_expect = compr_img->frame_size << compr_img->block_shift;
 		cdbuffer_size = cdbuffer_size_expect;
-		ret = uncompress2(compr_img->buff_raw[0], &cdbuffer_size, compr_img->buff_compressed, size);
+		ret = uncompress2(&ctx->z, e->data, &cdbuffer_size, ctx->buff_compressed, size);
 		if (ret != 0) {
-			printf("uncompress failed with %d for block %d, sector %d\n",
-					ret, block, sector);
+			if (verbose)
+				printf("uncompress failed with %d for block %d\n", ret, block);
 			return -1;
 		}
-		if (cdbuffer_size != cdbuffer_size_expect)
-			printf("cdbuffer_size: %lu != %lu, sector %d\n", cdbuffer_size,
-					cdbuffer_size_expect, sector);
+		if (verbose && cdbuffer_size != cdbuffer_size_expect)
+			printf("cdbuffer_size: %lu != %lu, block %d\n", cdbuffer_size,
+					cdbuffer_size_expect, block);
 	}
 
-	// done at last!
-	compr_img->current_block = block;
+	return 0;
+}
+
+// Least recently used entry that may be replaced, caller holds lock.
+//  Blocks in [keep_first, keep_end) aren't evicted.
+static struct compr_entry *compr_evict(int keep_first, int keep_end)
+{
+	struct compr_entry *e, *best = NULL;
 
-finish:
-	if (dest != cdbuffer) // copy avoid HACK
-		memcpy(dest, compr_img->buff_raw[compr_img->sector_in_blk],
-			CD_FRAMESIZE_RAW);
-	return CD_FRAMESIZE_RAW;
+	for (e = compr_img->cache; e < compr_img->cache + compr_img->cache_len; e++) {
+		if (e->state == COMPR_BUSY || e == compr_img->cur_entry)
+			continue;
+		if (e->block >= keep_first && e->block < keep_end)
+			continue;
+		if (e->block < 0)
+			return e;
+		if (best == NULL || (int)(e->last_use - best->last_use) < 0)
+			best = e;
+	}
+
+	return best;
+}
+
+// Assign entry to block, caller holds lock
+static void compr_claim(struct compr_entry *e, int block)
+{
+	if (e->block >= 0)
+		compr_img->block_map[e->block] = -1;
+	compr_img->block_map[block] = e - compr_img->cache;
+	e->block = block;
+	e->state = COMPR_BUSY;
+	e->last_use = compr_img->use_ctr;
+}
+
+#ifdef CDR_READAHEAD
+// Inflates blocks following the last one read, so they're ready in time
+static void *compr_worker(void *param)
+{
+	struct compr_ctx ctx;
+
+	memset(&ctx, 0, sizeof(ctx));
+#ifdef HAVE_CHD
+	// libchdr handles can't be shared between threads
+	if (compr_img->chd != NULL) {
+		if (chd_open(GetIsoFile(), CHD_OPEN_READ, NULL, &ctx.chd) != CHDERR_NONE)
+			return NULL;
+	} else
+#endif
+	{
+		ctx.buff_compressed = (unsigned char *)malloc(COMPR_BUFF_SIZE);
+		if (ctx.buff_compressed == NULL)
+			return NULL;
+	}
+
+	pthread_mutex_lock(&compr_img->lock);
+	while (!compr_img->exit_thread) {
+		int end = compr_img->want + compr_img->ahead;
+		int block;
+
+		if (end > (int)compr_img->index_len)
+			end = compr_img->index_len;
+		for (block = compr_img->want; block < end; block++)
+			if (compr_img->block_map[block] < 0)
+				break;
+
+		struct compr_entry *e = NULL;
+		if (block < end)
+			e = compr_evict(compr_img->want, end);
+		if (e == NULL) {
+			pthread_cond_wait(&compr_img->cond_work, &compr_img->lock);
+			continue;
+		}
+
+		compr_claim(e, block);
+		pthread_mutex_unlock(&compr_img->lock);
+
+		int ret = compr_fill(e, block, &ctx, FALSE);
+
+		pthread_mutex_lock(&compr_img->lock);
+		e->state = (ret == 0) ? COMPR_READY : COMPR_ERROR;
+		pthread_cond_broadcast(&compr_img->cond_done);
+	}
+	pthread_mutex_unlock(&compr_img->lock);
+
+	if (ctx.z.zalloc != NULL)
+		inflateEnd(&ctx.z);
+	free(ctx.buff_compressed);
+#ifdef HAVE_CHD
+	if (ctx.chd != NULL)
+		chd_close(ctx.chd);
+#endif
+	return NULL;
+}
+#endif
+
+static int cdread_compressed(FILE *f, unsigned int base, void *dest, int sector)
+{
+	static struct compr_ctx ctx;
+	struct compr_entry *e;
+	int ret = 0, block, sector_in_blk;
+
+	if (base)
+		sector += base / CD_FRAMESIZE_RAW;
+
+	block = sector >> compr_img->block_shift;
+	sector_in_blk = sector & ((1 << compr_img->block_shift) - 1);
+
+	if (block >= (int)compr_img->index_len) {
+		printf("sector %d is past img end\n", sector);
+		return -1;
+	}
+
+	COMPR_LOCK();
+	compr_img->use_ctr++;
+
+#ifdef CDR_READAHEAD
+	// Wait for worker if it's busy with this very block
+	while (compr_img->block_map[block] >= 0 &&
+	       compr_img->cache[compr_img->block_map[block]].state == COMPR_BUSY)
+		pthread_cond_wait(&compr_img->cond_done, &compr_img->lock);
+#endif
+
+	if (compr_img->block_map[block] >= 0 &&
+	    compr_img->cache[compr_img->block_map[block]].state == COMPR_READY) {
+		e = &compr_img->cache[compr_img->block_map[block]];
+		e->last_use = compr_img->use_ctr;
+	} else {
+		if (compr_img->block_map[block] >= 0)
+			e = &compr_img->cache[compr_img->block_map[block]];
+		else
+			e = compr_evict(-1, -1);
+		compr_claim(e, block);
+		COMPR_UNLOCK();
+
+		// CDDA thread reads from here too
+#ifdef CDR_READAHEAD
+		pthread_mutex_lock(&compr_img->fill_lock);
+#endif
+		ctx.buff_compressed = compr_img->buff_compressed;
+#ifdef HAVE_CHD
+		ctx.chd = compr_img->chd;
+#endif
+		ret = compr_fill(e, block, &ctx, TRUE);
+#ifdef CDR_READAHEAD
+		pthread_mutex_unlock(&compr_img->fill_lock);
+#endif
+		if (ret != 0)
+			printf("failed to read sector %d\n", sector);
+
+		COMPR_LOCK();
+		e->state = (ret == 0) ? COMPR_READY : COMPR_ERROR;
+#ifdef CDR_READAHEAD
+		pthread_cond_broadcast(&compr_img->cond_done);
+#endif
+	}
+
+	if (ret == 0) {
+		unsigned char *p = e->data + sector_in_blk * compr_img->frame_size;
+
+		if (dest != cdbuffer) // copy avoid HACK
+			memcpy(dest, p, CD_FRAMESIZE_RAW);
+		else {
+			compr_img->cur_entry = e;
+			compr_img->cur_sector = p;
+
+			// CHD frames carry subcode after sector data
+			if (subChanMixed && compr_img->frame_size > CD_FRAMESIZE_RAW) {
+				memcpy(subbuffer, p + CD_FRAMESIZE_RAW, SUB_FRAMESIZE);
+				if (subChanRaw) DecodeRawSubData();
+			}
+		}
+	}
+
+#ifdef CDR_READAHEAD
+	if (compr_img->want != block + 1) {
+		compr_img->want = block + 1;
+		pthread_cond_broadcast(&compr_img->cond_work);
+	}
+#endif
+	COMPR_UNLOCK();
+
+	return ret == 0 ? CD_FRAMESIZE_RAW : -1;
+}
+
+static int compr_cache_init(void)
+{
+	unsigned int i, blk_size = compr_img->frame_size << compr_img->block_shift;
+
+	compr_img->cache_len = cdrIsoCacheSectors >> compr_img->block_shift;
+	if (compr_img->cache_len < COMPR_MIN_BLOCKS)
+		compr_img->cache_len = COMPR_MIN_BLOCKS;
+
+	compr_img->cache = (struct compr_entry *)calloc(compr_img->cache_len, sizeof(compr_img->cache[0]));
+	compr_img->cache_data = (unsigned char *)calloc(compr_img->cache_len, blk_size);
+	compr_img->block_map = (int *)malloc((compr_img->index_len + 1) * sizeof(compr_img->block_map[0]));
+	if (compr_img->cache == NULL || compr_img->cache_data == NULL || compr_img->block_map == NULL)
+		return -1;
+
+	for (i = 0; i < compr_img->cache_len; i++) {
+		compr_img->cache[i].block = -1;
+		compr_img->cache[i].data = compr_img->cache_data + i * blk_size;
+	}
+	for (i = 0; i <= compr_img->index_len; i++)
+		compr_img->block_map[i] = -1;
+	compr_img->cur_sector = compr_img->cache[0].data;
+
+#ifdef CDR_READAHEAD
+	// Leave room for blocks being read on emulation thread and workers
+	compr_img->ahead = COMPR_AHEAD_SECTORS >> compr_img->block_shift;
+	if (compr_img->ahead > (int)compr_img->cache_len - COMPR_WORKERS - 2)
+		compr_img->ahead = compr_img->cache_len - COMPR_WORKERS - 2;
+	compr_img->want = 0;
+	compr_img->exit_thread = FALSE;
+
+	pthread_mutex_init(&compr_img->lock, NULL);
+	pthread_mutex_init(&compr_img->fill_lock, NULL);
+	pthread_cond_init(&compr_img->cond_work, NULL);
+	pthread_cond_init(&compr_img->cond_done, NULL);
+	for (i = 0; i < COMPR_WORKERS; i++) {
+		if (pthread_create(&compr_img->workers[i], NULL, compr_worker, NULL) != 0)
+			break;
+	}
+	compr_img->worker_count = i;
+	compr_img->threads_started = TRUE;
+#endif
+
+	return 0;
+}
+
+static void compr_cache_finish(void)
+{
+#ifdef CDR_READAHEAD
+	if (compr_img->threads_started) {
+		pthread_mutex_lock(&compr_img->lock);
+		compr_img->exit_thread = TRUE;
+		pthread_cond_broadcast(&compr_img->cond_work);
+		pthread_mutex_unlock(&compr_img->lock);
+		for (int i = 0; i < compr_img->worker_count; i++)
+			pthread_join(compr_img->workers[i], NULL);
+
+		pthread_cond_destroy(&compr_img->cond_done);
+		pthread_cond_destroy(&compr_img->cond_work);
+		pthread_mutex_destroy(&compr_img->fill_lock);
+		pthread_mutex_destroy(&compr_img->lock);
+		compr_img->threads_started = FALSE;
+	}
+#endif
+
+	free(compr_img->block_map);
+	free(compr_img->cache_data);
+	free(compr_img->cache);
+	compr_img->block_map = NULL;
+	compr_img->cache_data = NULL;
+	compr_img->cache = NULL;
 }
 
 static int cdread_2048(FILE *f, unsigned int base, void *dest, int sector)
@@ -1372,14 +1795,448 @@ static int cdread_2048(FILE *f, unsigned int base, void *dest, int sector)
 	return ret;
 }
 
+#ifdef CDR_MMAP
+/*
+ * Memory-mapped access to uncompressed images
+ *
+ * The data file and every track file are mapped privately (so PPF
+ * patching of the returned buffer works), and sectors are read with
+ * pointer arithmetic instead of fseek+fread. Data sectors read into
+ * cdbuffer aren't even copied: CDR_getBuffer_mmap() points straight
+ * into the mapping. Files that couldn't be mapped use the stdio
+ * functions above.
+ */
+
+// Largest image mapped on hosts with 32-bit address space
+#define MMAP_MAX_SIZE_32	(512 << 20)
+
+// Sectors the kernel is asked to read ahead of the current one
+#define MMAP_AHEAD_SECTORS	64
+
+static struct cdimg_mmap {
+	FILE *f;
+	unsigned char *data;
+	size_t len;
+	boolean owner;		// Unmap on close, others share mapping
+	dev_t dev;
+	ino_t ino;
+} mmaps[MAXTRACKS + 1];
+static int mmap_count;
+
+// What CDR_getBuffer_mmap() returns, cdbuffer or somewhere in mapping
+static unsigned char *mmap_buffer = cdbuffer;
+// Sector that last triggered madvise() for the data file
+static int mmap_advised;
+
+static struct cdimg_mmap *find_mmap(FILE *f)
+{
+	for (int i = 0; i < mmap_count; i++)
+		if (mmaps[i].f == f)
+			return &mmaps[i];
+	return NULL;
+}
+
+// Like fseek+fread from mapping: returns bytes available at offs, up to size
+static int mmap_avail(const struct cdimg_mmap *m, off_t offs, size_t size)
+{
+	if (offs < 0)
+		return -1;
+	if ((size_t)offs >= m->len)
+		return 0;
+	return (m->len - offs < size) ? m->len - offs : size;
+}
+
+// Have kernel start reading sectors following a data sector
+static void mmap_advise(const struct cdimg_mmap *m, int sector, size_t stride)
+{
+	long page_size = sysconf(_SC_PAGESIZE);
+
+	// Enough is still on its way
+	if (sector >= mmap_advised && sector < mmap_advised + MMAP_AHEAD_SECTORS / 2)
+		return;
+
+	size_t start = (size_t)(sector + 1) * stride;
+	size_t end = start + MMAP_AHEAD_SECTORS * stride;
+	if (start >= m->len)
+		return;
+	if (end > m->len)
+		end = m->len;
+	start &= ~(page_size - 1);
+	madvise(m->data + start, end - start, MADV_WILLNEED);
+	mmap_advised = sector;
+}
+
+static int cdread_mmap_normal(FILE *f, unsigned int base, void *dest, int sector)
+{
+	struct cdimg_mmap *m = find_mmap(f);
+	off_t offs = (off_t)base + (off_t)sector * CD_FRAMESIZE_RAW;
+	int ret;
+
+	if (dest == cdbuffer)
+		mmap_buffer = cdbuffer;
+	if (m == NULL)
+		return cdread_normal(f, base, dest, sector);
+
+	ret = mmap_avail(m, offs, CD_FRAMESIZE_RAW);
+	if (ret <= 0)
+		return ret;
+
+	if (dest == cdbuffer) {
+		mmap_advise(m, sector, CD_FRAMESIZE_RAW);
+		if (ret == CD_FRAMESIZE_RAW) {
+			mmap_buffer = m->data + offs;
+			return ret;
+		}
+	}
+
+	memcpy(dest, m->data + offs, ret);
+	return ret;
+}
+
+static int cdread_mmap_sub_mixed(FILE *f, unsigned int base, void *dest, int sector)
+{
+	struct cdimg_mmap *m = find_mmap(f);
+	off_t offs = (off_t)base + (off_t)sector * (CD_FRAMESIZE_RAW + SUB_FRAMESIZE);
+	int ret;
+
+	if (dest == cdbuffer)
+		mmap_buffer = cdbuffer;
+	if (m == NULL)
+		return cdread_sub_mixed(f, base, dest, sector);
+
+	ret = mmap_avail(m, offs, CD_FRAMESIZE_RAW + SUB_FRAMESIZE);
+	if (ret < 0)
+		return ret;
+
+	if (ret < CD_FRAMESIZE_RAW + SUB_FRAMESIZE) {
+		printf("Error reading mixed subchannel info in cdread_sub_mixed()\n");
+	} else {
+		memcpy(subbuffer, m->data + offs + CD_FRAMESIZE_RAW, SUB_FRAMESIZE);
+		if (subChanRaw) DecodeRawSubData();
+	}
+	if (ret > CD_FRAMESIZE_RAW)
+		ret = CD_FRAMESIZE_RAW;
+
+	if (dest == cdbuffer) {
+		mmap_advise(m, sector, CD_FRAMESIZE_RAW + SUB_FRAMESIZE);
+		if (ret == CD_FRAMESIZE_RAW) {
+			mmap_buffer = m->data + offs;
+			return ret;
+		}
+	}
+
+	memcpy(dest, m->data + offs, ret);
+	return ret;
+}
+
+static int cdread_mmap_2048(FILE *f, unsigned int base, void *dest, int sector)
+{
+	struct cdimg_mmap *m = find_mmap(f);
+	off_t offs = (off_t)base + (off_t)sector * 2048;
+	int ret;
+
+	// Needs the fake header in front of data, so no zero-copy here
+	if (dest == cdbuffer)
+		mmap_buffer = cdbuffer;
+	if (m == NULL)
+		return cdread_2048(f, base, dest, sector);
+
+	ret = mmap_avail(m, offs, 2048);
+	if (ret < 0)
+		return ret;
+
+	memcpy((char *)dest + 12 * 2, m->data + offs, ret);
+	if (dest == cdbuffer)
+		mmap_advise(m, sector, 2048);
+
+	// not really necessary, fake mode 2 header
+	memset(cdbuffer, 0, 12 * 2);
+	sec2msf(sector + 2 * 75, (char *)&cdbuffer[12]);
+	cdbuffer[12 + 3] = 1;
+
+	return ret;
+}
+
+static unsigned char *CDR_getBuffer_mmap(void) {
+	return mmap_buffer + 12;
+}
+
+static int map_file(FILE *f)
+{
+	struct stat st;
+	void *data;
+
+	if (f == NULL || find_mmap(f) != NULL)
+		return 0;
+	if (fstat(fileno(f), &st) != 0 || st.st_size <= 0)
+		return -1;
+
+	struct cdimg_mmap *m = &mmaps[mmap_count];
+	m->f = f;
+	m->len = st.st_size;
+	m->dev = st.st_dev;
+	m->ino = st.st_ino;
+
+	// Track files are often the same file as data, share mapping then
+	for (int i = 0; i < mmap_count; i++) {
+		if (mmaps[i].dev == st.st_dev && mmaps[i].ino == st.st_ino) {
+			m->data = mmaps[i].data;
+			m->owner = FALSE;
+			mmap_count++;
+			return 0;
+		}
+	}
+
+	if (sizeof(void *) < 8 && (off_t)st.st_size > MMAP_MAX_SIZE_32)
+		return -1;
+
+	data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(f), 0);
+	if (data == MAP_FAILED)
+		return -1;
+
+	m->data = (unsigned char *)data;
+	m->owner = TRUE;
+	mmap_count++;
+	return 0;
+}
+
+static void cdimg_mmap_close(void)
+{
+	for (int i = 0; i < mmap_count; i++) {
+		if (mmaps[i].owner)
+			munmap(mmaps[i].data, mmaps[i].len);
+	}
+	memset(mmaps, 0, sizeof(mmaps));
+	mmap_count = 0;
+	mmap_buffer = cdbuffer;
+}
+
+// Switch to mmap access if data file could be mapped, else keep stdio
+static void cdimg_mmap_open(void)
+{
+	int (*read_func)(FILE *f, unsigned int base, void *dest, int sector);
+
+	if (cdimg_read_func == cdread_normal)
+		read_func = cdread_mmap_normal;
+	else if (cdimg_read_func == cdread_sub_mixed)
+		read_func = cdread_mmap_sub_mixed;
+	else if (cdimg_read_func == cdread_2048)
+		read_func = cdread_mmap_2048;
+	else
+		return;
+
+	if (map_file(cdHandle) != 0) {
+		printf("Couldn't map CD image, using stdio\n");
+		return;
+	}
+
+	for (int i = 1; i <= numtracks; i++)
+		map_file(ti[i].handle);
+
+	madvise(mmaps[0].data, mmaps[0].len, MADV_SEQUENTIAL);
+	mmap_advised = -MMAP_AHEAD_SECTORS;
+	cdimg_read_func = read_func;
+	CDR_getBuffer = CDR_getBuffer_mmap;
+}
+#endif // CDR_MMAP
+
 static unsigned char *CDR_getBuffer_compr(void) {
-	return compr_img->buff_raw[compr_img->sector_in_blk] + 12;
+	return compr_img->cur_sector + 12;
 }
 
 static unsigned char *CDR_getBuffer_norm(void) {
 	return cdbuffer + 12;
 }
 
+#ifdef CDR_READAHEAD
+/*
+ * Asynchronous read-ahead for uncompressed images
+ *
+ * An I/O thread with its own file handle keeps the sectors following the
+ * last one read (or the last Setloc target) in a small direct-mapped
+ * cache, so sequential reads in CDR_readTrack() are served from memory.
+ * On a miss the sector is read synchronously, as before, and the thread
+ * starts filling the cache from the sector after it.
+ */
+
+// Number of sectors read ahead, must be a power of two
+#define CDRA_SECTORS		64
+
+static struct {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	boolean running;
+	boolean exit_thread;
+
+	FILE *f;
+	int (*read_func)(FILE *f, unsigned int base, void *dest, int sector);
+	unsigned int stride;	// Bytes between sectors in image file
+	unsigned int size;	// Bytes read per sector
+	unsigned int offs;	// Offset in cdbuffer data is read to
+
+	int want;		// First sector of read-ahead window
+
+	struct {
+		int sector;	// -1 if slot is empty or being filled
+		int bytes;	// fread() result, -1 if seek failed
+		unsigned char buf[CD_FRAMESIZE_RAW + SUB_FRAMESIZE];
+	} slot[CDRA_SECTORS];
+} cdra;
+
+static void *cdra_thread(void *param)
+{
+	int pos = 0, file_sector = -1;
+
+	pthread_mutex_lock(&cdra.lock);
+	while (!cdra.exit_thread) {
+		int end = cdra.want + CDRA_SECTORS;
+
+		// Restart from beginning of window if it moved away
+		if (pos < cdra.want || pos > end)
+			pos = cdra.want;
+		if (pos < 0)
+			pos = 0;
+		if (pos >= end) {
+			pthread_cond_wait(&cdra.cond, &cdra.lock);
+			continue;
+		}
+
+		if (cdra.slot[pos & (CDRA_SECTORS - 1)].sector == pos) {
+			pos++;
+			continue;
+		}
+
+		// Slot is invisible to CDR_readTrack() while being filled
+		int i = pos & (CDRA_SECTORS - 1);
+		cdra.slot[i].sector = -1;
+		pthread_mutex_unlock(&cdra.lock);
+
+		int bytes = -1;
+		if (pos == file_sector ||
+		    fseeko(cdra.f, (off_t)pos * cdra.stride, SEEK_SET) != -1)
+			bytes = fread(cdra.slot[i].buf, 1, cdra.size, cdra.f);
+		file_sector = (bytes == (int)cdra.size) ? pos + 1 : -1;
+
+		pthread_mutex_lock(&cdra.lock);
+		cdra.slot[i].sector = pos;
+		cdra.slot[i].bytes = bytes;
+		pos++;
+	}
+	pthread_mutex_unlock(&cdra.lock);
+
+	return NULL;
+}
+
+// Move read-ahead window, caller must hold cdra.lock
+static void cdra_set_window(int sector)
+{
+	if (cdra.want != sector) {
+		cdra.want = sector;
+		pthread_cond_signal(&cdra.cond);
+	}
+}
+
+// Returns what cdimg_read_func would have, or -2 on cache miss
+static int cdra_read(int sector)
+{
+	int ret = -2;
+	boolean have_sub = FALSE;
+
+	pthread_mutex_lock(&cdra.lock);
+	int i = sector & (CDRA_SECTORS - 1);
+	if (cdra.slot[i].sector == sector) {
+		ret = cdra.slot[i].bytes;
+		if (cdra.read_func == cdread_sub_mixed) {
+			if (ret == CD_FRAMESIZE_RAW + SUB_FRAMESIZE) {
+				memcpy(subbuffer, cdra.slot[i].buf + CD_FRAMESIZE_RAW, SUB_FRAMESIZE);
+				have_sub = TRUE;
+			}
+			if (ret > CD_FRAMESIZE_RAW)
+				ret = CD_FRAMESIZE_RAW;
+		}
+		if (ret > 0)
+			memcpy(cdbuffer + cdra.offs, cdra.slot[i].buf, ret);
+	}
+	cdra_set_window(sector + 1);
+	pthread_mutex_unlock(&cdra.lock);
+
+	if (ret < 0)
+		return ret;
+
+	// Finish up like the read function would
+	if (cdra.read_func == cdread_sub_mixed) {
+		if (!have_sub)
+			printf("Error reading mixed subchannel info in cdread_sub_mixed()\n");
+		else if (subChanRaw)
+			DecodeRawSubData();
+	} else if (cdra.read_func == cdread_2048) {
+		memset(cdbuffer, 0, 12 * 2);
+		sec2msf(sector + 2 * 75, (char *)&cdbuffer[12]);
+		cdbuffer[12 + 3] = 1;
+	}
+
+	return ret;
+}
+
+static void cdra_start(const char *filename)
+{
+	if (cdimg_read_func == cdread_normal) {
+		cdra.stride = cdra.size = CD_FRAMESIZE_RAW;
+		cdra.offs = 0;
+	} else if (cdimg_read_func == cdread_sub_mixed) {
+		cdra.stride = cdra.size = CD_FRAMESIZE_RAW + SUB_FRAMESIZE;
+		cdra.offs = 0;
+	} else if (cdimg_read_func == cdread_2048) {
+		cdra.stride = cdra.size = 2048;
+		cdra.offs = 12 * 2;
+	} else {
+		return;
+	}
+
+	cdra.f = fopen(filename, "rb");
+	if (cdra.f == NULL)
+		return;
+
+	cdra.read_func = cdimg_read_func;
+	cdra.want = -CDRA_SECTORS;
+	cdra.exit_thread = FALSE;
+	for (int i = 0; i < CDRA_SECTORS; i++)
+		cdra.slot[i].sector = -1;
+
+	pthread_mutex_init(&cdra.lock, NULL);
+	pthread_cond_init(&cdra.cond, NULL);
+	if (pthread_create(&cdra.thread, NULL, cdra_thread, NULL) != 0) {
+		printf("Failed to start CD read-ahead thread\n");
+		pthread_cond_destroy(&cdra.cond);
+		pthread_mutex_destroy(&cdra.lock);
+		fclose(cdra.f);
+		cdra.f = NULL;
+		return;
+	}
+
+	cdra.running = TRUE;
+}
+
+static void cdra_stop(void)
+{
+	if (!cdra.running)
+		return;
+
+	pthread_mutex_lock(&cdra.lock);
+	cdra.exit_thread = TRUE;
+	pthread_cond_signal(&cdra.cond);
+	pthread_mutex_unlock(&cdra.lock);
+	pthread_join(cdra.thread, NULL);
+
+	pthread_cond_destroy(&cdra.cond);
+	pthread_mutex_destroy(&cdra.lock);
+	fclose(cdra.f);
+	cdra.f = NULL;
+	cdra.running = FALSE;
+}
+#endif // CDR_READAHEAD
+
 static void PrintTracks(void) {
 	int i;
 
@@ -1438,6 +2295,13 @@ long CDR_open(void) {
 		CDR_getBuffer = CDR_getBuffer_compr;
 		cdimg_read_func = cdread_compressed;
 	}
+#ifdef HAVE_CHD
+	else if (handlechd(GetIsoFile()) == 0) {
+		printf("[chd]");
+		CDR_getBuffer = CDR_getBuffer_compr;
+		cdimg_read_func = cdread_compressed;
+	}
+#endif
 	else if (handlecbin(GetIsoFile()) == 0) {
 		printf("[cbin]");
 		CDR_getBuffer = CDR_getBuffer_compr;
@@ -1501,7 +2365,7 @@ long CDR_open(void) {
 	}
 
 	// guess whether it is mode1/2048
-	if (ftello(cdHandle) % 2048 == 0) {
+	if (cdimg_read_func != cdread_compressed && ftello(cdHandle) % 2048 == 0) {
 		unsigned int modeTest = 0;
 		fseek(cdHandle, 0, SEEK_SET);
 		if (fread(&modeTest, 4, 1, cdHandle) == 1) {
@@ -1520,7 +2384,8 @@ long CDR_open(void) {
 
 	PrintTracks();
 
-	if (subChanMixed)
+	// Compressed images handle subchannel in cdread_compressed()
+	if (subChanMixed && cdimg_read_func != cdread_compressed)
 		cdimg_read_func = cdread_sub_mixed;
 	else if (isMode1CDR_)
 		cdimg_read_func = cdread_2048;
@@ -1532,12 +2397,34 @@ long CDR_open(void) {
 	cdda_cur_sector = 0;
 	cdda_file_offset = 0;
 
+	if (cdimg_read_func == cdread_compressed && compr_cache_init() != 0) {
+		printf("Couldn't allocate CD image block cache\n");
+		CDR_close();
+		return -1;
+	}
+#ifdef CDR_MMAP
+	cdimg_mmap_open();
+#endif
+#ifdef CDR_READAHEAD
+	// Only used if image wasn't mapped
+	cdra_start(bin_filename);
+#endif
+
 	return 0;
 }
 
 long CDR_close(void) {
 	int i;
 
+#ifdef CDR_READAHEAD
+	cdra_stop();
+#endif
+	// Stop workers before closing file they read from
+	if (compr_img != NULL)
+		compr_cache_finish();
+#ifdef CDR_MMAP
+	cdimg_mmap_close();
+#endif
 	if (cdHandle != NULL) {
 		fclose(cdHandle);
 		cdHandle = NULL;
@@ -1550,6 +2437,10 @@ long CDR_close(void) {
 	cddaHandle = NULL;
 
 	if (compr_img != NULL) {
+#ifdef HAVE_CHD
+		if (compr_img->chd != NULL)
+			chd_close(compr_img->chd);
+#endif
 		free(compr_img->index_table);
 		free(compr_img);
 		compr_img = NULL;
@@ -1655,6 +2546,7 @@ static void DecodeRawSubData(void) {
 long CDR_readTrack(unsigned char *time) {
 	int sector = MSF2SECT(btoi(time[0]), btoi(time[1]), btoi(time[2]));
 	long ret;
+	PMON_SCOPE(PMON_CDR);
 
 	if (cdHandle == NULL) {
 		return -1;
@@ -1669,6 +2561,10 @@ long CDR_readTrack(unsigned char *time) {
 		}
 	}
 
+#ifdef CDR_READAHEAD
+	ret = cdra.running ? cdra_read(sector) : -2;
+	if (ret == -2)
+#endif
 	ret = cdimg_read_func(cdHandle, 0, cdbuffer, sector);
 	if (ret < 0)
 		return -1;
@@ -1685,6 +2581,25 @@ long CDR_readTrack(unsigned char *time) {
 	return 0;
 }
 
+// hint that a read of given sector is likely to follow soon
+// time: byte 0 - minute; byte 1 - second; byte 2 - frame
+// uses bcd format
+void CDR_prefetch(unsigned char *time) {
+#ifdef CDR_READAHEAD
+	int sector = MSF2SECT(btoi(time[0]), btoi(time[1]), btoi(time[2]));
+
+	if (!cdra.running)
+		return;
+
+	if (pregapOffset && sector >= pregapOffset)
+		sector -= 2 * 75;
+
+	pthread_mutex_lock(&cdra.lock);
+	cdra_set_window(sector);
+	pthread_mutex_unlock(&cdra.lock);
+#endif
+}
+
 // plays cdda audio
 // sector: byte 0 - minute; byte 1 - second; byte 2 - frame
 // does NOT uses bcd format
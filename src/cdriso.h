@@ -29,4 +29,7 @@ extern void (CALLBACK *cdrIsoMultidiskCallback)(void);
 extern unsigned int cdrIsoMultidiskCount;
 extern unsigned int cdrIsoMultidiskSelect;
 
+// Size of decompressed block cache for compressed (PBP/CBIN) images
+extern unsigned int cdrIsoCacheSectors;
+
 #endif
@@ -1359,6 +1359,9 @@ void cdrWrite1(unsigned char rt) {
 		memcpy(cdr.SetSector, set_loc, 3);
 		cdr.SetSector[3] = 0;
 		cdr.SetlocPending = 1;
+
+		// Let image reader start on it while seek is emulated
+		CDR_prefetch(cdr.Param);
 		break;
 
 	case CdlReadN:
@@ -1564,9 +1567,7 @@ void psxDma3(u32 madr, u32 bcr, u32 chcr) {
 				psxCpu->Notify(R3000ACPU_NOTIFY_DMA3_EXE_LOAD, NULL);
 			}
 
-#ifdef PSXREC
 			psxCpu->Clear(madr, cdsize / 4);
-#endif
 
 			pTransfer += cdsize;
 
@@ -1641,7 +1642,8 @@ int cdrFreeze(void *f, FreezeMode mode)
 	if (mode == FREEZE_LOAD && !Config.Cdda)
 		CDR_stop();
 	
-	cdr.freeze_ver = 0x63647202;
+	if (mode == FREEZE_SAVE)
+		cdr.freeze_ver = 0x63647202;
 	if (freeze_rw(f, mode, &cdr, sizeof(cdr)))
 		return -1;
 	
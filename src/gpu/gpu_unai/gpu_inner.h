@@ -51,6 +51,10 @@
 #include "gpu_inner_quantization.h"
 #include "gpu_inner_light.h"
 
+#ifdef GPU_UNAI_SIMD
+#include "gpu_inner_simd.h"
+#endif
+
 // If defined, Gouraud colors are fixed-point 5.11, otherwise they are 8.16
 // This is only for debugging/verification of low-precision colors in C.
 // Low-precision Gouraud is intended for use by SIMD-optimized inner drivers
@@ -261,6 +265,12 @@ const PSD gpuPixelSpanDrivers[64] =
 template<int CF>
 static void gpuTileSpanFn(u16 *pDst, u32 count, u16 data)
 {
+#ifdef GPU_UNAI_SIMD
+	u32 done = gpuSpanSIMD<CF>(pDst, count, data, 0, 0);
+	if (done == count) return;
+	pDst += done;  count -= done;
+#endif
+
 	if (!CF_MASKCHECK && !CF_BLEND) {
 		if (CF_MASKSET) { data = data | 0x8000; }
 		do { *pDst++ = data; } while (--count);
@@ -473,6 +483,13 @@ static void gpuPolySpanFn(const gpu_unai_t &gpu_unai, u16 *pDst, u32 count)
 		{
 			// UNTEXTURED, NO GOURAUD
 			const u16 pix15 = gpu_unai.PixelData;
+
+#ifdef GPU_UNAI_SIMD
+			u32 done = gpuSpanSIMD<CF>(pDst, count, pix15, 0, 0);
+			if (done == count) return;
+			pDst += done;  count -= done;
+#endif
+
 			do {
 				u16 uSrc, uDst;
 
@@ -502,6 +519,15 @@ endpolynotextnogou:
 			u32 l_gCol = gpu_unai.gCol;
 			u32 l_gInc = gpu_unai.gInc;
 
+#ifdef GPU_UNAI_SIMD
+			// Dithered spans are left to the scalar loop
+			if (!CF_DITHER) {
+				u32 done = gpuSpanSIMD<CF>(pDst, count, 0, l_gCol, l_gInc);
+				if (done == count) return;
+				pDst += done;  count -= done;  l_gCol += done * l_gInc;
+			}
+#endif
+
 			do {
 				u16 uDst, uSrc;
 
@@ -0,0 +1,175 @@
+/***************************************************************************
+*   Copyright (C) 2010 PCSX4ALL Team                                      *
+*   Copyright (C) 2010 Unai                                               *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 2 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+*   You should have received a copy of the GNU General Public License     *
+*   along with this program; if not, write to the                         *
+*   Free Software Foundation, Inc.,                                       *
+*   51 Franklin Street, Fifth Floor, Boston, MA 02111-1307 USA.           *
+***************************************************************************/
+
+#ifndef _OP_SIMD_H_
+#define _OP_SIMD_H_
+
+//  GPU SIMD span operations, 8 pixels per iteration
+//
+//  Written with GCC vector extensions, so the same code compiles to SSE2 on
+//  x86 and NEON on ARM. Only enabled when gpu_unai.h defines GPU_UNAI_SIMD.
+//  Results are bit-exact with the scalar functions in gpu_inner.h, which
+//  remain the reference and render any pixels left over at end of a span.
+
+typedef u16 gpu_v8u16 __attribute__((vector_size(16)));
+typedef s16 gpu_v8s16 __attribute__((vector_size(16)));
+typedef u32 gpu_v4u32 __attribute__((vector_size(16)));
+
+// Framebuffer spans have no particular alignment
+GPU_INLINE gpu_v8u16 gpuLoad8(const u16 *p)
+{
+	gpu_v8u16 v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+GPU_INLINE void gpuStore8(u16 *p, gpu_v8u16 v)
+{
+	memcpy(p, &v, sizeof(v));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Vector version of gpuBlending<BLENDMODE, true>() in gpu_inner_blend.h.
+//  Each 16-bit lane holds one bgr555 pixel. Source MSB must be unset, which
+//  is always true for untextured prims.
+//  All intermediate values either fit in 16 bits or have bits above 15
+//  masked off later, so 16-bit lanes give the same result as the u32
+//  temporaries used by the scalar version.
+////////////////////////////////////////////////////////////////////////////////
+template <int BLENDMODE>
+GPU_INLINE gpu_v8u16 gpuBlendingV(gpu_v8u16 uSrc, gpu_v8u16 uDst)
+{
+	gpu_v8u16 mix;
+
+	// 0.5 x Back + 0.5 x Forward
+	if (BLENDMODE==0) {
+#ifdef GPU_UNAI_USE_ACCURATE_BLENDING
+		uDst &= 0x7fff;
+		mix = ((uSrc + uDst) - ((uSrc ^ uDst) & 0x0421)) >> 1;
+#else
+		mix = ((uDst & 0x7bde) + (uSrc & 0x7bde)) >> 1;
+#endif
+	}
+
+	// 1.0 x Back + 1.0 x Forward
+	if (BLENDMODE==1) {
+		uDst &= 0x7fff;
+		gpu_v8u16 sum      = uSrc + uDst;
+		gpu_v8u16 low_bits = (uSrc ^ uDst) & 0x0421;
+		gpu_v8u16 carries  = (sum - low_bits) & 0x8420;
+		gpu_v8u16 modulo   = sum - carries;
+		gpu_v8u16 clamp    = carries - (carries >> 5);
+		mix = modulo | clamp;
+	}
+
+	// 1.0 x Back - 1.0 x Forward
+	if (BLENDMODE==2) {
+		uDst &= 0x7fff;
+		gpu_v8u16 diff     = uDst - uSrc + 0x8420;
+		gpu_v8u16 low_bits = (uDst ^ uSrc) & 0x8420;
+		gpu_v8u16 borrows  = (diff - low_bits) & 0x8420;
+		gpu_v8u16 modulo   = diff - borrows;
+		gpu_v8u16 clamp    = borrows - (borrows >> 5);
+		mix = modulo & clamp;
+	}
+
+	// 1.0 x Back + 0.25 x Forward
+	if (BLENDMODE==3) {
+		uDst &= 0x7fff;
+		uSrc = ((uSrc >> 2) & 0x1ce7);
+		gpu_v8u16 sum      = uSrc + uDst;
+		gpu_v8u16 low_bits = (uSrc ^ uDst) & 0x0421;
+		gpu_v8u16 carries  = (sum - low_bits) & 0x8420;
+		gpu_v8u16 modulo   = sum - carries;
+		gpu_v8u16 clamp    = carries - (carries >> 5);
+		mix = modulo | clamp;
+	}
+
+	return mix;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Vector version of gpuLightingRGB() in gpu_inner_light.h: extract eight
+//  bgr555 colors from two vectors of four Gouraud 8.3:8.3:8.2 rgb triplets.
+//  'lo' holds colors of pixels 0..3, 'hi' those of pixels 4..7.
+////////////////////////////////////////////////////////////////////////////////
+GPU_INLINE gpu_v8u16 gpuLightingRGBV(gpu_v4u32 lo, gpu_v4u32 hi)
+{
+	lo = ((lo<< 5)&0x7C00) | ((lo>>11)&0x03E0) | (lo>>27);
+	hi = ((hi<< 5)&0x7C00) | ((hi>>11)&0x03E0) | (hi>>27);
+
+	// Results fit in 16 bits, gather low halves (little-endian lanes)
+	const gpu_v8u16 sel = { 0, 2, 4, 6, 8, 10, 12, 14 };
+	return __builtin_shuffle((gpu_v8u16)lo, (gpu_v8u16)hi, sel);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//  Untextured span generator gpuSpanSIMD<>
+//  Renders untextured, non-dithered pixels of a poly or tile span eight at a
+//  time. Handles blending, mask check, mask set and Gouraud shading with the
+//  same CF template field as the scalar span functions.
+//  Returns how many pixels were rendered (a multiple of 8, can be 0). Caller
+//  renders the remainder with the scalar loop.
+template<int CF>
+static u32 gpuSpanSIMD(u16 *pDst, u32 count, u16 pix15, u32 gCol, u32 gInc)
+{
+	const u32 done = count & ~7;
+
+	const gpu_v8u16 vCol = { pix15, pix15, pix15, pix15,
+	                         pix15, pix15, pix15, pix15 };
+	gpu_v4u32 gLo, gHi;
+
+	if (CF_GOURAUD) {
+		// Same wrap-around as the scalar loop's successive adds of gInc
+		gLo = (gpu_v4u32){ gCol, gCol + gInc, gCol + gInc*2, gCol + gInc*3 };
+		gHi = gLo + gInc*4;
+	}
+
+	for (u32 i = 0; i < done; i += 8, pDst += 8) {
+		gpu_v8u16 uDst, uSrc;
+
+		if (CF_BLEND || CF_MASKCHECK) uDst = gpuLoad8(pDst);
+
+		if (CF_GOURAUD) {
+			uSrc = gpuLightingRGBV(gLo, gHi);
+			gLo += gInc*8;
+			gHi += gInc*8;
+		} else {
+			uSrc = vCol;
+		}
+
+		if (CF_BLEND)
+			uSrc = gpuBlendingV<CF_BLENDMODE>(uSrc, uDst);
+
+		if (CF_MASKSET) uSrc |= 0x8000;
+
+		if (CF_MASKCHECK) {
+			// Keep destination pixels that have their mask bit set
+			gpu_v8u16 keep = (gpu_v8u16)((gpu_v8s16)uDst >> 15);
+			uSrc = (uDst & keep) | (uSrc & ~keep);
+		}
+
+		gpuStore8(pDst, uSrc);
+	}
+
+	return done;
+}
+
+#endif  //_OP_SIMD_H_
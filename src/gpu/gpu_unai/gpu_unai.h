@@ -43,6 +43,16 @@
 //#define GPU_UNAI_USE_INT_DIV_MULTINV   // If GPU_UNAI_USE_FLOATMATH is *not*
                                          //  defined, use old inaccurate division
 
+//#define GPU_UNAI_NO_SIMD               // Disable SSE2/NEON span functions for
+                                         //  untextured polys/tiles (use scalar)
+
+#if !defined(GPU_UNAI_NO_SIMD) && \
+    (defined(__SSE2__) || defined(__ARM_NEON) || defined(__ARM_NEON__)) && \
+    defined(__GNUC__) && !defined(__clang__) && \
+    (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define GPU_UNAI_SIMD
+#endif
+
 
 #define u8  uint8_t
 #define s8  int8_t
@@ -310,7 +320,8 @@ static inline bool PixelSkipEnabled()
 
 static inline bool LineSkipEnabled()
 {
-	return true;
+	// Smooth software scaling averages line pairs of 480-line modes
+	return Config.VideoScaling != 2;
 }
 
 #endif // GPU_UNAI_H
@@ -150,7 +150,8 @@ static void gpuGP0Cmd_0xEx(gpu_unai_t &gpu_unai, u32 cmd_word)
 {
   // Assume incoming GP0 command is 0xE1..0xE6, convert to 1..6
   u8 num = (cmd_word >> 24) & 7;
-  gpu.ex_regs[num] = cmd_word; // Update gpulib register
+  if (!gpu.render_thread)
+    gpu.ex_regs[num] = cmd_word; // Update gpulib register
   switch (num) {
     case 1: {
       // GP0(E1h) - Draw Mode setting (aka "Texpage")
@@ -596,8 +597,11 @@ int do_cmd_list(unsigned int *list, int list_len, int *last_cmd)
   }
 
 breakloop:
-  gpu.ex_regs[1] &= ~0x1ff;
-  gpu.ex_regs[1] |= gpu_unai.GPU_GP1 & 0x1ff;
+  // With a render thread, gpulib tracks these itself (see gpu_thread.cpp)
+  if (!gpu.render_thread) {
+    gpu.ex_regs[1] &= ~0x1ff;
+    gpu.ex_regs[1] |= gpu_unai.GPU_GP1 & 0x1ff;
+  }
 
   *last_cmd = cmd;
   return list - list_start;
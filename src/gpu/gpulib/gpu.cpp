@@ -14,6 +14,7 @@
 #include "plugins.h"    // For GPUFreeze_t, GPUScreenInfo_t
 #include "gpu.h"
 #include "plugin_lib.h"
+#include "perfmon.h"
 
 #define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
 #ifdef __GNUC__
@@ -39,6 +40,23 @@ gpulib_config_t gpulib_config;
 
 static noinline int do_cmd_buffer(uint32_t *data, int count);
 static void finish_vram_transfer(int is_read);
+static void mark_cmd_list_dirty(const uint32_t *list, int count, uint32_t e3, uint32_t e4);
+
+// Pass commands to renderer, or queue them when it has its own thread
+static inline int renderer_do_cmd_list(uint32_t *list, int count, int *last_cmd)
+{
+  if (gpu.render_thread)
+    return gpu_thread_do_cmd_list(list, count, last_cmd);
+  return do_cmd_list(list, count, last_cmd);
+}
+
+static inline void renderer_do_sync_ecmds(uint32_t *ecmds)
+{
+  if (gpu.render_thread)
+    gpu_thread_sync_ecmds(ecmds);
+  else
+    renderer_sync_ecmds(ecmds);
+}
 
 static noinline void do_cmd_reset(void)
 {
@@ -122,7 +140,8 @@ static noinline void decide_frameskip(void)
 
   if (!gpu.frameskip.active && gpu.frameskip.pending_fill[0] != 0) {
     int dummy;
-    do_cmd_list(gpu.frameskip.pending_fill, 3, &dummy);
+    renderer_do_cmd_list(gpu.frameskip.pending_fill, 3, &dummy);
+    mark_cmd_list_dirty(gpu.frameskip.pending_fill, 3, 0, 0);
     gpu.frameskip.pending_fill[0] = 0;
   }
 }
@@ -240,6 +259,7 @@ long GPU_init(void)
 
 long GPU_shutdown(void)
 {
+  gpu_thread_stop();
   renderer_finish();
   long ret = vout_finish();
 
@@ -316,6 +336,7 @@ void GPU_writeStatus(uint32_t data)
       update_width();
       update_height();
       update_window_size(gpu.screen.hres, gpu.screen.vres, Config.PsxType == PSX_TYPE_NTSC);
+      gpu_thread_sync();
       renderer_notify_res_change();
       break;
     default:
@@ -423,7 +444,10 @@ static void start_vram_transfer(uint32_t pos_word, uint32_t size_word, int is_re
   gpu.dma.is_read = is_read;
   gpu.dma_start = gpu.dma;
 
+  gpu_thread_sync();
   renderer_flush_queues();
+  if (!is_read)
+    gpu_mark_vram_dirty(gpu.dma.x, gpu.dma.y, gpu.dma.w, gpu.dma.h);
   if (is_read) {
     gpu.status.img = 1;
     // XXX: wrong for width 1
@@ -444,6 +468,86 @@ static void finish_vram_transfer(int is_read)
                            gpu.dma_start.w, gpu.dma_start.h);
 }
 
+void gpu_mark_vram_dirty(int x, int y, int w, int h)
+{
+  if (w <= 0 || h <= 0)
+    return;
+
+  uint32_t bands = gpu_vram_bands(x, w);
+  if (h > 512)
+    h = 512;
+  for (y &= 511; h > 0; h--, y = (y + 1) & 511)
+    gpu.vram_dirty[y] |= bands;
+}
+
+// Mark drawing area given by E3/E4 command words
+static void mark_draw_area_dirty(uint32_t e3, uint32_t e4)
+{
+  int x1 = e3 & 0x3ff, y1 = (e3 >> 10) & 0x3ff;
+  int x2 = e4 & 0x3ff, y2 = (e4 >> 10) & 0x3ff;
+  if (y2 > 511)
+    y2 = 511;
+  gpu_mark_vram_dirty(x1, y1, x2 - x1 + 1, y2 - y1 + 1);
+}
+
+// Mark VRAM areas the renderer wrote while executing complete commands in
+//  'list'. Drawing primitives are always clipped to the drawing area, which
+//  'e3' and 'e4' give at start of list.
+static void mark_cmd_list_dirty(const uint32_t *list, int count, uint32_t e3, uint32_t e4)
+{
+  const uint32_t *list_end = list + count;
+  int drawn = 0, len, v;
+
+  for (; list < list_end; list += 1 + len)
+  {
+    int cmd = list[0] >> 24;
+    len = cmd_lengths[cmd];
+
+    switch (cmd) {
+      case 0x02: // fill, ignores drawing area, allow for width rounding
+        gpu_mark_vram_dirty(list[1] & 0x3ff, (list[1] >> 16) & 0x1ff,
+                            (list[2] & 0x3ff) + 15, (list[2] >> 16) & 0x3ff);
+        break;
+      case 0x20 ... 0x47:
+      case 0x50 ... 0x57:
+      case 0x60 ... 0x7f:
+        drawn = 1;
+        break;
+      case 0x48 ... 0x4f:
+        for (v = 3; list + v < list_end; v++)
+          if ((list[v] & 0xf000f000) == 0x50005000)
+            break;
+        len += v - 3;
+        drawn = 1;
+        break;
+      case 0x58 ... 0x5f:
+        for (v = 4; list + v < list_end; v += 2)
+          if ((list[v] & 0xf000f000) == 0x50005000)
+            break;
+        len += v - 4;
+        drawn = 1;
+        break;
+      case 0x80 ... 0x9f: // vram copy
+        gpu_mark_vram_dirty(list[2] & 0x3ff, (list[2] >> 16) & 0x1ff,
+                            ((list[3] - 1) & 0x3ff) + 1, (((list[3] >> 16) - 1) & 0x1ff) + 1);
+        break;
+      case 0xe3:
+      case 0xe4:
+        if (drawn)
+          mark_draw_area_dirty(e3, e4);
+        drawn = 0;
+        if (cmd == 0xe3)
+          e3 = list[0];
+        else
+          e4 = list[0];
+        break;
+    }
+  }
+
+  if (drawn)
+    mark_draw_area_dirty(e3, e4);
+}
+
 static noinline int do_cmd_list_skip(uint32_t *data, int count, int *last_cmd)
 {
   int cmd = 0, pos = 0, len, dummy, v;
@@ -458,9 +562,11 @@ static noinline int do_cmd_list_skip(uint32_t *data, int count, int *last_cmd)
 
     switch (cmd) {
       case 0x02:
-        if ((int)(list[2] & 0x3ff) > gpu.screen.w || (int)((list[2] >> 16) & 0x1ff) > gpu.screen.h)
+        if ((int)(list[2] & 0x3ff) > gpu.screen.w || (int)((list[2] >> 16) & 0x1ff) > gpu.screen.h) {
           // clearing something large, don't skip
-          do_cmd_list(list, 3, &dummy);
+          renderer_do_cmd_list(list, 3, &dummy);
+          mark_cmd_list_dirty(list, 3, 0, 0);
+        }
         else
           memcpy(gpu.frameskip.pending_fill, list, 3 * 4);
         break;
@@ -505,7 +611,7 @@ static noinline int do_cmd_list_skip(uint32_t *data, int count, int *last_cmd)
     pos += len;
   }
 
-  renderer_sync_ecmds(gpu.ex_regs);
+  renderer_do_sync_ecmds(gpu.ex_regs);
   *last_cmd = cmd;
   return pos;
 }
@@ -515,6 +621,7 @@ static noinline int do_cmd_buffer(uint32_t *data, int count)
   int cmd, pos;
   uint32_t old_e3 = gpu.ex_regs[3];
   int vram_dirty = 0;
+  PMON_SCOPE(PMON_GPU);
 
   // process buffer
   for (pos = 0; pos < count; )
@@ -538,7 +645,10 @@ static noinline int do_cmd_buffer(uint32_t *data, int count)
     if (gpu.frameskip.active && (gpu.frameskip.allow || ((data[pos] >> 24) & 0xf0) == 0xe0))
       pos += do_cmd_list_skip(data + pos, count - pos, &cmd);
     else {
-      pos += do_cmd_list(data + pos, count - pos, &cmd);
+      uint32_t e3 = gpu.ex_regs[3], e4 = gpu.ex_regs[4];
+      int len = renderer_do_cmd_list(data + pos, count - pos, &cmd);
+      mark_cmd_list_dirty(data + pos, len, e3, e4);
+      pos += len;
       vram_dirty = 1;
     }
 
@@ -661,8 +771,10 @@ void GPU_readDataMem(uint32_t *mem, int count)
   if (unlikely(gpu.cmd_len > 0))
     flush_cmd_buffer();
 
-  if (gpu.dma.h)
+  if (gpu.dma.h) {
+    gpu_thread_sync();
     do_vram_io(mem, count, 1);
+  }
 }
 
 uint32_t GPU_readData(void)
@@ -673,8 +785,10 @@ uint32_t GPU_readData(void)
     flush_cmd_buffer();
 
   ret = gpu.gp0;
-  if (gpu.dma.h)
+  if (gpu.dma.h) {
+    gpu_thread_sync();
     do_vram_io(&ret, 1, 1);
+  }
 
   log_io("gpu_read %08x\n", ret);
   return ret;
@@ -700,12 +814,14 @@ long GPU_freeze(uint32_t type, GPUFreeze_t *freeze)
     case 1: // save
       if (gpu.cmd_len > 0)
         flush_cmd_buffer();
+      gpu_thread_sync();
       memcpy(freeze->psxVRam, gpu.vram, 1024 * 512 * 2);
       memcpy(freeze->ulControl, gpu.regs, sizeof(gpu.regs));
       memcpy(freeze->ulControl + 0xe0, gpu.ex_regs, sizeof(gpu.ex_regs));
       freeze->ulStatus = gpu.status.reg;
       break;
     case 0: // load
+      gpu_thread_sync();
       memcpy(gpu.vram, freeze->psxVRam, 1024 * 512 * 2);
       memcpy(gpu.regs, freeze->ulControl, sizeof(gpu.regs));
       memcpy(gpu.ex_regs, freeze->ulControl + 0xe0, sizeof(gpu.ex_regs));
@@ -715,8 +831,10 @@ long GPU_freeze(uint32_t type, GPUFreeze_t *freeze)
         gpu.regs[i] ^= 1; // avoid reg change detection
         GPU_writeStatus((i << 24) | (gpu.regs[i] ^ 1));
       }
-      renderer_sync_ecmds(gpu.ex_regs);
+      renderer_do_sync_ecmds(gpu.ex_regs);
+      gpu_thread_sync();
       renderer_update_caches(0, 0, 1024, 512);
+      gpu_mark_vram_dirty(0, 0, 1024, 512);
       break;
   }
 
@@ -727,6 +845,7 @@ void GPU_updateLace(void)
 {
   if (gpu.cmd_len > 0)
     flush_cmd_buffer();
+  gpu_thread_sync();
   renderer_flush_queues();
 
   if (gpu.status.blanking) {
@@ -771,6 +890,7 @@ void GPU_vBlank(int is_vblank, int lcf)
 
     if (gpu.cmd_len > 0)
       flush_cmd_buffer();
+    gpu_thread_sync();
     renderer_flush_queues();
     renderer_set_interlace(interlace, !lcf);
   }
@@ -785,6 +905,9 @@ void GPU_requestScreenRedraw()
 
 void GPU_getScreenInfo(GPUScreenInfo_t *sinfo)
 {
+	// Caller reads vram directly
+	gpu_thread_sync();
+
 	sinfo->vram    = (uint8_t*)gpu.vram;
 	sinfo->x       = (uint16_t)gpu.screen.x;
 	sinfo->y       = (uint16_t)gpu.screen.y;
@@ -815,6 +938,12 @@ void gpulib_set_config(const gpulib_config_t *config)
     map_vram();
 #endif
 
+  gpu_thread_sync();
   renderer_set_config(config);
   vout_set_config(config);
+
+  if (config->render_thread)
+    gpu_thread_start();
+  else
+    gpu_thread_stop();
 }
@@ -94,6 +94,12 @@ struct psx_gpu {
   void *(*mmap)(unsigned int size);
   void  (*munmap)(void *ptr, unsigned int size);
 #endif
+  int render_thread;  // Renderer runs on its own thread, see gpu_thread.cpp.
+                      //  If set, renderer must leave gpu.ex_regs alone.
+
+  // VRAM written since last vout_update(): a bit per 64-pixel-wide column
+  //  band in each row. Only touched by the emulation thread.
+  uint16_t vram_dirty[512];
 };
 
 extern struct psx_gpu gpu;
@@ -102,6 +108,20 @@ extern const unsigned char cmd_lengths[256];
 
 int do_cmd_list(uint32_t *list, int count, int *last_cmd);
 
+// Bits of gpu.vram_dirty[] column bands covering 'w' pixels starting at
+//  'x', wrapping around right edge of VRAM
+static inline uint32_t gpu_vram_bands(int x, int w)
+{
+  if (w >= 1024)
+    return 0xffff;
+  x &= 1023;
+  uint32_t b0 = x >> 6, b1 = (x + w - 1) >> 6;
+  uint32_t bands = (2u << b1) - (1u << b0);  // b1 can be up to 31
+  return (bands | (bands >> 16)) & 0xffff;
+}
+
+void gpu_mark_vram_dirty(int x, int y, int w, int h);
+
 struct gpulib_config_t {
 #ifdef GPULIB_USE_MMAP
 	void *(*mmap)(unsigned int size);
@@ -122,6 +142,8 @@ struct gpulib_config_t {
 		bool no_light, no_blend;
 		int  lineskip;
 	} gpu_unai_config;
+
+	bool render_thread;   // Run renderer on separate thread
 };
 
 extern gpulib_config_t gpulib_config;
@@ -138,9 +160,18 @@ void renderer_set_interlace(int enable, int is_odd);
 void renderer_set_config(const gpulib_config_t *config);
 void renderer_notify_res_change(void);
 
+// In gpu_thread.cpp
+void gpu_thread_start(void);
+void gpu_thread_stop(void);
+int  gpu_thread_running(void);
+void gpu_thread_sync(void);
+int  gpu_thread_do_cmd_list(uint32_t *list, int count, int *last_cmd);
+void gpu_thread_sync_ecmds(uint32_t *ecmds);
+
 int  vout_init(void);
 int  vout_finish(void);
 void vout_update(void);
 void vout_blank(void);
 void vout_set_config(const gpulib_config_t *config);
+void vout_force_full_update(void);
 #endif // GPULIB_GPU_H
@@ -0,0 +1,284 @@
+/*
+ * (C) PCSX4ALL team 2024
+ *
+ * This work is licensed under the terms of any of these licenses
+ * (at your option):
+ *  - GNU GPL, version 2 or later.
+ *  - GNU LGPL, version 2.1 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+/*
+ * Optional render thread for gpulib
+ *
+ * The emulation thread parses GP0 command lists just far enough to know
+ *  command lengths and to keep gpu.ex_regs up to date, copies them into a
+ *  single-producer/single-consumer ring and returns immediately. The render
+ *  thread feeds them to the renderer's do_cmd_list().
+ *
+ * Anything that touches VRAM or renderer state from the emulation thread
+ *  must call gpu_thread_sync() first, which waits for the ring to drain.
+ *  gpu.cpp does this for VRAM transfers, GPU_updateLace(), freeze, etc.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "gpu.h"
+
+// Ring size in 32-bit words, must be a power of two
+#define RING_SIZE      (1 << 16)
+#define RING_MASK      (RING_SIZE - 1)
+
+// Batch header marking that the rest of the ring is unused, next batch
+//  starts at offset 0
+#define RING_WRAP      0xffffffff
+
+// Long command lists are queued in several batches of at most this size
+#define MAX_BATCH      (RING_SIZE / 4)
+
+static struct {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond_work;     // Signalled when batches were queued
+  pthread_cond_t cond_idle;     // Signalled when ring was drained
+  int running;
+
+  // Free-running positions, accessed with __atomic builtins
+  uint32_t write_pos;           // Only written by emulation thread
+  uint32_t read_pos;            // Only written by render thread
+  int render_waiting;           // Render thread sleeps on cond_work
+  int emu_waiting;              // Emulation thread sleeps on cond_idle
+  int exit_thread;
+
+  uint32_t ring[RING_SIZE];
+} thr;
+
+static void *gpu_render_thread(void *unused)
+{
+  uint32_t pos = thr.read_pos;
+
+  for (;;) {
+    if (pos == __atomic_load_n(&thr.write_pos, __ATOMIC_ACQUIRE)) {
+      pthread_mutex_lock(&thr.lock);
+      __atomic_store_n(&thr.render_waiting, 1, __ATOMIC_SEQ_CST);
+      while (pos == __atomic_load_n(&thr.write_pos, __ATOMIC_SEQ_CST) &&
+             !thr.exit_thread)
+        pthread_cond_wait(&thr.cond_work, &thr.lock);
+      __atomic_store_n(&thr.render_waiting, 0, __ATOMIC_SEQ_CST);
+      pthread_mutex_unlock(&thr.lock);
+
+      if (thr.exit_thread && pos == __atomic_load_n(&thr.write_pos, __ATOMIC_ACQUIRE))
+        break;
+      continue;
+    }
+
+    uint32_t len = thr.ring[pos & RING_MASK];
+    if (len == RING_WRAP) {
+      pos += RING_SIZE - (pos & RING_MASK);
+    } else {
+      int dummy;
+      do_cmd_list(&thr.ring[(pos + 1) & RING_MASK], len, &dummy);
+      pos += 1 + len;
+    }
+
+    __atomic_store_n(&thr.read_pos, pos, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&thr.emu_waiting, __ATOMIC_SEQ_CST)) {
+      pthread_mutex_lock(&thr.lock);
+      pthread_cond_signal(&thr.cond_idle);
+      pthread_mutex_unlock(&thr.lock);
+    }
+  }
+
+  return NULL;
+}
+
+void gpu_thread_sync(void)
+{
+  if (!thr.running ||
+      __atomic_load_n(&thr.read_pos, __ATOMIC_ACQUIRE) == thr.write_pos)
+    return;
+
+  pthread_mutex_lock(&thr.lock);
+  __atomic_store_n(&thr.emu_waiting, 1, __ATOMIC_SEQ_CST);
+  while (__atomic_load_n(&thr.read_pos, __ATOMIC_SEQ_CST) != thr.write_pos)
+    pthread_cond_wait(&thr.cond_idle, &thr.lock);
+  __atomic_store_n(&thr.emu_waiting, 0, __ATOMIC_SEQ_CST);
+  pthread_mutex_unlock(&thr.lock);
+}
+
+// Copy 'count' words of complete commands into ring as one batch
+static void queue_batch(const uint32_t *list, int count)
+{
+  uint32_t pos = thr.write_pos;
+  uint32_t offs = pos & RING_MASK;
+
+  if (count <= 0)
+    return;
+
+  // Batch must be contiguous, as renderer reads it in place
+  if (offs + 1 + count > RING_SIZE) {
+    // Wait until render thread has left the tail of the ring
+    while (pos + (RING_SIZE - offs) + 1 + count -
+           __atomic_load_n(&thr.read_pos, __ATOMIC_ACQUIRE) > RING_SIZE)
+      gpu_thread_sync();
+    thr.ring[offs] = RING_WRAP;
+    pos += RING_SIZE - offs;
+    offs = 0;
+  }
+
+  while (pos + 1 + count - __atomic_load_n(&thr.read_pos, __ATOMIC_ACQUIRE) > RING_SIZE)
+    gpu_thread_sync();
+
+  thr.ring[offs] = count;
+  memcpy(&thr.ring[offs + 1], list, count * 4);
+
+  __atomic_store_n(&thr.write_pos, pos + 1 + count, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&thr.render_waiting, __ATOMIC_SEQ_CST)) {
+    pthread_mutex_lock(&thr.lock);
+    pthread_cond_signal(&thr.cond_work);
+    pthread_mutex_unlock(&thr.lock);
+  }
+}
+
+// Front end to renderer's do_cmd_list() when render thread is running.
+//  Consumes exactly what the renderer would, tracking the same gpu.ex_regs
+//  updates it would make, and queues it for the render thread.
+int gpu_thread_do_cmd_list(uint32_t *list, int count, int *last_cmd)
+{
+  uint32_t *list_start = list;
+  uint32_t *list_end = list + count;
+  uint32_t *batch_start = list;
+  int cmd = 0, len, v;
+
+  for (; list < list_end; list += 1 + len)
+  {
+    if (list - batch_start >= MAX_BATCH) {
+      queue_batch(batch_start, list - batch_start);
+      batch_start = list;
+    }
+
+    cmd = list[0] >> 24;
+    len = cmd_lengths[cmd];
+    if (list + 1 + len > list_end) {
+      cmd = -1;
+      break;
+    }
+
+    switch (cmd) {
+      case 0x24 ... 0x27:
+      case 0x2c ... 0x2f:
+      case 0x34 ... 0x37:
+      case 0x3c ... 0x3f:
+        // Textured polys set the texture page
+        gpu.ex_regs[1] &= ~0x1ff;
+        gpu.ex_regs[1] |= (list[4 + ((cmd >> 4) & 1)] >> 16) & 0x1ff;
+        break;
+      case 0x48 ... 0x4f:
+        for (v = 3; list + v < list_end; v++)
+          if ((list[v] & 0xf000f000) == 0x50005000)
+            break;
+        if (list + v >= list_end) {
+          cmd = -1;
+          goto breakloop;
+        }
+        len += v - 3;
+        break;
+      case 0x58 ... 0x5f:
+        for (v = 4; list + v < list_end; v += 2)
+          if ((list[v] & 0xf000f000) == 0x50005000)
+            break;
+        if (list + v >= list_end) {
+          cmd = -1;
+          goto breakloop;
+        }
+        len += v - 4;
+        break;
+      case 0xa0:
+      case 0xc0:
+        // Handled by gpulib
+        goto breakloop;
+      case 0xe1 ... 0xe6:
+        gpu.ex_regs[cmd & 7] = list[0];
+        break;
+    }
+  }
+
+breakloop:
+  queue_batch(batch_start, list - batch_start);
+
+  *last_cmd = cmd;
+  return list - list_start;
+}
+
+// Renderer's renderer_sync_ecmds() equivalent
+void gpu_thread_sync_ecmds(uint32_t *ecmds)
+{
+  queue_batch(&ecmds[1], 6);
+}
+
+int gpu_thread_running(void)
+{
+  return thr.running;
+}
+
+void gpu_thread_start(void)
+{
+  if (thr.running)
+    return;
+
+  thr.write_pos = thr.read_pos = 0;
+  thr.render_waiting = thr.emu_waiting = 0;
+  thr.exit_thread = 0;
+
+  if (pthread_mutex_init(&thr.lock, NULL) != 0)
+    goto fail_mutex;
+  if (pthread_cond_init(&thr.cond_work, NULL) != 0)
+    goto fail_cond_work;
+  if (pthread_cond_init(&thr.cond_idle, NULL) != 0)
+    goto fail_cond_idle;
+
+  // Must be set before thread runs, renderer checks it
+  thr.running = 1;
+  gpu.render_thread = 1;
+
+  if (pthread_create(&thr.thread, NULL, gpu_render_thread, NULL) != 0)
+    goto fail_thread;
+
+  printf("Started gpu_render_thread()\n");
+  return;
+
+fail_thread:
+  thr.running = 0;
+  gpu.render_thread = 0;
+  pthread_cond_destroy(&thr.cond_idle);
+fail_cond_idle:
+  pthread_cond_destroy(&thr.cond_work);
+fail_cond_work:
+  pthread_mutex_destroy(&thr.lock);
+fail_mutex:
+  printf("Failed to start GPU render thread, rendering on main thread\n");
+}
+
+void gpu_thread_stop(void)
+{
+  if (!thr.running)
+    return;
+
+  gpu_thread_sync();
+
+  pthread_mutex_lock(&thr.lock);
+  thr.exit_thread = 1;
+  pthread_cond_signal(&thr.cond_work);
+  pthread_mutex_unlock(&thr.lock);
+  pthread_join(thr.thread, NULL);
+
+  pthread_cond_destroy(&thr.cond_idle);
+  pthread_cond_destroy(&thr.cond_work);
+  pthread_mutex_destroy(&thr.lock);
+
+  thr.running = 0;
+  gpu.render_thread = 0;
+}
+
+// vim:shiftwidth=2:expandtab
@@ -15,6 +15,7 @@
 #include <psxcommon.h>
 #include "port.h"
 #include "gpu.h"
+#include "perfmon.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 // BLITTERS TAKEN FROM gpu_unai/gpu_blit.h
@@ -28,6 +29,24 @@
 #define RGB24(R,G,B)  	((((R)&0xF8)>>3)|(((G)&0xF8)<<2)|(((B)&0xF8)<<7))
 #endif
 
+// Average of two screen pixels, rounding down. Masks off lowest bit of each
+//  color component so halves can't carry into the component below.
+#ifndef USE_BGR15
+#define VOUT_AVG_MASK	0xf7de
+#else
+#define VOUT_AVG_MASK	0x7bde
+#endif
+#define VOUT_AVG(A,B)	(((A)&(B)) + ((((A)^(B))&VOUT_AVG_MASK)>>1))
+
+// VOUT_USE_SIMD selects vector versions of blitters from vout_simd.h. It is
+//  set on platforms with 128-bit integer SIMD that includes byte shuffles,
+//  unless VOUT_NO_SIMD is defined. Plain SSE2 lacks those, and 24-bit
+//  conversion is slower than the scalar code there.
+#if !defined(VOUT_NO_SIMD) && defined(__GNUC__) && !defined(__clang__) && \
+    (defined(__SSSE3__) || defined(__ARM_NEON__) || defined(__ARM_NEON))
+#define VOUT_USE_SIMD
+#endif
+
 #define u8 uint8_t
 #define s8 int8_t
 #define u16 uint16_t
@@ -431,12 +450,200 @@ static inline void GPU_BlitCopy(const void*__restrict__ src, u16*__restrict__ ds
 	}
 }
 
+// Averaging version of GPU_BlitWWSWWSWS(): each 8 pixels give 5, weighted
+//  close to the 1.6 source pixels each of them covers
+static inline void GPU_BlitWWSWWSWS_Smooth(const void*__restrict__ src, u16*__restrict__ dst16, bool isRGB24)
+{
+	u32 uCount = 64;
+	u16 p[8];
+	do {
+		if (!isRGB24) {
+			const u16*__restrict__ src16 = (const u16*__restrict__) src;
+			for (int i = 0; i < 8; i++)
+#ifndef USE_BGR15
+				p[i] = RGB16(src16[i]);
+#else
+				p[i] = src16[i];
+#endif
+			src = src16 + 8;
+		} else {
+			const u8*__restrict__ src8 = (const u8*__restrict__) src;
+			for (int i = 0; i < 8; i++)
+				p[i] = RGB24(src8[i*3], src8[i*3+1], src8[i*3+2]);
+			src = src8 + 24;
+		}
+		dst16[0] = VOUT_AVG(p[0], p[1]);
+		dst16[1] = VOUT_AVG(p[2], VOUT_AVG(p[1], p[3]));
+		dst16[2] = VOUT_AVG(p[3], p[4]);
+		dst16[3] = VOUT_AVG(p[5], VOUT_AVG(p[4], p[6]));
+		dst16[4] = VOUT_AVG(p[6], p[7]);
+		dst16 += 5;
+	} while (--uCount);
+}
+
+// Averaging version of GPU_BlitWS()
+static inline void GPU_BlitWS_Smooth(const void*__restrict__ src, u16*__restrict__ dst16, bool isRGB24)
+{
+	u32 uCount = 320;
+	if (!isRGB24) {
+		const u16*__restrict__ src16 = (const u16*__restrict__) src;
+		do {
+#ifndef USE_BGR15
+			u16 a = RGB16(src16[0]), b = RGB16(src16[1]);
+#else
+			u16 a = src16[0], b = src16[1];
+#endif
+			*dst16++ = VOUT_AVG(a, b);
+			src16 += 2;
+		} while (--uCount);
+	} else {
+		const u8*__restrict__ src8 = (const u8*__restrict__) src;
+		do {
+			u16 a = RGB24(src8[0], src8[1], src8[2]);
+			u16 b = RGB24(src8[3], src8[4], src8[5]);
+			*dst16++ = VOUT_AVG(a, b);
+			src8 += 6;
+		} while (--uCount);
+	}
+}
+
+static inline void GPU_BlitWWWWWWWWS_Clip4(const void*__restrict__ src, u16*__restrict__ dst16, bool isRGB24)
+{
+	GPU_BlitWWWWWWWWS(src, dst16, isRGB24, 4);
+}
+
+#ifdef VOUT_USE_SIMD
+#include "vout_simd.h"
+#endif
+
+typedef void (*vout_blit_fn)(const void *src, u16 *dst16, bool isRGB24);
+
+// Returns blitter for scaling rows of width 'w0' to 320 pixels, or NULL
+//  if width isn't supported. 'smooth' selects averaging versions.
+static vout_blit_fn vout_get_blitter(int w0, bool smooth)
+{
+	switch (w0) {
+#ifdef VOUT_USE_SIMD
+		case 256: return GPU_BlitWWDWW_SIMD;
+		case 320: return GPU_BlitWW_SIMD;
+		case 368: return GPU_BlitWWWWWWWWS_SIMD;
+		case 384: return GPU_BlitWWWWWS_SIMD;
+		case 512: return smooth ? GPU_BlitWWSWWSWS_Smooth_SIMD : GPU_BlitWWSWWSWS_SIMD;
+		case 640: return smooth ? GPU_BlitWS_Smooth_SIMD : GPU_BlitWS_SIMD;
+#else
+		case 256: return GPU_BlitWWDWW;
+		case 320: return GPU_BlitWW;
+		case 368: return GPU_BlitWWWWWWWWS_Clip4;
+		case 384: return GPU_BlitWWWWWS;
+		case 512: return smooth ? GPU_BlitWWSWWSWS_Smooth : GPU_BlitWWSWWSWS;
+		case 640: return smooth ? GPU_BlitWS_Smooth : GPU_BlitWS;
+#endif
+	}
+	return NULL;
+}
+
+// Averages VRAM row at 'src16_offs' with the one below it, for displaying
+//  480-line modes at 240 lines. Returns pointer to blended row, which holds
+//  'w' pixels.
+static const void *vout_blend_rows(const u16 *src16, unsigned int src16_offs, int w, bool isRGB24)
+{
+	static u32 line[1024] __attribute__((aligned(16)));
+
+	// Work on whole aligned words, they are read from the row start rounded
+	//  down. Reading a little past the row end is fine, VRAM has padding.
+	const u32 *a = (const u32 *)(src16 + (src16_offs & ~1));
+	const u32 *b = (const u32 *)(src16 + ((src16_offs + 1024) & (1024*512-1) & ~1));
+	int n = (isRGB24 ? w * 3 : w * 2) + 2;
+	u32 mask = isRGB24 ? 0xfefefefe : 0x7bde7bde;
+
+#ifdef VOUT_USE_SIMD
+	vout_blend_rows_SIMD(line, a, b, n, mask);
+#else
+	for (int i = 0; i < (n + 3) / 4; i++)
+		line[i] = (a[i] & b[i]) + (((a[i] ^ b[i]) & mask) >> 1);
+#endif
+
+	return (const u16 *)line + (src16_offs & 1);
+}
+
+// Number of host screen buffers a row has to be redrawn into before all of
+//  them hold it (SDL double or triple buffering)
+#define VOUT_BUFFERS 3
+
+// Tracks which screen rows need blitting again. A row of VRAM written since
+//  last update is redrawn into each of the VOUT_BUFFERS screen buffers, the
+//  rest are left alone. Any change of display setup redraws everything.
+static struct {
+	int x, y, hres, vres, w, h, rgb24;
+	int scaling, screen_w, screen_h, ntsc_fix;
+	int full_redraws;
+	u8 row_redraws[512];
+} vout_dirty;
+
+void vout_force_full_update(void)
+{
+	vout_dirty.full_redraws = VOUT_BUFFERS;
+}
+
+// Returns true if any part of display area changed since last vout_update()
+static bool vout_check_dirty(int x0, int w0, bool isRGB24)
+{
+	if (vout_dirty.x != gpu.screen.x || vout_dirty.y != gpu.screen.y ||
+	    vout_dirty.hres != gpu.screen.hres || vout_dirty.vres != gpu.screen.vres ||
+	    vout_dirty.w != gpu.screen.w || vout_dirty.h != gpu.screen.h ||
+	    vout_dirty.rgb24 != isRGB24 || vout_dirty.scaling != Config.VideoScaling ||
+	    vout_dirty.screen_w != SCREEN_WIDTH || vout_dirty.screen_h != SCREEN_HEIGHT ||
+	    vout_dirty.ntsc_fix != gpu_unai_config_ext.ntsc_fix) {
+		vout_dirty.x = gpu.screen.x;
+		vout_dirty.y = gpu.screen.y;
+		vout_dirty.hres = gpu.screen.hres;
+		vout_dirty.vres = gpu.screen.vres;
+		vout_dirty.w = gpu.screen.w;
+		vout_dirty.h = gpu.screen.h;
+		vout_dirty.rgb24 = isRGB24;
+		vout_dirty.scaling = Config.VideoScaling;
+		vout_dirty.screen_w = SCREEN_WIDTH;
+		vout_dirty.screen_h = SCREEN_HEIGHT;
+		vout_dirty.ntsc_fix = gpu_unai_config_ext.ntsc_fix;
+		vout_dirty.full_redraws = VOUT_BUFFERS;
+	}
+
+	// FPS overlay is drawn over the image on every flip
+	if (Config.ShowFps)
+		vout_dirty.full_redraws = VOUT_BUFFERS;
+
+	bool dirty = vout_dirty.full_redraws > 0;
+	u32 bands = gpu_vram_bands(x0, isRGB24 ? w0 * 3 / 2 : w0);
+	for (int y = 0; y < 512; y++) {
+		if (gpu.vram_dirty[y] & bands)
+			vout_dirty.row_redraws[y] = VOUT_BUFFERS;
+		if (vout_dirty.row_redraws[y])
+			dirty = true;
+	}
+	memset(gpu.vram_dirty, 0, sizeof(gpu.vram_dirty));
+	return dirty;
+}
+
+static void vout_age_dirty(void)
+{
+	if (vout_dirty.full_redraws > 0)
+		vout_dirty.full_redraws--;
+	for (int y = 0; y < 512; y++)
+		if (vout_dirty.row_redraws[y])
+			vout_dirty.row_redraws[y]--;
+}
+
+// Returns true if VRAM row at 'src16_offs' needs to be blitted
+#define ROW_DIRTY(src16_offs) \
+	(full || vout_dirty.row_redraws[((src16_offs) >> 10) & 511])
 
 // Basically an adaption of old gpu_unai/gpu.cpp's gpuVideoOutput() that
 //  assumes 320x240 destination resolution (for now)
 // TODO: clean up / improve / add HW scaling support
 void vout_update(void)
 {
+	PMON_SCOPE(PMON_VOUT);
+
 	//Debugging:
 #if 0
 	if (gpu.screen.w != gpu.screen.hres) {
@@ -452,13 +659,19 @@ void vout_update(void)
 	int y0 = gpu.screen.y;
 	int w0 = gpu.screen.hres;
 	int w1 = gpu.screen.w;
-	int h0 = !gpu_unai_config_ext.ntsc_fix || Config.VideoScaling == 1 ? gpu.screen.vres : SCREEN_HEIGHT;
+	int h0 = !gpu_unai_config_ext.ntsc_fix || Config.VideoScaling != 0 ? gpu.screen.vres : SCREEN_HEIGHT;
 	int h1 = gpu.screen.h;     // height of image displayed on screen
 
 	if (w0 == 0 || h0 == 0)
 		return;
 
 	bool isRGB24 = gpu.status.rgb24;
+
+	// Nothing on screen changed, keep showing what was last flipped
+	if (!vout_check_dirty(x0, w0, isRGB24))
+		return;
+	bool full = vout_dirty.full_redraws > 0;
+
 	u16* dst16 = SCREEN;
 	u16* src16 = (u16*)gpu.vram;
 
@@ -466,7 +679,7 @@ void vout_update(void)
 	unsigned int src16_offs_msk = 1024*512-1;
 	unsigned int src16_offs = (x0 + y0*1024u) & src16_offs_msk;
 
-	if (Config.VideoScaling == 1) {
+	if (Config.VideoScaling != 0) {
 		//  Height centering
 		int sizeShift = 1;
 		if (h0 == 256) {
@@ -484,62 +697,25 @@ void vout_update(void)
 		int incY = (h0 == 480) ? 2 : 1;
 		h0 = ((h0 == 480) ? 2048 : 1024);
 
-		switch (w0) {
-			case 256: {
-				for (int y1 = y0 + h1; y0 < y1; y0 += incY) {
-					GPU_BlitWWDWW(src16 + src16_offs, dst16, isRGB24);
-					dst16 += SCREEN_WIDTH;
-					src16_offs = (src16_offs + h0) & src16_offs_msk;
-				}
-			}
-				break;
-
-			case 368: {
-				for (int y1 = y0 + h1; y0 < y1; y0 += incY) {
-					GPU_BlitWWWWWWWWS(src16 + src16_offs, dst16, isRGB24, 4);
-					dst16 += SCREEN_WIDTH;
-					src16_offs = (src16_offs + h0) & src16_offs_msk;
-				}
-			}
-				break;
-
-			case 320: {
-				// Ensure 32-bit alignment for GPU_BlitWW() blitter:
-				src16_offs &= ~1;
-				for (int y1 = y0 + h1; y0 < y1; y0 += incY) {
-					GPU_BlitWW(src16 + src16_offs, dst16, isRGB24);
-					dst16 += SCREEN_WIDTH;
-					src16_offs = (src16_offs + h0) & src16_offs_msk;
-				}
-			}
-				break;
-
-			case 384: {
-				for (int y1 = y0 + h1; y0 < y1; y0 += incY) {
-					GPU_BlitWWWWWS(src16 + src16_offs, dst16, isRGB24);
-					dst16 += SCREEN_WIDTH;
-					src16_offs = (src16_offs + h0) & src16_offs_msk;
-				}
-			}
-				break;
-
-			case 512: {
-				for (int y1 = y0 + h1; y0 < y1; y0 += incY) {
-					GPU_BlitWWSWWSWS(src16 + src16_offs, dst16, isRGB24);
-					dst16 += SCREEN_WIDTH;
-					src16_offs = (src16_offs + h0) & src16_offs_msk;
-				}
+		// Smooth scaling averages pixels when dropping them, including 480
+		//  line modes' line pairs
+		bool smooth = Config.VideoScaling == 2;
+		bool vblend = smooth && incY == 2;
+		vout_blit_fn blit = vout_get_blitter(w0, smooth);
+
+		// Ensure 32-bit alignment for GPU_BlitWW() blitter:
+		if (w0 == 320)
+			src16_offs &= ~1;
+
+		for (int y1 = y0 + h1; blit && y0 < y1; y0 += incY) {
+			if (ROW_DIRTY(src16_offs) || (vblend && ROW_DIRTY(src16_offs + 1024))) {
+				if (vblend)
+					blit(vout_blend_rows(src16, src16_offs, w0, isRGB24), dst16, isRGB24);
+				else
+					blit(src16 + src16_offs, dst16, isRGB24);
 			}
-				break;
-
-			case 640: {
-				for (int y1 = y0 + h1; y0 < y1; y0 += incY) {
-					GPU_BlitWS(src16 + src16_offs, dst16, isRGB24);
-					dst16 += SCREEN_WIDTH;
-					src16_offs = (src16_offs + h0) & src16_offs_msk;
-				}
-			}
-				break;
+			dst16 += SCREEN_WIDTH;
+			src16_offs = (src16_offs + h0) & src16_offs_msk;
 		}
 	} else {
 		if (h1 > h0) {
@@ -555,16 +731,23 @@ void vout_update(void)
 		}
 
 		for (int y1 = y0+h1; y0<y1; y0++) {
-			GPU_BlitCopy(src16+src16_offs, dst16, w1, isRGB24);
+			if (ROW_DIRTY(src16_offs))
+#ifdef VOUT_USE_SIMD
+				GPU_BlitCopy_SIMD(src16+src16_offs, dst16, w1, isRGB24);
+#else
+				GPU_BlitCopy(src16+src16_offs, dst16, w1, isRGB24);
+#endif
 			dst16 += SCREEN_WIDTH;
 			src16_offs = (src16_offs+1024) & src16_offs_msk;
 		}
 	}
+	vout_age_dirty();
 	video_flip();
 }
 
 int vout_init(void)
 {
+	vout_force_full_update();
 	return 0;
 }
 
@@ -576,6 +759,7 @@ int vout_finish(void)
 //senquack - Handles PSX display disabling (TODO: implement?)
 void vout_blank(void)
 {
+	vout_force_full_update();
 }
 
 void vout_set_config(const gpulib_config_t *config)
@@ -0,0 +1,263 @@
+// Vector versions of the blitters in vout_port.cpp, included there when
+//  VOUT_USE_SIMD is set. Output is identical to the scalar blitters, except
+//  GPU_BlitCopy_SIMD() doesn't leave out last pixel of odd widths.
+//
+// Written with GCC vector extensions, so the same code compiles to SSE on
+//  x86 and NEON on ARM. Source pixels are loaded eight at a time and
+//  converted to screen format first, then picked or averaged with shuffles.
+//  Where eight source pixels give more than eight screen pixels, two
+//  overlapping stores are used. No source pixels past those the scalar
+//  blitters read are loaded.
+
+#ifndef VOUT_SIMD_H
+#define VOUT_SIMD_H
+
+typedef u8  vout_v16u8 __attribute__((vector_size(16)));
+typedef u16 vout_v8u16 __attribute__((vector_size(16)));
+typedef u32 vout_v4u32 __attribute__((vector_size(16)));
+
+#define VOUT_V8(a,b,c,d,e,f,g,h) ((vout_v8u16){ a, b, c, d, e, f, g, h })
+
+INLINE vout_v8u16 voutSplatV(u16 x)
+{
+	return VOUT_V8(x, x, x, x, x, x, x, x);
+}
+
+INLINE vout_v8u16 voutLoadV(const u16 *p)
+{
+	vout_v8u16 v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+INLINE void voutStoreV(u16 *p, vout_v8u16 v)
+{
+	memcpy(p, &v, sizeof(v));
+}
+
+// Convert eight 15-bit VRAM pixels to screen format
+INLINE vout_v8u16 voutRGB16V(vout_v8u16 c)
+{
+#ifndef USE_BGR15
+	return ((c >> 10) & voutSplatV(0x1f)) |
+	       ((c & voutSplatV(0x1f << 5)) << 1) |
+	       (c << 11);
+#else
+	return c;
+#endif
+}
+
+// Convert eight 24-bit VRAM pixels at 's' to screen format
+INLINE vout_v8u16 voutRGB24V(const u8 *s)
+{
+	// Pixels 0..4 come from 'lo', 5..7 from 'hi'. Only low byte of each
+	//  lane is wanted, masks below get rid of the high one.
+	static const vout_v16u8 ir = { 0,0, 3,0, 6,0,  9,0, 12,0, 15,0, 26,0, 29,0 };
+	static const vout_v16u8 ig = { 1,0, 4,0, 7,0, 10,0, 13,0, 24,0, 27,0, 30,0 };
+	static const vout_v16u8 ib = { 2,0, 5,0, 8,0, 11,0, 14,0, 25,0, 28,0, 31,0 };
+	vout_v16u8 lo, hi;
+	memcpy(&lo, s, sizeof(lo));
+	memcpy(&hi, s + 8, sizeof(hi));
+	vout_v8u16 r = (vout_v8u16)__builtin_shuffle(lo, hi, ir);
+	vout_v8u16 g = (vout_v8u16)__builtin_shuffle(lo, hi, ig);
+	vout_v8u16 b = (vout_v8u16)__builtin_shuffle(lo, hi, ib);
+#ifndef USE_BGR15
+	return ((r << 8) & voutSplatV(0xf800)) |
+	       ((g & voutSplatV(0xfc)) << 3) |
+	       ((b & voutSplatV(0xf8)) >> 3);
+#else
+	return ((r & voutSplatV(0xf8)) >> 3) |
+	       ((g & voutSplatV(0xf8)) << 2) |
+	       ((b & voutSplatV(0xf8)) << 7);
+#endif
+}
+
+// Load eight pixels starting at pixel 'i' of 'src', in screen format
+template<bool rgb24>
+INLINE vout_v8u16 voutPixelsV(const void *src, int i)
+{
+	if (rgb24)
+		return voutRGB24V((const u8 *)src + i * 3);
+	else
+		return voutRGB16V(voutLoadV((const u16 *)src + i));
+}
+
+// Average of screen pixels, see VOUT_AVG()
+INLINE vout_v8u16 voutAvgV(vout_v8u16 a, vout_v8u16 b)
+{
+	return (a & b) + (((a ^ b) & voutSplatV(VOUT_AVG_MASK)) >> 1);
+}
+
+#define VOUT_SHUF1(a, m)    __builtin_shuffle((a), (m))
+#define VOUT_SHUF2(a, b, m) __builtin_shuffle((a), (b), (m))
+
+template<bool rgb24>
+static void GPU_BlitWW_V(const void *src, u16 *dst16)
+{
+	for (int i = 0; i < 320; i += 8)
+		voutStoreV(dst16 + i, voutPixelsV<rgb24>(src, i));
+}
+
+// 256: 8 pixels to 10
+template<bool rgb24>
+static void GPU_BlitWWDWW_V(const void *src, u16 *dst16)
+{
+	for (int i = 0; i < 256; i += 8, dst16 += 10) {
+		vout_v8u16 a = voutPixelsV<rgb24>(src, i);
+		voutStoreV(dst16,     VOUT_SHUF1(a, VOUT_V8(0, 1, 1, 2, 3, 4, 5, 5)));
+		voutStoreV(dst16 + 2, VOUT_SHUF1(a, VOUT_V8(1, 2, 3, 4, 5, 5, 6, 7)));
+	}
+}
+
+// 368: 18 pixels to 16, starting at pixel 4
+template<bool rgb24>
+static void GPU_BlitWWWWWWWWS_V(const void *src, u16 *dst16)
+{
+	for (int i = 4; i < 4 + 360; i += 18, dst16 += 16) {
+		voutStoreV(dst16,     voutPixelsV<rgb24>(src, i));
+		voutStoreV(dst16 + 8, voutPixelsV<rgb24>(src, i + 9));
+	}
+}
+
+// 384: 12 pixels to 10
+template<bool rgb24>
+static void GPU_BlitWWWWWS_V(const void *src, u16 *dst16)
+{
+	for (int i = 0; i < 384; i += 12, dst16 += 10) {
+		vout_v8u16 a = voutPixelsV<rgb24>(src, i);
+		vout_v8u16 b = voutPixelsV<rgb24>(src, i + 4);
+		voutStoreV(dst16,     VOUT_SHUF2(a, b, VOUT_V8(0, 1, 2, 3, 4, 6, 7, 12)));
+		voutStoreV(dst16 + 2, VOUT_SHUF2(a, b, VOUT_V8(2, 3, 4, 6, 7, 12, 13, 14)));
+	}
+}
+
+// 512: 16 pixels to 10
+template<bool rgb24>
+static void GPU_BlitWWSWWSWS_V(const void *src, u16 *dst16)
+{
+	for (int i = 0; i < 512; i += 16, dst16 += 10) {
+		vout_v8u16 a = voutPixelsV<rgb24>(src, i);
+		vout_v8u16 b = voutPixelsV<rgb24>(src, i + 8);
+		voutStoreV(dst16,     VOUT_SHUF2(a, b, VOUT_V8(0, 1, 3, 4, 6, 8, 9, 11)));
+		voutStoreV(dst16 + 2, VOUT_SHUF2(a, b, VOUT_V8(3, 4, 6, 8, 9, 11, 12, 14)));
+	}
+}
+
+// 512, averaging: 16 pixels to 10, see GPU_BlitWWSWWSWS_Smooth()
+template<bool rgb24>
+static void GPU_BlitWWSWWSWS_Smooth_V(const void *src, u16 *dst16)
+{
+	for (int i = 0; i < 512; i += 16, dst16 += 10) {
+		vout_v8u16 a = voutPixelsV<rgb24>(src, i);
+		vout_v8u16 b = voutPixelsV<rgb24>(src, i + 8);
+		vout_v8u16 o;
+
+		o = voutAvgV(VOUT_SHUF2(a, b, VOUT_V8(0, 2, 3, 5, 7, 8, 10, 11)),
+		             voutAvgV(VOUT_SHUF2(a, b, VOUT_V8(1, 1, 4, 4, 6, 9, 9, 12)),
+		                      VOUT_SHUF2(a, b, VOUT_V8(1, 3, 4, 6, 6, 9, 11, 12))));
+		voutStoreV(dst16, o);
+		o = voutAvgV(VOUT_SHUF2(a, b, VOUT_V8(3, 5, 7, 8, 10, 11, 13, 15)),
+		             voutAvgV(VOUT_SHUF2(a, b, VOUT_V8(4, 4, 6, 9, 9, 12, 12, 14)),
+		                      VOUT_SHUF2(a, b, VOUT_V8(4, 6, 6, 9, 11, 12, 14, 14))));
+		voutStoreV(dst16 + 2, o);
+	}
+}
+
+// 640: 16 pixels to 8
+template<bool rgb24>
+static void GPU_BlitWS_V(const void *src, u16 *dst16)
+{
+	for (int i = 0; i < 640; i += 16, dst16 += 8) {
+		vout_v8u16 a = voutPixelsV<rgb24>(src, i);
+		vout_v8u16 b = voutPixelsV<rgb24>(src, i + 8);
+		voutStoreV(dst16, VOUT_SHUF2(a, b, VOUT_V8(0, 2, 4, 6, 8, 10, 12, 14)));
+	}
+}
+
+// 640, averaging: 16 pixels to 8
+template<bool rgb24>
+static void GPU_BlitWS_Smooth_V(const void *src, u16 *dst16)
+{
+	for (int i = 0; i < 640; i += 16, dst16 += 8) {
+		vout_v8u16 a = voutPixelsV<rgb24>(src, i);
+		vout_v8u16 b = voutPixelsV<rgb24>(src, i + 8);
+		// Average each pixel pair within its 32-bit lane, then pick them
+		a = voutAvgV(a, (vout_v8u16)((vout_v4u32)a >> 16));
+		b = voutAvgV(b, (vout_v8u16)((vout_v4u32)b >> 16));
+		voutStoreV(dst16, VOUT_SHUF2(a, b, VOUT_V8(0, 2, 4, 6, 8, 10, 12, 14)));
+	}
+}
+
+template<bool rgb24>
+static void GPU_BlitCopy_V(const void *src, u16 *dst16, int w)
+{
+	int i;
+	for (i = 0; i + 8 <= w; i += 8)
+		voutStoreV(dst16 + i, voutPixelsV<rgb24>(src, i));
+
+	// Remaining pixels one at a time
+	if (rgb24) {
+		const u8 *src8 = (const u8 *)src + i * 3;
+		for (; i < w; i++, src8 += 3)
+			dst16[i] = RGB24(src8[0], src8[1], src8[2]);
+	} else {
+		const u16 *src16 = (const u16 *)src;
+		for (; i < w; i++)
+#ifndef USE_BGR15
+			dst16[i] = RGB16(src16[i]);
+#else
+			dst16[i] = src16[i];
+#endif
+	}
+}
+
+// Blitters with the same signature as the scalar ones
+#define VOUT_SIMD_BLITTER(name) \
+static void name##_SIMD(const void *src, u16 *dst16, bool isRGB24) \
+{ \
+	if (isRGB24) \
+		name##_V<true>(src, dst16); \
+	else \
+		name##_V<false>(src, dst16); \
+}
+
+VOUT_SIMD_BLITTER(GPU_BlitWW)
+VOUT_SIMD_BLITTER(GPU_BlitWWDWW)
+VOUT_SIMD_BLITTER(GPU_BlitWWWWWWWWS)
+VOUT_SIMD_BLITTER(GPU_BlitWWWWWS)
+VOUT_SIMD_BLITTER(GPU_BlitWWSWWSWS)
+VOUT_SIMD_BLITTER(GPU_BlitWWSWWSWS_Smooth)
+VOUT_SIMD_BLITTER(GPU_BlitWS)
+
+// Vectors only pay off here when converting 24-bit pixels: 15-bit pixel
+//  pairs are averaged faster by the scalar GPU_BlitWS_Smooth()
+static void GPU_BlitWS_Smooth_SIMD(const void *src, u16 *dst16, bool isRGB24)
+{
+	if (isRGB24)
+		GPU_BlitWS_Smooth_V<true>(src, dst16);
+	else
+		GPU_BlitWS_Smooth(src, dst16, false);
+}
+
+static void GPU_BlitCopy_SIMD(const void *src, u16 *dst16, int w, bool isRGB24)
+{
+	if (isRGB24)
+		GPU_BlitCopy_V<true>(src, dst16, w);
+	else
+		GPU_BlitCopy_V<false>(src, dst16, w);
+}
+
+// Average 'n' bytes of two VRAM rows into 'dst', see vout_blend_rows()
+static void vout_blend_rows_SIMD(u32 *dst, const u32 *a, const u32 *b, int n, u32 mask)
+{
+	const vout_v4u32 m = { mask, mask, mask, mask };
+	for (int i = 0; i < n; i += 16) {
+		vout_v4u32 va, vb;
+		memcpy(&va, (const u8 *)a + i, sizeof(va));
+		memcpy(&vb, (const u8 *)b + i, sizeof(vb));
+		va = (va & vb) + (((va ^ vb) & m) >> 1);
+		memcpy((u8 *)dst + i, &va, sizeof(va));
+	}
+}
+
+#endif // VOUT_SIMD_H
@@ -21,6 +21,37 @@
 
 #include "gte.h"
 #include "psxmem.h"
+#include "perfmon.h"
+
+// gte_nf.cpp builds this file a second time with GTE_FLAGLESS defined, giving
+//  variants of GTE operations that skip updating the FLAG register. The
+//  recompilers call them when an operation's FLAG result is overwritten by
+//  a later one before any CFC2 can read it. Register transfer functions are
+//  only built once.
+#ifdef GTE_FLAGLESS
+#define gteRTPS  gteRTPS_nf
+#define gteOP    gteOP_nf
+#define gteNCLIP gteNCLIP_nf
+#define gteDPCS  gteDPCS_nf
+#define gteINTPL gteINTPL_nf
+#define gteMVMVA gteMVMVA_nf
+#define gteNCDS  gteNCDS_nf
+#define gteNCDT  gteNCDT_nf
+#define gteCDP   gteCDP_nf
+#define gteNCCS  gteNCCS_nf
+#define gteCC    gteCC_nf
+#define gteNCS   gteNCS_nf
+#define gteNCT   gteNCT_nf
+#define gteSQR   gteSQR_nf
+#define gteDCPL  gteDCPL_nf
+#define gteDPCT  gteDPCT_nf
+#define gteAVSZ3 gteAVSZ3_nf
+#define gteAVSZ4 gteAVSZ4_nf
+#define gteRTPT  gteRTPT_nf
+#define gteGPF   gteGPF_nf
+#define gteGPL   gteGPL_nf
+#define gteNCCT  gteNCCT_nf
+#endif
 
 // MIPS platforms have hardware divider, faster than 64KB LUT + UNR algo
 #if defined(__mips__)
@@ -188,21 +219,27 @@
 //senquack-Don't try to optimize return value to s32 like PCSX Rearmed did here:
 //it's why as of Nov. 2016, PC build has gfx glitches in 1st level of 'Driver'
 INLINE s64 BOUNDS(s64 n_value, s64 n_max, int n_maxflag, s64 n_min, int n_minflag) {
+#ifndef GTE_FLAGLESS
 	if (n_value > n_max) {
 		gteFLAG |= n_maxflag;
 	} else if (n_value < n_min) {
 		gteFLAG |= n_minflag;
 	}
+#endif
 	return n_value;
 }
 
 INLINE s32 LIM(s32 value, s32 max, s32 min, u32 flag) {
 	s32 ret = value;
 	if (value > max) {
+#ifndef GTE_FLAGLESS
 		gteFLAG |= flag;
+#endif
 		ret = max;
 	} else if (value < min) {
+#ifndef GTE_FLAGLESS
 		gteFLAG |= flag;
+#endif
 		ret = min;
 	}
 	return ret;
@@ -221,7 +258,9 @@ INLINE s32 LIM(s32 value, s32 max, s32 min, u32 flag) {
 
 INLINE u32 limE(u32 result) {
 	if (result > 0x1ffff) {
+#ifndef GTE_FLAGLESS
 		gteFLAG |= (1 << 31) | (1 << 17);
+#endif
 		return 0x1ffff;
 	}
 
@@ -262,6 +301,7 @@ INLINE u32 DIVIDE(u16 n, u16 d) {
 #include "gte_divide.h"
 #endif // GTE_USE_NATIVE_DIVIDE
 
+#ifndef GTE_FLAGLESS
 //senquack - Applied fixes from PCSX Rearmed 7384197d8a5fd20a4d94f3517a6462f7fe86dd4c
 // Case 28 now falls through to case 29, and don't return 0 for case 30
 // Fixes main menu freeze in 'Lego Racers'
@@ -395,8 +435,10 @@ void gteLWC2(void) {
 void gteSWC2(void) {
 	psxMemWrite32(_oB_, gtecalcMFC2(_Rt_));
 }
+#endif // GTE_FLAGLESS
 
 void gteRTPS(void) {
+	PMON_SCOPE(PMON_GTE);
 	int quotient;
 
 #ifdef GTE_LOG
@@ -429,7 +471,13 @@ void gteRTPS(void) {
 	gteIR0 = limH(tmp >> 12);
 }
 
+// NOTE: There are no vector versions of RTPT, NCCT, NCDT or MVMVA. Doing the
+//       three vertices (or matrix rows) in vector lanes, with exact 64-bit
+//       sums and per-lane FLAG bits, was measured slower than this scalar
+//       code on x86_64: with three lanes, multiply latency and lane extracts
+//       cost more than the scalar 64-bit MACs they replace.
 void gteRTPT(void) {
+	PMON_SCOPE(PMON_GTE);
 	int quotient;
 	int v;
 	s32 vx, vy, vz;
@@ -464,6 +512,7 @@ void gteRTPT(void) {
 
 // NOTE: 'gteop' parameter is instruction opcode shifted right 10 places.
 void gteMVMVA(u32 gteop) {
+	PMON_SCOPE(PMON_GTE);
 	int shift = 12 * GTE_SF(gteop);
 	int mx = GTE_MX(gteop);
 	int v = GTE_V(gteop);
@@ -488,6 +537,7 @@ void gteMVMVA(u32 gteop) {
 }
 
 void gteNCLIP(void) {
+	PMON_SCOPE(PMON_GTE);
 #ifdef GTE_LOG
 	GTE_LOG("GTE NCLIP\n");
 #endif
@@ -499,6 +549,7 @@ void gteNCLIP(void) {
 }
 
 void gteAVSZ3(void) {
+	PMON_SCOPE(PMON_GTE);
 #ifdef GTE_LOG
 	GTE_LOG("GTE AVSZ3\n");
 #endif
@@ -509,6 +560,7 @@ void gteAVSZ3(void) {
 }
 
 void gteAVSZ4(void) {
+	PMON_SCOPE(PMON_GTE);
 #ifdef GTE_LOG
 	GTE_LOG("GTE AVSZ4\n");
 #endif
@@ -520,6 +572,7 @@ void gteAVSZ4(void) {
 
 // NOTE: 'gteop' parameter is instruction opcode shifted right 10 places.
 void gteSQR(u32 gteop) {
+	PMON_SCOPE(PMON_GTE);
 	int shift = 12 * GTE_SF(gteop);
 	int lm = GTE_LM(gteop);
 
@@ -537,6 +590,7 @@ void gteSQR(u32 gteop) {
 }
 
 void gteNCCS(void) {
+	PMON_SCOPE(PMON_GTE);
 #ifdef GTE_LOG
 	GTE_LOG("GTE NCCS\n");
 #endif
@@ -570,6 +624,7 @@ void gteNCCS(void) {
 }
 
 void gteNCCT(void) {
+	PMON_SCOPE(PMON_GTE);
 	int v;
 	s32 vx, vy, vz;
 
@@ -611,6 +666,7 @@ void gteNCCT(void) {
 }
 
 void gteNCDS(void) {
+	PMON_SCOPE(PMON_GTE);
 #ifdef GTE_LOG
 	GTE_LOG("GTE NCDS\n");
 #endif
@@ -644,6 +700,7 @@ void gteNCDS(void) {
 }
 
 void gteNCDT(void) {
+	PMON_SCOPE(PMON_GTE);
 	int v;
 	s32 vx, vy, vz;
 
@@ -686,6 +743,7 @@ void gteNCDT(void) {
 
 // NOTE: 'gteop' parameter is instruction opcode shifted right 10 places.
 void gteOP(u32 gteop) {
+	PMON_SCOPE(PMON_GTE);
 	int shift = 12 * GTE_SF(gteop);
 	int lm = GTE_LM(gteop);
 
@@ -704,6 +762,7 @@ void gteOP(u32 gteop) {
 
 // NOTE: 'gteop' parameter is instruction opcode shifted right 10 places.
 void gteDCPL(u32 gteop) {
+	PMON_SCOPE(PMON_GTE);
 	int lm = GTE_LM(gteop);
 
 	s32 RIR1 = ((s32)gteR * gteIR1) >> 8;
@@ -733,6 +792,7 @@ void gteDCPL(u32 gteop) {
 
 // NOTE: 'gteop' parameter is instruction opcode shifted right 10 places.
 void gteGPF(u32 gteop) {
+	PMON_SCOPE(PMON_GTE);
 	int shift = 12 * GTE_SF(gteop);
 
 #ifdef GTE_LOG
@@ -757,6 +817,7 @@ void gteGPF(u32 gteop) {
 
 // NOTE: 'gteop' parameter is instruction opcode shifted right 10 places.
 void gteGPL(u32 gteop) {
+	PMON_SCOPE(PMON_GTE);
 	int shift = 12 * GTE_SF(gteop);
 
 #ifdef GTE_LOG
@@ -781,6 +842,7 @@ void gteGPL(u32 gteop) {
 
 // NOTE: 'gteop' parameter is instruction opcode shifted right 10 places.
 void gteDPCS(u32 gteop) {
+	PMON_SCOPE(PMON_GTE);
 	int shift = 12 * GTE_SF(gteop);
 
 #ifdef GTE_LOG
@@ -804,6 +866,7 @@ void gteDPCS(u32 gteop) {
 }
 
 void gteDPCT(void) {
+	PMON_SCOPE(PMON_GTE);
 	int v;
 
 #ifdef GTE_LOG
@@ -829,6 +892,7 @@ void gteDPCT(void) {
 }
 
 void gteNCS(void) {
+	PMON_SCOPE(PMON_GTE);
 #ifdef GTE_LOG
 	GTE_LOG("GTE NCS\n");
 #endif
@@ -856,6 +920,7 @@ void gteNCS(void) {
 }
 
 void gteNCT(void) {
+	PMON_SCOPE(PMON_GTE);
 	int v;
 	s32 vx, vy, vz;
 
@@ -890,6 +955,7 @@ void gteNCT(void) {
 }
 
 void gteCC(void) {
+	PMON_SCOPE(PMON_GTE);
 #ifdef GTE_LOG
 	GTE_LOG("GTE CC\n");
 #endif
@@ -918,6 +984,7 @@ void gteCC(void) {
 
 // NOTE: 'gteop' parameter is instruction opcode shifted right 10 places.
 void gteINTPL(u32 gteop) {
+	PMON_SCOPE(PMON_GTE);
 	int shift = 12 * GTE_SF(gteop);
 	int lm = GTE_LM(gteop);
 
@@ -941,6 +1008,7 @@ void gteINTPL(u32 gteop) {
 }
 
 void gteCDP(void) {
+	PMON_SCOPE(PMON_GTE);
 #ifdef GTE_LOG
 	GTE_LOG("GTE CDP\n");
 #endif
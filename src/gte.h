@@ -54,6 +54,31 @@ void gteGPF(u32 gteop);
 void gteGPL(u32 gteop);
 void gteNCCT(void);
 
+// Same as above, but don't update FLAG (built from gte.cpp by gte_nf.cpp).
+//  Recompilers use these when FLAG is overwritten before it could be read.
+void gteRTPS_nf(void);
+void gteOP_nf(u32 gteop);
+void gteNCLIP_nf(void);
+void gteDPCS_nf(u32 gteop);
+void gteINTPL_nf(u32 gteop);
+void gteMVMVA_nf(u32 gteop);
+void gteNCDS_nf(void);
+void gteNCDT_nf(void);
+void gteCDP_nf(void);
+void gteNCCS_nf(void);
+void gteCC_nf(void);
+void gteNCS_nf(void);
+void gteNCT_nf(void);
+void gteSQR_nf(u32 gteop);
+void gteDCPL_nf(u32 gteop);
+void gteDPCT_nf(void);
+void gteAVSZ3_nf(void);
+void gteAVSZ4_nf(void);
+void gteRTPT_nf(void);
+void gteGPF_nf(u32 gteop);
+void gteGPL_nf(u32 gteop);
+void gteNCCT_nf(void);
+
 // for the recompiler
 u32 gtecalcMFC2(int reg);
 void gtecalcMTC2(u32 value, int reg);
@@ -7,7 +7,10 @@
 
 #include "psxcommon.h"
 
-static const u16 initial_guess[32768] = {
+// Table is defined once, in gte.cpp, and shared with flag-less build of it
+extern const u16 gte_initial_guess[32768];
+#ifndef GTE_FLAGLESS
+const u16 gte_initial_guess[32768] = {
 	0x0000, 0xFE93, 0xFE91, 0xFE8F, 0xFE8D, 0xFE8B, 0xFE89, 0xFE87,
 	0xFE85, 0xFE83, 0xFE81, 0xFE7F, 0xFE7D, 0xFE7B, 0xFE79, 0xFE77,
 	0xFE75, 0xFE71, 0xFE6F, 0xFE6D, 0xFE6B, 0xFE69, 0xFE67, 0xFE65,
@@ -4105,6 +4108,7 @@ static const u16 initial_guess[32768] = {
 	0x1058, 0x1047, 0x1047, 0x103E, 0x103E, 0x1035, 0x1035, 0x102C,
 	0x102C, 0x1023, 0x1023, 0x101A, 0x101A, 0x1011, 0x1011, 0x1008
 };
+#endif
 
 // note: returns 16.16 fixed-point
 //senquack - n param should be unsigned (will be 'gteH' reg which is u16)
@@ -4122,7 +4126,7 @@ static u32 DIVIDE(u16 n, u16 d) {
 
 		// Newton-Raphson interation - x0, x1, x2
 		// (16.16 fixed-point)
-		r = initial_guess[offset & 0x7fff] | 0x10000;
+		r = gte_initial_guess[offset & 0x7fff] | 0x10000;
 
 		s = (u64)offset * r >> 16;
 		r = (u64)r * (0x20000 - s) >> 16;
@@ -0,0 +1,7 @@
+/*
+ * GTE functions that don't update the FLAG register, for the recompilers.
+ *  See notes at top of gte.cpp.
+ */
+
+#define GTE_FLAGLESS
+#include "gte.cpp"
@@ -19,6 +19,14 @@
  ***************************************************************************/
 
 #include "mdec.h"
+#include "perfmon.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+
+// Decode macroblocks of DMA1 transfers on worker threads, see mdec_queue()
+#define MDEC_THREADS
+#endif
 
 /* memory speed is 1 byte per MDEC_BIAS psx clock
  * That mean (PSXCLK / MDEC_BIAS) B/s
@@ -37,6 +45,15 @@
 #define DSIZE			8
 #define DSIZE2			(DSIZE * DSIZE)
 
+// MDEC_USE_SIMD selects vector IDCT and color conversion from mdec_simd.h.
+//  It is set on little-endian platforms with 128-bit integer SIMD that
+//  includes byte shuffles, unless MDEC_NO_SIMD is defined.
+#if !defined(MDEC_NO_SIMD) && defined(__GNUC__) && !defined(__clang__) && \
+    defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ && \
+    (defined(__SSSE3__) || defined(__ARM_NEON__) || defined(__ARM_NEON))
+#define MDEC_USE_SIMD
+#endif
+
 #define SCALE(x, n)		((x) >> (n))
 #define SCALER(x, n)	(((x) + ((1 << (n)) >> 1)) >> (n))
 
@@ -229,6 +246,10 @@ static struct {
 	struct _pending_dma1 pending_dma1;
 } mdec;
 
+#ifdef MDEC_USE_SIMD
+#include "mdec_simd.h"
+#endif
+
 static int iq_y[DSIZE2], iq_uv[DSIZE2];
 
 static int zscan[DSIZE2] = {
@@ -298,6 +319,11 @@ static unsigned short *rl2blk(int *blk, unsigned short *mdec_rl) {
 		// at least one non zero cofficient in the rows 1-7
 		// single coefficients in row 0 are treted specially 
 		// in the idtc function
+#ifdef MDEC_USE_SIMD
+		if (used_col != -1)
+			idct_simd(blk);
+		else
+#endif
 		idct(blk, used_col);
 		blk += DSIZE2;
 	}
@@ -360,6 +386,10 @@ static inline void yuv2rgb15(int *blk, unsigned short *image) {
 	int *Cbblk = blk + DSIZE2;
 
 	if (!Config.Mdec) {
+#ifdef MDEC_USE_SIMD
+		yuv2rgb15_simd(blk, image);
+		return;
+#endif
 		for (y = 0; y < 16; y += 2, Crblk += 4, Cbblk += 4, Yblk += 8, image += 24) {
 			if (y == 8) Yblk += DSIZE2;
 			for (x = 0; x < 4; x++, image += 2, Crblk++, Cbblk++, Yblk += 2) {
@@ -419,6 +449,10 @@ static void yuv2rgb24(int *blk, u8 *image) {
 	int *Cbblk = blk + DSIZE2;
 
 	if (!Config.Mdec) {
+#ifdef MDEC_USE_SIMD
+		yuv2rgb24_simd(blk, image);
+		return;
+#endif
 		for (y = 0; y < 16; y += 2, Crblk += 4, Cbblk += 4, Yblk += 8, image += 8 * 3 * 3) {
 			if (y == 8) Yblk += DSIZE2;
 			for (x = 0; x < 4; x++, image += 6, Crblk++, Cbblk++, Yblk += 2) {
@@ -435,15 +469,282 @@ static void yuv2rgb24(int *blk, u8 *image) {
 	}
 }
 
+// Returns end of macroblock data at 'mdec_rl', which is read exactly the
+//  way rl2blk() reads it
+static unsigned short *rl_skip(unsigned short *mdec_rl) {
+	int i, k, rl;
+
+	for (i = 0; i < 6; i++) {
+		mdec_rl++;
+		for (k = 0;;) {
+			rl = SWAP16(*mdec_rl); mdec_rl++;
+			if (rl == MDEC_END_OF_DATA) break;
+			k += RLE_RUN(rl) + 1;
+			if (k > 63) break;
+		}
+	}
+	return mdec_rl;
+}
+
+// Decode macroblock at 'mdec_rl' to 'image', returns end of its data
+static unsigned short *mdec_decode(int *blk, unsigned short *mdec_rl, u8 *image, boolean rgb15) {
+	mdec_rl = rl2blk(blk, mdec_rl);
+	if (rgb15)
+		yuv2rgb15(blk, (u16 *)image);
+	else
+		yuv2rgb24(blk, image);
+	return mdec_rl;
+}
+
+#define SIZE_OF_24B_BLOCK (16*16*3)
+#define SIZE_OF_16B_BLOCK (16*16*2)
+
+/* Worker threads
+ *
+ * With mdecThreads set, psxDma1() only finds where each macroblock of the
+ * transfer starts, which takes little more than reading the RLE codes, and
+ * queues one job per macroblock with a copy of its RLE data. Macroblocks
+ * don't depend on each other, so workers decode them in any order, each to
+ * its job's own buffer. The emulation thread then joins in and waits for the
+ * rest in mdec1Interrupt(), and copies the decoded macroblocks to PSX RAM
+ * before the transfer is completed. Emulated timing is unchanged.
+ *
+ * Workers never touch PSX RAM: the CPU keeps running meanwhile, and writes
+ * to RAM from the emulation thread are the only ones the rest of the
+ * emulator expects.
+ *
+ * Anything else that touches MDEC state or the quantization tables waits
+ * for queued jobs first, see mdecSync().
+ */
+#ifdef MDEC_THREADS
+#define MDEC_MAX_JOBS		512
+
+// Longest macroblock data rl_skip() accepts: six blocks, each a DC code
+//  followed by at most 64 AC codes
+#define MDEC_MAX_RL			(6 * (1 + 64))
+
+int mdecThreads = 0;
+
+struct mdec_job {
+	unsigned short rl[MDEC_MAX_RL];
+	u8 out[16*16*3];
+	u8 *image;			// Where in PSX RAM 'out' goes
+	boolean rgb15;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond_work;	// Signalled when jobs are queued
+	pthread_cond_t cond_done;	// Signalled when last queued job is done
+	pthread_t threads[MDEC_MAX_THREADS];
+	int count;			// Number of threads running
+	int wanted;			// mdecThreads value they were started for
+	struct mdec_job jobs[MDEC_MAX_JOBS];
+	int added;			// Jobs filled in, only used by emulation thread
+	int queued;			// Jobs threads may take
+	int taken;
+	int done;
+	boolean exit_thread;
+} mthr;
+
+// Take next queued job and decode it. Called with lock held, which is
+//  dropped while decoding.
+static void mdec_run_job(int *blk) {
+	struct mdec_job *job = &mthr.jobs[mthr.taken++];
+
+	pthread_mutex_unlock(&mthr.lock);
+	mdec_decode(blk, job->rl, job->out, job->rgb15);
+	pthread_mutex_lock(&mthr.lock);
+
+	if (++mthr.done == mthr.queued)
+		pthread_cond_signal(&mthr.cond_done);
+}
+
+static void *mdec_thread(void *arg) {
+	int blk[DSIZE2 * 6];
+
+	pthread_mutex_lock(&mthr.lock);
+	for (;;) {
+		while (mthr.taken == mthr.queued && !mthr.exit_thread)
+			pthread_cond_wait(&mthr.cond_work, &mthr.lock);
+		if (mthr.exit_thread)
+			break;
+		mdec_run_job(blk);
+	}
+	pthread_mutex_unlock(&mthr.lock);
+	return NULL;
+}
+
+// Let threads take jobs added so far
+static void mdec_kick(void) {
+	if (mthr.added == 0)
+		return;
+
+	pthread_mutex_lock(&mthr.lock);
+	mthr.queued = mthr.added;
+	pthread_cond_broadcast(&mthr.cond_work);
+	pthread_mutex_unlock(&mthr.lock);
+}
+
+void mdecSync(void) {
+	int blk[DSIZE2 * 6];
+
+	if (mthr.added == 0)
+		return;
+
+	pthread_mutex_lock(&mthr.lock);
+	mthr.queued = mthr.added;
+	while (mthr.taken < mthr.queued)
+		mdec_run_job(blk);
+	while (mthr.done < mthr.queued)
+		pthread_cond_wait(&mthr.cond_done, &mthr.lock);
+	pthread_mutex_unlock(&mthr.lock);
+
+	// Threads are idle until more jobs are queued
+	for (int i = 0; i < mthr.queued; i++) {
+		struct mdec_job *job = &mthr.jobs[i];
+		memcpy(job->image, job->out, job->rgb15 ? SIZE_OF_16B_BLOCK : SIZE_OF_24B_BLOCK);
+	}
+	mthr.added = mthr.queued = mthr.taken = mthr.done = 0;
+}
+
+// Queue decoding of macroblock at 'mdec_rl' to 'image', returns end of its
+//  data. Decodes it right away if there are no threads.
+static unsigned short *mdec_queue(int *blk, unsigned short *mdec_rl, u8 *image, boolean rgb15) {
+	struct mdec_job *job;
+	unsigned short *rl_end;
+
+	if (mthr.count == 0)
+		return mdec_decode(blk, mdec_rl, image, rgb15);
+
+	if (mthr.added == MDEC_MAX_JOBS)
+		mdecSync();
+
+	rl_end = rl_skip(mdec_rl);
+
+	job = &mthr.jobs[mthr.added++];
+	memcpy(job->rl, mdec_rl, (rl_end - mdec_rl) * sizeof(job->rl[0]));
+	job->image = image;
+	job->rgb15 = rgb15;
+
+	// Wake threads early in long transfers
+	if ((mthr.added & 15) == 0)
+		mdec_kick();
+
+	return rl_end;
+}
+
+static void mdec_thread_start(int count) {
+	int i;
+
+	if (pthread_mutex_init(&mthr.lock, NULL) != 0)
+		goto fail;
+	if (pthread_cond_init(&mthr.cond_work, NULL) != 0)
+		goto fail_lock;
+	if (pthread_cond_init(&mthr.cond_done, NULL) != 0)
+		goto fail_work;
+
+	mthr.exit_thread = FALSE;
+	for (i = 0; i < count; i++) {
+		if (pthread_create(&mthr.threads[i], NULL, mdec_thread, NULL) != 0)
+			break;
+	}
+	mthr.count = i;
+	if (mthr.count == 0)
+		goto fail_done;
+
+	printf("Started %d MDEC decoding thread(s)\n", mthr.count);
+	return;
+
+fail_done:
+	pthread_cond_destroy(&mthr.cond_done);
+fail_work:
+	pthread_cond_destroy(&mthr.cond_work);
+fail_lock:
+	pthread_mutex_destroy(&mthr.lock);
+fail:
+	printf("Failed to start MDEC decoding threads, decoding on emulation thread\n");
+}
+
+void mdecShutdown(void) {
+	int i;
+
+	mthr.wanted = 0;
+	if (mthr.count == 0)
+		return;
+
+	mdecSync();
+
+	pthread_mutex_lock(&mthr.lock);
+	mthr.exit_thread = TRUE;
+	pthread_cond_broadcast(&mthr.cond_work);
+	pthread_mutex_unlock(&mthr.lock);
+	for (i = 0; i < mthr.count; i++)
+		pthread_join(mthr.threads[i], NULL);
+
+	pthread_cond_destroy(&mthr.cond_done);
+	pthread_cond_destroy(&mthr.cond_work);
+	pthread_mutex_destroy(&mthr.lock);
+	mthr.count = 0;
+}
+
+// Start or stop threads when mdecThreads changed. No jobs may be queued.
+static void mdec_thread_update(void) {
+	int count = mdecThreads;
+
+	if (count > MDEC_MAX_THREADS)
+		count = MDEC_MAX_THREADS;
+	if (count < 0)
+		count = 0;
+	if (count == mthr.wanted)
+		return;
+
+	mdecShutdown();
+	mthr.wanted = count;
+	if (count > 0)
+		mdec_thread_start(count);
+}
+#else
+int mdecThreads = 0;
+
+static inline unsigned short *mdec_queue(int *blk, unsigned short *mdec_rl, u8 *image, boolean rgb15) {
+	return mdec_decode(blk, mdec_rl, image, rgb15);
+}
+
+static inline void mdec_kick(void) {}
+static inline void mdec_thread_update(void) {}
+void mdecSync(void) {}
+void mdecShutdown(void) {}
+#endif // MDEC_THREADS
+
 void mdecInit(void) {
+	mdecSync();
+	mdec_thread_update();
+
 	memset(&mdec, 0, sizeof(mdec));
 	memset(iq_y, 0, sizeof(iq_y));
 	memset(iq_uv, 0, sizeof(iq_uv));
 	mdec.rl = (u16 *)&psxM[0x100000];
 }
 
+#ifdef MDEC_CAPTURE
+// Append command 'cmd' and its 'words' of DMA0 data to mdec_capture.bin,
+//  as input for bench/mdec_bench.cpp
+static void mdec_capture(u32 cmd, const u8 *data, u32 words) {
+	static FILE *f;
+	u32 hdr[2] = { cmd, words };
+
+	if (f == NULL && (f = fopen("mdec_capture.bin", "wb")) == NULL)
+		return;
+	fwrite(hdr, sizeof(hdr), 1, f);
+	fwrite(data, 4, words, f);
+	fflush(f);
+}
+#endif
+
 // command register
 void mdecWrite0(u32 data) {
+	mdecSync();
 	mdec.reg0 = data;
 }
 
@@ -454,6 +755,7 @@ u32 mdecRead0(void) {
 // status register
 void mdecWrite1(u32 data) {
 	if (data & MDEC1_RESET) { // mdec reset
+		mdecSync();
 		mdec.reg0 = 0;
 		mdec.reg1 = 0;
 		mdec.pending_dma1.adr = 0;
@@ -469,16 +771,24 @@ u32 mdecRead1(void) {
 void psxDma0(u32 adr, u32 bcr, u32 chcr) {
 	int cmd = mdec.reg0;
 	int size;
+	PMON_SCOPE(PMON_MDEC);
 
 	if (chcr != 0x01000201) {
 		return;
 	}
 
+	mdecSync();
+
 	/* mdec is STP till dma0 is released */
 	mdec.reg1 |= MDEC1_STP;
 
 	size = (bcr >> 16) * (bcr & 0xffff);
 
+#ifdef MDEC_CAPTURE
+	if ((cmd >> 28) == 0x3 || (cmd >> 28) == 0x4)
+		mdec_capture(cmd, (u8 *)PSXM(adr), size);
+#endif
+
 	switch (cmd >> 28) {
 		case 0x3: // decode
 			mdec.rl = (u16 *) PSXM(adr);
@@ -537,17 +847,18 @@ void mdec0Interrupt()
 	}
 }
 
-#define SIZE_OF_24B_BLOCK (16*16*3)
-#define SIZE_OF_16B_BLOCK (16*16*2)
-
 void psxDma1(u32 adr, u32 bcr, u32 chcr) {
 	int blk[DSIZE2 * 6];
 	u8 * image;
 	int size;
 	u32 words;
+	PMON_SCOPE(PMON_MDEC);
 
 	if (chcr != 0x01000200) return;
 
+	mdecSync();
+	mdec_thread_update();
+
 	words = (bcr >> 16) * (bcr & 0xffff);
 	/* size in byte */
 	size = words * 4;
@@ -577,8 +888,7 @@ void psxDma1(u32 adr, u32 bcr, u32 chcr) {
 			}
 
 			while(size >= SIZE_OF_16B_BLOCK) {
-				mdec.rl = rl2blk(blk, mdec.rl);
-				yuv2rgb15(blk, (u16 *)image);
+				mdec.rl = mdec_queue(blk, mdec.rl, image, TRUE);
 				image += SIZE_OF_16B_BLOCK;
 				size -= SIZE_OF_16B_BLOCK;
 			}
@@ -606,8 +916,7 @@ void psxDma1(u32 adr, u32 bcr, u32 chcr) {
 			}
 
 			while(size >= SIZE_OF_24B_BLOCK) {
-				mdec.rl = rl2blk(blk, mdec.rl);
-				yuv2rgb24(blk, image);
+				mdec.rl = mdec_queue(blk, mdec.rl, image, FALSE);
 				image += SIZE_OF_24B_BLOCK;
 				size -= SIZE_OF_24B_BLOCK;
 			}
@@ -620,6 +929,8 @@ void psxDma1(u32 adr, u32 bcr, u32 chcr) {
 			}
 		}
 
+		mdec_kick();
+
 		/* define the power of mdec */
 		MDECOUTDMA_INT(words * MDEC_BIAS);
 	}
@@ -650,6 +961,9 @@ void mdec1Interrupt() {
 	 *
 	 */
 
+	/* macroblocks queued by psxDma1() must be in RAM by now */
+	mdecSync();
+
 	/* MDEC_END_OF_DATA avoids read outside memory */
 	if (mdec.rl >= mdec.rl_end || SWAP16(*(mdec.rl)) == MDEC_END_OF_DATA) {
 		mdec.reg1 &= ~(MDEC1_STP|MDEC1_BUSY);
@@ -672,6 +986,12 @@ int mdecFreeze(void* f, FreezeMode mode)
 	u8 *base = (u8 *)&psxM[0x100000];
 	u32 v;
 
+	// Only counting bytes: leave decoder state alone
+	const bool info = (mode == FREEZE_INFO);
+
+	if (!info)
+		mdecSync();
+
 	if ( freeze_rw(f, mode, &mdec.reg0, sizeof(mdec.reg0)) ||
 	     freeze_rw(f, mode, &mdec.reg1, sizeof(mdec.reg1)) )
 		return -1;
@@ -680,20 +1000,24 @@ int mdecFreeze(void* f, FreezeMode mode)
 	v = (u8 *)mdec.rl - base;
 	if (freeze_rw(f, mode, &v, sizeof(v)))
 		return -1;
-	mdec.rl = (u16 *)(base + (v & 0xffffe));
+	if (!info)
+		mdec.rl = (u16 *)(base + (v & 0xffffe));
 	v = (u8 *)mdec.rl_end - base;
 	if (freeze_rw(f, mode, &v, sizeof(v)))
 		return -1;
-	mdec.rl_end = (u16 *)(base + (v & 0xffffe));
+	if (!info)
+		mdec.rl_end = (u16 *)(base + (v & 0xffffe));
 
 	v = 0;
 	if (mdec.block_buffer_pos)
 		v = mdec.block_buffer_pos - base;
 	if (freeze_rw(f, mode, &v, sizeof(v)))
 		return -1;
-	mdec.block_buffer_pos = 0;
-	if (v)
-		mdec.block_buffer_pos = base + (v & 0xfffff);
+	if (!info) {
+		mdec.block_buffer_pos = 0;
+		if (v)
+			mdec.block_buffer_pos = base + (v & 0xfffff);
+	}
 
 	if ( freeze_rw(f, mode, &mdec.block_buffer, sizeof(mdec.block_buffer)) ||
 	     freeze_rw(f, mode, &mdec.pending_dma1, sizeof(mdec.pending_dma1)) ||
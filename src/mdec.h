@@ -26,7 +26,14 @@
 #include "psxhw.h"
 #include "psxdma.h"
 
+// Number of threads decoding macroblocks, 0: decode on emulation thread.
+//  Changes take effect on next DMA1 transfer.
+#define MDEC_MAX_THREADS	4
+extern int mdecThreads;
+
 void mdecInit(void);
+void mdecShutdown(void);
+void mdecSync(void);
 void mdecWrite0(u32 data);
 void mdecWrite1(u32 data);
 u32  mdecRead0(void);
@@ -262,9 +262,7 @@ int LoadCdrom() {
 	tmpHead.t_size = SWAP32(tmpHead.t_size);
 	tmpHead.t_addr = SWAP32(tmpHead.t_addr);
 
-#ifdef PSXREC
 	psxCpu->Clear(tmpHead.t_addr, tmpHead.t_size / 4);
-#endif
 
 	// Read the rest of the main executable
 	while (tmpHead.t_size & ~2047) {
@@ -311,9 +309,7 @@ int LoadCdromFile(const char *filename, EXE_HEADER *head) {
 	size = head->t_size;
 	addr = head->t_addr;
 
-#ifdef PSXREC
 	psxCpu->Clear(addr, size / 4);
-#endif
 
 	while (size & ~2047) {
 		incTime();
@@ -480,15 +476,13 @@ int Load(const char *ExePath) {
 				section_size = SWAP32(tmpHead.t_size);
 				mem = PSXM(section_address);
 				if (mem != NULL) {
+					psxCpu->Clear(section_address, section_size / 4);
 					if (fseek(tmpFile, 0x800, SEEK_SET) == -1 ||
 					    fread(mem, section_size, 1, tmpFile) != 1) {
 						printf("Error reading PSX_EXE executable file\n");
 						retval = -1;
 						break;
 					}
-#ifdef PSXREC
-					psxCpu->Clear(section_address, section_size / 4);
-#endif
 				}
 				psxRegs.pc = SWAP32(tmpHead.pc0);
 				psxRegs.GPR.n.gp = SWAP32(tmpHead.gp0);
@@ -528,14 +522,12 @@ int Load(const char *ExePath) {
 #endif
 							mem = PSXM(section_address);
 							if (mem != NULL) {
+								psxCpu->Clear(section_address, section_size / 4);
 								if (fread(mem, section_size, 1, tmpFile) != 1) {
 									printf("Error reading CPE_EXE executable file\n");
 									retval = -1;
 									break;
 								}
-#ifdef PSXREC
-								psxCpu->Clear(section_address, section_size / 4);
-#endif
 							}
 							break;
 						case 3: /* register loading (PC only?) */
@@ -667,23 +659,93 @@ static int zlib_close(void *file)
 	return retval;
 }
 
+struct PcsxSaveFuncs SaveFuncs = {
+	zlib_open, zlib_read, zlib_write, zlib_seek, zlib_close
+#if !(defined(_WIN32) && !defined(__CYGWIN__))
+	, -1, -1
+#endif
+};
+
+// Savestate stream over a caller-provided buffer, for in-memory savestates.
+//  When 'buf' is NULL, nothing is stored and 'pos' just counts the bytes a
+//  save would take.
+struct mem_state {
+	u8  *buf;
+	u32 size;
+	u32 pos;
+};
+
+// Funcs freeze_rw() uses: SaveFuncs, or MemSaveFuncs during in-memory
+//  savestates (see SaveStateMem())
+static struct PcsxSaveFuncs *freeze_funcs = &SaveFuncs;
+
+// FREEZE_INFO only adds 'len' to the byte count of a counting mem_state,
+//  see SaveStateMemSize(). Freeze functions must not change any state then.
 int freeze_rw(void *file, enum FreezeMode mode, void *buf, unsigned len)
 {
 	if (mode == FREEZE_LOAD) {
-		if (SaveFuncs.read(file, buf, len) != len) return -1;
+		if (freeze_funcs->read(file, buf, len) != len) return -1;
 	} else if (mode == FREEZE_SAVE) {
-		if (SaveFuncs.write(file, buf, len) != len) return -1;
+		if (freeze_funcs->write(file, buf, len) != len) return -1;
+	} else if (mode == FREEZE_INFO) {
+		((struct mem_state *)file)->pos += len;
 	}
 	return 0;
 }
 
-struct PcsxSaveFuncs SaveFuncs = {
-	zlib_open, zlib_read, zlib_write, zlib_seek, zlib_close
+//////////////////////////////////
+// In-memory savestate handling //
+//////////////////////////////////
+
+static int mem_state_read(void *file, void *buf, u32 len)
+{
+	struct mem_state *ms = (struct mem_state *)file;
+	if (len > ms->size - ms->pos)
+		return -1;
+	memcpy(buf, ms->buf + ms->pos, len);
+	ms->pos += len;
+	return len;
+}
+
+static int mem_state_write(void *file, const void *buf, u32 len)
+{
+	struct mem_state *ms = (struct mem_state *)file;
+	if (len > ms->size - ms->pos)
+		return -1;
+	memcpy(ms->buf + ms->pos, buf, len);
+	ms->pos += len;
+	return len;
+}
+
+static long mem_state_seek(void *file, long offs, int whence)
+{
+	struct mem_state *ms = (struct mem_state *)file;
+	long pos = (whence == SEEK_SET) ? offs : ms->pos + offs;
+	if (whence == SEEK_END || pos < 0 || pos > (long)ms->size)
+		return -1;
+	ms->pos = pos;
+	return pos;
+}
+
+static struct PcsxSaveFuncs MemSaveFuncs = {
+	NULL, mem_state_read, mem_state_write, mem_state_seek, NULL
 #if !(defined(_WIN32) && !defined(__CYGWIN__))
 	, -1, -1
 #endif
 };
 
+// Reserve 'len' bytes at the next 8-byte aligned position of 'ms', for a
+//  plugin to freeze its state into directly. Returns NULL when there is no
+//  room left, or when 'ms' is only counting bytes.
+static void *mem_state_reserve(struct mem_state *ms, u32 len)
+{
+	u32 pos = (ms->pos + 7) & ~7;
+	if (ms->buf && (pos > ms->size || len > ms->size - pos))
+		return NULL;
+	ms->pos = pos + len;
+	return ms->buf ? ms->buf + pos : NULL;
+}
+
 static const char PcsxHeader[32] = "STv4 PCSX v" PACKAGE_VERSION;
 
 // Savestate Versioning!
@@ -713,6 +775,27 @@ static const u32 SaveVersionEarliestSupported = 0x8b410004;
 //                 * Embedded screenshot data area is expanded a bit and now
 //                   used for rgb565 160x120x2 image (38400 bytes)
 
+// Everything after the SPU data: devices and controller state
+static int freeze_devices(void *f, enum FreezeMode mode)
+{
+	if (    sioFreeze(f, mode)
+	     || cdrFreeze(f, mode)
+	     || psxHwFreeze(f, mode)
+	     || psxRcntFreeze(f, mode)
+	     || mdecFreeze(f, mode) )
+		return -1;
+
+	return freeze_rw(f, mode, &player_controller[0], sizeof(struct ps1_controller));
+}
+
+// Size of SPU plugin's freeze data
+static u32 spu_freeze_size(void)
+{
+	u32 info[4];  // FREEZE_INFO only fills in name, version and size
+	SPU_freeze(FREEZE_INFO, (SPUFreeze_t *)info, psxRegs.cycle);
+	return ((SPUFreeze_t *)info)->Size;
+}
+
 int SaveState(const char *file) {
 	void* f;
 	GPUFreeze_t *gpufP = NULL;
@@ -745,6 +828,9 @@ int SaveState(const char *file) {
 	if (Config.HLE)
 		psxBiosFreeze(1);
 
+	// Macroblocks still being decoded go to RAM
+	mdecSync();
+
 	if ( freeze_rw(f, FREEZE_SAVE, psxM, 0x00200000)  ||
 	     freeze_rw(f, FREEZE_SAVE, psxR, 0x00080000)  ||
 	     freeze_rw(f, FREEZE_SAVE, psxH, 0x00010000)  ||
@@ -762,11 +848,7 @@ int SaveState(const char *file) {
 	gpufP = NULL;
 
 	// spu
-	if ((spufP = (SPUFreeze_t *)malloc(16)) == NULL)
-		goto error;
-	SPU_freeze(FREEZE_INFO, spufP, psxRegs.cycle);
-	Size = spufP->Size;
-	free(spufP);
+	Size = spu_freeze_size();
 	if (freeze_rw(f, FREEZE_SAVE, &Size, 4))
 		goto error;
 	if ( (spufP = (SPUFreeze_t *)malloc(Size)) == NULL    ||
@@ -776,14 +858,7 @@ int SaveState(const char *file) {
 	free(spufP);
 	spufP = NULL;
 
-	if (    sioFreeze(f, FREEZE_SAVE)
-	     || cdrFreeze(f, FREEZE_SAVE)
-	     || psxHwFreeze(f, FREEZE_SAVE)
-	     || psxRcntFreeze(f, FREEZE_SAVE)
-	     || mdecFreeze(f, FREEZE_SAVE) )
-		goto error;
-
-	if (freeze_rw(f, FREEZE_SAVE, &player_controller[0], sizeof(struct ps1_controller)))
+	if (freeze_devices(f, FREEZE_SAVE))
 		goto error;
 
 	if (SaveFuncs.close(f)) {
@@ -831,6 +906,9 @@ int LoadState(const char *file) {
 
 	psxCpu->Reset();
 
+	// Don't let macroblocks still being decoded overwrite loaded RAM
+	mdecSync();
+
 	// XXX - Save versions before 0x8b410006 had smaller area
 	//       reserved for screenshot data, which was unused.
 	if (version <= 0x8b410005) {
@@ -893,17 +971,8 @@ int LoadState(const char *file) {
 		goto skip_missing_data_hack;
 	}
 
-	if ( sioFreeze(f, FREEZE_LOAD)      ||
-	     cdrFreeze(f, FREEZE_LOAD)      ||
-	     psxHwFreeze(f, FREEZE_LOAD)    ||
-	     psxRcntFreeze(f, FREEZE_LOAD)  ||
-	     mdecFreeze(f, FREEZE_LOAD)     )
+	if (freeze_devices(f, FREEZE_LOAD))
 		goto error;
-
-	if (freeze_rw(f, FREEZE_LOAD, &player_controller[0], sizeof(struct ps1_controller)))
-	{
-		goto error;
-	}
 	//XXX: HACK December 2016 -- see comment above
 skip_missing_data_hack:
 
@@ -918,6 +987,168 @@ error:
 	return -1;
 }
 
+// In-memory savestates, for quick-saves, rewind etc. Same contents as a
+//  savestate file minus the screenshot, uncompressed, with the GPU and SPU
+//  data frozen in place at 8-byte aligned offsets. No memory is allocated.
+//  Only valid for the running build: LoadStateMem() requires the exact
+//  same SaveVersion.
+static int save_state_mem(struct mem_state *ms)
+{
+	// Without a buffer, only count bytes (see SaveStateMemSize())
+	enum FreezeMode mode = ms->buf ? FREEZE_SAVE : FREEZE_INFO;
+	GPUFreeze_t *gpufP;
+	SPUFreeze_t *spufP;
+	u32 Size;
+
+	if ( freeze_rw(ms, mode, (void*)PcsxHeader, 32)              ||
+	     freeze_rw(ms, mode, (void*)&SaveVersion, sizeof(u32))   ||
+	     freeze_rw(ms, mode, (void*)&Config.HLE, sizeof(boolean)) )
+		return -1;
+
+	if (mode == FREEZE_SAVE) {
+		if (Config.HLE)
+			psxBiosFreeze(1);
+
+		// Macroblocks still being decoded go to RAM
+		mdecSync();
+	}
+
+	if ( freeze_rw(ms, mode, psxM, 0x00200000)  ||
+	     freeze_rw(ms, mode, psxR, 0x00080000)  ||
+	     freeze_rw(ms, mode, psxH, 0x00010000)  ||
+	     freeze_rw(ms, mode, (void*)&psxRegs, sizeof(psxRegs)) )
+		return -1;
+
+	// gpu
+	gpufP = (GPUFreeze_t *)mem_state_reserve(ms, sizeof(GPUFreeze_t));
+	if (mode == FREEZE_SAVE) {
+		if (gpufP == NULL)
+			return -1;
+		gpufP->ulFreezeVersion = 1;
+		if (!GPU_freeze(FREEZE_SAVE, gpufP))
+			return -1;
+	}
+
+	// spu
+	Size = spu_freeze_size();
+	if (freeze_rw(ms, mode, &Size, 4))
+		return -1;
+	spufP = (SPUFreeze_t *)mem_state_reserve(ms, Size);
+	if (mode == FREEZE_SAVE) {
+		if (spufP == NULL || !SPU_freeze(FREEZE_SAVE, spufP, psxRegs.cycle))
+			return -1;
+	}
+
+	return freeze_devices(ms, mode);
+}
+
+// Returns the buffer size SaveStateMem() needs. Call again if the SPU
+//  plugin or its settings change. Emulator state is left untouched.
+u32 SaveStateMemSize(void)
+{
+	struct mem_state ms = { NULL, 0, 0 };
+
+	save_state_mem(&ms);
+
+	return ms.pos;
+}
+
+// Save state into 'buf' of 'size' bytes, which should be 8-byte aligned.
+//  Returns bytes used, or -1 if 'buf' is too small.
+int SaveStateMem(void *buf, u32 size)
+{
+	struct mem_state ms = { (u8 *)buf, size, 0 };
+	int ret;
+
+	freeze_funcs = &MemSaveFuncs;
+	ret = save_state_mem(&ms);
+	freeze_funcs = &SaveFuncs;
+
+	if (ret) {
+		printf("Error in SaveStateMem() saving to %u byte buffer\n", size);
+		return -1;
+	}
+	return ms.pos;
+}
+
+static int load_state_mem(struct mem_state *ms)
+{
+	GPUFreeze_t *gpufP;
+	SPUFreeze_t *spufP;
+	u32 Size;
+	char header[32];
+	u32 version;
+	boolean hle;
+
+	if ( freeze_rw(ms, FREEZE_LOAD, header, sizeof(header)) ||
+	     freeze_rw(ms, FREEZE_LOAD, &version, sizeof(u32))  ||
+	     freeze_rw(ms, FREEZE_LOAD, &hle, sizeof(boolean)) )
+		return -1;
+
+	if (memcmp(PcsxHeader, header, sizeof(header)) != 0 ||
+	    version != SaveVersion || hle != Config.HLE)
+		return -1;
+
+	psxCpu->Reset();
+
+	// Don't let macroblocks still being decoded overwrite loaded RAM
+	mdecSync();
+
+	if ( freeze_rw(ms, FREEZE_LOAD, psxM, 0x00200000) ||
+	     freeze_rw(ms, FREEZE_LOAD, psxR, 0x00080000) ||
+	     freeze_rw(ms, FREEZE_LOAD, psxH, 0x00010000) )
+		return -1;
+
+	if (freeze_rw(ms, FREEZE_LOAD, (void*)&psxRegs, sizeof(psxRegs)))
+		return -1;
+	psxRegs.psxM=psxM;
+	psxRegs.psxP=psxP;
+	psxRegs.psxR=psxR;
+	psxRegs.psxH=psxH;
+	psxRegs.io_cycle_counter=0;
+
+	// See LoadState()
+	psxEvqueueInitFromFreeze();
+
+	if (Config.HLE)
+		psxBiosFreeze(0);
+
+	// gpu
+	if ((gpufP = (GPUFreeze_t *)mem_state_reserve(ms, sizeof(GPUFreeze_t))) == NULL ||
+	     (!GPU_freeze(FREEZE_LOAD, gpufP)))
+		return -1;
+	if (HW_GPU_STATUS == 0)
+		HW_GPU_STATUS = GPU_readStatus();
+
+	// spu
+	if ( freeze_rw(ms, FREEZE_LOAD, &Size, 4)                         ||
+	     (spufP = (SPUFreeze_t *)mem_state_reserve(ms, Size)) == NULL ||
+	     (!SPU_freeze(FREEZE_LOAD, spufP, psxRegs.cycle)) )
+		return -1;
+
+	if (freeze_devices(ms, FREEZE_LOAD))
+		return -1;
+
+	pl_reset();  // Reset plugin_lib
+	return 0;
+}
+
+// Load state saved by SaveStateMem() from 'buf' of 'size' bytes.
+//  Returns 0 on success, -1 on error.
+int LoadStateMem(const void *buf, u32 size)
+{
+	struct mem_state ms = { (u8 *)buf, size, 0 };
+	int ret;
+
+	freeze_funcs = &MemSaveFuncs;
+	ret = load_state_mem(&ms);
+	freeze_funcs = &SaveFuncs;
+
+	if (ret)
+		printf("Error in LoadStateMem(): invalid or truncated state\n");
+	return ret;
+}
+
 // Checks if sstate 'file' contains a valid header and version.
 // If 'get_sshot' is true, it will check if it contains screenshot data.
 // If 'get_sshot' is true and 'sshot_image' is not NULL, it will copy
@@ -73,6 +73,10 @@ int SaveState(const char *file);
 int LoadState(const char *file);
 int CheckState(const char *file, bool *uses_hle, bool get_sshot, u16 *sshot_image);
 
+u32 SaveStateMemSize(void);
+int SaveStateMem(void *buf, u32 size);
+int LoadStateMem(const void *buf, u32 size);
+
 enum {
 	CHECKSTATE_SUCCESS        = 0,
 	CHECKSTATE_ERR_OPEN       = -1,
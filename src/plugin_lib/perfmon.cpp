@@ -40,6 +40,17 @@
 #include "perfmon.h"
 #include "psxcommon.h"
 
+struct pmon_subsys_t pmon_subsys;
+uint64_t pmon_counters[PMON_CTR_COUNT];
+
+static const char *pmon_subsys_names[PMON_SUBSYS_COUNT] = {
+	"cpu", "gte", "gpu", "vout", "spu", "mdec", "cdr", "evt"
+};
+
+static const char *pmon_counter_names[PMON_CTR_COUNT] = {
+	"rec_evict", "rec_flush", "rec_superblock"
+};
+
 static struct {
 	struct timeval tv_last;
 	unsigned frame_ctr;
@@ -57,6 +68,14 @@ static struct {
 	float cpu_cur, cpu_avg, cpu_min, cpu_max;
 	struct timeval tv_last_ru_utime, tv_last_ru_stime;
 #endif
+
+	// Per-subsystem totals at start of stats interval, and resulting
+	//  milliseconds per frame for last interval
+	uint64_t subsys_nsecs_last[PMON_SUBSYS_COUNT];
+	float subsys_ms[PMON_SUBSYS_COUNT];
+
+	// Event counter totals at start of detailed stats interval
+	uint64_t counters_last[PMON_CTR_COUNT];
 } pmon;
 
 // Returns # of microseconds spanning interval between tv and tv_old
@@ -105,9 +124,32 @@ void pmonReset()
 	pmon.cpu_cur = 0;
 	pmonInitCpuUsage();
 #endif
+
+	bool subsys_enable = Config.PerfmonDetailedStats || Config.Headless;
+	if (pmon_subsys.enabled != subsys_enable)
+		pmonSubsysEnable(subsys_enable);
+	pmonSubsysGetTotals(pmon.subsys_nsecs_last);
+	memset(pmon.subsys_ms, 0, sizeof(pmon.subsys_ms));
+	memset(pmon_counters, 0, sizeof(pmon_counters));
+	memset(pmon.counters_last, 0, sizeof(pmon.counters_last));
+
 	gettimeofday(&pmon.tv_last, 0);
 }
 
+static void pmonUpdateSubsysStats(unsigned frames)
+{
+	if (!pmon_subsys.enabled || frames == 0)
+		return;
+
+	uint64_t nsecs[PMON_SUBSYS_COUNT];
+	pmonSubsysGetTotals(nsecs);
+	for (int i=0; i < PMON_SUBSYS_COUNT; ++i) {
+		pmon.subsys_ms[i] = (float)(nsecs[i] - pmon.subsys_nsecs_last[i]) /
+		                    (1000000.0f * (float)frames);
+		pmon.subsys_nsecs_last[i] = nsecs[i];
+	}
+}
+
 bool pmonUpdate(struct timeval *tv_now)
 {
 	bool ret = false;
@@ -120,6 +162,7 @@ bool pmonUpdate(struct timeval *tv_now)
 #ifdef PERFMON_CPU_STATS
 		pmon.cpu_cur = pmonGetCpuUsage(diff);
 #endif
+		pmonUpdateSubsysStats(pmon.frame_ctr);
 		pmon.tv_last = *tv_now;
 		pmon.frame_ctr = 0;
 
@@ -205,6 +248,12 @@ void pmonResume()
 #ifdef PERFMON_CPU_STATS
 	pmonInitCpuUsage();
 #endif
+
+	// Don't charge time spent in frontend to any subsystem
+	if (pmon_subsys.enabled) {
+		pmon_subsys.ts_last = pmonTimestamp();
+		pmonSubsysGetTotals(pmon.subsys_nsecs_last);
+	}
 }
 
 void pmonGetStats(float *fps_cur, float *cpu_cur)
@@ -217,6 +266,43 @@ void pmonGetStats(float *fps_cur, float *cpu_cur)
 #endif
 }
 
+void pmonGetSubsysStats(float *ms)
+{
+	memcpy(ms, pmon.subsys_ms, sizeof(pmon.subsys_ms));
+}
+
+static void pmonPrintSubsysStats()
+{
+	if (!pmon_subsys.enabled)
+		return;
+
+	float ms_total = 0;
+	for (int i=0; i < PMON_SUBSYS_COUNT; ++i)
+		ms_total += pmon.subsys_ms[i];
+
+	printf("Frame time by subsystem (ms/frame):\n");
+	for (int i=0; i < PMON_SUBSYS_COUNT; ++i) {
+		printf("  %-5s %7.3f  %5.1f%%\n", pmonSubsysName(i), pmon.subsys_ms[i],
+		       ms_total > 0 ? 100.0f * pmon.subsys_ms[i] / ms_total : 0.0f);
+	}
+}
+
+static void pmonPrintCounters()
+{
+	bool any = false;
+	for (int i=0; i < PMON_CTR_COUNT; ++i) {
+		uint64_t n = pmon_counters[i] - pmon.counters_last[i];
+		pmon.counters_last[i] = pmon_counters[i];
+		if (n == 0)
+			continue;
+		printf("%s%s: %llu", any ? "  " : "Events: ", pmonCounterName(i),
+		       (unsigned long long)n);
+		any = true;
+	}
+	if (any)
+		printf("\n");
+}
+
 void pmonPrintStats(bool print_detailed_stats)
 {
 #ifdef PERFMON_CPU_STATS
@@ -224,13 +310,48 @@ void pmonPrintStats(bool print_detailed_stats)
 	if (print_detailed_stats) {
 		printf("FPS min: %6.1f  max: %6.1f  avg: %6.1f\n", pmon.fps_min, pmon.fps_max, pmon.fps_avg);
 		printf("CPU min: %6.1f%% max: %6.1f%% avg: %6.1f%%\n", pmon.cpu_min, pmon.cpu_max, pmon.cpu_avg);
+		pmonPrintSubsysStats();
+		pmonPrintCounters();
 		printf("\n");
 	}
 #else
 	printf("FPS: %6.1f\n", pmon.fps_cur);
 	if (print_detailed_stats) {
 		printf("FPS min: %6.1f  max: %6.1f  avg: %6.1f\n", pmon.fps_min, pmon.fps_max, pmon.fps_avg);
+		pmonPrintSubsysStats();
+		pmonPrintCounters();
 		printf("\n");
 	}
 #endif
 }
+
+void pmonSubsysEnable(bool enable)
+{
+	memset(&pmon_subsys, 0, sizeof(pmon_subsys));
+	pmon_subsys.cur = PMON_CPU;
+	pmon_subsys.ts_last = pmonTimestamp();
+	pmon_subsys.enabled = enable;
+}
+
+void pmonSubsysGetTotals(uint64_t *nsecs)
+{
+	// Charge time elapsed since last probe to current subsystem first
+	if (pmon_subsys.enabled)
+		pmonSubsysLeave(pmonSubsysEnter(pmon_subsys.cur));
+
+	memcpy(nsecs, pmon_subsys.nsecs, sizeof(pmon_subsys.nsecs));
+}
+
+const char *pmonSubsysName(int subsys)
+{
+	if (subsys < 0 || subsys >= PMON_SUBSYS_COUNT)
+		return "";
+	return pmon_subsys_names[subsys];
+}
+
+const char *pmonCounterName(int ctr)
+{
+	if (ctr < 0 || ctr >= PMON_CTR_COUNT)
+		return "";
+	return pmon_counter_names[ctr];
+}
@@ -25,6 +25,8 @@
 #define PERFMON_H
 
 #include <sys/time.h>
+#include <stdint.h>
+#include <time.h>
 
 // Called when (re)starting a game, before first call to pmonUpdate()
 void pmonReset();
@@ -36,6 +38,10 @@ bool pmonUpdate(struct timeval *tv_now);
 // Return current FPS, CPU%
 void pmonGetStats(float *fps_cur, float *cpu_cur);
 
+// Return per-subsystem milliseconds per frame over last stats interval,
+//  filling ms[PMON_SUBSYS_COUNT]
+void pmonGetSubsysStats(float *ms);
+
 // Output stats to console
 void pmonPrintStats(bool print_detailed_stats);
 
@@ -43,4 +49,113 @@ void pmonPrintStats(bool print_detailed_stats);
 void pmonPause();
 void pmonResume();
 
+/*
+ * Per-subsystem wall-time accounting
+ *
+ * At any moment, exactly one subsystem is 'current' and is charged for the
+ *  time that passes. PMON_CPU is the default, so whatever is not claimed by
+ *  another subsystem counts as CPU core execution. Entering a subsystem
+ *  returns the one it displaced, which must be handed back when leaving, so
+ *  nested probes (SPU update run from inside an event dispatch, etc) are
+ *  accounted exclusively.
+ *
+ * Accounting is off unless pmonSubsysEnable(true) was called, in which case
+ *  each probe costs one clock_gettime() call. pmonReset() turns it on for
+ *  detailed stats (-perfmon) and headless runs.
+ *
+ * Probes must only be placed in code run by the emu thread.
+ */
+enum {
+	PMON_CPU = 0,   // CPU core execution (anything not claimed below)
+	PMON_GTE,       // GTE ops
+	PMON_GPU,       // GPU DMA, command lists
+	PMON_VOUT,      // vout_update() blits
+	PMON_SPU,       // SPU updates, DMA
+	PMON_MDEC,      // MDEC decode
+	PMON_CDR,       // CD-ROM image reads
+	PMON_EVENTS,    // Event dispatch (psxEvqueueDispatchAndRemoveFront)
+	PMON_SUBSYS_COUNT
+};
+
+struct pmon_subsys_t {
+	bool enabled;
+	int cur;
+	uint64_t ts_last;
+	uint64_t nsecs[PMON_SUBSYS_COUNT];
+};
+
+extern struct pmon_subsys_t pmon_subsys;
+
+static inline uint64_t pmonTimestamp()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static inline int pmonSubsysEnter(int subsys)
+{
+	if (!pmon_subsys.enabled)
+		return -1;
+	uint64_t now = pmonTimestamp();
+	int prev = pmon_subsys.cur;
+	pmon_subsys.nsecs[prev] += now - pmon_subsys.ts_last;
+	pmon_subsys.ts_last = now;
+	pmon_subsys.cur = subsys;
+	return prev;
+}
+
+static inline void pmonSubsysLeave(int prev)
+{
+	if (prev < 0 || !pmon_subsys.enabled)
+		return;
+	uint64_t now = pmonTimestamp();
+	pmon_subsys.nsecs[pmon_subsys.cur] += now - pmon_subsys.ts_last;
+	pmon_subsys.ts_last = now;
+	pmon_subsys.cur = prev;
+}
+
+// Charges the enclosing C++ scope to a subsystem
+struct PmonScope {
+	int prev;
+	PmonScope(int subsys) : prev(pmonSubsysEnter(subsys)) {}
+	~PmonScope() { pmonSubsysLeave(prev); }
+};
+
+#define PMON_SCOPE(subsys) PmonScope pmon_scope_##subsys(subsys)
+
+// Turn accounting on/off. Turning it on clears all counters.
+void pmonSubsysEnable(bool enable);
+
+// Fill nsecs[PMON_SUBSYS_COUNT] with time charged to each subsystem so far
+void pmonSubsysGetTotals(uint64_t *nsecs);
+
+// Short name of subsystem, i.e. "cpu", "gpu"
+const char *pmonSubsysName(int subsys);
+
+/*
+ * Event counters
+ *
+ * Counts of infrequent events that explain stutters the frame times alone
+ *  don't, like dynarec code cache evictions. Always on, as counting is a
+ *  single increment. Totals are since pmonReset(), per-interval counts are
+ *  printed with detailed stats.
+ */
+enum {
+	PMON_CTR_REC_EVICT = 0,   // Dynarec code cache segments evicted
+	PMON_CTR_REC_FLUSH,       // Dynarec full code cache flushes
+	PMON_CTR_REC_SUPERBLOCK,  // Dynarec blocks recompiled with hot paths stitched in
+	PMON_CTR_COUNT
+};
+
+extern uint64_t pmon_counters[PMON_CTR_COUNT];
+
+static inline void pmonCount(int ctr)
+{
+	pmon_counters[ctr]++;
+}
+
+// Short name of counter, i.e. "rec_evict"
+const char *pmonCounterName(int ctr);
+
 #endif //PERFMON_H
@@ -51,6 +51,9 @@ void pl_clear_screen()
 {
 	u16 *dst = SCREEN;
 	memset((void*)dst, 0, SCREEN_WIDTH*SCREEN_HEIGHT*2);
+#ifdef USE_GPULIB
+	vout_force_full_update();
+#endif
 }
 
 void pl_clear_borders()
@@ -115,6 +118,14 @@ void pl_frame_limit(void)
 		pl_frameskip_prepare();
 	}
 
+	// Headless runs go as fast as possible, and results must not depend on
+	//  how fast the host is: never advise frameskip
+	if (Config.Headless) {
+		pl_data.fskip_advice = false;
+		pl_data.dynarec_compiled = false;
+		return;
+	}
+
 	// tv_expect uses usec*1024 units instead of usecs for better accuracy
 	pl_data.tv_expect.tv_usec += pl_data.frame_interval1024;
 	if (pl_data.tv_expect.tv_usec >= (1000000 << 10)) {
@@ -176,6 +187,7 @@ void pl_reset(void)
 	pl_data.dynarec_active_vsyncs = 0;
 	pl_frameskip_prepare();
 	sprintf(pl_data.stats_msg, "000x000x00 CPU=000%% FPS=000/00");
+	pl_data.subsys_msg[0][0] = pl_data.subsys_msg[1][0] = '\0';
 	pmonReset(); // Reset performance monitor (FPS,CPU usage,etc)
 }
 
@@ -205,4 +217,16 @@ static void pl_stats_update(void)
 			(unsigned int)(pl_data.fps_cur + 0.5f),
 			pl_data.sinfo.pal ? 50 : 60,
 			player_controller[0].pad_mode?"A":"D");
+
+	if (Config.PerfmonDetailedStats) {
+		// Two lines of four subsystems each, i.e. "cpu  8.1 gte  1.2 ..."
+		float ms[PMON_SUBSYS_COUNT];
+		pmonGetSubsysStats(ms);
+		for (int line = 0; line < 2; line++) {
+			char *p = pl_data.subsys_msg[line];
+			p[0] = '\0';
+			for (int i = line * 4; i < (line + 1) * 4 && i < PMON_SUBSYS_COUNT; i++)
+				p += sprintf(p, "%s%s %4.1f", i % 4 ? " " : "", pmonSubsysName(i), ms[i]);
+		}
+	}
 }
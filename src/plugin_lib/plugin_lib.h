@@ -47,6 +47,7 @@ struct pl_data_t {
 
 	GPUScreenInfo_t sinfo, sinfo_last;
 	char stats_msg[80]; // Short msg showing screen res, FPS, CPU usage, etc
+	char subsys_msg[2][48]; // Per-subsystem ms/frame (detailed stats only)
 };
 
 extern struct pl_data_t pl_data;
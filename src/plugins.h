@@ -102,6 +102,7 @@ long CDR_close(void);
 long CDR_getTN(unsigned char *);
 long CDR_getTD(unsigned char , unsigned char *);
 long CDR_readTrack(unsigned char *);
+void CDR_prefetch(unsigned char *);
 extern unsigned char *(*CDR_getBuffer)(void);
 long CDR_play(unsigned char *);
 long CDR_stop(void);
@@ -13,6 +13,7 @@
 #include "cdrom.h"
 #include "cdriso.h"
 #include "cheat.h"
+#include "mdec.h"
 
 #include <SDL.h>
 
@@ -193,7 +194,11 @@ static const char *wildcards[] = {
 	//"z", "bz", "znx",
 
 	"bin", "img", "mdf", "iso", "cue",
-	"pbp", "cbn", NULL
+	"pbp", "cbn",
+#ifdef HAVE_CHD
+	"chd",
+#endif
+	NULL
 };
 
 static s32 check_ext(const char *name)
@@ -1012,13 +1017,18 @@ static int gui_swap_cd(void)
 	return 1;
 }
 
-#ifdef PSXREC
 static int emu_alter(u32 keys)
 {
+#ifdef PSXREC
+	const u8 first = CPU_DYNAREC;
+#else
+	const u8 first = CPU_INTERPRETER;
+#endif
+
 	if (keys & KEY_RIGHT) {
-		if (Config.Cpu == 1) Config.Cpu = 0;
+		if (Config.Cpu > first) Config.Cpu--;
 	} else if (keys & KEY_LEFT) {
-		if (Config.Cpu == 0) Config.Cpu = 1;
+		if (Config.Cpu < CPU_INTERPRETER_THREADED) Config.Cpu++;
 	}
 
 	return 0;
@@ -1026,9 +1036,15 @@ static int emu_alter(u32 keys)
 
 static const char *emu_show()
 {
-	return Config.Cpu ? _("int") : _("rec");
+	switch (Config.Cpu) {
+	case CPU_INTERPRETER:          return _("int");
+	case CPU_INTERPRETER_THREADED: return _("int-thr");
+	default:                       return _("rec");
+	}
 }
 
+#ifdef PSXREC
+
 extern u32 cycle_multiplier; // in mips/recompiler.cpp
 
 static int cycle_alter(u32 keys)
@@ -1209,6 +1225,31 @@ static const char *VSyncWA_show()
 	return onoff_str(!!Config.VSyncWA);
 }
 
+static int mdecthread_alter(u32 keys)
+{
+	if (keys & KEY_RIGHT) {
+		if (mdecThreads < MDEC_MAX_THREADS) mdecThreads++;
+	} else if (keys & KEY_LEFT) {
+		if (mdecThreads > 0) mdecThreads--;
+	}
+
+	return 0;
+}
+
+static const char *mdecthread_show()
+{
+	static char buf[16] = "\0";
+	if (mdecThreads == 0)
+		return _("off");
+	sprintf(buf, "%d", mdecThreads);
+	return buf;
+}
+
+static void mdecthread_hint()
+{
+	port_printf(4 * 8, 70, _("Decode movies on threads"));
+}
+
 static int McdSlot1_alter(u32 keys)
 {
 	int slot = Config.McdSlot1;
@@ -1268,6 +1309,7 @@ static int settings_defaults()
 	Config.AnalogMode = 2;
 	Config.RCntFix = 0;
 	Config.VSyncWA = 0;
+	mdecThreads = 0;
 #ifdef PSXREC
 	Config.Cpu = 0;
 #else
@@ -1355,7 +1397,7 @@ static int videoscaling_alter(u32 keys)
 {
 	int vs = Config.VideoScaling;
 	if (keys & KEY_RIGHT) {
-		if (vs < 1) vs++;
+		if (vs < 2) vs++;
 	} else if (keys & KEY_LEFT) {
 		if (vs > 0) vs--;
 	}
@@ -1364,10 +1406,10 @@ static int videoscaling_alter(u32 keys)
 }
 
 static const char *videoscaling_show() {
-	const char* str[] = {_("hardware"), _("nearest")};
+	const char* str[] = {_("hardware"), _("nearest"), _("smooth")};
 	int vs = Config.VideoScaling;
 	if (vs < 0) vs = 0;
-	else if (vs > 1) vs = 1;
+	else if (vs > 2) vs = 2;
 	return (char*)str[vs];
 }
 
@@ -1379,6 +1421,9 @@ static void videoscaling_hint() {
 	case 1:
 		port_printf(7 * 8, 70, _("Nearest filter"));
 		break;
+	case 2:
+		port_printf(7 * 8, 70, _("Averaging filter"));
+		break;
 	}
 }
 #endif //USE_GPULIB
@@ -1700,6 +1745,31 @@ static const char *volume_show()
 	sprintf(buf, "%d", val);
 	return buf;
 }
+
+static int sputhread_alter(u32 keys)
+{
+	if (keys & KEY_RIGHT) {
+		if (spu_config.iUseThread < SPU_MAX_THREADS) spu_config.iUseThread++;
+	} else if (keys & KEY_LEFT) {
+		if (spu_config.iUseThread > 0) spu_config.iUseThread--;
+	}
+
+	return 0;
+}
+
+static const char *sputhread_show()
+{
+	static char buf[16] = "\0";
+	if (spu_config.iUseThread == 0)
+		return _("off");
+	sprintf(buf, "%d", spu_config.iUseThread);
+	return buf;
+}
+
+static void sputhread_hint()
+{
+	port_printf(4 * 8, 70, _("Mix audio channels on threads"));
+}
 #endif //SPU_PCSXREARMED
 
 static int spu_settings_defaults()
@@ -1715,6 +1785,7 @@ static int spu_settings_defaults()
 	spu_config.iUseInterpolation = 0;
 	spu_config.iUseReverb = 0;
 	spu_config.iVolume = 1024;
+	spu_config.iUseThread = 0;
 #endif
 	return 0;
 }
@@ -1740,8 +1811,8 @@ static int gui_LoadIso()
 static int gui_Settings()
 {
 	MENUITEM gui_SettingsItems[] = {
-#ifdef PSXREC
 		{(char *)_("Emulation core"), NULL, &emu_alter, &emu_show, NULL},
+#ifdef PSXREC
 		{(char *)_("Cycle multiplier"), NULL, &cycle_alter, &cycle_show, NULL},
 #endif
 		{(char *)_("HLE emulated BIOS"), NULL, &bios_alter, &bios_show, NULL},
@@ -1751,6 +1822,7 @@ static int gui_Settings()
 		{(char *)_("Analog Mode"), NULL, &Analog_Mode_alter, &Analog_Mode_show, &Analog_Mode_hint},
 		{(char *)_("RCntFix"), NULL, &RCntFix_alter, &RCntFix_show, &RCntFix_hint},
 		{(char *)_("VSyncWA"), NULL, &VSyncWA_alter, &VSyncWA_show, &VSyncWA_hint},
+		{(char *)_("MDEC threads"), NULL, &mdecthread_alter, &mdecthread_show, &mdecthread_hint},
 		{(char *)_("Memory card Slot1"), NULL, &McdSlot1_alter, &McdSlot1_show, NULL},
 		{(char *)_("Memory card Slot2"), NULL, &McdSlot2_alter, &McdSlot2_show, NULL},
 		{(char *)_("Restore defaults"), &settings_defaults, NULL, NULL, NULL},
@@ -1811,6 +1883,7 @@ static int gui_SPUSettings()
 		{(char *)_("Interpolation"), NULL, &interpolation_alter, &interpolation_show, NULL},
 		{(char *)_("Reverb"), NULL, &reverb_alter, &reverb_show, NULL},
 		{(char *)_("Master volume"), NULL, &volume_alter, &volume_show, NULL},
+		{(char *)_("SPU threads"), NULL, &sputhread_alter, &sputhread_show, &sputhread_hint},
 #endif
 		{(char *)_("Restore defaults"), &spu_settings_defaults, NULL, NULL, NULL},
 		{0}
@@ -2,6 +2,9 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
 
 #include "port.h"
 #include "r3000a.h"
@@ -9,6 +12,8 @@
 #include "plugin_lib.h"
 #include "perfmon.h"
 #include "cheat.h"
+#include "cdriso.h"
+#include "mdec.h"
 #include <SDL.h>
 
 /* PATH_MAX inclusion */
@@ -111,8 +116,9 @@ static void pcsx4all_exit(void)
 	// unload cheats
 	cheat_unload();
 
-	// Store config to file
-	config_save();
+	// Store config to file (headless runs don't touch the user's config)
+	if (!Config.Headless)
+		config_save();
 
 	if (ttf_font) delete ttf_font;
 #ifdef GCW_ZERO
@@ -324,6 +330,14 @@ void config_load()
 			if (value < FORCED_XA_UPDATES_MIN || value > FORCED_XA_UPDATES_MAX)
 				value = FORCED_XA_UPDATES_DEFAULT;
 			Config.ForcedXAUpdates = value;
+		} else if (!strcmp(line, "CdCacheSectors")) {
+			sscanf(arg, "%d", &value);
+			cdrIsoCacheSectors = value;
+		} else if (!strcmp(line, "MdecThreads")) {
+			sscanf(arg, "%d", &value);
+			if (value > MDEC_MAX_THREADS) value = MDEC_MAX_THREADS;
+			if (value < 0) value = 0;
+			mdecThreads = value;
 		} else if (!strcmp(line, "ShowFps")) {
 			sscanf(arg, "%d", &value);
 			Config.ShowFps = value;
@@ -351,6 +365,11 @@ void config_load()
 			if (value > 1024) value = 1024;
 			if (value < 0) value = 0;
 			spu_config.iVolume = value;
+		} else if (!strcmp(line, "SpuUseThread")) {
+			sscanf(arg, "%d", &value);
+			if (value > SPU_MAX_THREADS) value = SPU_MAX_THREADS;
+			if (value < 0) value = 0;
+			spu_config.iUseThread = value;
 		}
 #endif
 		else if (!strcmp(line, "LastDir")) {
@@ -478,10 +497,14 @@ void config_save()
 		   Config.SpuUpdateFreq, Config.ForcedXAUpdates, Config.ShowFps,
 		   Config.FrameLimit, Config.FrameSkip, Config.VideoScaling);
 
+	fprintf(f, "CdCacheSectors %u\n", cdrIsoCacheSectors);
+	fprintf(f, "MdecThreads %d\n", mdecThreads);
+
 #ifdef SPU_PCSXREARMED
 	fprintf(f, "SpuUseInterpolation %d\n", spu_config.iUseInterpolation);
 	fprintf(f, "SpuUseReverb %d\n", spu_config.iUseReverb);
 	fprintf(f, "SpuVolume %d\n", spu_config.iVolume);
+	fprintf(f, "SpuUseThread %d\n", spu_config.iUseThread);
 #endif
 
 #ifdef PSXREC
@@ -653,11 +676,254 @@ void joy_init()
 	Set_Controller_Mode();
 }
 
+/*
+ * Headless benchmark mode
+ *
+ * Runs a fixed number of emulated frames without video/audio output or
+ *  frame limiting, optionally feeding pad input from a script, then writes a
+ *  report of wall time, emulated FPS and per-subsystem time and exits.
+ *
+ * Pad script format, one event per line, '#' starts a comment:
+ *   <frame> <button>[+<button>...]   Hold these buttons from <frame> on
+ *   <frame> none                     Release all buttons from <frame> on
+ * Button names: up down left right cross circle square triangle
+ *               l1 r1 l2 r2 l3 r3 start select
+ *
+ * With -statecheck <n>, every n frames the state is saved to memory, loaded
+ *  back and saved again, and the two saves must match byte for byte. The
+ *  report counts checks and mismatches, and the exit status is 1 if there
+ *  were any.
+ */
+struct bench_pad_event {
+	unsigned frame;
+	unsigned short pad;
+};
+
+static struct {
+	unsigned frames;        // Frame budget, 0: run until killed
+	unsigned frame_ctr;     // Frames emulated so far
+	char pad_file[MAXPATHLEN];
+	char report_file[MAXPATHLEN];
+	struct bench_pad_event *pad_events;
+	int pad_event_cnt, pad_event_idx;
+	uint64_t ts_start;
+	uint64_t subsys_nsecs_start[PMON_SUBSYS_COUNT];
+	uint64_t counters_start[PMON_CTR_COUNT];
+	unsigned statecheck;    // Savestate round-trip interval, 0: off
+	unsigned statecheck_cnt, statecheck_fail;
+	u8 *state_buf[2];
+	u32 state_size;
+} bench;
+
+static const char *bench_button_names[DKEY_TOTAL] = {
+	"select", "l3", "r3", "start", "up", "right", "down", "left",
+	"l2", "r2", "l1", "r1", "triangle", "circle", "cross", "square"
+};
+
+// Returns 0: success, -1: failure
+static int bench_pad_load(const char *filename)
+{
+	FILE *f = fopen(filename, "r");
+	if (!f) {
+		printf("ERROR: can't open pad script: %s\n", filename);
+		return -1;
+	}
+
+	char line[256];
+	int line_num = 0;
+	unsigned last_frame = 0;
+	while (fgets(line, sizeof(line), f)) {
+		line_num++;
+		char *p = strchr(line, '#');
+		if (p) *p = '\0';
+
+		char *tok = strtok(line, " \t\r\n");
+		if (!tok)
+			continue;
+
+		unsigned frame = strtoul(tok, &p, 10);
+		char *buttons = strtok(NULL, " \t\r\n");
+		if (*p != '\0' || !buttons || frame < last_frame) {
+			printf("ERROR: pad script %s line %d: expected "
+			       "'<frame> <buttons>' in ascending frame order\n",
+			       filename, line_num);
+			fclose(f);
+			return -1;
+		}
+		last_frame = frame;
+
+		unsigned short pad = 0xffff;
+		if (strcmp(buttons, "none") != 0) {
+			for (tok = strtok(buttons, "+"); tok; tok = strtok(NULL, "+")) {
+				int k;
+				for (k = 0; k < DKEY_TOTAL; k++) {
+					if (strcasecmp(tok, bench_button_names[k]) == 0)
+						break;
+				}
+				if (k == DKEY_TOTAL) {
+					printf("ERROR: pad script %s line %d: unknown button '%s'\n",
+					       filename, line_num, tok);
+					fclose(f);
+					return -1;
+				}
+				pad &= ~(1 << k);
+			}
+		}
+
+		bench.pad_events = (struct bench_pad_event *)realloc(bench.pad_events,
+				(bench.pad_event_cnt + 1) * sizeof(struct bench_pad_event));
+		bench.pad_events[bench.pad_event_cnt].frame = frame;
+		bench.pad_events[bench.pad_event_cnt].pad = pad;
+		bench.pad_event_cnt++;
+	}
+
+	fclose(f);
+	return 0;
+}
+
+static void bench_start(void)
+{
+	bench.frame_ctr = 0;
+	bench.pad_event_idx = 0;
+	if (bench.statecheck) {
+		bench.state_size = SaveStateMemSize();
+		bench.state_buf[0] = (u8 *)malloc(bench.state_size);
+		bench.state_buf[1] = (u8 *)malloc(bench.state_size);
+		if (!bench.state_buf[0] || !bench.state_buf[1]) {
+			printf("ERROR: can't allocate savestate buffers, no -statecheck\n");
+			bench.statecheck = 0;
+		}
+	}
+	pmonSubsysGetTotals(bench.subsys_nsecs_start);  // pmonReset() enabled it
+	memcpy(bench.counters_start, pmon_counters, sizeof(bench.counters_start));
+	bench.ts_start = pmonTimestamp();
+}
+
+static void bench_report(void)
+{
+	uint64_t nsecs[PMON_SUBSYS_COUNT];
+	pmonSubsysGetTotals(nsecs);
+	double wall_secs = (double)(pmonTimestamp() - bench.ts_start) / 1e9;
+
+	FILE *f = stdout;
+	if (bench.report_file[0] != '\0') {
+		f = fopen(bench.report_file, "w");
+		if (!f) {
+			printf("ERROR: can't open report file %s, using stdout\n",
+			       bench.report_file);
+			f = stdout;
+		}
+	}
+
+	fprintf(f, "{\n");
+	fprintf(f, "  \"frames\": %u,\n", bench.frame_ctr);
+	fprintf(f, "  \"wall_secs\": %.3f,\n", wall_secs);
+	fprintf(f, "  \"fps\": %.2f,\n",
+	        wall_secs > 0 ? (double)bench.frame_ctr / wall_secs : 0.0);
+	fprintf(f, "  \"cpu_core\": \"%s\",\n",
+	        Config.Cpu == CPU_INTERPRETER_THREADED ? "threaded_interpreter" :
+	        Config.Cpu ? "interpreter" : "recompiler");
+#if defined(GPU_UNAI)
+	fprintf(f, "  \"gpu\": \"gpu_unai\",\n");
+#elif defined(GPU_DFXVIDEO)
+	fprintf(f, "  \"gpu\": \"gpu_dfxvideo\",\n");
+#elif defined(GPU_DRHELL)
+	fprintf(f, "  \"gpu\": \"gpu_drhell\",\n");
+#else
+	fprintf(f, "  \"gpu\": \"gpu_null\",\n");
+#endif
+#ifndef _WIN32
+	struct rusage ru;
+	if (getrusage(RUSAGE_SELF, &ru) == 0) {
+		fprintf(f, "  \"user_secs\": %.3f,\n",
+		        ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6);
+		fprintf(f, "  \"sys_secs\": %.3f,\n",
+		        ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6);
+	}
+#endif
+	fprintf(f, "  \"subsys_secs\": {");
+	for (int i = 0; i < PMON_SUBSYS_COUNT; i++) {
+		fprintf(f, "%s\n    \"%s\": %.3f", i ? "," : "",
+		        pmonSubsysName(i),
+		        (double)(nsecs[i] - bench.subsys_nsecs_start[i]) / 1e9);
+	}
+	fprintf(f, "\n  },\n");
+	fprintf(f, "  \"counters\": {");
+	for (int i = 0; i < PMON_CTR_COUNT; i++) {
+		fprintf(f, "%s\n    \"%s\": %llu", i ? "," : "",
+		        pmonCounterName(i),
+		        (unsigned long long)(pmon_counters[i] - bench.counters_start[i]));
+	}
+	fprintf(f, "\n  }");
+	if (bench.statecheck) {
+		fprintf(f, ",\n  \"statecheck\": { \"checks\": %u, \"mismatches\": %u }",
+		        bench.statecheck_cnt, bench.statecheck_fail);
+	}
+	fprintf(f, "\n}\n");
+
+	if (f != stdout)
+		fclose(f);
+	else
+		fflush(f);
+}
+
+// Save, load and save again, and compare the two saves
+static void bench_statecheck(void)
+{
+	u8 *a = bench.state_buf[0], *b = bench.state_buf[1];
+	int len_a, len_b;
+
+	bench.statecheck_cnt++;
+	len_a = SaveStateMem(a, bench.state_size);
+	if (len_a < 0 || LoadStateMem(a, len_a) < 0) {
+		printf("statecheck: frame %u: save/load failed\n", bench.frame_ctr);
+		bench.statecheck_fail++;
+		return;
+	}
+	len_b = SaveStateMem(b, bench.state_size);
+	if (len_b != len_a || memcmp(a, b, len_a) != 0) {
+		int i = 0;
+		if (len_b == len_a)
+			while (a[i] == b[i]) i++;
+		printf("statecheck: frame %u: saves differ (%d/%d bytes, first at %d)\n",
+		       bench.frame_ctr, len_a, len_b, i);
+		bench.statecheck_fail++;
+	}
+}
+
+// Called by EmuUpdate() once per emulated frame when running headless
+void bench_update(void)
+{
+	bench.frame_ctr++;
+	if (bench.statecheck && bench.frame_ctr % bench.statecheck == 0)
+		bench_statecheck();
+	if (bench.frames && bench.frame_ctr >= bench.frames) {
+		bench_report();
+		exit(bench.statecheck_fail ? 1 : 0);
+	}
+}
+
+static void bench_pad_update(void)
+{
+	while (bench.pad_event_idx < bench.pad_event_cnt &&
+	       bench.pad_events[bench.pad_event_idx].frame <= bench.frame_ctr)
+	{
+		pad1 = bench.pad_events[bench.pad_event_idx].pad;
+		bench.pad_event_idx++;
+	}
+}
+
 void pad_update(void)
 {
 	//int axisval, a, k = 0;
 	int  k = 0;
 	SDL_Event event;
+
+	if (Config.Headless) {
+		bench_pad_update();
+		return;
+	}
+
 	Uint8 *keys = SDL_GetKeyState(NULL);
 
 	while (SDL_PollEvent(&event))
@@ -781,6 +1047,10 @@ void video_flip(void)
 {
 	if (emu_running && Config.ShowFps) {
 		port_printf_pixel(5, 5, pl_data.stats_msg);
+		if (Config.PerfmonDetailedStats) {
+			port_printf_pixel(5, 15, pl_data.subsys_msg[0]);
+			port_printf_pixel(5, 25, pl_data.subsys_msg[1]);
+		}
 	}
 
 	if (SDL_MUSTLOCK(screen))
@@ -1012,9 +1282,9 @@ int main (int argc, char **argv)
 	Config.Cdda=0; /* 0=Enable Cd audio, 1=Disable Cd audio */
 	Config.HLE=0; /* 0=BIOS, 1=HLE */
 #if defined (PSXREC)
-	Config.Cpu=0; /* 0=recompiler, 1=interpreter */
+	Config.Cpu=0; /* 0=recompiler, 1=interpreter, 2=threaded interpreter */
 #else
-	Config.Cpu=1; /* 0=recompiler, 1=interpreter */
+	Config.Cpu=1; /* 0=recompiler, 1=interpreter, 2=threaded interpreter */
 #endif
 	Config.SlowBoot=0; /* 0=skip bios logo sequence on boot  1=show sequence (does not apply to HLE) */
 	Config.RCntFix=0; /* 1=Parasite Eve 2, Vandal Hearts 1/2 Fix */
@@ -1178,6 +1448,10 @@ int main (int argc, char **argv)
 		if (strcmp(argv[i],"-interpreter") == 0)
 			Config.Cpu = 1;
 
+		// Interpreter running from pre-decoded instruction cache
+		if (strcmp(argv[i],"-threaded_interpreter") == 0)
+			Config.Cpu = 2;
+
 		// Show BIOS logo sequence at BIOS startup (doesn't apply to HLE)
 		if (strcmp(argv[i],"-slowboot") == 0)
 			Config.SlowBoot = 1;
@@ -1259,6 +1533,91 @@ int main (int argc, char **argv)
 			Config.PerfmonDetailedStats = true;
 		}
 
+		// Headless benchmark mode, see bench_update()
+		if (strcmp(argv[i],"-headless") == 0) {
+			Config.Headless = true;
+		}
+
+#ifdef USE_GPULIB
+		// Draw on a separate thread, see gpu/gpulib/gpu_thread.cpp
+		if (strcmp(argv[i],"-gputhread") == 0) {
+			gpulib_config.render_thread = true;
+		}
+#endif
+
+		// Decode MDEC macroblocks on worker threads, see mdec.cpp
+		if (strcmp(argv[i],"-mdecthreads") == 0) {
+			if (++i >= argc) {
+				printf("ERROR: missing value for -mdecthreads\n");
+				param_parse_error = true;
+				break;
+			}
+
+			int val = atoi(argv[i]);
+			if (val < 0 || val > MDEC_MAX_THREADS) {
+				printf("ERROR: -mdecthreads value must be between 0..%d\n", MDEC_MAX_THREADS);
+				param_parse_error = true;
+				break;
+			}
+			mdecThreads = val;
+		}
+
+		// Number of frames to emulate when headless
+		if (strcmp(argv[i],"-frames") == 0) {
+			if (++i >= argc) {
+				printf("ERROR: missing value for -frames\n");
+				param_parse_error = true;
+				break;
+			}
+
+			int val = atoi(argv[i]);
+			if (val <= 0) {
+				printf("ERROR: -frames value must be greater than 0\n");
+				param_parse_error = true;
+				break;
+			}
+			bench.frames = val;
+		}
+
+		// Pad input script to play back when headless
+		if (strcmp(argv[i],"-padscript") == 0) {
+			if (++i < argc) {
+				snprintf(bench.pad_file, MAXPATHLEN, "%s", argv[i]);
+			} else {
+				printf("ERROR: missing value for -padscript\n");
+				param_parse_error = true;
+				break;
+			}
+		}
+
+		// Check savestate round trips every <n> frames when headless
+		if (strcmp(argv[i],"-statecheck") == 0) {
+			if (++i >= argc) {
+				printf("ERROR: missing value for -statecheck\n");
+				param_parse_error = true;
+				break;
+			}
+
+			int val = atoi(argv[i]);
+			if (val <= 0) {
+				printf("ERROR: -statecheck value must be greater than 0\n");
+				param_parse_error = true;
+				break;
+			}
+			bench.statecheck = val;
+		}
+
+		// Write headless benchmark report to file instead of stdout
+		if (strcmp(argv[i],"-report") == 0) {
+			if (++i < argc) {
+				snprintf(bench.report_file, MAXPATHLEN, "%s", argv[i]);
+			} else {
+				printf("ERROR: missing value for -report\n");
+				param_parse_error = true;
+				break;
+			}
+		}
+
 		// GPU
 		// show FPS
 		if (strcmp(argv[i],"-showfps") == 0) {
@@ -1443,6 +1802,25 @@ int main (int argc, char **argv)
 	update_memcards(0);
 	strcpy(BiosFile, Config.Bios);
 
+	if (Config.Headless) {
+		// Nothing is presented, and emulation must not depend on host speed
+		Config.FrameLimit = 0;
+		Config.FrameSkip = FRAMESKIP_OFF;
+		Config.ShowFps = 0;
+#ifdef SPU_PCSXREARMED
+		spu_config.iDisabled = 1;    // SPU still runs, output goes to nullsnd
+#endif
+		SDL_putenv((char *)"SDL_VIDEODRIVER=dummy");
+
+		if (bench.pad_file[0] != '\0' && bench_pad_load(bench.pad_file) < 0)
+			param_parse_error = true;
+
+		if (cdrfilename[0] == '\0' && filename[0] == '\0') {
+			printf("ERROR: -headless needs -iso or -file\n");
+			param_parse_error = true;
+		}
+	}
+
 	if (param_parse_error) {
 		printf("Failed to parse command-line parameters, exiting.\n");
 		exit(1);
@@ -1457,7 +1835,7 @@ int main (int argc, char **argv)
 
 	SDL_WM_SetCaption("pcsx4all - SDL Version", "pcsx4all");
 
-	if (Config.VideoScaling == 1) {
+	if (Config.VideoScaling != 0) {
 #ifdef SDL_TRIPLEBUF
 	int flags = SDL_TRIPLEBUF;
 #else
@@ -1508,7 +1886,7 @@ int main (int argc, char **argv)
 
 	font_init();
 
-	if (argc < 2 || cdrfilename[0] == '\0') {
+	if (!Config.Headless && (argc < 2 || cdrfilename[0] == '\0')) {
 		// Enter frontend main-menu:
 		emu_running = false;
 		if (!SelectGame()) {
@@ -1574,6 +1952,8 @@ int main (int argc, char **argv)
 	}
 
 	if ((cdrfilename[0] != '\0') || (filename[0] != '\0') || (Config.HLE == 0)) {
+		if (Config.Headless)
+			bench_start();
 		psxCpu->Execute();
 	}
 
@@ -41,6 +41,7 @@ unsigned get_ticks(void);
 void wait_ticks(unsigned s);
 void pad_update(void);
 unsigned short pad_read(int num);
+void bench_update(void);
 
 void video_flip(void);
 #ifdef GPU_DFXVIDEO
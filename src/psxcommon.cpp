@@ -25,6 +25,10 @@ void EmuUpdate()
 {
 	pl_frame_limit();
 
+	// Ends headless benchmark runs once their frame budget is used up
+	if (Config.Headless)
+		bench_update();
+
 	// Update controls
 	// NOTE: This is point of control transfer to frontend menu..
 	//  Only allow re-entry to frontend when PS1 cache status is normal.
@@ -136,7 +136,7 @@ typedef struct {
 	u8 AnalogMode;   /* 0-Digital 1-DualAnalog 2-DualShock */
 	boolean RCntFix; /* 1=Parasite Eve 2, Vandal Hearts 1/2 Fix */
 	boolean VSyncWA; /* 1=InuYasha Sengoku Battle Fix */
-	u8 Cpu; /* 0=recompiler, 1=interpreter */
+	u8 Cpu; /* 0=recompiler, 1=interpreter, 2=threaded interpreter */
 	u8 PsxType; /* 0=ntsc, 1=pal */
     u8 McdSlot1; /* mcd slot 1, mcd%03u.mcr */
     u8 McdSlot2; /* mcd slot 2, mcd%03u.mcr */
@@ -161,12 +161,16 @@ typedef struct {
 	boolean FrameLimit;  // Limit to NTSC/PAL framerate
 
 	s8      FrameSkip;	// -1: AUTO  0: OFF  1-3: FIXED
-	s8      VideoScaling; // 0: Hardware  1: Software Nearest
+	s8      VideoScaling; // 0: Hardware  1: Software Nearest  2: Software Smooth
 
 	// Options for performance monitor
 	boolean PerfmonConsoleOutput;
 	boolean PerfmonDetailedStats;
 
+	// Headless benchmark run: no video/audio output, no frame limit, and
+	//  host timing is not allowed to influence emulation (frameskip etc)
+	boolean Headless;
+
 } PcsxConfig;
 
 extern PcsxConfig Config;
@@ -194,7 +198,8 @@ extern "C" {
 enum FreezeMode {
 	FREEZE_LOAD = 0,
 	FREEZE_SAVE = 1,
-	FREEZE_INFO = 2    // Query plugin for amount of ram to allocate for freeze
+	FREEZE_INFO = 2    // Query plugin for amount of ram to allocate for freeze,
+	                   //  or with freeze_rw(), only count bytes
 };
 int freeze_rw(void *file, enum FreezeMode mode, void *buf, unsigned len);
 #ifdef _cplusplus
@@ -213,7 +218,8 @@ enum {
 
 enum {
 	CPU_DYNAREC = 0,
-	CPU_INTERPRETER
+	CPU_INTERPRETER,
+	CPU_INTERPRETER_THREADED
 }; // CPU Types
 
 void EmuUpdate();
@@ -41,6 +41,7 @@
 #include "psxevents.h"
 #include "gpu.h"
 #include "cheat.h"
+#include "perfmon.h"
 
 /******************************************************************************/
 
@@ -367,13 +368,18 @@ void psxRcntUpdate()
                 return;
             }
 
+            int pmon_prev = pmonSubsysEnter(PMON_GPU);
             GPU_updateLace();
+            pmonSubsysLeave(pmon_prev);
 
             //senquack - PCSX Rearmed updates its SPU plugin once per emulated
             // frame. However, we target slower platforms and update SPU plugin
             // at flexible interval (scheduled event) to avoid audio dropouts.
-            if (Config.SpuUpdateFreq == SPU_UPDATE_FREQ_1)
+            if (Config.SpuUpdateFreq == SPU_UPDATE_FREQ_1) {
+                pmon_prev = pmonSubsysEnter(PMON_SPU);
                 SPU_async(cycle, 1);
+                pmonSubsysLeave(pmon_prev);
+            }
 
 			cheat_apply();
         }
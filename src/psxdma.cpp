@@ -24,6 +24,7 @@
 
 #include "psxdma.h"
 #include "gpu.h"
+#include "perfmon.h"
 
 // Dma0/1 in Mdec.c
 // Dma3   in CdRom.c
@@ -41,6 +42,7 @@ void spuInterrupt() {
 void psxDma4(u32 madr, u32 bcr, u32 chcr) { // SPU
 	u16 *ptr;
 	u32 words;
+	PMON_SCOPE(PMON_SPU);
 
 	switch (chcr) {
 		case 0x01000201: //cpu to spu transfer
@@ -77,9 +79,7 @@ void psxDma4(u32 madr, u32 bcr, u32 chcr) { // SPU
 
 			SPU_readDMAMem(ptr, words * 2, psxRegs.cycle);
 
-#ifdef PSXREC
 			psxCpu->Clear(madr, words);
-#endif
 
 			HW_DMA4_MADR = SWAPu32(madr + words * 4);
 			SPUDMA_INT(words / 2);
@@ -141,6 +141,7 @@ void psxDma2(u32 madr, u32 bcr, u32 chcr) { // GPU
 	u32 *ptr;
 	u32 words;
 	u32 size;
+	PMON_SCOPE(PMON_GPU);
 
 	switch(chcr) {
 		case 0x01000200: // vram2mem
@@ -157,9 +158,7 @@ void psxDma2(u32 madr, u32 bcr, u32 chcr) { // GPU
 			// BA blocks * BS words (word = 32-bits)
 			words = (bcr >> 16) * (bcr & 0xffff);
 			GPU_readDataMem(ptr, words);
-			#ifdef PSXREC
 			psxCpu->Clear(madr, words);
-			#endif
 
 			HW_DMA2_MADR = SWAPu32(madr + words * 4);
 
@@ -20,10 +20,17 @@
  *
  * Added July 2016 by senquack (Daniel Silsby)
  *
- * Queue is an array sorted by event imminency. It can have spare capacity
- * both at the front and at the back. If an event is removed from the front
- * of the queue and a new event enqueued that ends up back at front of queue,
- * the operation is O(1).
+ * Queue is a binary min-heap of event numbers ordered by event imminency,
+ * with each queued event's heap position tracked so it can be rescheduled or
+ * removed in place. Adding, rescheduling and removing are O(log n), finding
+ * the most imminent event is O(1): it is always at heap[0].
+ * NOTE: With the few event types there are, this is no faster than the
+ *       sorted array was (see bench/evqueue_bench.cpp), it only keeps the
+ *       cost from growing linearly as event types are added.
+ *
+ * Events with equal imminency are dispatched in the order they were
+ * scheduled, same as with the sorted array the heap replaced. Each
+ * scheduling is stamped with a sequence number used as tie-breaker.
  *
  * We also handle a small bit of SPU update logic here
  *
@@ -32,6 +39,7 @@
 #include "psxevents.h"
 #include "r3000a.h"
 #include "plugin_lib.h"
+#include "perfmon.h"
 
 // To get event-handler functions:
 #include "cdrom.h"
@@ -64,10 +72,12 @@ static const int EVQUEUE_CAPACITY = PSXINT_COUNT;
 typedef void (*EventFunc)(void);
 
 static struct {
-	u8 useBeginIdx;             // Idx of first used element of queue[]
-	u8 useEndIdx;               // Idx one past last used element of queue[], or
-	                            //  same val as useBeginIdx when queue is empty.
-	u8 queue[EVQUEUE_CAPACITY];
+	u8 size;                    // Number of events in heap[]
+	u8 heap[EVQUEUE_CAPACITY];  // Binary min-heap, heap[0] is most imminent
+	u8 heapPos[EVQUEUE_CAPACITY]; // Idx in heap[] of each queued event
+	u32 seq[EVQUEUE_CAPACITY];  // Sequence number of each queued event,
+	                            //  breaks ties between equally-imminent events
+	u32 seqCtr;
 	EventFunc funcs[EVQUEUE_CAPACITY];
 	u32 spuUpdateInterval;      // Cycles between SPU plugin updates
 } evqueue;
@@ -82,15 +92,12 @@ static inline void evqueueClear(void);
 static inline size_t evqueueSize(void);
 static inline bool evqueueEmpty(void);
 static inline u8 evqueueFront(void);
-static inline u8* evqueueFrontPtr(void);
-static inline u8* evqueueEndPtr(void);
 static inline void evqueueAdd(u8 ev);
-static inline bool evqueueRemove(u8 ev);
+static inline void evqueueReschedule(u8 ev);
+static inline void evqueueRemove(u8 ev);
 static inline void evqueueRemoveFront(void);
-static inline void evqueueMoveTowardsFront(u8 *start, u8 *end);
-static inline void evqueueMoveTowardsBack(u8 *start, u8 *end);
-static inline void evqueueInsertFront(u8 *pos, u8 ev);
-static inline void evqueueInsertBack(u8 *pos, u8 ev);
+static inline void evqueueSiftUp(u8 pos);
+static inline void evqueueSiftDown(u8 pos);
 #ifdef DEBUG_EVENTS
 static bool evqueueConsistencyCheck(void);
 static void evqueuePrintQueue(void);
@@ -185,8 +192,8 @@ static void psxEvqueueSchedulePersistentEvents(void)
 //  This function fixes up timestamps of all queued events when this occurs.
 static void psxEvqueueAdjustTimestamps(u32 prev_cycle_val)
 {
-	for (u8 *ev = evqueueFrontPtr(); ev != evqueueEndPtr(); ++ev) {
-		psxRegs.intCycle[*ev].sCycle -= prev_cycle_val;
+	for (int i = 0; i < evqueue.size; ++i) {
+		psxRegs.intCycle[evqueue.heap[i]].sCycle -= prev_cycle_val;
 	}
 
 	psxRegs.intCycle[PSXINT_NEXT_EVENT].sCycle -= prev_cycle_val;
@@ -194,14 +201,18 @@ static void psxEvqueueAdjustTimestamps(u32 prev_cycle_val)
 
 void psxEvqueueAdd(psxEventNum ev, u32 cycles_after)
 {
-	// Dequeue event if it already exists, to match original emu behavior
-	if (psxRegs.interrupt & (1 << ev))
-		evqueueRemove(ev);
-
-	psxRegs.interrupt |= (1 << ev);
 	psxRegs.intCycle[ev].sCycle = psxRegs.cycle;
 	psxRegs.intCycle[ev].cycle = cycles_after;
-	evqueueAdd(ev);
+
+	// Reschedule event in place if it already exists. It is ordered after
+	//  any equally-imminent events, to match original emu behavior.
+	if (psxRegs.interrupt & (1 << ev)) {
+		evqueueReschedule(ev);
+	} else {
+		psxRegs.interrupt |= (1 << ev);
+		evqueueAdd(ev);
+	}
+
 	psxRegs.intCycle[PSXINT_NEXT_EVENT] = psxRegs.intCycle[evqueueFront()];
 
 	// io_cycle_counter is used to determine next time to call psxBranchTest()
@@ -245,6 +256,8 @@ void psxEvqueueDispatchAndRemoveFront(psxRegisters *pr)
 	}
 #endif
 
+	PMON_SCOPE(PMON_EVENTS);
+
 	u8 ev = evqueueFront();
 	evqueueRemoveFront();
 	pr->interrupt &= ~(1 << ev);
@@ -294,7 +307,9 @@ void SPU_update(void)
 	// this call to SPU_async(), and new SPUIRQ scheduled if necessary.
 	psxEvqueueRemove(PSXINT_SPUIRQ);
 
+	int pmon_prev = pmonSubsysEnter(PMON_SPU);
 	SPU_async(psxRegs.cycle, 1);
+	pmonSubsysLeave(pmon_prev);
 
 	// If frameskip is advised, update SPU more frequently to avoid dropouts
 	if (Config.SpuUpdateFreq > SPU_UPDATE_FREQ_1) {
@@ -309,10 +324,12 @@ void SPU_update(void)
 // allowing handling as a generic event
 static void SPU_handleIRQ(void)
 {
+	PMON_SCOPE(PMON_SPU);
 	SPU_async(psxRegs.cycle, 0);
 }
 
 // Returns true if event 'lh_ev' is more imminent than 'rh_ev'.
+//  Equally-imminent events are ordered by when they were scheduled.
 static inline bool EventMoreImminent(u8 lh_ev, u8 rh_ev)
 {
 	// Compare the two event timestamps, interpreting the result as a signed
@@ -321,46 +338,75 @@ static inline bool EventMoreImminent(u8 lh_ev, u8 rh_ev)
 	             - psxRegs.cycle;
 	int rh_tmp = psxRegs.intCycle[rh_ev].sCycle + psxRegs.intCycle[rh_ev].cycle
 	             - psxRegs.cycle;
-	return lh_tmp < rh_tmp;
+	if (lh_tmp != rh_tmp)
+		return lh_tmp < rh_tmp;
+	return (int)(evqueue.seq[lh_ev] - evqueue.seq[rh_ev]) < 0;
 }
 
 static inline void evqueueClear(void)
 {
-	evqueue.useEndIdx = evqueue.useBeginIdx = 0;
+	evqueue.size = 0;
 }
 
 static inline size_t evqueueSize(void)
 {
-	return evqueue.useEndIdx - evqueue.useBeginIdx;
+	return evqueue.size;
 }
 
 static inline bool evqueueEmpty(void)
 {
-	return evqueue.useEndIdx == evqueue.useBeginIdx;
+	return evqueue.size == 0;
 }
 
 static inline u8 evqueueFront(void)
 {
-	return evqueue.queue[evqueue.useBeginIdx];
+	return evqueue.heap[0];
 }
 
-// Returns pointer to first element in use
-static inline u8* evqueueFrontPtr(void)
+// Place event 'ev' at heap position 'pos', updating its back-reference
+static inline void evqueueSet(u8 pos, u8 ev)
 {
-	return evqueue.queue + evqueue.useBeginIdx;
+	evqueue.heap[pos] = ev;
+	evqueue.heapPos[ev] = pos;
 }
 
-// Returns pointer to one past the last element in use,
-//  but when empty, points to same element as evqueueFrontPtr()
-static inline u8* evqueueEndPtr(void)
+// Move element at 'pos' towards heap root until its parent is more imminent
+static inline void evqueueSiftUp(u8 pos)
 {
-	return evqueue.queue + evqueue.useEndIdx;
+	u8 ev = evqueue.heap[pos];
+	while (pos > 0) {
+		u8 parent = (pos - 1) / 2;
+		if (!EventMoreImminent(ev, evqueue.heap[parent]))
+			break;
+		evqueueSet(pos, evqueue.heap[parent]);
+		pos = parent;
+	}
+	evqueueSet(pos, ev);
 }
 
-// Insert new element, keeping queue sorted by event imminency.
+// Move element at 'pos' away from heap root until no child is more imminent
+static inline void evqueueSiftDown(u8 pos)
+{
+	u8 ev = evqueue.heap[pos];
+	for (;;) {
+		u8 child = pos * 2 + 1;
+		if (child >= evqueue.size)
+			break;
+		if (child + 1 < evqueue.size &&
+		    EventMoreImminent(evqueue.heap[child+1], evqueue.heap[child]))
+			++child;
+		if (!EventMoreImminent(evqueue.heap[child], ev))
+			break;
+		evqueueSet(pos, evqueue.heap[child]);
+		pos = child;
+	}
+	evqueueSet(pos, ev);
+}
+
+// Insert new element, keeping heap ordered by event imminency.
 //  Event's timestamp in psxRegs.intCycle[] must be set before call.
 //  Important: two elements equivalent in imminency keep their relative order,
-//  i.e., new events are inserted after existing equally-imminent events.
+//  i.e., new events are dispatched after existing equally-imminent events.
 static inline void evqueueAdd(u8 ev)
 {
 #ifdef DEBUG_EVENTS
@@ -376,21 +422,9 @@ static inline void evqueueAdd(u8 ev)
 	}
 #endif
 
-	u8 *it = evqueueFrontPtr();  // iterator
-
-	while ((it != evqueueEndPtr()) && !EventMoreImminent(ev, *it))
-		++it;
-
-	// Rather than be fancy and compute position relative to front/end, to
-	//  decide how to insert, we choose evqueueInsertFront() when possible,
-	//  to keep object code size small. Our queue is usually pretty small.
-	if (evqueue.useBeginIdx > 0) {
-		// Insert before position 'it', move elements towards front to make room
-		evqueueInsertFront(it-1, ev);
-	} else {
-		// Insert at position 'it', move elements towards back to make room
-		evqueueInsertBack(it, ev);
-	}
+	evqueue.seq[ev] = evqueue.seqCtr++;
+	evqueue.heap[evqueue.size] = ev;
+	evqueueSiftUp(evqueue.size++);
 
 #ifdef DEBUG_EVENTS
 	if (!evqueueConsistencyCheck()) {
@@ -401,20 +435,34 @@ static inline void evqueueAdd(u8 ev)
 #endif
 }
 
-// Remove the first matching element, returning false if not found
-static bool evqueueRemove(u8 ev)
+// Restore heap order after timestamp of already-queued event 'ev' changed.
+//  Like evqueueAdd(), event ends up after existing equally-imminent events.
+static inline void evqueueReschedule(u8 ev)
 {
-	u8 *it = evqueueFrontPtr();
-	while ((it != evqueueEndPtr()) && (*it != ev))
-		++it;
+	evqueue.seq[ev] = evqueue.seqCtr++;
+	evqueueSiftUp(evqueue.heapPos[ev]);
+	evqueueSiftDown(evqueue.heapPos[ev]);
+
+#ifdef DEBUG_EVENTS
+	if (!evqueueConsistencyCheck()) {
+		printf("ERROR: Queue consistent ordering check failed in %s(),\n"
+	           "after rescheduling event %u\n", __func__, ev);
+		evqueuePrintQueue();
+	}
+#endif
+}
 
-	if (it == evqueueEndPtr())
-		return false;
+// Remove queued element 'ev': last heap element takes its place
+static inline void evqueueRemove(u8 ev)
+{
+	u8 pos = evqueue.heapPos[ev];
+	u8 last = evqueue.heap[--evqueue.size];
 
-	// Rather than be fancy and compute position relative to front/end, we
-	//  always shrink array towards front, to keep object code size small.
-	--evqueue.useEndIdx;
-	evqueueMoveTowardsFront(it+1, evqueueEndPtr());
+	if (pos != evqueue.size) {
+		evqueueSet(pos, last);
+		evqueueSiftUp(pos);
+		evqueueSiftDown(evqueue.heapPos[last]);
+	}
 
 #ifdef DEBUG_EVENTS
 	if (!evqueueConsistencyCheck()) {
@@ -423,8 +471,6 @@ static bool evqueueRemove(u8 ev)
 		evqueuePrintQueue();
 	}
 #endif
-
-	return true;
 }
 
 static inline void evqueueRemoveFront(void)
@@ -436,56 +482,26 @@ static inline void evqueueRemoveFront(void)
 	}
 #endif
 
-	++evqueue.useBeginIdx;
-}
-
-// Copy all elements between [start,end] to [start+1,end+1].
-//  If start address is greater than end, no copy will occur.
-static inline void evqueueMoveTowardsBack(u8 *start, u8 *end)
-{
-	for (u8 *ptr = end; ptr >= start; --ptr)
-		*(ptr+1) = *ptr;
-}
-
-// Copy all elements between [start,end] to [start-1,end-1].
-//  If start address is greater than end, no copy will occur.
-static inline void evqueueMoveTowardsFront(u8 *start, u8 *end)
-{
-	for (u8 *ptr = start; ptr <= end; ++ptr)
-		*(ptr-1) = *ptr;
-}
-
-// Insert new entry 'ev' at position 'pos'. Any existing elements at or
-//  before position will be moved towards the front to make room.
-static inline void evqueueInsertFront(u8 *pos, u8 ev)
-{
-	evqueueMoveTowardsFront(evqueueFrontPtr(), pos);
-	--evqueue.useBeginIdx;
-	*pos = ev;
-}
-
-// Insert new entry 'ev' at position 'pos'. Any existing elements at or
-//  after position will be moved towards the rear to make room.
-static inline void evqueueInsertBack(u8 *pos, u8 ev)
-{
-	evqueueMoveTowardsBack(pos, evqueueEndPtr()-1);
-	++evqueue.useEndIdx;
-	*pos = ev;
+	if (--evqueue.size > 0) {
+		evqueue.heap[0] = evqueue.heap[evqueue.size];
+		evqueueSiftDown(0);
+	}
 }
 
 #ifdef DEBUG_EVENTS
 static bool evqueueConsistencyCheck(void)
 {
-	if (evqueueSize() < 2)
-		return true;
-
-	for (u8 *ev = evqueueFrontPtr(); ev < (evqueueEndPtr()-1); ++ev) {
-		if (!EventMoreImminent(*ev, *(ev+1))) {
-			if ((psxRegs.intCycle[*ev].sCycle + psxRegs.intCycle[*ev].cycle) !=
-			    (psxRegs.intCycle[*(ev+1)].sCycle + psxRegs.intCycle[*(ev+1)].cycle)) {
-				printf("ERROR: %s() failed: EV %u > EV %u\n", __func__, *ev, *(ev+1));
-				return false;
-			}
+	for (int i = 0; i < evqueue.size; ++i) {
+		u8 ev = evqueue.heap[i];
+		if (evqueue.heapPos[ev] != i) {
+			printf("ERROR: %s() failed: EV %u at idx %d, heapPos %u\n",
+			       __func__, ev, i, evqueue.heapPos[ev]);
+			return false;
+		}
+		if (i > 0 && EventMoreImminent(ev, evqueue.heap[(i-1)/2])) {
+			printf("ERROR: %s() failed: EV %u > EV %u\n",
+			       __func__, evqueue.heap[(i-1)/2], ev);
+			return false;
 		}
 	}
 	return true;
@@ -493,11 +509,12 @@ static bool evqueueConsistencyCheck(void)
 
 static void evqueuePrintQueue(void)
 {
-	printf("Queue contains %zu events, useBeginIdx: %u  useEndIdx: %u\n",
-			evqueueSize(), evqueue.useBeginIdx, evqueue.useEndIdx);
-	for (u8 *ev = evqueueFrontPtr(); ev != evqueueEndPtr(); ++ev) {
-		printf("EV: %u SCYCLE: %u CYCLE: %u\n",
-		       *ev, psxRegs.intCycle[*ev].sCycle, psxRegs.intCycle[*ev].cycle);
+	printf("Queue contains %zu events\n", evqueueSize());
+	for (int i = 0; i < evqueue.size; ++i) {
+		u8 ev = evqueue.heap[i];
+		printf("IDX: %d EV: %u SCYCLE: %u CYCLE: %u SEQ: %u\n", i, ev,
+		       psxRegs.intCycle[ev].sCycle, psxRegs.intCycle[ev].cycle,
+		       evqueue.seq[ev]);
 	}
 
 	if (evqueueConsistencyCheck())
@@ -996,3 +996,460 @@ R3000Acpu psxInt = {
 	intNotify,
 	intShutdown
 };
+
+///////////////////////////////////////////
+// Threaded-code interpreter
+//
+// psxIntThr runs the same instruction handlers and branch/delay-slot logic
+//  as psxInt above, with the same results and cycle counts, but fetches
+//  from a cache of pre-decoded micro-ops instead of decoding psxRegs.code
+//  through psxBSC[] etc. for every instruction. Each word of RAM and BIOS
+//  has one 8-byte record, filled in the first time it is executed and
+//  cleared again by intThrClear(), which gets the same psxCpu->Clear()
+//  calls as the dynarecs do on stores and DMA.
+//
+// Common ops are executed inline and dispatched with computed goto. Rare
+//  ops fall back to their psxBSC[] handler. A taken branch whose delay slot
+//  holds an inline op also executes the slot inline; other delay slots
+//  (loads, branches) go through doBranch() like psxInt.
+
+// Micro-ops. Ones from LB on would need doBranch()'s load delay or
+//  branch-in-delay-slot handling if found in a delay slot.
+#define INT_UOPS(X) \
+	X(DECODE) X(NOP) \
+	X(ADDIU) X(SLTI) X(SLTIU) X(ANDI) X(ORI) X(XORI) X(LI) \
+	X(ADDU) X(SUBU) X(AND) X(OR) X(XOR) X(NOR) X(SLT) X(SLTU) \
+	X(SLL) X(SRL) X(SRA) X(SLLV) X(SRLV) X(SRAV) \
+	X(MFHI) X(MFLO) X(MTHI) X(MTLO) X(MULT) X(MULTU) X(DIV) X(DIVU) \
+	X(SB) X(SH) X(SW) X(FALLBACK) \
+	X(LB) X(LBU) X(LH) X(LHU) X(LW) X(FALLBACK_LD) \
+	X(BEQ) X(BNE) X(BLEZ) X(BGTZ) X(BLTZ) X(BGEZ) X(BLTZAL) X(BGEZAL) \
+	X(J) X(JAL) X(JR) X(JALR)
+
+enum {
+#define INT_UOP_ENUM(name) IOP_##name,
+	INT_UOPS(INT_UOP_ENUM)
+#undef INT_UOP_ENUM
+	IOP_COUNT
+};
+
+struct IntUop {
+	u8  op;          // IOP_*, IOP_DECODE (0) if not decoded yet
+	u8  rs, rt, rd;
+	u32 imm;         // Immediate, shift amount, branch offset, jump target
+	                 //  or, for IOP_FALLBACK*, the opcode
+};
+
+#define INT_RAM_UOPS   (0x200000/4)
+#define INT_ROM_UOPS   (0x080000/4)
+
+// Records for RAM and BIOS, each followed by an extra IOP_DECODE record so
+//  running off the end looks the address up again
+static IntUop *int_uops;
+static IntUop *int_uop_lut[0x10000];
+
+// Bit per 4KB page of RAM that has decoded records, see intThrClear()
+static u8 int_code_pages[0x200000/4096/8];
+
+static IntUop *intUopAt(u32 pc) {
+	IntUop *base = int_uop_lut[pc >> 16];
+	if (base == NULL)
+		return NULL;
+	return base + ((pc & 0xffff) >> 2);
+}
+
+static void intDecode(IntUop *u, u32 pc) {
+	u32 *p = (u32 *)PSXM(pc);
+	u32 code = (p == NULL) ? 0 : SWAP32(*p);
+	u32 op = IOP_NOP;
+	u32 imm = (s32)_fImm_(code);
+
+	if (u < int_uops + INT_RAM_UOPS) {
+		u32 page = (pc & 0x1fffff) / 4096;
+		int_code_pages[page/8] |= 1 << (page & 7);
+	}
+
+	u->rs = _fRs_(code);
+	u->rt = _fRt_(code);
+	u->rd = _fRd_(code);
+
+	switch (_fOp_(code)) {
+		case 0x00: // SPECIAL
+			switch (_fFunct_(code)) {
+				case 0x00: op = IOP_SLL;  imm = _fSa_(code); break;
+				case 0x02: op = IOP_SRL;  imm = _fSa_(code); break;
+				case 0x03: op = IOP_SRA;  imm = _fSa_(code); break;
+				case 0x04: op = IOP_SLLV; break;
+				case 0x06: op = IOP_SRLV; break;
+				case 0x07: op = IOP_SRAV; break;
+				case 0x08: op = IOP_JR;   break;
+				case 0x09: op = IOP_JALR; break;
+				case 0x0c: op = IOP_FALLBACK; break;  // SYSCALL
+				case 0x10: op = IOP_MFHI; break;
+				case 0x11: op = IOP_MTHI; break;
+				case 0x12: op = IOP_MFLO; break;
+				case 0x13: op = IOP_MTLO; break;
+				case 0x18: op = IOP_MULT; break;
+				case 0x19: op = IOP_MULTU; break;
+				case 0x1a: op = IOP_DIV;  break;
+				case 0x1b: op = IOP_DIVU; break;
+				case 0x20: case 0x21: op = IOP_ADDU; break;
+				case 0x22: case 0x23: op = IOP_SUBU; break;
+				case 0x24: op = IOP_AND;  break;
+				case 0x25: op = IOP_OR;   break;
+				case 0x26: op = IOP_XOR;  break;
+				case 0x27: op = IOP_NOR;  break;
+				case 0x2a: op = IOP_SLT;  break;
+				case 0x2b: op = IOP_SLTU; break;
+			}
+			// Ops writing only to Rd do nothing when it is r0
+			if (u->rd == 0 && op <= IOP_MFLO)
+				op = IOP_NOP;
+			break;
+
+		case 0x01: // REGIMM
+			switch (u->rt) {
+				case 0x00: op = IOP_BLTZ;   break;
+				case 0x01: op = IOP_BGEZ;   break;
+				case 0x10: op = IOP_BLTZAL; break;
+				case 0x11: op = IOP_BGEZAL; break;
+				// psxBranchNoDelay() takes some of the others for branches,
+				//  so leave them all to doBranch() when in a delay slot
+				default:   op = IOP_FALLBACK_LD; break;
+			}
+			imm <<= 2;
+			break;
+
+		case 0x02: op = IOP_J;   imm = _fTarget_(code) << 2; break;
+		case 0x03: op = IOP_JAL; imm = _fTarget_(code) << 2; break;
+		case 0x04: op = IOP_BEQ;  imm <<= 2; break;
+		case 0x05: op = IOP_BNE;  imm <<= 2; break;
+		case 0x06: op = IOP_BLEZ; imm <<= 2; break;
+		case 0x07: op = IOP_BGTZ; imm <<= 2; break;
+
+		case 0x08: case 0x09: op = IOP_ADDIU; break;
+		case 0x0a: op = IOP_SLTI;  break;
+		case 0x0b: op = IOP_SLTIU; break;
+		case 0x0c: op = IOP_ANDI;  imm = _fImmU_(code); break;
+		case 0x0d: op = IOP_ORI;   imm = _fImmU_(code); break;
+		case 0x0e: op = IOP_XORI;  imm = _fImmU_(code); break;
+		case 0x0f: op = IOP_LI;    imm = code << 16; break;
+
+		case 0x10: // COP0, MFC0/CFC0 have a load delay
+			op = (u->rs == 0 || u->rs == 2) ? IOP_FALLBACK_LD : IOP_FALLBACK;
+			break;
+		case 0x12: // COP2, MFC2/CFC2 have a load delay
+			if (_fFunct_(code) == 0 && (u->rs == 0 || u->rs == 2))
+				op = IOP_FALLBACK_LD;
+			else
+				op = IOP_FALLBACK;
+			break;
+
+		case 0x20: op = IOP_LB;  break;
+		case 0x21: op = IOP_LH;  break;
+		case 0x23: op = IOP_LW;  break;
+		case 0x24: op = IOP_LBU; break;
+		case 0x25: op = IOP_LHU; break;
+		case 0x22: case 0x26: case 0x32: // LWL, LWR, LWC2
+			op = IOP_FALLBACK_LD;
+			break;
+
+		case 0x28: op = IOP_SB; break;
+		case 0x29: op = IOP_SH; break;
+		case 0x2b: op = IOP_SW; break;
+		case 0x2a: case 0x2e: case 0x3a: case 0x3b: // SWL, SWR, SWC2, HLE
+			op = IOP_FALLBACK;
+			break;
+	}
+
+	// Immediate ops writing to r0 do nothing
+	if (u->rt == 0 && op >= IOP_ADDIU && op <= IOP_LI)
+		op = IOP_NOP;
+
+	if (op == IOP_FALLBACK || op == IOP_FALLBACK_LD)
+		imm = code;
+
+	u->imm = imm;
+	u->op = op;
+}
+
+static void intThrExecute(void) {
+#if defined(__GNUC__)
+	static void *const labels[IOP_COUNT] = {
+#define INT_UOP_LABEL(name) &&L_##name,
+		INT_UOPS(INT_UOP_LABEL)
+#undef INT_UOP_LABEL
+	};
+#define IOP_CASE(name)  L_##name: psxRegs.pc += 4; psxRegs.cycle += BIAS;
+#define IOP_DISPATCH()  goto *labels[u->op]
+#define IOP_SWITCH()
+#define IOP_SWITCH_END()
+#else
+#define IOP_CASE(name)  case IOP_##name: psxRegs.pc += 4; psxRegs.cycle += BIAS;
+#define IOP_DISPATCH()  goto dispatch
+#define IOP_SWITCH()    dispatch: switch (u->op) {
+#define IOP_SWITCH_END() }
+#endif
+
+// Next op, or finish the branch if this one was in its delay slot
+#define IOP_NEXT() \
+	do { u++; if (bd) goto bd_done; IOP_DISPATCH(); } while (0)
+
+#define uRs  psxRegs.GPR.r[u->rs]
+#define uRt  psxRegs.GPR.r[u->rt]
+#define uRd  psxRegs.GPR.r[u->rd]
+#define uAddr (uRs + u->imm)
+
+	IntUop *u;
+	u32 tar = 0;
+	int bd = 0;          // 1: executing delay slot of taken branch
+	int jump_test = 0;   // 1: call psxJumpTest() after branch, for JR
+
+resync:
+	u = intUopAt(psxRegs.pc);
+	if (u == NULL) {
+		// Not in RAM or BIOS
+		execI();
+		goto resync;
+	}
+	if (u->op == IOP_DECODE)
+		intDecode(u, psxRegs.pc);
+	IOP_DISPATCH();
+
+	IOP_SWITCH()
+
+#if defined(__GNUC__)
+L_DECODE:
+#else
+	case IOP_DECODE:
+#endif
+	goto resync;
+
+	IOP_CASE(NOP)   IOP_NEXT();
+
+	IOP_CASE(ADDIU) uRt = uRs + u->imm; IOP_NEXT();
+	IOP_CASE(SLTI)  uRt = _i32(uRs) < (s32)u->imm; IOP_NEXT();
+	IOP_CASE(SLTIU) uRt = uRs < u->imm; IOP_NEXT();
+	IOP_CASE(ANDI)  uRt = uRs & u->imm; IOP_NEXT();
+	IOP_CASE(ORI)   uRt = uRs | u->imm; IOP_NEXT();
+	IOP_CASE(XORI)  uRt = uRs ^ u->imm; IOP_NEXT();
+	IOP_CASE(LI)    uRt = u->imm; IOP_NEXT();
+
+	IOP_CASE(ADDU)  uRd = uRs + uRt; IOP_NEXT();
+	IOP_CASE(SUBU)  uRd = uRs - uRt; IOP_NEXT();
+	IOP_CASE(AND)   uRd = uRs & uRt; IOP_NEXT();
+	IOP_CASE(OR)    uRd = uRs | uRt; IOP_NEXT();
+	IOP_CASE(XOR)   uRd = uRs ^ uRt; IOP_NEXT();
+	IOP_CASE(NOR)   uRd = ~(uRs | uRt); IOP_NEXT();
+	IOP_CASE(SLT)   uRd = _i32(uRs) < _i32(uRt); IOP_NEXT();
+	IOP_CASE(SLTU)  uRd = uRs < uRt; IOP_NEXT();
+
+	IOP_CASE(SLL)   uRd = uRt << u->imm; IOP_NEXT();
+	IOP_CASE(SRL)   uRd = uRt >> u->imm; IOP_NEXT();
+	IOP_CASE(SRA)   uRd = _i32(uRt) >> u->imm; IOP_NEXT();
+	IOP_CASE(SLLV)  uRd = uRt << uRs; IOP_NEXT();
+	IOP_CASE(SRLV)  uRd = uRt >> uRs; IOP_NEXT();
+	IOP_CASE(SRAV)  uRd = _i32(uRt) >> uRs; IOP_NEXT();
+
+	IOP_CASE(MFHI)  uRd = _rHi_; IOP_NEXT();
+	IOP_CASE(MFLO)  uRd = _rLo_; IOP_NEXT();
+	IOP_CASE(MTHI)  _rHi_ = uRs; IOP_NEXT();
+	IOP_CASE(MTLO)  _rLo_ = uRs; IOP_NEXT();
+
+	IOP_CASE(MULT) {
+		u64 res = (s64)((s64)_i32(uRs) * (s64)_i32(uRt));
+		_rLo_ = (u32)res;
+		_rHi_ = (u32)(res >> 32);
+		IOP_NEXT();
+	}
+	IOP_CASE(MULTU) {
+		u64 res = (u64)uRs * (u64)uRt;
+		_rLo_ = (u32)res;
+		_rHi_ = (u32)(res >> 32);
+		IOP_NEXT();
+	}
+	IOP_CASE(DIV)
+		if (_i32(uRt) != 0) {
+			s32 lo = _i32(uRs) / _i32(uRt);
+			_i32(_rHi_) = _i32(uRs) % _i32(uRt);
+			_i32(_rLo_) = lo;
+		} else {
+			_i32(_rLo_) = _i32(uRs) >= 0 ? 0xffffffff : 1;
+			_i32(_rHi_) = _i32(uRs);
+		}
+		IOP_NEXT();
+	IOP_CASE(DIVU)
+		if (uRt != 0) {
+			u32 lo = uRs / uRt;
+			_rHi_ = uRs % uRt;
+			_rLo_ = lo;
+		} else {
+			_i32(_rLo_) = 0xffffffff;
+			_i32(_rHi_) = _i32(uRs);
+		}
+		IOP_NEXT();
+
+	IOP_CASE(SB)  psxMemWrite8 (uAddr, uRt &   0xff); IOP_NEXT();
+	IOP_CASE(SH)  psxMemWrite16(uAddr, uRt & 0xffff); IOP_NEXT();
+	IOP_CASE(SW)  psxMemWrite32(uAddr, uRt); IOP_NEXT();
+
+	IOP_CASE(LB) { u32 v = (s8)psxMemRead8(uAddr);   if (u->rt) uRt = v; IOP_NEXT(); }
+	IOP_CASE(LBU) { u32 v = psxMemRead8(uAddr);      if (u->rt) uRt = v; IOP_NEXT(); }
+	IOP_CASE(LH) { u32 v = (s16)psxMemRead16(uAddr); if (u->rt) uRt = v; IOP_NEXT(); }
+	IOP_CASE(LHU) { u32 v = psxMemRead16(uAddr);     if (u->rt) uRt = v; IOP_NEXT(); }
+	IOP_CASE(LW) { u32 v = psxMemRead32(uAddr);      if (u->rt) uRt = v; IOP_NEXT(); }
+
+	// Handler might raise an exception, so look up next op by psxRegs.pc
+	IOP_CASE(FALLBACK_LD)
+		goto fallback;
+	IOP_CASE(FALLBACK)
+fallback:
+		psxRegs.code = u->imm;
+		psxBSC[psxRegs.code >> 26]();
+		if (bd) goto bd_done;
+		goto resync;
+
+	IOP_CASE(BEQ)  if (uRs == uRt) goto branch_rel; IOP_NEXT();
+	IOP_CASE(BNE)  if (uRs != uRt) goto branch_rel; IOP_NEXT();
+	IOP_CASE(BLEZ) if (_i32(uRs) <= 0) goto branch_rel; IOP_NEXT();
+	IOP_CASE(BGTZ) if (_i32(uRs) > 0) goto branch_rel; IOP_NEXT();
+	IOP_CASE(BLTZ) if (_i32(uRs) < 0) goto branch_rel; IOP_NEXT();
+	IOP_CASE(BGEZ) if (_i32(uRs) >= 0) goto branch_rel; IOP_NEXT();
+	IOP_CASE(BLTZAL)
+		if (_i32(uRs) < 0) { _SetLink(31); goto branch_rel; }
+		IOP_NEXT();
+	IOP_CASE(BGEZAL)
+		if (_i32(uRs) >= 0) { _SetLink(31); goto branch_rel; }
+		IOP_NEXT();
+	IOP_CASE(J)
+		tar = (psxRegs.pc & 0xf0000000) + u->imm;
+		goto branch;
+	IOP_CASE(JAL)
+		_SetLink(31);
+		tar = (psxRegs.pc & 0xf0000000) + u->imm;
+		goto branch;
+	IOP_CASE(JR)
+		tar = uRs;
+		jump_test = 1;
+		goto branch;
+	IOP_CASE(JALR)
+		tar = uRs;
+		if (u->rd) { _SetLink(u->rd); }
+		goto branch;
+
+	IOP_SWITCH_END()
+
+branch_rel:
+	tar = psxRegs.pc + u->imm;
+branch:
+	u++;
+	if (u->op == IOP_DECODE) {
+		u = intUopAt(psxRegs.pc);
+		if (u != NULL && u->op == IOP_DECODE)
+			intDecode(u, psxRegs.pc);
+	}
+	if (u == NULL || u->op >= IOP_LB) {
+		doBranch(tar);
+		if (jump_test) {
+			psxJumpTest();
+			jump_test = 0;
+		}
+		goto resync;
+	}
+	branch2 = branch = 1;
+	branchPC = tar;
+	bd = 1;
+	IOP_DISPATCH();
+
+bd_done:
+	bd = 0;
+	branch = 0;
+	psxRegs.pc = branchPC;
+	psxBranchTest();
+	if (jump_test) {
+		psxJumpTest();
+		jump_test = 0;
+	}
+	goto resync;
+
+#undef IOP_CASE
+#undef IOP_DISPATCH
+#undef IOP_SWITCH
+#undef IOP_SWITCH_END
+#undef IOP_NEXT
+#undef uRs
+#undef uRt
+#undef uRd
+#undef uAddr
+}
+
+static void intThrReset(void) {
+	memset(int_uops, 0, (INT_RAM_UOPS + 1 + INT_ROM_UOPS + 1) * sizeof(IntUop));
+	memset(int_code_pages, 0, sizeof(int_code_pages));
+}
+
+static int intThrInit(void) {
+	IntUop *ram, *rom;
+
+	int_uops = (IntUop *)malloc((INT_RAM_UOPS + 1 + INT_ROM_UOPS + 1) * sizeof(IntUop));
+	if (int_uops == NULL) {
+		printf("Error allocating memory\n"); return -1;
+	}
+	ram = int_uops;
+	rom = int_uops + INT_RAM_UOPS + 1;
+
+	memset(int_uop_lut, 0, sizeof(int_uop_lut));
+	for (int i = 0; i < 0x80; i++)
+		int_uop_lut[i + 0x0000] = ram + ((i & 0x1f) << 16) / 4;
+	memcpy(&int_uop_lut[0x8000], int_uop_lut, 0x80 * sizeof(int_uop_lut[0]));
+	memcpy(&int_uop_lut[0xa000], int_uop_lut, 0x80 * sizeof(int_uop_lut[0]));
+
+	for (int i = 0; i < 0x08; i++) {
+		int_uop_lut[i + 0x1fc0] = rom + (i << 16) / 4;
+		int_uop_lut[i + 0x9fc0] = rom + (i << 16) / 4;
+		int_uop_lut[i + 0xbfc0] = rom + (i << 16) / 4;
+	}
+
+	intThrReset();
+	return 0;
+}
+
+static void intThrClear(u32 Addr, u32 Size) {
+	const u32 masked_ram_addr = Addr & 0x1ffffc;
+	u32 end = masked_ram_addr + Size * 4;
+	if (end > 0x200000)
+		end = 0x200000;
+
+	// Skip pages nothing was decoded from, like recClear() does
+	u32 page = masked_ram_addr / 4096;
+	u32 end_page = (end - 1) / 4096 + 1;
+	bool has_code = false;
+	do {
+		has_code = int_code_pages[page/8] & (1 << (page & 7));
+	} while ((++page < end_page) && !has_code);
+
+	if (has_code)
+		memset(&int_uops[masked_ram_addr / 4], 0, (end - masked_ram_addr) / 4 * sizeof(IntUop));
+}
+
+static void intThrNotify(int note, void *data) {
+	// New code was loaded while cache was isolated, see psxmem.cpp
+	if (note == R3000ACPU_NOTIFY_CACHE_UNISOLATED)
+		intThrClear(0, 0x200000/4);
+}
+
+static void intThrShutdown(void) {
+	free(int_uops);
+	int_uops = NULL;
+	memset(int_uop_lut, 0, sizeof(int_uop_lut));
+}
+
+R3000Acpu psxIntThr = {
+	intThrInit,
+	intThrReset,
+	intThrExecute,
+	intExecuteBlock,
+	intThrClear,
+	intThrNotify,
+	intThrShutdown
+};
@@ -320,9 +320,7 @@ void psxMemWrite8(u32 mem, u8 value)
 		u8 *p = (u8*)(psxMemWLUT[t]);
 		if (p != NULL) {
 			*(u8*)(p + m) = value;
-#ifdef PSXREC
 			psxCpu->Clear((mem & (~3)), 1);
-#endif
 		} else {
 			PSXMEM_LOG("%s(): err sb 0x%08x\n", __func__, mem);
 		}
@@ -343,9 +341,7 @@ void psxMemWrite16(u32 mem, u16 value)
 		u8 *p = (u8*)(psxMemWLUT[t]);
 		if (p != NULL) {
 			*(u16*)(p + m) = SWAPu16(value);
-#ifdef PSXREC
 			psxCpu->Clear((mem & (~3)), 1);
-#endif
 		} else {
 			PSXMEM_LOG("%s(): err sh 0x%08x\n", __func__, mem);
 		}
@@ -366,14 +362,10 @@ void psxMemWrite32(u32 mem, u32 value)
 		u8 *p = (u8*)(psxMemWLUT[t]);
 		if (p != NULL) {
 			*(u32*)(p + m) = SWAPu32(value);
-#ifdef PSXREC
 			psxCpu->Clear(mem, 1);
-#endif
 		} else {
 			if (mem != 0xfffe0130) {
-#ifdef PSXREC
 				if (!psxRegs.writeok) psxCpu->Clear(mem, 1);
-#endif
 				if (psxRegs.writeok) { PSXMEM_LOG("%s(): err sw 0x%08x\n", __func__, mem); }
 			} else {
 				// Write to cache control port 0xfffe0130
@@ -43,11 +43,16 @@ int psxInit() {
 	#ifndef interpreter_none
 	if (Config.Cpu == CPU_INTERPRETER) {
 		psxCpu = &psxInt;
+	} else if (Config.Cpu == CPU_INTERPRETER_THREADED) {
+		psxCpu = &psxIntThr;
 	} else
 	#endif
 	psxCpu = &psxRec;
 #else
-	psxCpu = &psxInt;
+	if (Config.Cpu == CPU_INTERPRETER_THREADED)
+		psxCpu = &psxIntThr;
+	else
+		psxCpu = &psxInt;
 #endif
 
 	// Initialize CPU *before* calling psxMemInit(), so it can make any
@@ -90,6 +95,7 @@ void psxShutdown() {
 	//  psxM,psxH etc, if it has done so.
 	psxCpu->Shutdown();
 
+	mdecShutdown();
 	psxMemShutdown();
 	psxBiosShutdown();
 
@@ -45,6 +45,7 @@ typedef struct {
 
 extern R3000Acpu *psxCpu;
 extern R3000Acpu psxInt;
+extern R3000Acpu psxIntThr;
 #ifdef PSXREC
 extern R3000Acpu psxRec;
 #endif
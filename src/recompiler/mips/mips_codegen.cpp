@@ -477,6 +477,229 @@ int rec_discard_scan(u32 code_loc, int *discard_type)
 	return 0;
 }
 
+/*
+ * If opcode at PS1 code loc is a branch or jump that can end an idle loop,
+ *  i.e. not one that links or jumps to a register, return its target.
+ *
+ * Returns: true if opcode is such a branch/jump, with target in 'target'.
+ *          false if it is not, with 'is_other_branch' set for any other
+ *          branch or jump.
+ */
+static bool idle_loop_branch_target(u32 code_loc, u32 op, u32 *target, bool *is_other_branch)
+{
+	*is_other_branch = false;
+
+	switch (_fOp_(op)) {
+		case 0x00: /* SPECIAL prefix */
+			// JR, JALR
+			if (_fFunct_(op) == 0x08 || _fFunct_(op) == 0x09)
+				*is_other_branch = true;
+			return false;
+		case 0x01: /* REGIMM prefix */
+			// BLTZ, BGEZ. Link variants BLTZAL, BGEZAL are not accepted.
+			if (_fRt_(op) == 0x00 || _fRt_(op) == 0x01)
+				break;
+			*is_other_branch = true;
+			return false;
+		case 0x02: /* J */
+			*target = ((code_loc + 4) & 0xf0000000) | (_fTarget_(op) << 2);
+			return true;
+		case 0x03: /* JAL */
+			*is_other_branch = true;
+			return false;
+		case 0x04: /* BEQ */
+		case 0x05: /* BNE */
+		case 0x06: /* BLEZ */
+		case 0x07: /* BGTZ */
+			break;
+		default:
+			return false;
+	}
+
+	*target = code_loc + 4 + (_fImm_(op) * 4);
+	return true;
+}
+
+/*
+ * Scans for a polling loop at PS1 code location, where a game waits for an
+ *  interrupt handler or hardware to change a value in memory, e.g.:
+ *
+ *    loop: lw    v0, 0x1070(a0)    # Poll I_STAT
+ *          nop
+ *          andi  v0, v0, 1
+ *          beq   v0, zero, loop
+ *          nop
+ *
+ *  The loop must branch back to 'code_loc' and, other than the branch and
+ *  its BD slot, contain only loads and ALU ops. No reg the loop writes may
+ *  be read before it is written in the same iteration. Each iteration then
+ *  computes the same thing, and only a change in memory can end the loop:
+ *  until the next interrupt or scheduled event, it would spin.
+ *  The loads are returned in 'info', for the caller to check that their
+ *  addresses are safe to read repeatedly. A load address is either known
+ *  (base reg is zero or set by LUI/ADDIU/ORI in the loop) or is an offset
+ *  from a reg the loop never writes.
+ *
+ * Returns: # of opcodes in loop including BD slot, 0 if none found.
+ */
+int rec_scan_for_idle_loop(u32 code_loc, struct IdleLoopInfo *info)
+{
+	int num_ops = 0;
+	u64 loop_writes = 0;
+
+	info->num_loads = 0;
+
+	// Find the branch back to 'code_loc'
+	for (int i = 0; i < IDLE_LOOP_MAX_OPCODES - 1; i++) {
+		u32 loc = code_loc + i * 4;
+		u32 target;
+		bool is_other_branch;
+		if (idle_loop_branch_target(loc, OPCODE_AT(loc), &target, &is_other_branch)) {
+			if (target != code_loc)
+				return 0;
+			num_ops = i + 2;  // Include BD slot
+			break;
+		}
+		if (is_other_branch)
+			return 0;
+	}
+	if (num_ops == 0)
+		return 0;
+
+	for (int i = 0; i < num_ops; i++)
+		loop_writes |= opcodeGetWrites(OPCODE_AT(code_loc + i * 4));
+	loop_writes &= ~(u64)1;
+
+	u64 written = 0;
+	u32 const_regs = 1;  // Regs with known val, $zero always
+	u32 const_vals[32] = { 0 };
+
+	for (int i = 0; i < num_ops; i++) {
+		const u32 op = OPCODE_AT(code_loc + i * 4);
+		u32 target;
+		bool is_other_branch;
+
+		if (idle_loop_branch_target(code_loc + i * 4, op, &target, &is_other_branch) ||
+		    is_other_branch) {
+			if (i != num_ops - 2)
+				return 0;  // Branch in BD slot
+		} else if (op == 0) {
+			// NOP
+		} else if (opcodeIsALU(op, NULL)) {
+			const u32 rt = _fRt_(op), rs = _fRs_(op);
+			switch (_fOp_(op)) {
+				case 0x0f: /* LUI */
+					const_regs |= (1 << rt);
+					const_vals[rt] = (u32)_fImmU_(op) << 16;
+					break;
+				case 0x09: /* ADDIU */
+				case 0x0d: /* ORI */
+					if (const_regs & (1 << rs)) {
+						const_regs |= (1 << rt);
+						const_vals[rt] = (_fOp_(op) == 0x09) ?
+							const_vals[rs] + _fImm_(op) : const_vals[rs] | _fImmU_(op);
+						break;
+					}
+					// Fall through
+				default:
+					const_regs &= ~((u32)opcodeGetWrites(op) & ~1);
+					break;
+			}
+		} else {
+			const u32 rt = _fRt_(op), rs = _fRs_(op);
+			switch (_fOp_(op)) {
+				case 0x20: /* LB */
+				case 0x21: /* LH */
+				case 0x23: /* LW */
+				case 0x24: /* LBU */
+				case 0x25: /* LHU */
+					break;
+				default:
+					return 0;  // Store, mult/div, coprocessor op, etc
+			}
+
+			IdleLoopLoad *load = &info->loads[info->num_loads++];
+			if (const_regs & (1 << rs)) {
+				load->base_reg = 0;
+				load->addr = const_vals[rs] + _fImm_(op);
+			} else if (loop_writes & BIT(rs)) {
+				return 0;  // Address depends on values loop computes
+			} else {
+				load->base_reg = rs;
+				load->addr = _fImm_(op);
+			}
+			const_regs &= ~(1 << rt);
+		}
+
+		// No reads of values left over from the last iteration
+		if (opcodeGetReads(op) & loop_writes & ~written)
+			return 0;
+		written |= opcodeGetWrites(op);
+	}
+
+	return num_ops;
+}
+
+/*
+ * Can rec_scan_for_dead_regs() step over opcode? Only opcodes whose GPR,
+ *  LO/HI accesses opcodeGetReads()/opcodeGetWrites() know, and that run no
+ *  exception handler, are accepted: not SYSCALL, BREAK, COP0 or HLE ops.
+ *  Branches and jumps are not accepted either, scan is straight-line only.
+ */
+static bool dead_regs_scan_ok(const u32 op)
+{
+	switch (_fOp_(op)) {
+		case 0x00: /* SPECIAL prefix */
+			switch (_fFunct_(op)) {
+				case 0x00: case 0x02: case 0x03:            // SLL, SRL, SRA
+				case 0x04: case 0x06: case 0x07:            // SLLV, SRLV, SRAV
+				case 0x10: case 0x11: case 0x12: case 0x13: // MFHI, MTHI, MFLO, MTLO
+				case 0x18: case 0x19: case 0x1a: case 0x1b: // MULT, MULTU, DIV, DIVU
+				case 0x20: case 0x21: case 0x22: case 0x23: // ADD, ADDU, SUB, SUBU
+				case 0x24: case 0x25: case 0x26: case 0x27: // AND, OR, XOR, NOR
+				case 0x2a: case 0x2b:                       // SLT, SLTU
+					return true;
+			}
+			return false;
+		case 0x08: case 0x09: case 0x0a: case 0x0b:  // ADDI, ADDIU, SLTI, SLTIU
+		case 0x0c: case 0x0d: case 0x0e: case 0x0f:  // ANDI, ORI, XORI, LUI
+		case 0x12:                                   // COP2 (GTE)
+		case 0x20: case 0x21: case 0x22: case 0x23:  // LB, LH, LWL, LW
+		case 0x24: case 0x25: case 0x26:             // LBU, LHU, LWR
+		case 0x28: case 0x29: case 0x2a: case 0x2b:  // SB, SH, SWL, SW
+		case 0x2e:                                   // SWR
+		case 0x32: case 0x3a:                        // LWC2, SWC2
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Scans straight-line code at PS1 code location, up to 'code_end', for regs
+ *  that are written before they are read. A block exit to 'code_loc' need not
+ *  spill such regs to psxRegs: nothing will see the old value. The scan ends
+ *  at the first branch, jump, or opcode dead_regs_scan_ok() doesn't accept.
+ *
+ * Returns: Mask of dead regs, same bit layout as opcodeGetReads()
+ */
+u64 rec_scan_for_dead_regs(u32 code_loc, u32 code_end)
+{
+	u64 reads = 0;
+	u64 dead = 0;
+
+	for (int i = 0; i < DEAD_REGS_MAX_OPCODES && code_loc < code_end; i++, code_loc += 4) {
+		const u32 op = OPCODE_AT(code_loc);
+
+		if (!dead_regs_scan_ok(op))
+			break;
+
+		reads |= opcodeGetReads(op);
+		dead  |= opcodeGetWrites(op) & ~reads;
+	}
+
+	return dead & ~(u64)1;
+}
+
 /*
  * Returns: Char string ptr describing discardable sequence 'discard_type'
  */
@@ -457,7 +457,8 @@ do {                                                                           \
 
 #define rec_recompile_end_part2(use_fastpath_return)                           \
 do {                                                                           \
-    const u32 cycles = ADJUST_CLOCK((pc-oldpc)/4);                             \
+    PROFILE_BLOCK_RETURN(use_fastpath_return);                                 \
+    const u32 cycles = ADJUST_CLOCK(rec_block_insns());                        \
     if (cycles <= 0xffff) {                                                    \
         if (block_ret_addr) {                                                  \
             if (use_fastpath_return)                                           \
@@ -573,4 +574,20 @@ int rec_scan_for_MFHI_MFLO_sequence(u32 code_loc);
 int rec_discard_scan(u32 code_loc, int *discard_type);
 const char* rec_discard_type_str(int discard_type);
 
+/* Idle loop detection */
+#define IDLE_LOOP_MAX_OPCODES 12
+typedef struct {
+	u32 base_reg;   /* 0 if 'addr' is the full address */
+	u32 addr;       /* Full address, or offset from 'base_reg' */
+} IdleLoopLoad;
+struct IdleLoopInfo {
+	int          num_loads;
+	IdleLoopLoad loads[IDLE_LOOP_MAX_OPCODES];
+};
+int rec_scan_for_idle_loop(u32 code_loc, struct IdleLoopInfo *info);
+
+/* Liveness at block exit targets */
+#define DEAD_REGS_MAX_OPCODES 16
+u64 rec_scan_for_dead_regs(u32 code_loc, u32 code_end);
+
 #endif /* MIPS_CODEGEN_H */
@@ -102,6 +102,111 @@ static void emitBlockReturnPC(const u32  new_pc,
 #endif // USE_PC_CACHING
 }
 
+/* If block is an idle loop and 'new_pc' loops back to its start, emit code
+ *  to advance psxRegs.cycle so that, once this block's own cycles are added
+ *  by the dispatch loop, the next scheduled event is due. Emitted right
+ *  before rec_recompile_end_part2(), on the taken path of the branch.
+ *  See rec_idle_loop_scan().
+ */
+static void emitIdleLoopSkip(const u32 new_pc)
+{
+	if (!block_is_idle_loop || new_pc != oldpc)
+		return;
+
+	// Don't skip if regs that load addresses are based on have changed
+	u32 *backpatch[2];
+	for (int i = 0; i < idle_loop_num_guards; i++) {
+		LW(TEMP_0, PERM_REG_1, offGPR(idle_loop_guard_regs[i]));
+		LI32(TEMP_1, idle_loop_guard_vals[i]);
+		backpatch[i] = recMem;
+		BNE(TEMP_0, TEMP_1, 0);
+		NOP(); // <BD>
+	}
+
+	// target = io_cycle_counter - cycles
+	// if ((s32)(target - psxRegs.cycle) > 0)
+	//    psxRegs.cycle = target
+	const u32 cycles = ADJUST_CLOCK(rec_block_insns());
+	LW(TEMP_0, PERM_REG_1, off(io_cycle_counter));
+	LW(TEMP_1, PERM_REG_1, off(cycle));
+	LI32(TEMP_2, cycles);
+	SUBU(TEMP_0, TEMP_0, TEMP_2);
+	SUBU(TEMP_2, TEMP_0, TEMP_1);
+	SLT(TEMP_2, 0, TEMP_2);
+	MOVN(TEMP_1, TEMP_0, TEMP_2);
+	SW(TEMP_1, PERM_REG_1, off(cycle));
+
+	for (int i = 0; i < idle_loop_num_guards; i++)
+		fixup_branch(backpatch[i]);
+}
+
+/* Return mask of regs that a block exit from the jump/branch at 'branch_pc'
+ *  to 'target_pc' need not spill, see rec_scan_for_dead_regs(). Only exits
+ *  back into this part of the block are considered: the code scanned there
+ *  is then the same code this block was recompiled from.
+ */
+static u64 rec_exit_dead_regs(const u32 branch_pc, const u32 target_pc)
+{
+#ifdef USE_DEAD_REG_EXITS
+	if (target_pc >= block_part_pc && target_pc < branch_pc)
+		return rec_scan_for_dead_regs(target_pc, branch_pc);
+#endif
+	return 0;
+}
+
+/* Emit code to count how often the exit of the jump/branch at 'branch_pc'
+ *  is taken, on the exit's path before rec_recompile_end_part2(). When it
+ *  becomes hot, the code clears this block's ptr, so the dispatch loop
+ *  recompiles it with 'target_pc' stitched in. See rec_trace_can_stitch().
+ */
+static void emitTraceHeatCount(const u32 branch_pc, const u32 target_pc)
+{
+	if (!rec_trace_should_count(branch_pc, target_pc))
+		return;
+
+	u32 *heat = rec_trace_heat_ptr(branch_pc);
+	u32 *block_ptr = (u32 *)PC_REC(oldpc);
+
+	LUI(TEMP_0, ADR_HI(heat));
+	LW(TEMP_1, TEMP_0, ADR_LO(heat));
+	ADDIU(TEMP_1, TEMP_1, 1);
+	SLTIU(TEMP_2, TEMP_1, REC_TRACE_HEAT);
+	u32 *backpatch = recMem;
+	BNE(TEMP_2, 0, 0);
+	SW(TEMP_1, TEMP_0, ADR_LO(heat)); // <BD>
+	LUI(TEMP_3, ADR_HI(block_ptr));
+	SW(0, TEMP_3, ADR_LO(block_ptr));
+	fixup_branch(backpatch);
+}
+
+/* Emit code at the start of a part stitched in at 'target_pc', exiting the
+ *  superblock to 'target_pc' if its own block's ptr was cleared: a store
+ *  hit the code there, which may no longer be what was stitched in.
+ *  Code in ROM can't change and gets no check.
+ */
+static void emitTraceGuard(const u32 target_pc)
+{
+	if ((s32)(target_pc << 4) < 0)
+		return;
+
+	u32 *block_ptr = (u32 *)PC_REC(target_pc);
+
+	LUI(TEMP_0, ADR_HI(block_ptr));
+	LW(TEMP_0, TEMP_0, ADR_LO(block_ptr));
+	u32 *backpatch = recMem;
+	BNE(TEMP_0, 0, 0);
+	NOP(); // <BD>
+
+	regPushState();
+	emitBlockReturnPC(target_pc, BCU_FIRST_INSTRUCTION_MAYBE_EXECUTED);
+	rec_recompile_end_part1();
+	regClearBranch();
+	rec_recompile_end_part2(false);
+	regPopState();
+
+	fixup_branch(backpatch);
+}
+
 /* Emit code to set already-allocated register 'reg' to return address
  *  'return_pc' of a JAL/JALR/BAL instruction.
  *
@@ -272,22 +377,32 @@ static void recDelaySlot()
 
 static void iJumpNormal(u32 bpc)
 {
+	const u32 branch_pc = pc - 4;
 #ifdef LOG_BRANCHLOADDELAYS
 	u32 dt = DelayTest(pc, bpc);
 #endif
 
 	recDelaySlot();
 
+	// Is the jump hot? Keep going at its target then.
+	if (rec_trace_can_stitch(branch_pc, bpc)) {
+		rec_trace_stitch(bpc);
+		return;
+	}
+
 	// Can block use 'fastpath' return? (branches backward to its beginning)
 	const bool use_fastpath_return = rec_recompile_use_fastpath_return(bpc);
 
 	rec_recompile_end_part1();
-	regClearJump();
+	regClearJumpTo(rec_exit_dead_regs(branch_pc, bpc));
 
 	// Only need to set $v0 to new PC when not returning to 'fastpath'.
 	if (!use_fastpath_return)
 		emitBlockReturnPC(bpc, BCU_FIRST_INSTRUCTION_ALWAYS_EXECUTED);
 
+	emitTraceHeatCount(branch_pc, bpc);
+	emitIdleLoopSkip(bpc);
+
 	rec_recompile_end_part2(use_fastpath_return);
 
 	end_block = 1;
@@ -295,6 +410,7 @@ static void iJumpNormal(u32 bpc)
 
 static void iJumpAL(u32 bpc, u32 nbpc)
 {
+	const u32 branch_pc = pc - 4;
 	const u32 ra = regMipsToHost(31, REG_FIND, REG_REGISTER);
 	emitJumpAndLinkReturnAddress(ra, nbpc);
 	regUnlock(ra);
@@ -312,16 +428,24 @@ static void iJumpAL(u32 bpc, u32 nbpc)
 		recDelaySlot();
 	}
 
+	// Is the call hot? Keep going in the function then.
+	if (rec_trace_can_stitch(branch_pc, bpc)) {
+		rec_trace_stitch(bpc);
+		return;
+	}
+
 	// Can block use 'fastpath' return? (branches backward to its beginning)
 	const bool use_fastpath_return = rec_recompile_use_fastpath_return(bpc);
 
 	rec_recompile_end_part1();
-	regClearJump();
+	regClearJumpTo(rec_exit_dead_regs(branch_pc, bpc));
 
 	// Only need to set $v0 to new PC when not returning to 'fastpath'.
 	if (!use_fastpath_return)
 		emitBlockReturnPC(bpc, BCU_FIRST_INSTRUCTION_ALWAYS_EXECUTED);
 
+	emitTraceHeatCount(branch_pc, bpc);
+
 	rec_recompile_end_part2(use_fastpath_return);
 
 	end_block = 1;
@@ -331,6 +455,7 @@ static void iJumpAL(u32 bpc, u32 nbpc)
 static void emitBxxZ(int andlink, u32 bpc, u32 nbpc)
 {
 	const u32 code = psxRegs.code;
+	const u32 branch_pc = pc - 4;
 	const int dt = DelayTest(pc, bpc);
 
 #ifdef USE_CONST_BRANCH_OPTIMIZATIONS
@@ -430,16 +555,25 @@ static void emitBxxZ(int andlink, u32 bpc, u32 nbpc)
 	if (dt == 3 || dt == 0)
 		recDelaySlot();
 
+	// Is the branch hot when taken? Then the not-taken path is the block
+	//  exit, and the code at the branch target is stitched in after it.
+	const u32 target_pc = bpc;
+	const bool stitch = !andlink && (dt == 3 || dt == 0) &&
+	                    rec_trace_can_stitch(branch_pc, target_pc);
+	if (stitch)
+		bpc = nbpc;
+
 	u32* const backpatch = (u32 *)recMem;
 
 	// Check opcode and emit branch with REVERSED logic!
+	//  (Not reversed when stitching: the taken path skips the exit then.)
 	switch (code & 0xfc1f0000) {
 	case 0x04000000: /* BLTZ */
-	case 0x04100000: /* BLTZAL */	BGEZ(br1, 0); break;
+	case 0x04100000: /* BLTZAL */	if (stitch) BLTZ(br1, 0); else BGEZ(br1, 0); break;
 	case 0x04010000: /* BGEZ */
-	case 0x04110000: /* BGEZAL */	BLTZ(br1, 0); break;
-	case 0x1c000000: /* BGTZ */	BLEZ(br1, 0); break;
-	case 0x18000000: /* BLEZ */	BGTZ(br1, 0); break;
+	case 0x04110000: /* BGEZAL */	if (stitch) BGEZ(br1, 0); else BLTZ(br1, 0); break;
+	case 0x1c000000: /* BGTZ */	if (stitch) BGTZ(br1, 0); else BLEZ(br1, 0); break;
+	case 0x18000000: /* BLEZ */	if (stitch) BLEZ(br1, 0); else BGTZ(br1, 0); break;
 	default:
 		printf("Error opcode=%08x\n", code);
 		exit(1);
@@ -477,12 +611,15 @@ static void emitBxxZ(int andlink, u32 bpc, u32 nbpc)
 	// address. Otherwise, rec_recompile_end_part2() emits direct return jump.
 	rec_recompile_end_part1();  // <BD slot> (if instruction is emitted)
 
-	regClearBranch();  // <BD slot> (if instruction is emitted)
+	regClearBranchTo(rec_exit_dead_regs(branch_pc, bpc));  // <BD slot> (if instruction is emitted)
 
 	// Rarely, the branch delay slot is still empty at this point. Fill if so.
 	if (bd_slot_loc == (uptr)recMem)
 		NOP();  // <BD slot>
 
+	emitTraceHeatCount(branch_pc, target_pc);
+	emitIdleLoopSkip(bpc);
+
 	rec_recompile_end_part2(use_fastpath_return);
 
 	regPopState();
@@ -492,12 +629,16 @@ static void emitBxxZ(int andlink, u32 bpc, u32 nbpc)
 
 	if (dt != 3 && dt != 0)
 		recDelaySlot();
+
+	if (stitch)
+		rec_trace_stitch(target_pc);
 }
 
 /* Used for BEQ and BNE */
 static void emitBxx(u32 bpc)
 {
 	const u32 code = psxRegs.code;
+	const u32 branch_pc = pc - 4;
 #ifdef LOG_BRANCHLOADDELAYS
 	const u32 dt = DelayTest(pc, bpc);
 #endif
@@ -571,12 +712,20 @@ static void emitBxx(u32 bpc)
 
 	recDelaySlot();
 
+	// Is the branch hot when taken? Then the not-taken path is the block
+	//  exit, and the code at the branch target is stitched in after it.
+	const u32 target_pc = bpc;
+	const bool stitch = rec_trace_can_stitch(branch_pc, target_pc);
+	if (stitch)
+		bpc = pc;
+
 	u32* const backpatch = (u32 *)recMem;
 
 	// Check opcode and emit branch with REVERSED logic!
+	//  (Not reversed when stitching: the taken path skips the exit then.)
 	switch (code & 0xfc000000) {
-	case 0x10000000: /* BEQ */	BNE(br1, br2, 0); break;
-	case 0x14000000: /* BNE */	BEQ(br1, br2, 0); break;
+	case 0x10000000: /* BEQ */	if (stitch) BEQ(br1, br2, 0); else BNE(br1, br2, 0); break;
+	case 0x14000000: /* BNE */	if (stitch) BNE(br1, br2, 0); else BEQ(br1, br2, 0); break;
 	default:
 		printf("Error opcode=%08x\n", code);
 		exit(1);
@@ -599,17 +748,23 @@ static void emitBxx(u32 bpc)
 	// address. Otherwise, rec_recompile_end_part2() emits direct return jump.
 	rec_recompile_end_part1();  // <BD slot> (if instruction is emitted)
 
-	regClearBranch();  // <BD slot> (if instruction is emitted)
+	regClearBranchTo(rec_exit_dead_regs(branch_pc, bpc));  // <BD slot> (if instruction is emitted)
 
 	// Rarely, the branch delay slot is still empty at this point. Fill if so.
 	if (bd_slot_loc == (uptr)recMem)
 		NOP();  // <BD slot>
 
+	emitTraceHeatCount(branch_pc, target_pc);
+	emitIdleLoopSkip(bpc);
+
 	rec_recompile_end_part2(use_fastpath_return);
 
 	fixup_branch(backpatch);
 	regUnlock(br1);
 	regUnlock(br2);
+
+	if (stitch)
+		rec_trace_stitch(target_pc);
 }
 
 static void recBLTZ()
@@ -23,12 +23,81 @@
 #define SKIP_MFC2_WRITEBACK
 
 
+/* COP2 function fields that are GTE operations, see recCP2[] */
+#define GTE_OP_FUNCS ( \
+	(1ULL << 0x01) | (1ULL << 0x06) | (1ULL << 0x0c) | (1ULL << 0x10) | \
+	(1ULL << 0x11) | (1ULL << 0x12) | (1ULL << 0x13) | (1ULL << 0x14) | \
+	(1ULL << 0x16) | (1ULL << 0x1b) | (1ULL << 0x1c) | (1ULL << 0x1e) | \
+	(1ULL << 0x20) | (1ULL << 0x28) | (1ULL << 0x29) | (1ULL << 0x2a) | \
+	(1ULL << 0x2d) | (1ULL << 0x2e) | (1ULL << 0x30) | (1ULL << 0x3d) | \
+	(1ULL << 0x3e) | (1ULL << 0x3f) )
+
+/* Maximum number of opcodes gteFlagIsLive() looks ahead */
+#define GTE_FLAG_SCAN_MAX 64
+
+/* Returns false if the GTE FLAG register value produced by the GTE operation
+ *  being recompiled is certain to be overwritten before being read. Scans
+ *  forward through straight-line code from 'pc': FLAG is overwritten by
+ *  another GTE operation (they all clear it first) or a CTC2 to it, and read
+ *  by a CFC2 from it. Branches, jumps, exceptions and anything past the scan
+ *  limit are assumed to read it.
+ */
+static bool gteFlagIsLive()
+{
+	// Next opcode executed after one in a BD slot is not the one at 'pc'
+	if (branch)
+		return true;
+
+	for (int i = 0; i < GTE_FLAG_SCAN_MAX; ++i) {
+		const u32 addr = pc + i*4;
+
+		// Don't scan past end of mapped memory
+		if (!psxMemRLUT[addr >> 16])
+			return true;
+
+		const u32 code = OPCODE_AT(addr);
+		const u32 rs = (code >> 21) & 0x1f;
+		const u32 rd = (code >> 11) & 0x1f;
+
+		switch (code >> 26) {
+		case 0x00: // SPECIAL
+			switch (code & 0x3f) {
+			case 0x08: case 0x09:  // JR, JALR
+			case 0x0c: case 0x0d:  // SYSCALL, BREAK
+				return true;
+			}
+			break;
+
+		case 0x01: case 0x02: case 0x03:  // REGIMM branches, J, JAL
+		case 0x04: case 0x05: case 0x06: case 0x07:  // BEQ, BNE, BLEZ, BGTZ
+		case 0x3b:  // HLE
+			return true;
+
+		case 0x12: // COP2
+			if ((code & 0x3f) != 0) {
+				if (GTE_OP_FUNCS & (1ULL << (code & 0x3f)))
+					return false;
+			} else if (rd == 31) {
+				if (rs == 2) return true;   // CFC2 from FLAG
+				if (rs == 6) return false;  // CTC2 to FLAG
+			}
+			break;
+		}
+	}
+
+	return true;
+}
+
 /* Emit code to call a GTE func that takes no arguments */
 #define CP2_FUNC_0(f) \
 extern void gte##f(); \
+extern void gte##f##_nf(); \
 void rec##f() \
 { \
-	JAL(gte##f); \
+	if (gteFlagIsLive()) \
+		JAL(gte##f); \
+	else \
+		JAL(gte##f##_nf); \
 	NOP(); /* <BD slot> */ \
 }
 
@@ -38,9 +107,13 @@ void rec##f() \
  */
 #define CP2_FUNC_1(f) \
 extern void gte##f(u32 gteop); \
+extern void gte##f##_nf(u32 gteop); \
 void rec##f() \
 { \
-	JAL(gte##f); \
+	if (gteFlagIsLive()) \
+		JAL(gte##f); \
+	else \
+		JAL(gte##f##_nf); \
 	LI16(MIPSREG_A0, (u16)(psxRegs.code >> 10)); /* <BD slot> */ \
 }
 
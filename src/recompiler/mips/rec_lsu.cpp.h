@@ -281,7 +281,12 @@ static u32 emitAddressConversion(const u32 op_rs,
 }
 
 
-/* Emit no code invalidations for PSX base reg 'op_rs'? */
+/* Emit no code invalidations for PSX base reg 'op_rs'?
+ * NOTE: Write-protecting host pages of PSX RAM that hold code, and
+ *  invalidating from a SIGSEGV handler instead, was tried and removed: it
+ *  could not be run on a MIPS target or qemu-mipsel, and MDEC worker
+ *  threads write PSX RAM while recClear() is unsynchronized.
+ */
 static inline bool LSU_skip_code_invalidation(const u32 op_rs)
 {
 	// For certain games that do Icache trickery, we use a workaround that
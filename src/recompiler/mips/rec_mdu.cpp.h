@@ -36,6 +36,25 @@
 
 static bool convertMultiplyTo3Op();
 
+/* LO/HI are cached by the reg allocator like GPRs. These set LO/HI
+ *  ('mdureg' is REG_LO or REG_HI) to host reg 'src', or to const 'val'.
+ */
+static void emitWriteMDU(u32 mdureg, u32 src)
+{
+	u32 dst = regMipsToHost(mdureg, REG_FIND, REG_REGISTER);
+	MOV(dst, src);
+	regMipsChanged(mdureg);
+	regUnlock(dst);
+}
+
+static void emitWriteMDUConst(u32 mdureg, u32 val)
+{
+	u32 dst = regMipsToHost(mdureg, REG_FIND, REG_REGISTER);
+	LI32(dst, val);
+	regMipsChanged(mdureg);
+	regUnlock(dst);
+}
+
 
 static void recMULT()
 {
@@ -82,10 +101,10 @@ static void recMULT()
 				work_reg = TEMP_1;
 			}
 
-			SW(work_reg, PERM_REG_1, offGPR(32)); // LO
+			emitWriteMDU(REG_LO, work_reg);
 			// Upper word is all 0s or 1s depending on sign of LO result
 			SRA(TEMP_1, work_reg, 31);
-			SW(TEMP_1, PERM_REG_1, offGPR(33));   // HI
+			emitWriteMDU(REG_HI, TEMP_1);
 
 			regUnlock(ident_reg);
 
@@ -114,10 +133,10 @@ static void recMULT()
 				}
 
 				SLL(TEMP_1, work_reg, shift_amt);
-				SW(TEMP_1, PERM_REG_1, offGPR(32)); // LO
+				emitWriteMDU(REG_LO, TEMP_1);
 				// Sign-extend here when computing upper word of result
 				SRA(TEMP_1, work_reg, (32 - shift_amt));
-				SW(TEMP_1, PERM_REG_1, offGPR(33)); // HI
+				emitWriteMDU(REG_HI, TEMP_1);
 
 				regUnlock(npot_reg);
 
@@ -127,19 +146,8 @@ static void recMULT()
 		}
 
 		if (const_res) {
-			if (lo_res) {
-				LI32(TEMP_1, (u32)lo_res);
-				SW(TEMP_1, PERM_REG_1, offGPR(32)); // LO
-			} else {
-				SW(0, PERM_REG_1, offGPR(32)); // LO
-			}
-
-			if (hi_res) {
-				LI32(TEMP_1, (u32)hi_res);
-				SW(TEMP_1, PERM_REG_1, offGPR(33)); // HI
-			} else {
-				SW(0, PERM_REG_1, offGPR(33)); // HI
-			}
+			emitWriteMDUConst(REG_LO, (u32)lo_res);
+			emitWriteMDUConst(REG_HI, (u32)hi_res);
 
 			// We're done
 			return;
@@ -159,15 +167,19 @@ static void recMULT()
 
 	u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER);
 	u32 rt = regMipsToHost(_Rt_, REG_LOAD, REG_REGISTER);
+	u32 lo = regMipsToHost(REG_LO, REG_FIND, REG_REGISTER);
+	u32 hi = regMipsToHost(REG_HI, REG_FIND, REG_REGISTER);
 
 	MULT(rs, rt);
-	MFLO(TEMP_1);
-	MFHI(TEMP_2);
-	SW(TEMP_1, PERM_REG_1, offGPR(32)); // LO
-	SW(TEMP_2, PERM_REG_1, offGPR(33)); // HI
+	MFLO(lo);
+	MFHI(hi);
+	regMipsChanged(REG_LO);
+	regMipsChanged(REG_HI);
 
 	regUnlock(rs);
 	regUnlock(rt);
+	regUnlock(lo);
+	regUnlock(hi);
 }
 
 
@@ -206,8 +218,8 @@ static void recMULTU()
 			u32 ident_reg_psx = rs_const ? _Rt_ : _Rs_;
 			u32 ident_reg = regMipsToHost(ident_reg_psx, REG_LOAD, REG_REGISTER);
 
-			SW(0, PERM_REG_1, offGPR(33));         // HI
-			SW(ident_reg, PERM_REG_1, offGPR(32)); // LO
+			emitWriteMDU(REG_HI, 0);
+			emitWriteMDU(REG_LO, ident_reg);
 
 			regUnlock(ident_reg);
 
@@ -229,9 +241,9 @@ static void recMULTU()
 				u32 shift_amt = __builtin_ctz(pot_val);
 
 				SLL(TEMP_1, npot_reg, shift_amt);
-				SW(TEMP_1, PERM_REG_1, offGPR(32)); // LO
+				emitWriteMDU(REG_LO, TEMP_1);
 				SRL(TEMP_1, npot_reg, (32 - shift_amt));
-				SW(TEMP_1, PERM_REG_1, offGPR(33)); // HI
+				emitWriteMDU(REG_HI, TEMP_1);
 
 				regUnlock(npot_reg);
 
@@ -241,19 +253,8 @@ static void recMULTU()
 		}
 
 		if (const_res) {
-			if (lo_res) {
-				LI32(TEMP_1, lo_res);
-				SW(TEMP_1, PERM_REG_1, offGPR(32)); // LO
-			} else {
-				SW(0, PERM_REG_1, offGPR(32)); // LO
-			}
-
-			if (hi_res) {
-				LI32(TEMP_1, hi_res);
-				SW(TEMP_1, PERM_REG_1, offGPR(33)); // HI
-			} else {
-				SW(0, PERM_REG_1, offGPR(33)); // HI
-			}
+			emitWriteMDUConst(REG_LO, lo_res);
+			emitWriteMDUConst(REG_HI, hi_res);
 
 			// We're done
 			return;
@@ -273,15 +274,19 @@ static void recMULTU()
 
 	u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER);
 	u32 rt = regMipsToHost(_Rt_, REG_LOAD, REG_REGISTER);
+	u32 lo = regMipsToHost(REG_LO, REG_FIND, REG_REGISTER);
+	u32 hi = regMipsToHost(REG_HI, REG_FIND, REG_REGISTER);
 
 	MULTU(rs, rt);
-	MFLO(TEMP_1);
-	MFHI(TEMP_2);
-	SW(TEMP_1, PERM_REG_1, offGPR(32)); // LO
-	SW(TEMP_2, PERM_REG_1, offGPR(33)); // HI
+	MFLO(lo);
+	MFHI(hi);
+	regMipsChanged(REG_LO);
+	regMipsChanged(REG_HI);
 
 	regUnlock(rs);
 	regUnlock(rt);
+	regUnlock(lo);
+	regUnlock(hi);
 }
 
 
@@ -310,8 +315,8 @@ static void recDIV()
 			ADDIU(TEMP_2, 0, -1);
 			SLT(TEMP_1, rs, 0);           // TEMP_1 = dividend < 0
 			MOVN(TEMP_1, TEMP_2, TEMP_1); // if (TEMP_1 != 0) TEMP_1 = TEMP_2
-			SW(TEMP_1, PERM_REG_1, offGPR(32)); // LO
-			SW(rs, PERM_REG_1, offGPR(33));     // HI
+			emitWriteMDU(REG_LO, TEMP_1);
+			emitWriteMDU(REG_HI, rs);
 
 			regUnlock(rs);
 
@@ -321,8 +326,8 @@ static void recDIV()
 			// If divisor is const-val '1', result is identity
 			u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER);
 
-			SW(0, PERM_REG_1, offGPR(33));  // HI
-			SW(rs, PERM_REG_1, offGPR(32)); // LO
+			emitWriteMDU(REG_HI, 0);
+			emitWriteMDU(REG_LO, rs);
 
 			regUnlock(rs);
 
@@ -333,19 +338,8 @@ static void recDIV()
 			u32 lo_res = rs_val / rt_val;
 			u32 hi_res = rs_val % rt_val;
 
-			if (lo_res) {
-				LI32(TEMP_1, lo_res);
-				SW(TEMP_1, PERM_REG_1, offGPR(32)); // LO
-			} else {
-				SW(0, PERM_REG_1, offGPR(32)); // LO
-			}
-
-			if (hi_res) {
-				LI32(TEMP_1, hi_res);
-				SW(TEMP_1, PERM_REG_1, offGPR(33)); // HI
-			} else {
-				SW(0, PERM_REG_1, offGPR(33)); // HI
-			}
+			emitWriteMDUConst(REG_LO, lo_res);
+			emitWriteMDUConst(REG_HI, hi_res);
 
 			// We're done
 			return;
@@ -369,7 +363,7 @@ static void recDIV()
 				}
 
 				SRA(TEMP_1, work_reg, shift_amt);
-				SW(TEMP_1, PERM_REG_1, offGPR(32)); // LO
+				emitWriteMDU(REG_LO, TEMP_1);
 
 				// Subtract one from pot divisor to get remainder modulo mask
 				if ((pot_val-1) > 0xffff) {
@@ -378,7 +372,7 @@ static void recDIV()
 				} else {
 					ANDI(TEMP_1, rs, (pot_val-1));
 				}
-				SW(TEMP_1, PERM_REG_1, offGPR(33)); // HI
+				emitWriteMDU(REG_HI, TEMP_1);
 
 				regUnlock(rs);
 
@@ -393,6 +387,8 @@ static void recDIV()
 
 	u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER);
 	u32 rt = regMipsToHost(_Rt_, REG_LOAD, REG_REGISTER);
+	u32 lo = regMipsToHost(REG_LO, REG_FIND, REG_REGISTER);
+	u32 hi = regMipsToHost(REG_HI, REG_FIND, REG_REGISTER);
 
 	// Test if divisor is 0, emulating correct results for PS1 CPU.
 	// NOTE: we don't bother checking for signed division overflow (the
@@ -427,31 +423,33 @@ static void recDIV()
 
 	if (omit_div_by_zero_fixup) {
 		DIV(rs, rt);
-		MFLO(TEMP_1);              // NOTE: Hi/Lo can't be cached for now, so spill them
-		MFHI(TEMP_2);
+		MFLO(lo);
+		MFHI(hi);
 	} else {
 		DIV(rs, rt);
 		ADDIU(MIPSREG_A1, 0, -1);
 		SLT(TEMP_3, rs, 0);        // TEMP_3 = (rs < 0 ? 1 : 0)
-		MFLO(TEMP_1);              // NOTE: Hi/Lo can't be cached for now, so spill them
-		MFHI(TEMP_2);
+		MFLO(lo);
+		MFHI(hi);
 
 		// If divisor was 0, set LO result (quotient) to 1 if dividend was < 0
 		// If divisor was 0, set LO result (quotient) to -1 if dividend was >= 0
 		MOVN(MIPSREG_A0, TEMP_3, TEMP_3);      // if (TEMP_3 != 0) then MIPSREG_A1 = TEMP_3
 		MOVZ(MIPSREG_A0, MIPSREG_A1, TEMP_3);  // if (TEMP_3 == 0) then MIPSREG_A1 = MIPSREG_A0
-		MOVZ(TEMP_1, MIPSREG_A0, rt);          // if (rt == 0) then TEMP_1 = MIPSREG_A0
+		MOVZ(lo, MIPSREG_A0, rt);              // if (rt == 0) then lo = MIPSREG_A0
 
 #ifndef OMIT_DIV_BY_ZERO_HI_FIXUP
 		// If divisor was 0, set HI result (remainder) to rs
-		MOVZ(TEMP_2, rs, rt);
+		MOVZ(hi, rs, rt);
 #endif
 	}
 
-	SW(TEMP_1, PERM_REG_1, offGPR(32));
-	SW(TEMP_2, PERM_REG_1, offGPR(33));
+	regMipsChanged(REG_LO);
+	regMipsChanged(REG_HI);
 	regUnlock(rs);
 	regUnlock(rt);
+	regUnlock(lo);
+	regUnlock(hi);
 }
 
 
@@ -478,8 +476,8 @@ static void recDIVU()
 			u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER);
 
 			ADDIU(TEMP_1, 0, -1);
-			SW(TEMP_1, PERM_REG_1, offGPR(32)); // LO
-			SW(rs, PERM_REG_1, offGPR(33));     // HI
+			emitWriteMDU(REG_LO, TEMP_1);
+			emitWriteMDU(REG_HI, rs);
 
 			regUnlock(rs);
 
@@ -489,8 +487,8 @@ static void recDIVU()
 			// If divisor is const-val '1', result is identity
 			u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER);
 
-			SW(0, PERM_REG_1, offGPR(33));  // HI
-			SW(rs, PERM_REG_1, offGPR(32)); // LO
+			emitWriteMDU(REG_HI, 0);
+			emitWriteMDU(REG_LO, rs);
 
 			regUnlock(rs);
 
@@ -501,19 +499,8 @@ static void recDIVU()
 			u32 lo_res = rs_val / rt_val;
 			u32 hi_res = rs_val % rt_val;
 
-			if (lo_res) {
-				LI32(TEMP_1, lo_res);
-				SW(TEMP_1, PERM_REG_1, offGPR(32)); // LO
-			} else {
-				SW(0, PERM_REG_1, offGPR(32)); // LO
-			}
-
-			if (hi_res) {
-				LI32(TEMP_1, hi_res);
-				SW(TEMP_1, PERM_REG_1, offGPR(33)); // HI
-			} else {
-				SW(0, PERM_REG_1, offGPR(33)); // HI
-			}
+			emitWriteMDUConst(REG_LO, lo_res);
+			emitWriteMDUConst(REG_HI, hi_res);
 
 			// We're done
 			return;
@@ -529,7 +516,7 @@ static void recDIVU()
 				u32 shift_amt = __builtin_ctz(pot_val);
 
 				SRL(TEMP_1, rs, shift_amt);
-				SW(TEMP_1, PERM_REG_1, offGPR(32)); // LO
+				emitWriteMDU(REG_LO, TEMP_1);
 
 				// Subtract one from pot divisor to get remainder modulo mask
 				if ((pot_val-1) > 0xffff) {
@@ -538,7 +525,7 @@ static void recDIVU()
 				} else {
 					ANDI(TEMP_1, rs, (pot_val-1));
 				}
-				SW(TEMP_1, PERM_REG_1, offGPR(33)); // HI
+				emitWriteMDU(REG_HI, TEMP_1);
 
 				regUnlock(rs);
 
@@ -553,6 +540,8 @@ static void recDIVU()
 
 	u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER);
 	u32 rt = regMipsToHost(_Rt_, REG_LOAD, REG_REGISTER);
+	u32 lo = regMipsToHost(REG_LO, REG_FIND, REG_REGISTER);
+	u32 hi = regMipsToHost(REG_HI, REG_FIND, REG_REGISTER);
 
 	// Test if divisor is 0, emulating correct results for PS1 CPU.
 	//  Rs              Rt       Hi/Remainder  Lo/Result
@@ -574,27 +563,29 @@ static void recDIVU()
 
 	if (omit_div_by_zero_fixup) {
 		DIVU(rs, rt);
-		MFLO(TEMP_1);              // NOTE: Hi/Lo can't be cached for now, so spill them
-		MFHI(TEMP_2);
+		MFLO(lo);
+		MFHI(hi);
 	} else {
 		DIVU(rs, rt);
 		ADDIU(TEMP_3, 0, -1);
-		MFLO(TEMP_1);              // NOTE: Hi/Lo can't be cached for now, so spill them
-		MFHI(TEMP_2);
+		MFLO(lo);
+		MFHI(hi);
 
 		// If divisor was 0, set LO result (quotient) to 0xffff_ffff
-		MOVZ(TEMP_1, TEMP_3, rt);  // if (rt == 0) then TEMP_1 = TEMP_3
+		MOVZ(lo, TEMP_3, rt);      // if (rt == 0) then lo = TEMP_3
 
 #ifndef OMIT_DIV_BY_ZERO_HI_FIXUP
 		// If divisor was 0, set HI result (remainder) to rs
-		MOVZ(TEMP_2, rs, rt);
+		MOVZ(hi, rs, rt);
 #endif
 	}
 
-	SW(TEMP_1, PERM_REG_1, offGPR(32));
-	SW(TEMP_2, PERM_REG_1, offGPR(33));
+	regMipsChanged(REG_LO);
+	regMipsChanged(REG_HI);
 	regUnlock(rs);
 	regUnlock(rt);
+	regUnlock(lo);
+	regUnlock(hi);
 }
 
 static void recMFHI()
@@ -602,18 +593,20 @@ static void recMFHI()
 // Rd = Hi
 	if (!_Rd_) return;
 	SetUndef(_Rd_);
+	u32 hi = regMipsToHost(REG_HI, REG_LOAD, REG_REGISTER);
 	u32 rd = regMipsToHost(_Rd_, REG_FIND, REG_REGISTER);
 
-	LW(rd, PERM_REG_1, offGPR(33));
+	MOV(rd, hi);
 	regMipsChanged(_Rd_);
 	regUnlock(rd);
+	regUnlock(hi);
 }
 
 static void recMTHI()
 {
 // Hi = Rs
 	u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER);
-	SW(rs, PERM_REG_1, offGPR(33));
+	emitWriteMDU(REG_HI, rs);
 	regUnlock(rs);
 }
 
@@ -634,11 +627,13 @@ static void recMFLO()
 	if (!_Rd_) return;
 
 	SetUndef(_Rd_);
+	u32 lo = regMipsToHost(REG_LO, REG_LOAD, REG_REGISTER);
 	u32 rd = regMipsToHost(_Rd_, REG_FIND, REG_REGISTER);
 
-	LW(rd, PERM_REG_1, offGPR(32));
+	MOV(rd, lo);
 	regMipsChanged(_Rd_);
 	regUnlock(rd);
+	regUnlock(lo);
 }
 
 
@@ -646,7 +641,7 @@ static void recMTLO()
 {
 // Lo = Rs
 	u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER);
-	SW(rs, PERM_REG_1, offGPR(32));
+	emitWriteMDU(REG_LO, rs);
 	regUnlock(rs);
 }
 
@@ -1101,7 +1096,7 @@ static bool convertMultiplyTo3Op()
 	//  the result. Other blocks might start at or before the MFLO instruction
 	//  in the original code.
 	if (branch) {
-		SW(rd, PERM_REG_1, offGPR(32)); // LO
+		emitWriteMDU(REG_LO, rd);
 	}
 
 	SetUndef(rd_of_mflo);
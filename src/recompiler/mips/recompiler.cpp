@@ -27,6 +27,7 @@
 
 #include <stddef.h>
 #include "plugin_lib.h"
+#include "perfmon.h"
 #include "psxcommon.h"
 #include "psxhle.h"
 #include "psxmem.h"
@@ -57,6 +58,28 @@
 /* Scan for and skip useless code in PS1 executable: */
 #define USE_CODE_DISCARD
 
+/* Detect loops polling memory for a change, i.e. waiting for an interrupt,
+ *  and advance the cycle counter to the next event when they loop, instead
+ *  of spinning there. See rec_idle_loop_scan().
+ * Off until it has been run on a MIPS target (uncomment next line to enable)
+ */
+//#define USE_IDLE_LOOP_SKIP
+
+/* Count how often each jump and branch exit of a block is taken. Once one
+ *  is hot, recompile the block with the code at the exit's target stitched
+ *  in, keeping PS1 regs in host regs instead of returning to the dispatch
+ *  loop there. See rec_trace_can_stitch().
+ * Off until it has been run on a MIPS target (uncomment next line to enable)
+ */
+//#define USE_SUPERBLOCKS
+
+/* At block exits that loop back into code already recompiled in the block,
+ *  don't spill regs the code there overwrites before reading them. See
+ *  rec_scan_for_dead_regs().
+ * Off until it has been run on a MIPS target (uncomment next line to enable)
+ */
+//#define USE_DEAD_REG_EXITS
+
 /* If HLE emulated BIOS is not in use, blocks return to dispatch loop directly */
 #define USE_DIRECT_BLOCK_RETURN_JUMPS
 
@@ -113,6 +136,9 @@
 //#define WITH_DISASM
 //#define DEBUGG printf
 
+/* Profiling build, see rec_prof_report() (uncomment next line to enable) */
+//#define WITH_PROFILE
+
 #include "mem_mapping.h"
 
 /* Bit vector indicating which PS1 RAM pages contain the start of blocks.
@@ -198,13 +224,35 @@ static inline bool IsFuzzyScratchpadAddr(const u32 reg)  { return iRegs[reg].is_
  *  code *far* too high in virtual address space.
  */
 #define RECMEM_SIZE         (12 * 1024 * 1024)
-#define RECMEM_SIZE_MAX     (RECMEM_SIZE-(512*1024))
 static u8 recMemBase[RECMEM_SIZE] __attribute__((aligned(4)));
 
+/* The code cache is used as a ring of REC_SEG_COUNT segments. When emitted
+ *  code reaches the end of the free space, only the segment holding the
+ *  oldest code is evicted, not the whole cache: the block ptrs of blocks
+ *  starting in it are cleared, using the PCs each segment keeps for its
+ *  blocks. Blocks never jump into other blocks, they always return to a
+ *  dispatch loop, so nothing else can point into an evicted segment.
+ *  A block can run past the end of the segment it starts in, so
+ *  REC_BLOCK_SIZE_MAX bytes are kept free ahead of each new block.
+ */
+#define REC_SEG_COUNT       16
+#define REC_SEG_SIZE        (RECMEM_SIZE / REC_SEG_COUNT)
+#define REC_BLOCK_SIZE_MAX  (512 * 1024)
+
+typedef struct {
+	u32 *block_pcs;                /* Start PCs of blocks in this segment */
+	int  num_blocks;
+	int  max_blocks;
+} rec_seg_t;
+static rec_seg_t rec_segs[REC_SEG_COUNT];
+static u8 *rec_free_end;           /* Code cache from recMem up to here is free */
+
 u32        *recMem;                /* Where does next emitted opcode in block go? */
 static u32 *recMemStart;           /* Where did first emitted opcode in block go? */
 static u32 pc;                     /* Recompiler pc */
 static u32 oldpc;                  /* Recompiler pc at start of block */
+static u32 block_part_pc;          /* Recompiler pc at start of current part of a superblock */
+static u32 block_part_insns;       /* Instructions in the superblock's earlier parts */
 u32 cycle_multiplier = 0x200;      /* Cycle advance per emulated instruction
                                       Default is 0x200 == 2.00 (24.8 fixed-pt) */
 
@@ -222,6 +270,12 @@ static bool end_block;                     /* Has recompilation phase ended? */
 static bool skip_emitting_next_mflo;       /* Was a MULT/MULTU converted to 3-op MUL? See rec_mdu.cpp.h */
 static bool emit_code_invalidations;       /* Emit code invalidation for store instructions? */
 static bool flush_code_on_dma3_exe_load;   /* Flush code cache when psxDma3() detects EXE load? */
+static bool skip_idle_loops;               /* Skip ahead to next event in idle loops? */
+static bool block_is_idle_loop;            /* Block is an idle loop? See rec_idle_loop_scan() */
+static int  idle_loop_num_guards;          /* Regs the idle loop's load addresses depend on, */
+static u32  idle_loop_guard_regs[2];       /*  and their values when block was recompiled */
+static u32  idle_loop_guard_vals[2];
+static bool form_superblocks;              /* Stitch hot exits into blocks? See rec_trace_can_stitch() */
 
 /* Flags/vals used to cache common values in temp regs in emitted code */
 static bool lsu_tmp_cache_valid;           /* LSU vals are cached in $at,$v1. See rec_lsu.cpp.h */
@@ -230,6 +284,15 @@ static u32  host_v0_reg_constval;
 static bool host_ra_reg_has_block_retaddr; /* Indirect-return address is cached in $ra. */
 
 
+/* Instructions in block so far, for its cycle count. A superblock's parts
+ *  are not contiguous, so this can't just be pc-oldpc.
+ */
+static inline u32 rec_block_insns()
+{
+	return block_part_insns + (pc - block_part_pc)/4;
+}
+
+
 #ifdef WITH_DISASM
 char	disasm_buffer[512];
 #endif
@@ -240,6 +303,7 @@ static void recReset();
 static void recRecompile();
 static void recClear(u32 Addr, u32 Size);
 static void recNotify(int note, void *data);
+static void emitTraceGuard(u32 target_pc);
 
 extern void (*recBSC[64])();
 extern void (*recSPC[64])();
@@ -371,6 +435,423 @@ do { \
 
 #endif
 
+#ifdef WITH_PROFILE
+
+/* Profiling build: blocks count their own entries and returns to the
+ *  dispatch loop, recompilation counts code size and recompiles per PC, and
+ *  recClear() counts invalidations. The report, sorted by entries times
+ *  host instructions, is written to REC_PROFILE_FILE by recShutdown() or
+ *  at exit, with disassembly of the top blocks.
+ * Counters are 32-bit and incremented by emitted code, so a block entered
+ *  more than 4G times wraps. Blocks past REC_PROFILE_MAX_BLOCKS PCs aren't
+ *  tracked.
+ */
+#define REC_PROFILE_FILE        "mipsrec_profile.txt"
+#define REC_PROFILE_MAX_BLOCKS  (1 << 16)  /* Must be power of two */
+#define REC_PROFILE_TOP_BLOCKS  100        /* Blocks listed in report */
+#define REC_PROFILE_DISASM      20         /* Blocks disassembled in report */
+
+typedef struct {
+	u32 pc;
+	u32 entries;                   /* These three are incremented by */
+	u32 returns;                   /*  emitted code. Returns are to the */
+	u32 fastpath_returns;          /*  dispatch loop's lookup or fastpath */
+	u32 compiles;                  /* Zero if table slot is unused */
+	u32 guest_insns;               /* Size of last compile */
+	u32 host_bytes;
+	u32 host_code;                 /* Address of last compile */
+} rec_prof_block_t;
+
+static rec_prof_block_t rec_prof_blocks[REC_PROFILE_MAX_BLOCKS];
+static rec_prof_block_t *rec_prof_cur;  /* Block being recompiled, or NULL */
+
+static struct {
+	u32 num_blocks;
+	u32 untracked_compiles;
+	u64 compiles;
+	u64 guest_insns;
+	u64 host_bytes;
+	u64 clear_calls;
+	u64 clear_calls_with_code;
+	u64 clear_blocks;
+	bool reported;
+} rec_prof;
+static bool rec_prof_atexit_registered;
+
+static rec_prof_block_t *rec_prof_lookup(u32 pc)
+{
+	u32 i = ((pc >> 2) * 2654435761u) >> 16;
+
+	for (u32 n = 0; n < REC_PROFILE_MAX_BLOCKS; n++, i++) {
+		rec_prof_block_t *b = &rec_prof_blocks[i & (REC_PROFILE_MAX_BLOCKS-1)];
+		if (b->compiles == 0) {
+			if (rec_prof.num_blocks >= REC_PROFILE_MAX_BLOCKS/2)
+				return NULL;  // Keep probe sequences short
+			rec_prof.num_blocks++;
+			b->pc = pc;
+			return b;
+		}
+		if (b->pc == pc)
+			return b;
+	}
+	return NULL;
+}
+
+/* Emit code incrementing 32-bit 'counter' */
+static void rec_prof_emit_count(u32 *counter)
+{
+	LUI(TEMP_0, ADR_HI(counter));
+	LW(TEMP_1, TEMP_0, ADR_LO(counter));
+	ADDIU(TEMP_1, TEMP_1, 1);
+	SW(TEMP_1, TEMP_0, ADR_LO(counter));
+}
+
+static void rec_prof_block_start(u32 block_pc)
+{
+	rec_prof_cur = rec_prof_lookup(block_pc);
+	if (!rec_prof_cur) {
+		rec_prof.untracked_compiles++;
+		return;
+	}
+	rec_prof_cur->compiles++;
+	rec_prof_emit_count(&rec_prof_cur->entries);
+}
+
+static void rec_prof_block_end(u32 guest_insns)
+{
+	u32 host_bytes = (u32)recMem - (u32)recMemStart;
+
+	rec_prof.compiles++;
+	rec_prof.guest_insns += guest_insns;
+	rec_prof.host_bytes += host_bytes;
+
+	if (rec_prof_cur) {
+		rec_prof_cur->guest_insns = guest_insns;
+		rec_prof_cur->host_bytes = host_bytes;
+		rec_prof_cur->host_code = (u32)recMemStart;
+	}
+}
+
+static void rec_prof_block_return(bool fastpath)
+{
+	if (rec_prof_cur)
+		rec_prof_emit_count(fastpath ? &rec_prof_cur->fastpath_returns :
+		                               &rec_prof_cur->returns);
+}
+
+/* Count block ptrs recClear() is about to zero */
+static void rec_prof_clear(const u32 *ptrs, u32 count, bool has_code)
+{
+	rec_prof.clear_calls++;
+	if (!has_code)
+		return;
+	rec_prof.clear_calls_with_code++;
+	for (u32 i = 0; i < count; i++)
+		if (ptrs[i])
+			rec_prof.clear_blocks++;
+}
+
+/* Estimated host instructions executed by a block */
+static u64 rec_prof_cost(const rec_prof_block_t *b)
+{
+	return (u64)b->entries * (b->host_bytes / 4);
+}
+
+static int rec_prof_compare(const void *a, const void *b)
+{
+	u64 cost_a = rec_prof_cost(*(const rec_prof_block_t **)a);
+	u64 cost_b = rec_prof_cost(*(const rec_prof_block_t **)b);
+	return (cost_a < cost_b) - (cost_a > cost_b);
+}
+
+static void rec_prof_disasm_block(FILE *f, const rec_prof_block_t *b)
+{
+	char buf[512];
+
+	fprintf(f, "\nBlock PC %08x: %u entries, %u guest insns, %u host bytes\n",
+	        b->pc, b->entries, b->guest_insns, b->host_bytes);
+
+	// Guest code is what is in PS1 RAM now, it may have changed since
+	if (psxMemRLUT[b->pc >> 16]) {
+		for (u32 i = 0; i < b->guest_insns; i++) {
+			u32 pc = b->pc + i * 4;
+			u32 opcode = OPCODE_AT(pc);
+			disasm_mips_instruction(opcode, buf, pc, 0, 0);
+			fprintf(f, "  %08x: %08x %s\n", pc, opcode, buf);
+		}
+	}
+
+	// Host code is only shown if the block is still current
+	if (PC_REC32(b->pc) != b->host_code) {
+		fprintf(f, " (host code invalidated or evicted)\n");
+		return;
+	}
+	fprintf(f, " ->\n");
+	for (u32 i = 0; i < b->host_bytes / 4; i++) {
+		u32 addr = b->host_code + i * 4;
+		u32 opcode = *(u32*)addr;
+		disasm_mips_instruction(opcode, buf, addr, 0, 0);
+		fprintf(f, "  %08x: %s\t(0x%08x)\n", addr, buf, opcode);
+	}
+}
+
+static void rec_prof_report()
+{
+	if (rec_prof.reported || rec_prof.compiles == 0)
+		return;
+	rec_prof.reported = true;
+
+	FILE *f = fopen(REC_PROFILE_FILE, "w");
+	if (!f) {
+		REC_LOG("Error writing profile %s\n", REC_PROFILE_FILE);
+		return;
+	}
+
+	rec_prof_block_t **sorted = (rec_prof_block_t **)
+		malloc(rec_prof.num_blocks * sizeof(rec_prof_block_t *));
+	u32 n = 0;
+	u64 entries = 0, returns = 0, fastpath_returns = 0, cost = 0;
+	for (u32 i = 0; i < REC_PROFILE_MAX_BLOCKS; i++) {
+		rec_prof_block_t *b = &rec_prof_blocks[i];
+		if (b->compiles == 0)
+			continue;
+		entries += b->entries;
+		returns += b->returns;
+		fastpath_returns += b->fastpath_returns;
+		cost += rec_prof_cost(b);
+		if (sorted)
+			sorted[n++] = b;
+	}
+
+	fprintf(f, "mipsrec profile\n\n");
+	fprintf(f, "Blocks:              %u PCs, %llu compiles (%u untracked)\n",
+	        rec_prof.num_blocks, (unsigned long long)rec_prof.compiles,
+	        rec_prof.untracked_compiles);
+	fprintf(f, "Code size:           %llu guest insns -> %llu host bytes, %.2f host insns/guest insn\n",
+	        (unsigned long long)rec_prof.guest_insns, (unsigned long long)rec_prof.host_bytes,
+	        rec_prof.guest_insns ? (double)rec_prof.host_bytes / 4 / rec_prof.guest_insns : 0.0);
+	fprintf(f, "Block entries:       %llu\n", (unsigned long long)entries);
+	fprintf(f, "Dispatch returns:    %llu (%llu fastpath)\n",
+	        (unsigned long long)(returns + fastpath_returns),
+	        (unsigned long long)fastpath_returns);
+	fprintf(f, "recClear():          %llu calls, %llu on pages with code, %llu block ptrs cleared\n",
+	        (unsigned long long)rec_prof.clear_calls,
+	        (unsigned long long)rec_prof.clear_calls_with_code,
+	        (unsigned long long)rec_prof.clear_blocks);
+
+	if (sorted) {
+		qsort(sorted, n, sizeof(sorted[0]), rec_prof_compare);
+
+		fprintf(f, "\nTop blocks by entries * host insns:\n");
+		fprintf(f, "  %-8s %11s %9s %8s %6s %6s %6s %6s\n", "pc", "entries",
+		        "fastpath", "compiles", "guest", "host", "ratio", "cost%");
+		for (u32 i = 0; i < n && i < REC_PROFILE_TOP_BLOCKS; i++) {
+			const rec_prof_block_t *b = sorted[i];
+			fprintf(f, "  %08x %11u %9u %8u %6u %6u %6.2f %6.2f\n", b->pc,
+			        b->entries, b->fastpath_returns, b->compiles,
+			        b->guest_insns, b->host_bytes / 4,
+			        b->guest_insns ? (double)b->host_bytes / 4 / b->guest_insns : 0.0,
+			        cost ? 100.0 * rec_prof_cost(b) / cost : 0.0);
+		}
+
+		for (u32 i = 0; i < n && i < REC_PROFILE_DISASM; i++)
+			rec_prof_disasm_block(f, sorted[i]);
+
+		free(sorted);
+	}
+
+	fclose(f);
+	REC_LOG("Wrote profile %s\n", REC_PROFILE_FILE);
+}
+
+/* Start a new profile, i.e. after a previous one was reported */
+static void rec_prof_init()
+{
+	if (rec_prof.reported) {
+		memset(rec_prof_blocks, 0, sizeof(rec_prof_blocks));
+		memset(&rec_prof, 0, sizeof(rec_prof));
+	}
+	// Headless benchmark runs end with exit(), without a shutdown
+	if (!rec_prof_atexit_registered)
+		rec_prof_atexit_registered = (atexit(rec_prof_report) == 0);
+}
+
+#define PROFILE_INIT()                  rec_prof_init()
+#define PROFILE_BLOCK_START()           rec_prof_block_start(oldpc)
+#define PROFILE_BLOCK_END()             rec_prof_block_end(rec_block_insns())
+#define PROFILE_BLOCK_RETURN(_FAST_)    rec_prof_block_return(_FAST_)
+#define PROFILE_CLEAR(_PTRS_, _N_, _HAS_CODE_) \
+	rec_prof_clear((const u32 *)(_PTRS_), (_N_), (_HAS_CODE_))
+#define PROFILE_REPORT()                rec_prof_report()
+
+#else
+
+#define PROFILE_INIT()
+#define PROFILE_BLOCK_START()
+#define PROFILE_BLOCK_END()
+#define PROFILE_BLOCK_RETURN(_FAST_)
+#define PROFILE_CLEAR(_PTRS_, _N_, _HAS_CODE_)
+#define PROFILE_REPORT()
+
+#endif
+
+
+/* Superblocks: emitted code counts, in trace_heat[], how often each jump or
+ *  branch exit is taken. When an exit becomes hot, its block's ptr is
+ *  cleared, so the block is recompiled on its next entry. That time, the
+ *  code at the exit's target is recompiled inline as the next part of the
+ *  block, with no regClearJump() spill and no return to the dispatch loop.
+ *  Conditional branches that are hot when taken get their not-taken path
+ *  as the side exit instead.
+ *  Stores and recClear() only clear the ptr of the block starting at the
+ *  address written, like for any block. So parts are only stitched in when
+ *  their own block's ptr is set, and each part starts with a check that it
+ *  still is (see emitTraceGuard()); if not, the superblock exits there.
+ *  Recompiling a block then invalidates the superblocks it was stitched
+ *  into, see rec_trace_block_recompiled().
+ */
+#define REC_TRACE_HEAT        64     /* Exit is hot when taken this many times */
+#define REC_TRACE_HEAT_SIZE   4096   /* Heat counters, hashed by exit PC. Must be power of two */
+#define REC_TRACE_MAX_PARTS   8      /* Max parts of a superblock */
+#define REC_TRACE_MAX_INSNS   512    /* Stop stitching past this many instructions */
+#define REC_TRACE_MAX_BLOCKS  4096   /* Superblocks before all are invalidated */
+
+static u32 trace_heat[REC_TRACE_HEAT_SIZE];
+static u8  trace_pages[0x200000/4096/8];           /* RAM pages holding starts of superblocks or their parts */
+static u32 trace_block_pcs[REC_TRACE_MAX_BLOCKS];  /* Start PCs of superblocks */
+static u32 trace_block_parts[REC_TRACE_MAX_BLOCKS][REC_TRACE_MAX_PARTS];  /* Start PCs of their stitched parts */
+static u8  trace_block_num_parts[REC_TRACE_MAX_BLOCKS];
+static int trace_num_blocks;
+static u32 trace_part_start[REC_TRACE_MAX_PARTS];  /* Parts of block being */
+static u32 trace_part_end[REC_TRACE_MAX_PARTS];    /*  recompiled, if stitched */
+static int trace_num_parts;
+
+static inline u32 *rec_trace_heat_ptr(u32 branch_pc)
+{
+	return &trace_heat[((branch_pc >> 2) ^ (branch_pc >> 14)) & (REC_TRACE_HEAT_SIZE-1)];
+}
+
+/* Clear the block ptrs of all superblocks. Heat counters start over too,
+ *  or every hot exit would be stitched again as soon as its block is next
+ *  entered, recompiling all superblocks at once after each invalidation.
+ */
+static void rec_trace_invalidate_all()
+{
+	for (int i = 0; i < trace_num_blocks; i++)
+		PC_REC32(trace_block_pcs[i]) = 0;
+	trace_num_blocks = 0;
+	memset(trace_pages, 0, sizeof(trace_pages));
+	memset(trace_heat, 0, sizeof(trace_heat));
+}
+
+static inline void rec_trace_mark_page(u32 pc)
+{
+	u32 page = (pc & 0x1fffff) / 4096;
+	trace_pages[page/8] |= (1 << (page & 7));
+}
+
+/* Block at 'pc' is about to be recompiled. Its ptr was cleared, so its code
+ *  may have changed: clear the ptrs of superblocks it was stitched into,
+ *  and forget the superblock it was, if any.
+ */
+static void rec_trace_block_recompiled(u32 pc)
+{
+	u32 page = (pc & 0x1fffff) / 4096;
+	if (!(trace_pages[page/8] & (1 << (page & 7))))
+		return;
+
+	for (int i = 0; i < trace_num_blocks; ) {
+		bool hit = (trace_block_pcs[i] == pc);
+		for (int j = 0; j < trace_block_num_parts[i] && !hit; j++)
+			hit = (trace_block_parts[i][j] == pc);
+
+		if (!hit) {
+			i++;
+			continue;
+		}
+
+		PC_REC32(trace_block_pcs[i]) = 0;
+
+		// Move last superblock into the free slot
+		trace_num_blocks--;
+		trace_block_pcs[i] = trace_block_pcs[trace_num_blocks];
+		trace_block_num_parts[i] = trace_block_num_parts[trace_num_blocks];
+		memcpy(trace_block_parts[i], trace_block_parts[trace_num_blocks],
+		       sizeof(trace_block_parts[i]));
+	}
+}
+
+/* Can code at 'target_pc' become the next part of the block? It must be
+ *  readable, and not already recompiled in the block: loops stay loops.
+ */
+static bool rec_trace_target_ok(u32 target_pc)
+{
+	if (!form_superblocks || block_is_idle_loop || !psxMemRLUT[target_pc >> 16])
+		return false;
+
+	if (target_pc >= block_part_pc && target_pc < pc)
+		return false;
+	for (int i = 0; i < trace_num_parts; i++)
+		if (target_pc >= trace_part_start[i] && target_pc < trace_part_end[i])
+			return false;
+	return true;
+}
+
+/* Should the exit of the jump/branch at 'branch_pc' count how often it is
+ *  taken? See emitTraceHeatCount().
+ */
+static bool rec_trace_should_count(u32 branch_pc, u32 target_pc)
+{
+	return *rec_trace_heat_ptr(branch_pc) < REC_TRACE_HEAT &&
+	       rec_trace_target_ok(target_pc);
+}
+
+/* Should code at 'target_pc' be recompiled inline instead of emitting an
+ *  exit for the jump/branch at 'branch_pc'? Caller must then emit nothing
+ *  for the exit and call rec_trace_stitch().
+ */
+static bool rec_trace_can_stitch(u32 branch_pc, u32 target_pc)
+{
+	// Code in RAM also needs its own block, for emitTraceGuard() to check
+	return *rec_trace_heat_ptr(branch_pc) >= REC_TRACE_HEAT &&
+	       trace_num_parts < REC_TRACE_MAX_PARTS-1 &&
+	       rec_block_insns() < REC_TRACE_MAX_INSNS &&
+	       rec_trace_target_ok(target_pc) &&
+	       ((s32)(target_pc << 4) < 0 || PC_REC32(target_pc) != 0);
+}
+
+/* End current part of the block, at 'pc' */
+static void rec_trace_end_part()
+{
+	trace_part_start[trace_num_parts] = block_part_pc;
+	trace_part_end[trace_num_parts] = pc;
+	trace_num_parts++;
+	block_part_insns += (pc - block_part_pc)/4;
+}
+
+/* Continue recompiling the block at 'target_pc' */
+static void rec_trace_stitch(u32 target_pc)
+{
+	if (trace_num_parts == 0) {
+		trace_block_pcs[trace_num_blocks] = oldpc;
+		trace_block_num_parts[trace_num_blocks] = 0;
+		trace_num_blocks++;
+		rec_trace_mark_page(oldpc);
+		pmonCount(PMON_CTR_REC_SUPERBLOCK);
+	}
+
+	const int blk = trace_num_blocks - 1;
+	trace_block_parts[blk][trace_block_num_parts[blk]++] = target_pc;
+	rec_trace_mark_page(target_pc);
+
+	rec_trace_end_part();
+	pc = block_part_pc = target_pc;
+
+	emitTraceGuard(target_pc);
+
+	DISASM_MSG(" ->Superblock continues at %08x\n", target_pc);
+}
+
 
 #include "opcodes.h"
 
@@ -398,12 +879,29 @@ static inline void clear_insn_cache(void *start, void *end, int flags)
 }
 
 
+/* Games that misbehave when idle loops are skipped. Matched against the
+ *  start of CdromId, case-insensitively.
+ */
+static const char * const idle_loop_skip_disable_ids[] = {
+	NULL
+};
+
 /* Set default recompilation options, and any per-game settings */
 static void rec_set_options()
 {
 	// Default options
 	emit_code_invalidations = true;
 	flush_code_on_dma3_exe_load = false;
+#ifdef USE_IDLE_LOOP_SKIP
+	skip_idle_loops = true;
+#else
+	skip_idle_loops = false;
+#endif
+#ifdef USE_SUPERBLOCKS
+	form_superblocks = true;
+#else
+	form_superblocks = false;
+#endif
 
 	// Per-game options
 	// -> Use case-insensitive comparisons! Some CDs have lowercase CdromId.
@@ -422,19 +920,158 @@ static void rec_set_options()
 		emit_code_invalidations = false;
 		flush_code_on_dma3_exe_load = true;
 	}
+
+	for (int i = 0; idle_loop_skip_disable_ids[i]; i++) {
+		const char *id = idle_loop_skip_disable_ids[i];
+		if (strncasecmp(CdromId, id, strlen(id)) == 0) {
+			REC_LOG("Idle loop skipping disabled for this game.\n");
+			skip_idle_loops = false;
+		}
+	}
 }
 
 
+/* Can PS1 address 'addr' be read any number of times with no side effects,
+ *  and with its value only changing in interrupt handlers, DMA or events?
+ *  Timer and GPU status reads are left out: their values change with the
+ *  cycle count itself, and loops polling them are timing delays.
+ */
+static bool rec_idle_loop_load_is_safe(u32 addr)
+{
+	addr &= 0x1fffffff;
+
+	return (addr < 0x00800000) ||                         // RAM and mirrors
+	       (addr >= 0x1f800000 && addr < 0x1f800400) ||   // Scratchpad
+	       (addr >= 0x1f801070 && addr < 0x1f801078) ||   // I_STAT, I_MASK
+	       (addr >= 0x1f801080 && addr < 0x1f801100) ||   // DMA regs
+	       (addr == 0x1f801800) ||                        // CD-ROM index/status
+	       (addr >= 0x1f801824 && addr < 0x1f801828) ||   // MDEC status
+	       (addr >= 0x1f801daa && addr < 0x1f801db0);     // SPU control, status
+}
+
+/* Check if block at 'block_pc' is an idle loop we can skip ahead in. See
+ *  rec_scan_for_idle_loop() for what qualifies. Must be called when
+ *  psxRegs.pc is 'block_pc': addresses of loads based on regs the loop
+ *  doesn't write are checked using current reg values. Emitted code skips
+ *  only while those regs still hold the same values, see emitIdleLoopSkip().
+ */
+static bool rec_idle_loop_scan(u32 block_pc)
+{
+	struct IdleLoopInfo info;
+
+	idle_loop_num_guards = 0;
+
+	if (rec_scan_for_idle_loop(block_pc, &info) == 0)
+		return false;
+
+	for (int i = 0; i < info.num_loads; i++) {
+		const IdleLoopLoad *load = &info.loads[i];
+		u32 addr = load->addr;
+
+		if (load->base_reg) {
+			const u32 reg = load->base_reg;
+			const u32 val = psxRegs.GPR.r[reg];
+			int j;
+			for (j = 0; j < idle_loop_num_guards; j++)
+				if (idle_loop_guard_regs[j] == reg)
+					break;
+			if (j == idle_loop_num_guards) {
+				if (idle_loop_num_guards == 2)
+					return false;
+				idle_loop_guard_regs[j] = reg;
+				idle_loop_guard_vals[j] = val;
+				idle_loop_num_guards++;
+			}
+			addr += val;
+		}
+
+		if (!rec_idle_loop_load_is_safe(addr))
+			return false;
+	}
+
+	return true;
+}
+
+
+/* Clear the block ptrs of all blocks starting in code cache segment 'seg' */
+static void recEvictSegment(int seg)
+{
+	rec_seg_t *s = &rec_segs[seg];
+	const u32 seg_start = (u32)recMemBase + seg * REC_SEG_SIZE;
+
+	for (int i = 0; i < s->num_blocks; i++) {
+		u32 *p = (u32*)PC_REC(s->block_pcs[i]);
+		// Block may have been invalidated by recClear() and recompiled
+		//  into a newer segment since, leave that one alone.
+		if ((*p - seg_start) < REC_SEG_SIZE)
+			*p = 0;
+	}
+
+	if (s->num_blocks) {
+		REC_LOG_V("Evicted code cache segment %d (%d blocks)\n", seg, s->num_blocks);
+		pmonCount(PMON_CTR_REC_EVICT);
+	}
+	s->num_blocks = 0;
+}
+
+/* Make sure REC_BLOCK_SIZE_MAX bytes at recMem are free for the next block,
+ *  evicting the oldest segments of the code cache as needed.
+ */
+static void recMakeRoom()
+{
+	if ((u8*)recMem + REC_BLOCK_SIZE_MAX <= rec_free_end)
+		return;
+
+	// Wrap around when the end of the code cache is too close
+	if ((u8*)recMem + REC_BLOCK_SIZE_MAX > recMemBase + RECMEM_SIZE) {
+		recMem = (u32*)recMemBase;
+		rec_free_end = recMemBase;
+	}
+
+	while ((u8*)recMem + REC_BLOCK_SIZE_MAX > rec_free_end) {
+		recEvictSegment((rec_free_end - recMemBase) / REC_SEG_SIZE);
+		rec_free_end += REC_SEG_SIZE;
+	}
+}
+
+/* Record block at 'pc' as starting at recMem, in the segment recMem lies in.
+ *  Returns false if memory for the segment's list can't be allocated.
+ */
+static bool recSegAddBlock(u32 pc)
+{
+	rec_seg_t *s = &rec_segs[((u8*)recMem - recMemBase) / REC_SEG_SIZE];
+
+	if (s->num_blocks == s->max_blocks) {
+		int max_blocks = s->max_blocks ? s->max_blocks * 2 : 1024;
+		u32 *block_pcs = (u32*)realloc(s->block_pcs, max_blocks * sizeof(u32));
+		if (!block_pcs)
+			return false;
+		s->block_pcs = block_pcs;
+		s->max_blocks = max_blocks;
+	}
+
+	s->block_pcs[s->num_blocks++] = pc;
+	return true;
+}
+
 static void recRecompile()
 {
 	// Notify plugin_lib that we're recompiling (affects frameskip timing)
 	pl_dynarec_notify();
 
-	if (((uptr)recMem - (uptr)recMemBase) >= RECMEM_SIZE_MAX ) {
-		REC_LOG("Code cache size limit exceeded: flushing code cache.\n");
+	recMakeRoom();
+	if (!recSegAddBlock(psxRegs.pc)) {
+		REC_LOG("Out of memory for code cache segment: flushing code cache.\n");
 		recReset();
+		recSegAddBlock(psxRegs.pc);
 	}
 
+	// Done before the block's ptr is set, it may be in the list
+	if (trace_num_blocks == REC_TRACE_MAX_BLOCKS)
+		rec_trace_invalidate_all();
+	else
+		rec_trace_block_recompiled(psxRegs.pc);
+
 	recMemStart = recMem;
 
 	regReset();
@@ -442,6 +1079,11 @@ static void recRecompile()
 	PC_REC32(psxRegs.pc) = (u32)recMem;
 	oldpc = pc = psxRegs.pc;
 
+	// Block is in one part until a hot exit is stitched in
+	block_part_pc = pc;
+	block_part_insns = 0;
+	trace_num_parts = 0;
+
 	// If 'pc' is in PS1 RAM, mark the page of RAM as containing the start of
 	//  a block. For the range check, bit 27 is interpreted as a sign bit.
 	if ((s32)(pc << 4) >= 0) {
@@ -452,10 +1094,16 @@ static void recRecompile()
 	DISASM_INIT();
 
 	rec_recompile_start();
+	PROFILE_BLOCK_START();
 
 	// Reset const-propagation
 	ResetConsts();
 
+	// Is block a loop polling memory, waiting for an interrupt?
+	block_is_idle_loop = skip_idle_loops && rec_idle_loop_scan(pc);
+	if (block_is_idle_loop)
+		DISASM_MSG(" ->Idle loop detected\n");
+
 	// Flag indicates when recompilation should stop
 	end_block = false;
 
@@ -513,6 +1161,10 @@ static void recRecompile()
 		regUpdate();
 	} while (!end_block);
 
+	if (trace_num_parts > 0)
+		rec_trace_end_part();
+
+	PROFILE_BLOCK_END();
 	DISASM_HOST();
 	clear_insn_cache(recMemStart, recMem, 0);
 }
@@ -522,16 +1174,14 @@ static int recInit()
 {
 	REC_LOG("Initializing\n");
 
+	PROFILE_INIT();
+
 	recMem = (u32*)recMemBase;
 
 	// Init code buffer, to allocate the RAM we need in advance. Filling with
 	//  all-1's should force an exception on any accidental non-code execution.
-	{
-		size_t fill_size = RECMEM_SIZE_MAX + 0x1000;  // 4KB past 'maximum' we'd ever use.
-		if (fill_size > RECMEM_SIZE)
-			fill_size = RECMEM_SIZE;
-		memset(recMemBase, 0xff, fill_size);
-	}
+	//  All of it gets used, as the code cache is used as a ring.
+	memset(recMemBase, 0xff, RECMEM_SIZE);
 
 	// The tables recRAM and recROM hold block code pointers for all valid PC
 	//  values for a PS1 program, after masking away banking and/or mirroring.
@@ -594,11 +1244,19 @@ static void recShutdown()
 {
 	REC_LOG("Shutting down\n");
 
+	PROFILE_REPORT();
+
 	if (psx_mem_mapped)
 		rec_munmap_psx_mem();
 	if (rec_mem_mapped)
 		rec_munmap_rec_mem();
 	psx_mem_mapped = rec_mem_mapped = false;
+
+	for (int i = 0; i < REC_SEG_COUNT; i++) {
+		free(rec_segs[i].block_pcs);
+		rec_segs[i].block_pcs = NULL;
+		rec_segs[i].num_blocks = rec_segs[i].max_blocks = 0;
+	}
 }
 
 
@@ -1674,6 +2332,8 @@ static void recClear(u32 Addr, u32 Size)
 	//       mirror region the game is already using, reducing TLB pressure.
 	uptr dst_base = !rec_mem_mapped ? (uptr)recRAM : (uptr)PC_REC_MMAP(Addr & ~0x1fffff);
 
+	PROFILE_CLEAR(dst_base + (masked_ram_addr * REC_RAM_PTR_SIZE/4), Size, has_code);
+
 	if (has_code) {
 		void *dst = (void*)(dst_base + (masked_ram_addr * REC_RAM_PTR_SIZE/4));
 		memset(dst, 0, Size*REC_RAM_PTR_SIZE);
@@ -1753,10 +2413,18 @@ void recNotify(int note, void *data __attribute__((unused)))
 static void recReset()
 {
 	memset(code_pages, 0, sizeof(code_pages));
+	memset(trace_pages, 0, sizeof(trace_pages));
+	memset(trace_heat, 0, sizeof(trace_heat));
+	trace_num_blocks = 0;
 	memset(recRAM, 0, REC_RAM_SIZE);
 	memset(recROM, 0, REC_ROM_SIZE);
 
+	// Whole code cache is free, segments get evicted once it has wrapped
 	recMem = (u32*)recMemBase;
+	rec_free_end = recMemBase + RECMEM_SIZE;
+	for (int i = 0; i < REC_SEG_COUNT; i++)
+		rec_segs[i].num_blocks = 0;
+	pmonCount(PMON_CTR_REC_FLUSH);
 
 	regReset();
 
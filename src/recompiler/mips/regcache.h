@@ -1,6 +1,11 @@
 #define REG_CACHE_START		MIPSREG_S0
 #define REG_CACHE_END		(MIPSREG_S7+1)
 
+/* LO/HI are cached like GPRs, using their psxRegs.GPR.r[] indices */
+#define REG_LO			32
+#define REG_HI			33
+#define REG_PSX_CNT		34
+
 #define REG_LOAD		0
 #define REG_FIND		1
 #define REG_LOADBRANCH		2
@@ -30,7 +35,7 @@ typedef struct {
 } PSX_RecRegister;
 
 typedef struct {
-	PSX_RecRegister		psx[32];
+	PSX_RecRegister		psx[REG_PSX_CNT];
 	HOST_RecRegister	host[32];
 	u32			reglist[32];
 	u32			reglist_cnt;
@@ -43,14 +48,16 @@ static int          regcache_bak_idx  = 0;
 static const int    regcache_bak_size = 8; // Abitrary size choice (overkill?)
 static RecRegisters regcache_bak[regcache_bak_size];
 
-/* Spill regs to psxRegs if they are in host regs and were modified */
-static void regClearJump(void)
+/* Spill regs to psxRegs if they are in host regs and were modified.
+ *  Regs in 'dead' mask (see rec_scan_for_dead_regs()) are dropped unspilled.
+ */
+static void regClearJumpTo(u64 dead)
 {
-	for (int i = 1; i < 32; i++) {
+	for (int i = 1; i < REG_PSX_CNT; i++) {
 		if (regcache.psx[i].ismapped) {
 			int mappedto = regcache.psx[i].mappedto;
 
-			if (regcache.psx[i].psx_ischanged) {
+			if (regcache.psx[i].psx_ischanged && !(dead & ((u64)1 << i))) {
 				//DEBUGG("mappedto %d pr %d\n", mappedto, PERM_REG_1);
 				SW(mappedto, PERM_REG_1, offGPR(i));
 			}
@@ -66,6 +73,11 @@ static void regClearJump(void)
 	}
 }
 
+static void regClearJump(void)
+{
+	regClearJumpTo(0);
+}
+
 static void regFreeRegs(void)
 {
 	//DEBUGF("regFreeRegs\n");
@@ -159,8 +171,8 @@ static u32 regMipsToHostHelper(u32 regpsx, u32 action, u32 type)
 		regcache.host[regnum].mappedto = 0;
 
 		// If reg value is known-const, see if it can be loaded with just one ALU op
-		if (IsConst(regpsx) && ( (((u32)GetConst(regpsx) <= 0xffff) || !(GetConst(regpsx) & 0xffff)) ||
-		                         (((s32)GetConst(regpsx) < 0) && ((s32)GetConst(regpsx) >= -32768))    ))
+		if (regpsx < REG_LO && IsConst(regpsx) && ( (((u32)GetConst(regpsx) <= 0xffff) || !(GetConst(regpsx) & 0xffff)) ||
+		                                            (((s32)GetConst(regpsx) < 0) && ((s32)GetConst(regpsx) >= -32768))    ))
 		{
 			LI32(regnum, GetConst(regpsx));
 		} else {
@@ -173,8 +185,8 @@ static u32 regMipsToHostHelper(u32 regpsx, u32 action, u32 type)
 
 	if (action == REG_LOAD) {
 		// If reg value is known-const, see if it can be loaded with just one ALU op
-		if (IsConst(regpsx) && ( (((u32)GetConst(regpsx) <= 0xffff) || !(GetConst(regpsx) & 0xffff)) ||
-		                         (((s32)GetConst(regpsx) < 0) && ((s32)GetConst(regpsx) >= -32768))    ))
+		if (regpsx < REG_LO && IsConst(regpsx) && ( (((u32)GetConst(regpsx) <= 0xffff) || !(GetConst(regpsx) & 0xffff)) ||
+		                                            (((s32)GetConst(regpsx) < 0) && ((s32)GetConst(regpsx) >= -32768))    ))
 		{
 			LI32(regcache.psx[regpsx].mappedto, GetConst(regpsx));
 		} else {
@@ -245,19 +257,27 @@ static void regUnlock(u32 reghost)
 		regcache.host[reghost].host_islocked--;
 }
 
-static void regClearBranch(void)
+/* Like regClearJumpTo(), but regs stay mapped: code follows on the
+ *  branch-not-taken path. */
+static void regClearBranchTo(u64 dead)
 {
-	for (int i = 1; i < 32; i++) {
-		if (regcache.psx[i].ismapped && regcache.psx[i].psx_ischanged) {
+	for (int i = 1; i < REG_PSX_CNT; i++) {
+		if (regcache.psx[i].ismapped && regcache.psx[i].psx_ischanged &&
+		    !(dead & ((u64)1 << i))) {
 			SW(regcache.psx[i].mappedto, PERM_REG_1, offGPR(i));
 		}
 	}
 }
 
+static void regClearBranch(void)
+{
+	regClearBranchTo(0);
+}
+
 static void regReset()
 {
 	int i, i2;
-	for (i = 0; i < 32; i++) {
+	for (i = 0; i < REG_PSX_CNT; i++) {
 		regcache.psx[i].psx_ischanged = false;
 		regcache.psx[i].ismapped = false;
 		regcache.psx[i].mappedto = 0;
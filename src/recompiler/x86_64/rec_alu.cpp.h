@@ -0,0 +1,259 @@
+/******************************************************************************
+ * IMPORTANT: The following host registers have unique usage restrictions.    *
+ *            See notes in x86_64_codegen.h for full details.                 *
+ *  X86REG_RBX, X86REG_R12                                                    *
+ *****************************************************************************/
+
+/* PS1 GPRs live in psxRegs.GPR, so most emitters here are a load of one
+ *  operand to a temp reg, an ALU op with the other operand in memory, and
+ *  a store. Writes to $zero are never emitted; reads of it are fine, since
+ *  psxRegs.GPR.r[0] always holds 0.
+ */
+
+static void emitLoadGPR(X86Reg host, u32 reg)
+{
+	if (reg == 0)
+		MOV32RI(host, 0);
+	else
+		MOV32RM(host, PERM_REG_1, offGPR(reg));
+}
+
+static void emitStoreGPR(u32 reg, X86Reg host)
+{
+	if (reg != 0)
+		MOV32MR(PERM_REG_1, offGPR(reg), host);
+}
+
+static void recADDIU()
+{
+// Rt = Rs + Im
+	if (!_Rt_) return;
+
+	const s32 imm = _Imm_;
+
+	if (!_Rs_) {
+		MOV32MI(PERM_REG_1, offGPR(_Rt_), imm);
+	} else if (_Rs_ == _Rt_) {
+		if (imm != 0)
+			ALU32MI(ALU_ADD, PERM_REG_1, offGPR(_Rt_), imm);
+	} else {
+		MOV32RM(TEMP_0, PERM_REG_1, offGPR(_Rs_));
+		if (imm != 0)
+			ALU32RI(ALU_ADD, TEMP_0, imm);
+		MOV32MR(PERM_REG_1, offGPR(_Rt_), TEMP_0);
+	}
+}
+
+static void recADDI()
+{
+// Rt = Rs + Im (overflow exception is not emulated)
+	recADDIU();
+}
+
+/* Used for SLTI, SLTIU */
+static void emitSetLessThanImm(X86Cond cc)
+{
+	if (!_Rt_) return;
+
+	MOV32RI(TEMP_1, 0);
+	emitLoadGPR(TEMP_0, _Rs_);
+	ALU32RI(ALU_CMP, TEMP_0, _Imm_);
+	SETCC8(cc, TEMP_1);
+	MOV32MR(PERM_REG_1, offGPR(_Rt_), TEMP_1);
+}
+
+static void recSLTI()
+{
+// Rt = Rs < Im (signed)
+	emitSetLessThanImm(CC_L);
+}
+
+static void recSLTIU()
+{
+// Rt = Rs < Im (unsigned, Im is still sign-extended)
+	emitSetLessThanImm(CC_B);
+}
+
+/* Used for ANDI, ORI, XORI */
+static void emitLogicImm(X86AluOp aluop)
+{
+	if (!_Rt_) return;
+
+	const u32 imm = _ImmU_;
+
+	if (_Rs_ == _Rt_) {
+		ALU32MI(aluop, PERM_REG_1, offGPR(_Rt_), imm);
+	} else {
+		emitLoadGPR(TEMP_0, _Rs_);
+		ALU32RI(aluop, TEMP_0, imm);
+		MOV32MR(PERM_REG_1, offGPR(_Rt_), TEMP_0);
+	}
+}
+
+static void recANDI()
+{
+// Rt = Rs And Im
+	emitLogicImm(ALU_AND);
+}
+
+static void recORI()
+{
+// Rt = Rs Or Im
+	emitLogicImm(ALU_OR);
+}
+
+static void recXORI()
+{
+// Rt = Rs Xor Im
+	emitLogicImm(ALU_XOR);
+}
+
+static void recLUI()
+{
+// Rt = Imm << 16
+	if (!_Rt_) return;
+
+	MOV32MI(PERM_REG_1, offGPR(_Rt_), _ImmU_ << 16);
+}
+
+/* Used for ADD, ADDU, SUB, SUBU, AND, OR, XOR, NOR */
+static void emitALU(X86AluOp aluop, bool invert)
+{
+	if (!_Rd_) return;
+
+	emitLoadGPR(TEMP_0, _Rs_);
+	ALU32RM(aluop, TEMP_0, PERM_REG_1, offGPR(_Rt_));
+	if (invert)
+		NOT32R(TEMP_0);
+	MOV32MR(PERM_REG_1, offGPR(_Rd_), TEMP_0);
+}
+
+static void recADDU()
+{
+// Rd = Rs + Rt
+	emitALU(ALU_ADD, false);
+}
+
+static void recADD()
+{
+// Rd = Rs + Rt (overflow exception is not emulated)
+	emitALU(ALU_ADD, false);
+}
+
+static void recSUBU()
+{
+// Rd = Rs - Rt
+	emitALU(ALU_SUB, false);
+}
+
+static void recSUB()
+{
+// Rd = Rs - Rt (overflow exception is not emulated)
+	emitALU(ALU_SUB, false);
+}
+
+static void recAND()
+{
+// Rd = Rs And Rt
+	emitALU(ALU_AND, false);
+}
+
+static void recOR()
+{
+// Rd = Rs Or Rt
+	emitALU(ALU_OR, false);
+}
+
+static void recXOR()
+{
+// Rd = Rs Xor Rt
+	emitALU(ALU_XOR, false);
+}
+
+static void recNOR()
+{
+// Rd = Rs Nor Rt
+	emitALU(ALU_OR, true);
+}
+
+/* Used for SLT, SLTU */
+static void emitSetLessThan(X86Cond cc)
+{
+	if (!_Rd_) return;
+
+	MOV32RI(TEMP_1, 0);
+	emitLoadGPR(TEMP_0, _Rs_);
+	ALU32RM(ALU_CMP, TEMP_0, PERM_REG_1, offGPR(_Rt_));
+	SETCC8(cc, TEMP_1);
+	MOV32MR(PERM_REG_1, offGPR(_Rd_), TEMP_1);
+}
+
+static void recSLT()
+{
+// Rd = Rs < Rt (signed)
+	emitSetLessThan(CC_L);
+}
+
+static void recSLTU()
+{
+// Rd = Rs < Rt (unsigned)
+	emitSetLessThan(CC_B);
+}
+
+/* Used for SLL, SRL, SRA */
+static void emitShiftImm(X86ShiftOp sop)
+{
+	if (!_Rd_) return;
+
+	emitLoadGPR(TEMP_0, _Rt_);
+	if (_Sa_)
+		SHIFT32RI(sop, TEMP_0, _Sa_);
+	MOV32MR(PERM_REG_1, offGPR(_Rd_), TEMP_0);
+}
+
+static void recSLL()
+{
+// Rd = Rt << Sa
+	emitShiftImm(SHIFT_SHL);
+}
+
+static void recSRL()
+{
+// Rd = Rt >> Sa
+	emitShiftImm(SHIFT_SHR);
+}
+
+static void recSRA()
+{
+// Rd = Rt >> Sa (arithmetic)
+	emitShiftImm(SHIFT_SAR);
+}
+
+/* Used for SLLV, SRLV, SRAV. Like MIPS, x86 uses only low 5 bits of count. */
+static void emitShiftVar(X86ShiftOp sop)
+{
+	if (!_Rd_) return;
+
+	emitLoadGPR(TEMP_1, _Rs_);
+	emitLoadGPR(TEMP_0, _Rt_);
+	SHIFT32RCL(sop, TEMP_0);
+	MOV32MR(PERM_REG_1, offGPR(_Rd_), TEMP_0);
+}
+
+static void recSLLV()
+{
+// Rd = Rt << Rs
+	emitShiftVar(SHIFT_SHL);
+}
+
+static void recSRLV()
+{
+// Rd = Rt >> Rs
+	emitShiftVar(SHIFT_SHR);
+}
+
+static void recSRAV()
+{
+// Rd = Rt >> Rs (arithmetic)
+	emitShiftVar(SHIFT_SAR);
+}
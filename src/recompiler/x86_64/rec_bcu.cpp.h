@@ -0,0 +1,465 @@
+/******************************************************************************
+ * IMPORTANT: The following host registers have unique usage restrictions.    *
+ *            See notes in x86_64_codegen.h for full details.                 *
+ *  X86REG_RBX, X86REG_R12                                                    *
+ *****************************************************************************/
+
+/* Emit block exit to known-const PC */
+static void emitBlockExit(const u32 new_pc)
+{
+	MOV32MI(PERM_REG_1, off(pc), new_pc);
+	rec_recompile_end();
+}
+
+/* Emit block exit to PC held in BRANCH_REG */
+static void emitBlockExitBranchReg()
+{
+	MOV32MR(PERM_REG_1, off(pc), BRANCH_REG);
+	rec_recompile_end();
+}
+
+static void recSYSCALL()
+{
+	MOV32MI(PERM_REG_1, off(pc), pc - 4);
+	MOV32RI(ARG_1, 0x20);
+	MOV32RI(ARG_2, (branch ? 1 : 0));
+	CALL_FUNC(psxException);
+
+	// Return to dispatch loop with new PC set by psxException()
+	rec_recompile_end();
+
+	end_block = 1;
+}
+
+/* Check if an opcode has a delayed read if in delay slot */
+static int iLoadTest(u32 code)
+{
+	// check for load delay
+	u32 op = _fOp_(code);
+	switch (op) {
+	case 0x10: // COP0
+		switch (_fRs_(code)) {
+		case 0x00: // MFC0
+		case 0x02: // CFC0
+			return 1;
+		}
+		break;
+	case 0x12: // COP2
+		switch (_fFunct_(code)) {
+		case 0x00:
+			switch (_fRs_(code)) {
+			case 0x00: // MFC2
+			case 0x02: // CFC2
+				return 1;
+			}
+			break;
+		}
+		break;
+	case 0x32: // LWC2
+		return 1;
+	default:
+		// LB/LH/LWL/LW/LBU/LHU/LWR
+		if (op >= 0x20 && op <= 0x26) {
+			return 1;
+		}
+		break;
+	}
+	return 0;
+}
+
+static int DelayTest(const u32 pc, const u32 bpc)
+{
+	const u32 code1 = OPCODE_AT(pc);
+	const u32 code2 = OPCODE_AT(bpc);
+	const u32 reg = _fRt_(code1);
+
+	if (iLoadTest(code1)) {
+		return psxTestLoadDelay(reg, code2);
+		// 1: delayReadWrite	// the branch delay load is skipped
+		// 2: delayRead		// branch delay load
+		// 3: delayWrite	// no changes from normal behavior
+	}
+
+	return 0;
+}
+
+/* Revert execution order of opcodes at branch target address and in delay slot
+   This emulates the effect of delayed read from COP2 happening in delay slot
+   when the branch is taken. This fixes Tekken 2 (broken models). */
+static void recRevDelaySlot(u32 pc, u32 bpc)
+{
+	branch = 1;
+
+	psxRegs.code = OPCODE_AT(bpc);
+	recBSC[psxRegs.code>>26]();
+
+	psxRegs.code = OPCODE_AT(pc);
+	recBSC[psxRegs.code>>26]();
+
+	branch = 0;
+}
+
+/* Recompile opcode in delay slot */
+static void recDelaySlot()
+{
+	branch = 1;
+	psxRegs.code = OPCODE_AT(pc);
+	pc+=4;
+
+	// recRecompile() leaves branches with a branch in their BD slot to the
+	//  interpreter, so this is never a branch
+	recBSC[psxRegs.code>>26]();
+
+	branch = 0;
+}
+
+static void iJumpNormal(u32 bpc)
+{
+	recDelaySlot();
+
+	emitBlockExit(bpc);
+
+	end_block = 1;
+}
+
+static void iJumpAL(u32 bpc, u32 nbpc)
+{
+	MOV32MI(PERM_REG_1, offGPR(31), nbpc);
+
+	const int dt = DelayTest(pc, bpc);
+	if (dt == 2) {
+		// BD slot trickery has been detected: use a workaround.
+		// Fixes freezes/glitches in 'Tomb Raider 2, 4, 5' and 'Mortal Kombat Trilogy'.
+
+		recRevDelaySlot(pc, bpc);
+		bpc += 4;
+	} else if (dt == 3 || dt == 0) {
+		recDelaySlot();
+	}
+
+	emitBlockExit(bpc);
+
+	end_block = 1;
+}
+
+/* Emit the second half of a conditional branch: BRANCH_REG holds the branch
+ *  decision, made before the BD slot executes. If taken, block returns to
+ *  dispatch loop, otherwise code emission continues at instruction after the
+ *  BD slot. Param 'dt' is result of DelayTest().
+ */
+static void emitBranchTakenExit(u32 bpc, const int dt)
+{
+	if (dt == 3 || dt == 0)
+		recDelaySlot();
+
+	TEST32RR(BRANCH_REG, BRANCH_REG);
+	u8 *backpatch = JCC32(CC_E);
+
+	if (dt == 2) {
+		// BD slot trickery has been detected: use a workaround.
+		// Fixes gfx glitches in 'Tekken 2'
+
+		recRevDelaySlot(pc, bpc);
+		bpc += 4;
+	}
+
+	emitBlockExit(bpc);
+
+	fixup_branch(backpatch);
+
+	if (dt != 3 && dt != 0)
+		recDelaySlot();
+}
+
+/* Used for BLTZ, BGTZ, BLTZAL, BGEZAL, BLEZ, BGEZ */
+static void emitBxxZ(int andlink, u32 bpc, u32 nbpc)
+{
+	const u32 code = psxRegs.code;
+	const int dt = DelayTest(pc, bpc);
+
+	// MIPS branch decisions are made before execution of delay slots.
+	// Do the same here: the delay slot could write to decision regs!
+
+	MOV32RI(BRANCH_REG, 0);
+	MOV32RM(TEMP_0, PERM_REG_1, offGPR(_Rs_));
+	TEST32RR(TEMP_0, TEMP_0);
+
+	switch (code & 0xfc1f0000) {
+	case 0x04000000: /* BLTZ */
+	case 0x04100000: /* BLTZAL */	SETCC8(CC_L, BRANCH_REG);  break;
+	case 0x04010000: /* BGEZ */
+	case 0x04110000: /* BGEZAL */	SETCC8(CC_GE, BRANCH_REG); break;
+	case 0x1c000000: /* BGTZ */	SETCC8(CC_G, BRANCH_REG);  break;
+	case 0x18000000: /* BLEZ */	SETCC8(CC_LE, BRANCH_REG); break;
+	default:
+		printf("Error opcode=%08x\n", code);
+		exit(1);
+	}
+
+	if (andlink) {
+		// Branch-and-link instructions always set the 'ra' reg, even when the
+		//  branch is not taken! Though, according to MIPS docs, the branch
+		//  decision is made before the 'ra' write.
+		MOV32MI(PERM_REG_1, offGPR(31), nbpc);
+	}
+
+	emitBranchTakenExit(bpc, dt);
+}
+
+/* Used for BEQ and BNE */
+static void emitBxx(u32 bpc)
+{
+	const u32 code = psxRegs.code;
+
+	MOV32RI(BRANCH_REG, 0);
+	emitLoadGPR(TEMP_0, _Rs_);
+	ALU32RM(ALU_CMP, TEMP_0, PERM_REG_1, offGPR(_Rt_));
+
+	switch (code & 0xfc000000) {
+	case 0x10000000: /* BEQ */	SETCC8(CC_E, BRANCH_REG);  break;
+	case 0x14000000: /* BNE */	SETCC8(CC_NE, BRANCH_REG); break;
+	default:
+		printf("Error opcode=%08x\n", code);
+		exit(1);
+	}
+
+	emitBranchTakenExit(bpc, 0);
+}
+
+static void recBEQ()
+{
+// Branch if Rs == Rt
+	u32 bpc = _Imm_ * 4 + pc;
+	u32 nbpc = pc + 4;
+
+	if (bpc == nbpc && psxTestLoadDelay(_Rs_, OPCODE_AT(bpc)) == 0)
+		return;
+
+	if (_Rs_ == _Rt_) {
+		iJumpNormal(bpc);
+		return;
+	}
+
+	emitBxx(bpc);
+}
+
+static void recBNE()
+{
+// Branch if Rs != Rt
+	u32 bpc = _Imm_ * 4 + pc;
+	u32 nbpc = pc + 4;
+
+	if (bpc == nbpc && psxTestLoadDelay(_Rs_, OPCODE_AT(bpc)) == 0)
+		return;
+
+	if (_Rs_ == _Rt_) {
+		recDelaySlot();
+		return;
+	}
+
+	emitBxx(bpc);
+}
+
+static void recBLEZ()
+{
+// Branch if Rs <= 0
+	u32 bpc = _Imm_ * 4 + pc;
+	u32 nbpc = pc + 4;
+
+	if (bpc == nbpc && psxTestLoadDelay(_Rs_, OPCODE_AT(bpc)) == 0)
+		return;
+
+	if (!(_Rs_)) {
+		iJumpNormal(bpc);
+		return;
+	}
+
+	emitBxxZ(0, bpc, nbpc);
+}
+
+static void recBGEZ()
+{
+// Branch if Rs >= 0
+	u32 bpc = _Imm_ * 4 + pc;
+	u32 nbpc = pc + 4;
+
+	if (bpc == nbpc && psxTestLoadDelay(_Rs_, OPCODE_AT(bpc)) == 0)
+		return;
+
+	if (!(_Rs_)) {
+		iJumpNormal(bpc);
+		return;
+	}
+
+	emitBxxZ(0, bpc, nbpc);
+}
+
+static void recBLTZ()
+{
+// Branch if Rs < 0
+	u32 bpc = _Imm_ * 4 + pc;
+	u32 nbpc = pc + 4;
+
+	if (bpc == nbpc && psxTestLoadDelay(_Rs_, OPCODE_AT(bpc)) == 0)
+		return;
+
+	if (!(_Rs_)) {
+		recDelaySlot();
+		return;
+	}
+
+	emitBxxZ(0, bpc, nbpc);
+}
+
+static void recBGTZ()
+{
+// Branch if Rs > 0
+	u32 bpc = _Imm_ * 4 + pc;
+	u32 nbpc = pc + 4;
+
+	if (bpc == nbpc && psxTestLoadDelay(_Rs_, OPCODE_AT(bpc)) == 0)
+		return;
+
+	if (!(_Rs_)) {
+		recDelaySlot();
+		return;
+	}
+
+	emitBxxZ(0, bpc, nbpc);
+}
+
+static void recBLTZAL()
+{
+// Branch if Rs < 0
+	u32 bpc = _Imm_ * 4 + pc;
+	u32 nbpc = pc + 4;
+
+	if (!(_Rs_)) {
+		MOV32MI(PERM_REG_1, offGPR(31), nbpc);
+		recDelaySlot();
+		return;
+	}
+
+	emitBxxZ(1, bpc, nbpc);
+}
+
+static void recBGEZAL()
+{
+// Branch if Rs >= 0
+	u32 bpc = _Imm_ * 4 + pc;
+	u32 nbpc = pc + 4;
+
+	if (!(_Rs_)) {
+		iJumpAL(bpc, (pc + 4));
+		return;
+	}
+
+	emitBxxZ(1, bpc, nbpc);
+}
+
+static void recJ()
+{
+// j target
+
+	iJumpNormal(_Target_ * 4 + (pc & 0xf0000000));
+}
+
+static void recJAL()
+{
+// jal target
+
+	iJumpAL(_Target_ * 4 + (pc & 0xf0000000), (pc + 4));
+}
+
+/* HACK: Execute load delay in branch delay via interpreter */
+static u32 execBranchLoadDelay(u32 pc, u32 bpc)
+{
+	const u32 code1 = OPCODE_AT(pc);
+	const u32 code2 = OPCODE_AT(bpc);
+
+	branch = 1;
+
+	switch (psxTestLoadDelay(_fRt_(code1), code2)) {
+	case 2:		// branch delay + load delay
+		psxRegs.code = code2;
+		psxBSC[code2 >> 26](); // first branch opcode
+
+		bpc += 4;
+		// intentional fallthrough here!
+	case 0:
+	case 3:		// Simple branch delay
+		psxRegs.code = code1;
+		psxBSC[code1 >> 26](); // branch delay load
+
+		// again intentional fallthrough here!
+	case 1:		// No branch delay
+		break;
+	}
+
+	branch = 0;
+
+	return bpc;
+}
+
+static void recJR_load_delay()
+{
+	emitLoadGPR(ARG_2, _Rs_);
+	MOV32RI(ARG_1, pc);
+	CALL_FUNC(execBranchLoadDelay);
+
+	// TEMP_0 here contains jump address returned from execBranchLoadDelay()
+	MOV32MR(PERM_REG_1, off(pc), TEMP_0);
+	pc += 4;
+	rec_recompile_end();
+
+	end_block = 1;
+}
+
+static void recJR()
+{
+// jr Rs
+
+	// if possible read delay in branch delay slot
+	if (iLoadTest(OPCODE_AT(pc))) {
+		// BD slot trickery has been detected: use a workaround.
+		// Fixes 'Skullmonkeys'.
+
+		recJR_load_delay();
+
+		return;
+	}
+
+	emitLoadGPR(BRANCH_REG, _Rs_);
+	recDelaySlot();
+
+	emitBlockExitBranchReg();
+
+	end_block = 1;
+}
+
+static void recJALR()
+{
+// jalr Rs
+
+	emitLoadGPR(BRANCH_REG, _Rs_);
+	if (_Rd_)
+		MOV32MI(PERM_REG_1, offGPR(_Rd_), pc + 4);
+	recDelaySlot();
+
+	emitBlockExitBranchReg();
+
+	end_block = 1;
+}
+
+static void recBREAK() { }
+
+static void recHLE()
+{
+	MOV32MI(PERM_REG_1, off(pc), pc);
+	CALL_FUNC(psxHLEt[psxRegs.code & 0x7]);
+
+	// Return to dispatch loop with psxRegs.pc set by HLE func
+	rec_recompile_end();
+
+	end_block = 1;
+}
@@ -0,0 +1,132 @@
+/******************************************************************************
+ * IMPORTANT: The following host registers have unique usage restrictions.    *
+ *            See notes in x86_64_codegen.h for full details.                 *
+ *  X86REG_RBX, X86REG_R12                                                    *
+ *****************************************************************************/
+
+static void recMFC0()
+{
+// Rt = Cop0->Rd
+	if (!_Rt_) return;
+
+	MOV32RM(TEMP_0, PERM_REG_1, offCP0(_Rd_));
+	MOV32MR(PERM_REG_1, offGPR(_Rt_), TEMP_0);
+}
+
+static void recCFC0()
+{
+// Rt = Cop0->Rd
+
+	recMFC0();
+}
+
+// Tests for SW interrupts/exceptions after writes to MTC0 CP0 reg 12,13
+static void emitTestSWInts()
+{
+	// ---- Equivalent C code: ----
+	// if ((psxRegs.CP0.n.Cause & psxRegs.CP0.n.Status & 0x0300) &&
+	//     psxRegs.CP0.n.Status & 0x1))
+	// {
+	//     psxRegs.CP0.n.Cause &= ~0x7c;
+	//     psxException(psxRegs.CP0.n.Cause, branch);
+	//
+	//     /* return to block dispatch loop with exception's new PC */
+	// }
+
+	MOV32RM(TEMP_1, PERM_REG_1, offCP0(12));
+	ALU32RI(ALU_AND, TEMP_1, 0x1);
+	u8 *backpatch1 = JCC32(CC_E);
+
+	MOV32RM(TEMP_0, PERM_REG_1, offCP0(13));
+	ALU32RM(ALU_AND, TEMP_0, PERM_REG_1, offCP0(12));
+	ALU32RI(ALU_AND, TEMP_0, 0x300);
+	u8 *backpatch2 = JCC32(CC_E);
+
+	// Clear bits 6:2 of Cause reg value (ExcCode field), indicating
+	//  cause of exception is 'Interrupt'
+	ALU32MI(ALU_AND, PERM_REG_1, offCP0(13), ~0x7c);
+
+	// psxRegs.pc is set to instruction following the MTC0, which is what
+	//  the interpreter's psxTestSWInts() sees as EPC
+	MOV32MI(PERM_REG_1, off(pc), pc);
+
+	MOV32RM(ARG_1, PERM_REG_1, offCP0(13));
+	MOV32RI(ARG_2, (branch ? 1 : 0));
+	CALL_FUNC(psxException);
+
+	// Return to dispatch loop with new PC set by psxException()
+	rec_recompile_end();
+
+	fixup_branch(backpatch1);
+	fixup_branch(backpatch2);
+}
+
+static void recMTC0()
+{
+// Cop0->Rd = Rt
+
+	emitLoadGPR(TEMP_0, _Rt_);
+
+	switch (_Rd_) {
+		case 12: // Status
+			// Store new Status reg val, while also checking if new value
+			//  enables HW irqs/exceptions. Reset psxRegs.io_cycle_counter
+			//  if so, so that psxBranchTest() is called as soon as possible.
+			MOV32MR(PERM_REG_1, offCP0(12), TEMP_0);
+			ALU32RI(ALU_AND, TEMP_0, 0x401);
+			ALU32RI(ALU_CMP, TEMP_0, 0x401);
+			{
+				u8 *backpatch = JCC32(CC_NE);
+				MOV32MI(PERM_REG_1, off(io_cycle_counter), 0);
+				fixup_branch(backpatch);
+			}
+
+			// Modification of CP0 reg 12 or 13 must be followed by test for
+			//  software-generated IRQ/exception.
+			//  ** Fixes freeze at start of 'Jackie Chan Stuntmaster'
+			emitTestSWInts();
+			break;
+
+		case 13: // Cause
+			// Only bits 8,9 are writable
+			ALU32RI(ALU_AND, TEMP_0, 0x300);
+			ALU32MI(ALU_AND, PERM_REG_1, offCP0(13), ~0x300);
+			ALU32RM(ALU_OR, TEMP_0, PERM_REG_1, offCP0(13));
+			MOV32MR(PERM_REG_1, offCP0(13), TEMP_0);
+
+			emitTestSWInts();
+			break;
+
+		default:
+			MOV32MR(PERM_REG_1, offCP0(_Rd_), TEMP_0);
+			break;
+	}
+}
+
+static void recCTC0()
+{
+// Cop0->Rd = Rt
+
+	recMTC0();
+}
+
+static void recRFE()
+{
+// 'Return from exception' opcode
+//  Inside CP0 Status register (12), RFE atomically copies bits 5:2 to
+//  bits 3:0 , unwinding the exception 'stack'
+
+	MOV32RM(TEMP_0, PERM_REG_1, offCP0(12));
+
+	// Reset psxRegs.io_cycle_counter, so that psxBranchTest() is called as
+	//  soon as possible to handle any pending interrupts/events
+	MOV32MI(PERM_REG_1, off(io_cycle_counter), 0);
+
+	MOV32RR(TEMP_1, TEMP_0);
+	ALU32RI(ALU_AND, TEMP_0, ~0xf);   // TEMP_0 = orig SR value with bits 3:0 cleared
+	ALU32RI(ALU_AND, TEMP_1, 0x3c);   // TEMP_1 = just bits 5:2 from orig SR value
+	SHIFT32RI(SHIFT_SHR, TEMP_1, 2);  // Shift them right two places
+	ALU32RR(ALU_OR, TEMP_0, TEMP_1);  // TEMP_0 = new SR value
+
+	MOV32MR(PERM_REG_1, offCP0(12), TEMP_0);
+}
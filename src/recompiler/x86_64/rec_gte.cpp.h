@@ -0,0 +1,171 @@
+/******************************************************************************
+ * IMPORTANT: The following host registers have unique usage restrictions.    *
+ *            See notes in x86_64_codegen.h for full details.                 *
+ *  X86REG_RBX, X86REG_R12                                                    *
+ *****************************************************************************/
+
+/* COP2 function fields that are GTE operations, see recCP2[] */
+#define GTE_OP_FUNCS ( \
+	(1ULL << 0x01) | (1ULL << 0x06) | (1ULL << 0x0c) | (1ULL << 0x10) | \
+	(1ULL << 0x11) | (1ULL << 0x12) | (1ULL << 0x13) | (1ULL << 0x14) | \
+	(1ULL << 0x16) | (1ULL << 0x1b) | (1ULL << 0x1c) | (1ULL << 0x1e) | \
+	(1ULL << 0x20) | (1ULL << 0x28) | (1ULL << 0x29) | (1ULL << 0x2a) | \
+	(1ULL << 0x2d) | (1ULL << 0x2e) | (1ULL << 0x30) | (1ULL << 0x3d) | \
+	(1ULL << 0x3e) | (1ULL << 0x3f) )
+
+/* Maximum number of opcodes gteFlagIsLive() looks ahead */
+#define GTE_FLAG_SCAN_MAX 64
+
+/* Returns false if the GTE FLAG register value produced by the GTE operation
+ *  being recompiled is certain to be overwritten before being read. Scans
+ *  forward through straight-line code from 'pc': FLAG is overwritten by
+ *  another GTE operation (they all clear it first) or a CTC2 to it, and read
+ *  by a CFC2 from it. Branches, jumps, exceptions and anything past the scan
+ *  limit are assumed to read it.
+ */
+static bool gteFlagIsLive()
+{
+	// Next opcode executed after one in a BD slot is not the one at 'pc'
+	if (branch)
+		return true;
+
+	for (int i = 0; i < GTE_FLAG_SCAN_MAX; ++i) {
+		const u32 addr = pc + i*4;
+
+		// Don't scan past end of mapped memory
+		if (!psxMemRLUT[addr >> 16])
+			return true;
+
+		const u32 code = OPCODE_AT(addr);
+		const u32 rs = (code >> 21) & 0x1f;
+		const u32 rd = (code >> 11) & 0x1f;
+
+		switch (code >> 26) {
+		case 0x00: // SPECIAL
+			switch (code & 0x3f) {
+			case 0x08: case 0x09:  // JR, JALR
+			case 0x0c: case 0x0d:  // SYSCALL, BREAK
+				return true;
+			}
+			break;
+
+		case 0x01: case 0x02: case 0x03:  // REGIMM branches, J, JAL
+		case 0x04: case 0x05: case 0x06: case 0x07:  // BEQ, BNE, BLEZ, BGTZ
+		case 0x3b:  // HLE
+			return true;
+
+		case 0x12: // COP2
+			if ((code & 0x3f) != 0) {
+				if (GTE_OP_FUNCS & (1ULL << (code & 0x3f)))
+					return false;
+			} else if (rd == 31) {
+				if (rs == 2) return true;   // CFC2 from FLAG
+				if (rs == 6) return false;  // CTC2 to FLAG
+			}
+			break;
+		}
+	}
+
+	return true;
+}
+
+/* Emit code to call a GTE func that takes no arguments */
+#define CP2_FUNC_0(f) \
+static void rec##f() \
+{ \
+	if (gteFlagIsLive()) \
+		CALL_FUNC(gte##f); \
+	else \
+		CALL_FUNC(gte##f##_nf); \
+}
+
+/* Emit code to call a GTE func that takes one argument, which is the 32-bit
+ *  opcode shifted right 10, from which it gets various parameters.
+ */
+#define CP2_FUNC_1(f) \
+static void rec##f() \
+{ \
+	MOV32RI(ARG_1, psxRegs.code >> 10); \
+	if (gteFlagIsLive()) \
+		CALL_FUNC(gte##f); \
+	else \
+		CALL_FUNC(gte##f##_nf); \
+}
+
+CP2_FUNC_0(RTPS)
+CP2_FUNC_0(NCLIP)
+CP2_FUNC_0(NCDS)
+CP2_FUNC_0(NCDT)
+CP2_FUNC_0(CDP)
+CP2_FUNC_0(NCCS)
+CP2_FUNC_0(CC)
+CP2_FUNC_0(NCS)
+CP2_FUNC_0(NCT)
+CP2_FUNC_0(DPCT)
+CP2_FUNC_0(AVSZ3)
+CP2_FUNC_0(AVSZ4)
+CP2_FUNC_0(RTPT)
+CP2_FUNC_0(NCCT)
+CP2_FUNC_1(OP)
+CP2_FUNC_1(DPCS)
+CP2_FUNC_1(INTPL)
+CP2_FUNC_1(MVMVA)
+CP2_FUNC_1(SQR)
+CP2_FUNC_1(DCPL)
+CP2_FUNC_1(GPF)
+CP2_FUNC_1(GPL)
+
+static void recCFC2()
+{
+// Rt = Cop2Ctrl->Rd
+	if (!_Rt_) return;
+
+	MOV32RM(TEMP_0, PERM_REG_1, off(CP2C.r[_Rd_]));
+	MOV32MR(PERM_REG_1, offGPR(_Rt_), TEMP_0);
+}
+
+static void recMFC2()
+{
+// Rt = Cop2Data->Rd
+	if (!_Rt_) return;
+
+	MOV32RI(ARG_1, _Rd_);
+	CALL_FUNC(gtecalcMFC2);
+	MOV32MR(PERM_REG_1, offGPR(_Rt_), TEMP_0);
+}
+
+static void recCTC2()
+{
+// Cop2Ctrl->Rd = Rt
+	emitLoadGPR(ARG_1, _Rt_);
+	MOV32RI(ARG_2, _Rd_);
+	CALL_FUNC(gtecalcCTC2);
+}
+
+static void recMTC2()
+{
+// Cop2Data->Rd = Rt
+	emitLoadGPR(ARG_1, _Rt_);
+	MOV32RI(ARG_2, _Rd_);
+	CALL_FUNC(gtecalcMTC2);
+}
+
+static void recLWC2()
+{
+// Cop2Data->Rt = mem[Rs + Im]
+	emitAddressToArg1();
+	CALL_FUNC(psxMemRead32);
+	MOV32RR(ARG_1, TEMP_0);
+	MOV32RI(ARG_2, _Rt_);
+	CALL_FUNC(gtecalcMTC2);
+}
+
+static void recSWC2()
+{
+// mem[Rs + Im] = Cop2Data->Rt
+	MOV32RI(ARG_1, _Rt_);
+	CALL_FUNC(gtecalcMFC2);
+	MOV32RR(ARG_2, TEMP_0);
+	emitAddressToArg1();
+	CALL_FUNC(psxMemWrite32);
+}
@@ -0,0 +1,160 @@
+/******************************************************************************
+ * IMPORTANT: The following host registers have unique usage restrictions.    *
+ *            See notes in x86_64_codegen.h for full details.                 *
+ *  X86REG_RBX, X86REG_R12                                                    *
+ *****************************************************************************/
+
+/* Emit code to put effective address Rs + Imm in ARG_1 */
+static void emitAddressToArg1()
+{
+	emitLoadGPR(ARG_1, _Rs_);
+	if (_Imm_ != 0)
+		ALU32RI(ALU_ADD, ARG_1, _Imm_);
+}
+
+enum {
+	LSU_8BIT_U, LSU_8BIT_S, LSU_16BIT_U, LSU_16BIT_S, LSU_32BIT
+};
+
+/* Used for LB, LBU, LH, LHU, LW
+ *
+ *  Loads use an inline fastpath through psxMemRLUT[] for all regions except
+ * the one containing scratchpad and HW I/O ports (0x1f80xxxx and mirrors),
+ * which goes through psxMemRead*(). Every psxMemRLUT[] entry is non-NULL,
+ * unmapped regions point to a zero-filled page, so no NULL check is needed.
+ */
+static void emitLoad(int type)
+{
+	emitAddressToArg1();
+
+	// TEMP_0 = page index, TEMP_1 = (page index & 0x1fff)
+	MOV32RR(TEMP_0, ARG_1);
+	SHIFT32RI(SHIFT_SHR, TEMP_0, 16);
+	MOV32RR(TEMP_1, TEMP_0);
+	ALU32RI(ALU_AND, TEMP_1, 0x1fff);
+	ALU32RI(ALU_CMP, TEMP_1, 0x1f80);
+	u8 *backpatch_slow = JCC32(CC_E);
+
+	// TEMP_2 = psxMemRLUT[page], TEMP_1 = offset into page
+	MOV64RI(TEMP_2, (uptr)&psxMemRLUT);
+	MOV64RM(TEMP_2, TEMP_2, 0);
+	MOV64RMIDX8(TEMP_2, TEMP_2, TEMP_0);
+	MOVZX32R16(TEMP_1, ARG_1);
+
+	switch (type) {
+		case LSU_8BIT_U:  MOVZX32RM8IDX(TEMP_0, TEMP_2, TEMP_1);  break;
+		case LSU_8BIT_S:  MOVSX32RM8IDX(TEMP_0, TEMP_2, TEMP_1);  break;
+		case LSU_16BIT_U: MOVZX32RM16IDX(TEMP_0, TEMP_2, TEMP_1); break;
+		case LSU_16BIT_S: MOVSX32RM16IDX(TEMP_0, TEMP_2, TEMP_1); break;
+		default:          MOV32RMIDX(TEMP_0, TEMP_2, TEMP_1);     break;
+	}
+	u8 *backpatch_done = JMP32();
+
+	// Slow path: ARG_1 still holds address. Upper bits of u8/u16 retvals
+	//  are undefined in the ABI, so extend them here.
+	fixup_branch(backpatch_slow);
+	switch (type) {
+		case LSU_8BIT_U:  CALL_FUNC(psxMemRead8);  MOVZX32R8(TEMP_0, TEMP_0);  break;
+		case LSU_8BIT_S:  CALL_FUNC(psxMemRead8);  MOVSX32R8(TEMP_0, TEMP_0);  break;
+		case LSU_16BIT_U: CALL_FUNC(psxMemRead16); MOVZX32R16(TEMP_0, TEMP_0); break;
+		case LSU_16BIT_S: CALL_FUNC(psxMemRead16); MOVSX32R16(TEMP_0, TEMP_0); break;
+		default:          CALL_FUNC(psxMemRead32); break;
+	}
+
+	fixup_branch(backpatch_done);
+	emitStoreGPR(_Rt_, TEMP_0);
+}
+
+static void recLB()
+{
+// Rt = mem[Rs + Im] (signed)
+	emitLoad(LSU_8BIT_S);
+}
+
+static void recLBU()
+{
+// Rt = mem[Rs + Im] (unsigned)
+	emitLoad(LSU_8BIT_U);
+}
+
+static void recLH()
+{
+// Rt = mem[Rs + Im] (signed)
+	emitLoad(LSU_16BIT_S);
+}
+
+static void recLHU()
+{
+// Rt = mem[Rs + Im] (unsigned)
+	emitLoad(LSU_16BIT_U);
+}
+
+static void recLW()
+{
+// Rt = mem[Rs + Im]
+	emitLoad(LSU_32BIT);
+}
+
+/* Used for SB, SH, SW
+ *
+ *  Stores always go through psxMemWrite*(), which handles HW I/O, cache
+ * isolation and code invalidation via psxCpu->Clear().
+ */
+static void emitStore(int type)
+{
+	emitAddressToArg1();
+	emitLoadGPR(ARG_2, _Rt_);
+
+	switch (type) {
+		case LSU_8BIT_U:
+			MOVZX32R8(ARG_2, ARG_2);
+			CALL_FUNC(psxMemWrite8);
+			break;
+		case LSU_16BIT_U:
+			MOVZX32R16(ARG_2, ARG_2);
+			CALL_FUNC(psxMemWrite16);
+			break;
+		default:
+			CALL_FUNC(psxMemWrite32);
+			break;
+	}
+}
+
+static void recSB()
+{
+// mem[Rs + Im] = Rt
+	emitStore(LSU_8BIT_U);
+}
+
+static void recSH()
+{
+// mem[Rs + Im] = Rt
+	emitStore(LSU_16BIT_U);
+}
+
+static void recSW()
+{
+// mem[Rs + Im] = Rt
+	emitStore(LSU_32BIT);
+}
+
+/* Unaligned loads/stores are rare enough to leave to the interpreter */
+static void recLWL()
+{
+	emitInterpreterCall(psxBSC[0x22]);
+}
+
+static void recLWR()
+{
+	emitInterpreterCall(psxBSC[0x26]);
+}
+
+static void recSWL()
+{
+	emitInterpreterCall(psxBSC[0x2a]);
+}
+
+static void recSWR()
+{
+	emitInterpreterCall(psxBSC[0x2e]);
+}
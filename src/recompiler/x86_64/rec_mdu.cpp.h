@@ -0,0 +1,129 @@
+/******************************************************************************
+ * IMPORTANT: The following host registers have unique usage restrictions.    *
+ *            See notes in x86_64_codegen.h for full details.                 *
+ *  X86REG_RBX, X86REG_R12                                                    *
+ *****************************************************************************/
+
+/* Used for MULT, MULTU: EDX:EAX = Rs * Rt */
+static void emitMult(bool is_signed)
+{
+	emitLoadGPR(TEMP_0, _Rs_);
+	if (is_signed)
+		IMUL32M(PERM_REG_1, offGPR(_Rt_));
+	else
+		MUL32M(PERM_REG_1, offGPR(_Rt_));
+	MOV32MR(PERM_REG_1, offGPR(32), TEMP_0);  // LO
+	MOV32MR(PERM_REG_1, offGPR(33), TEMP_2);  // HI
+}
+
+static void recMULT()
+{
+// Lo/Hi = Rs * Rt (signed)
+	emitMult(true);
+}
+
+static void recMULTU()
+{
+// Lo/Hi = Rs * Rt (unsigned)
+	emitMult(false);
+}
+
+static void recDIV()
+{
+// Lo/Hi = Rs / Rt (signed)
+//  Division by zero gives the same result as the real R3000A:
+//   Lo = (Rs >= 0) ? -1 : 1,  Hi = Rs
+//  0x80000000 / -1 would trap on x86, it gives Lo = 0x80000000, Hi = 0
+
+	emitLoadGPR(TEMP_1, _Rt_);
+	emitLoadGPR(TEMP_0, _Rs_);
+
+	TEST32RR(TEMP_1, TEMP_1);
+	u8 *backpatch_div0 = JCC32(CC_E);
+
+	ALU32RI(ALU_CMP, TEMP_1, -1);
+	u8 *backpatch_normal1 = JCC32(CC_NE);
+	ALU32RI(ALU_CMP, TEMP_0, 0x80000000);
+	u8 *backpatch_normal2 = JCC32(CC_NE);
+
+	// 0x80000000 / -1
+	MOV32MR(PERM_REG_1, offGPR(32), TEMP_0);
+	MOV32MI(PERM_REG_1, offGPR(33), 0);
+	u8 *backpatch_done1 = JMP32();
+
+	fixup_branch(backpatch_normal1);
+	fixup_branch(backpatch_normal2);
+	CDQ();
+	IDIV32R(TEMP_1);
+	MOV32MR(PERM_REG_1, offGPR(32), TEMP_0);
+	MOV32MR(PERM_REG_1, offGPR(33), TEMP_2);
+	u8 *backpatch_done2 = JMP32();
+
+	// Division by zero
+	fixup_branch(backpatch_div0);
+	MOV32MR(PERM_REG_1, offGPR(33), TEMP_0);
+	SHIFT32RI(SHIFT_SAR, TEMP_0, 31);         // 0 if Rs >= 0, else -1
+	ALU32RR(ALU_ADD, TEMP_0, TEMP_0);
+	NOT32R(TEMP_0);                           // -1 if Rs >= 0, else 1
+	MOV32MR(PERM_REG_1, offGPR(32), TEMP_0);
+
+	fixup_branch(backpatch_done1);
+	fixup_branch(backpatch_done2);
+}
+
+static void recDIVU()
+{
+// Lo/Hi = Rs / Rt (unsigned)
+//  Division by zero gives Lo = 0xffffffff, Hi = Rs
+
+	emitLoadGPR(TEMP_1, _Rt_);
+	emitLoadGPR(TEMP_0, _Rs_);
+
+	TEST32RR(TEMP_1, TEMP_1);
+	u8 *backpatch_div0 = JCC32(CC_E);
+
+	MOV32RI(TEMP_2, 0);
+	DIV32R(TEMP_1);
+	MOV32MR(PERM_REG_1, offGPR(32), TEMP_0);
+	MOV32MR(PERM_REG_1, offGPR(33), TEMP_2);
+	u8 *backpatch_done = JMP32();
+
+	// Division by zero
+	fixup_branch(backpatch_div0);
+	MOV32MR(PERM_REG_1, offGPR(33), TEMP_0);
+	MOV32MI(PERM_REG_1, offGPR(32), 0xffffffff);
+
+	fixup_branch(backpatch_done);
+}
+
+static void recMFHI()
+{
+// Rd = Hi
+	if (!_Rd_) return;
+
+	MOV32RM(TEMP_0, PERM_REG_1, offGPR(33));
+	MOV32MR(PERM_REG_1, offGPR(_Rd_), TEMP_0);
+}
+
+static void recMTHI()
+{
+// Hi = Rs
+	emitLoadGPR(TEMP_0, _Rs_);
+	MOV32MR(PERM_REG_1, offGPR(33), TEMP_0);
+}
+
+static void recMFLO()
+{
+// Rd = Lo
+	if (!_Rd_) return;
+
+	MOV32RM(TEMP_0, PERM_REG_1, offGPR(32));
+	MOV32MR(PERM_REG_1, offGPR(_Rd_), TEMP_0);
+}
+
+static void recMTLO()
+{
+// Lo = Rs
+	emitLoadGPR(TEMP_0, _Rs_);
+	MOV32MR(PERM_REG_1, offGPR(32), TEMP_0);
+}
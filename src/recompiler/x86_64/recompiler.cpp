@@ -0,0 +1,363 @@
+/*
+ * Mips-to-x86_64 recompiler for pcsx4all
+ *
+ * Copyright (c) 2009 Ulrich Hecht
+ * Copyright (c) 2017 modified by Dmitry Smagin, Daniel Silsby
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stddef.h>
+#include <sys/mman.h>
+#include "plugin_lib.h"
+#include "psxcommon.h"
+#include "psxhle.h"
+#include "psxmem.h"
+#include "psxhw.h"
+#include "r3000a.h"
+#include "gte.h"
+
+#define REC_LOG(...) printf("x86_64rec: " __VA_ARGS__)
+#ifndef REC_LOG
+#define REC_LOG(...)
+#endif
+
+//#define REC_LOG_V REC_LOG
+#ifndef REC_LOG_V
+#define REC_LOG_V(...)
+#endif
+
+/* Code buffer pointers: one per 32-bit PS1 instruction word */
+#define REC_RAM_PTR_SIZE  sizeof(uptr)
+#define REC_RAM_SIZE      (0x200000/4 * REC_RAM_PTR_SIZE)
+#define REC_ROM_SIZE      (0x80000/4 * REC_RAM_PTR_SIZE)
+
+/* Bitfield indicating which 4KB pages of PS1 RAM contain the start of a block.
+ *  Used in recClear() to avoid needless code invalidations. */
+static u8 code_pages[0x200000/4096/8];
+
+/* Pointers to block code, indexed by PS1 PC. Unlike the MIPS recompiler,
+ *  these are always looked up through psxRecLUT[], which masks away the
+ *  banking and mirroring of PS1 addresses. */
+static s8 *recRAM;
+static s8 *recROM;
+static uptr psxRecLUT[0x10000];
+
+#undef PC_REC
+#undef PC_REC64
+#define PC_REC(x)	((uptr)psxRecLUT[(x) >> 16] + (((x) & 0xffff) * (REC_RAM_PTR_SIZE / 4)))
+#define PC_REC64(x)	(*(uptr *)PC_REC(x))
+
+#include "x86_64_codegen.h"
+
+/* Code buffer lives in .bss so emitted code lies within +/-2GB of the
+ *  emulator's own functions and data. This lets CALL_FUNC() use direct
+ *  calls. recInit() makes the buffer executable.
+ */
+#define RECMEM_SIZE         (12 * 1024 * 1024)
+#define RECMEM_SIZE_MAX     (RECMEM_SIZE-(512*1024))
+static u8 recMemBase[RECMEM_SIZE] __attribute__((aligned(4096)));
+
+u8         *recMem;                /* Where does next emitted opcode in block go? */
+static u32 pc;                     /* Recompiler pc */
+static u32 oldpc;                  /* Recompiler pc at start of block */
+u32 cycle_multiplier = 0x200;      /* Cycle advance per emulated instruction
+                                      0x100 == 1.0  0x200 == 2.0  etc */
+
+static bool branch;                        /* Current instruction lies in a BD slot? */
+static bool end_block;                     /* Has recompilation phase ended? */
+static bool flush_code_on_dma3_exe_load;   /* Flush code cache when psxDma3() detects EXE load? */
+
+static void recReset();
+static void recRecompile();
+static void recClear(u32 Addr, u32 Size);
+static void recNotify(int note, void *data);
+
+extern void (*recBSC[64])();
+extern void (*recSPC[64])();
+extern void (*recREG[32])();
+extern void (*recCP0[32])();
+extern void (*recCP2[64])();
+extern void (*recCP2BSC[32])();
+
+/* Interpreter tables and single-step, see psxinterpreter.cpp */
+extern void (*psxBSC[64])(void);
+extern void execI(void);
+
+/* Emit call to interpreter handler for current opcode. Used for rare
+ *  opcodes where native emitters wouldn't gain anything (LWL/LWR etc).
+ */
+static void emitInterpreterCall(void (*func)(void))
+{
+	MOV32MI(PERM_REG_1, off(code), psxRegs.code);
+	CALL_FUNC(func);
+}
+
+#include "opcodes.h"
+
+
+/* Set default recompilation options, and any per-game settings */
+static void rec_set_options()
+{
+	// Default options
+	flush_code_on_dma3_exe_load = false;
+
+	// Per-game options
+	// -> Use case-insensitive comparisons! Some CDs have lowercase CdromId.
+
+	// 'Studio 33' game workarounds, see comments in MIPS recompiler.
+	//  Stores always invalidate code here (they go through psxMemWrite*()),
+	//  so only the DMA3 flush part of the workaround applies.
+	if (strncasecmp(CdromId, "SCES03886", 9) == 0  ||  // Formula 1 Arcade
+	    strncasecmp(CdromId, "SLUS00870", 9) == 0  ||  // Formula 1 '99  NTSC US
+	    strncasecmp(CdromId, "SCPS10101", 9) == 0  ||  // Formula 1 '99  NTSC J (untested)
+	    strncasecmp(CdromId, "SCES01979", 9) == 0  ||  // Formula 1 '99  PAL  E (requires .SBI subchannel file)
+	    strncasecmp(CdromId, "SLES01979", 9) == 0  ||  // Formula 1 '99  PAL  E (unknown revision, couldn't test)
+	    strncasecmp(CdromId, "SCES03404", 9) == 0  ||  // Formula 1 2001 PAL  E,Fi (fixes broken AI/controls)
+	    strncasecmp(CdromId, "SCES03423", 9) == 0)     // Formula 1 2001 PAL  Fr,G (fixes broken AI/controls)
+	{
+		REC_LOG("Using Icache workarounds for trouble games 'Formula One 99/2001/etc'.\n");
+		flush_code_on_dma3_exe_load = true;
+	}
+}
+
+
+static void recRecompile()
+{
+	// Notify plugin_lib that we're recompiling (affects frameskip timing)
+	pl_dynarec_notify();
+
+	if (((uptr)recMem - (uptr)recMemBase) >= RECMEM_SIZE_MAX ) {
+		REC_LOG("Code cache size limit exceeded: flushing code cache.\n");
+		recReset();
+	}
+
+	PC_REC64(psxRegs.pc) = (uptr)recMem;
+	oldpc = pc = psxRegs.pc;
+
+	// If 'pc' is in PS1 RAM, mark the page of RAM as containing the start of
+	//  a block. For the range check, bit 27 is interpreted as a sign bit.
+	if ((s32)(pc << 4) >= 0) {
+		u32 masked_pc = pc & 0x1fffff;
+		code_pages[masked_pc/4096/8] |= (1 << ((masked_pc/4096) & 7));
+	}
+
+	rec_recompile_start();
+
+	// Flag indicates when recompilation should stop
+	end_block = false;
+
+	do {
+		// Flag indicates if next instruction lies in a BD slot
+		branch = false;
+
+		psxRegs.code = OPCODE_AT(pc);
+
+		// A branch with another branch in its BD slot can't be recompiled.
+		//  The interpreter handles it (see psxDelayBranchTest()), so end the
+		//  block before it. A block starting at it has the interpreter run
+		//  the branch and its BD slot, adding their cycles itself.
+		if (opcodeIsBranchOrJump(psxRegs.code) &&
+		    opcodeIsBranchOrJump(OPCODE_AT(pc + 4))) {
+			MOV32MI(PERM_REG_1, off(pc), pc);
+			if (pc == oldpc)
+				CALL_FUNC(execI);
+			rec_recompile_end();
+			break;
+		}
+
+		pc += 4;
+
+		// Recompile next instruction.
+		recBSC[psxRegs.code>>26]();
+	} while (!end_block);
+}
+
+
+static int recInit()
+{
+	REC_LOG("Initializing\n");
+
+	recMem = recMemBase;
+
+	// Make code buffer executable. Filling with 'int3' should force an
+	//  exception on any accidental non-code execution.
+	memset(recMemBase, 0xcc, RECMEM_SIZE);
+	if (mprotect(recMemBase, RECMEM_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC) < 0) {
+		printf("Error making code buffer executable\n"); return -1;
+	}
+
+	recRAM = (s8*)malloc(REC_RAM_SIZE);
+	recROM = (s8*)malloc(REC_ROM_SIZE);
+
+	if (recRAM == NULL || recROM == NULL) {
+		printf("Error allocating memory\n"); return -1;
+	}
+
+	recReset();
+
+	for (int i = 0; i < 0x80; i++)
+		psxRecLUT[i + 0x0000] = (uptr)recRAM + (((i & 0x1f) << 16) * (REC_RAM_PTR_SIZE/4));
+
+	memcpy(&psxRecLUT[0x8000], psxRecLUT, 0x80 * sizeof(psxRecLUT[0]));
+	memcpy(&psxRecLUT[0xa000], psxRecLUT, 0x80 * sizeof(psxRecLUT[0]));
+
+	for (int i = 0; i < 0x08; i++)
+		psxRecLUT[i + 0xbfc0] = (uptr)recROM + ((i << 16) * (REC_RAM_PTR_SIZE/4));
+
+	return 0;
+}
+
+
+static void recShutdown()
+{
+	REC_LOG("Shutting down\n");
+
+	free(recRAM);
+	free(recROM);
+	recRAM = recROM = NULL;
+}
+
+
+/* Blocks are plain C-callable functions: they save/restore the 'saved' host
+ *  regs they use, update psxRegs.pc and psxRegs.cycle themselves, and
+ *  return. So unlike the MIPS recompiler, dispatch loops need no asm.
+ */
+typedef void (*rec_block_func)(void);
+
+/* Execute blocks starting at psxRegs.pc until target_pc is reached.
+ *  Used by BIOS bootstrap and HLE BIOS softcalls.
+ */
+static void recExecuteBlock(unsigned target_pc)
+{
+	do {
+		uptr *p = (uptr *)PC_REC(psxRegs.pc);
+		if (*p == 0)
+			recRecompile();
+
+		((rec_block_func)*p)();
+
+		if (psxRegs.cycle >= psxRegs.io_cycle_counter)
+			psxBranchTest();
+	} while (psxRegs.pc != target_pc);
+}
+
+
+static void recExecute()
+{
+	// Clear code cache, so that any now-dead code emitted during BIOS
+	//  startup is discarded. Non-dead BIOS code gets recompiled fresh.
+	recReset();
+
+	for (;;) {
+		uptr *p = (uptr *)PC_REC(psxRegs.pc);
+		if (*p == 0)
+			recRecompile();
+
+		((rec_block_func)*p)();
+
+		if (psxRegs.cycle >= psxRegs.io_cycle_counter)
+			psxBranchTest();
+	}
+}
+
+
+/* Invalidate 'Size' code block pointers at word-aligned PS1 address 'Addr'. */
+static void recClear(u32 Addr, u32 Size)
+{
+	const u32 masked_ram_addr = Addr & 0x1ffffc;
+
+	// Check if the page(s) of PS1 RAM that 'Addr','Size' target contain the
+	//  start of any blocks. If not, invalidation would have no effect and is
+	//  skipped. This eliminates 99% of large unnecessary invalidations that
+	//  occur when many games stream CD data in-game.
+	u32 page = masked_ram_addr/4096;
+	u32 end_page = ((masked_ram_addr + (Size-1)*4)/4096) + 1;
+	bool has_code = false;
+	do {
+		u32 pflag = 1 << (page & 7);  // Each byte in code_pages[] represents 8 pages
+		has_code = code_pages[page/8] & pflag;
+	} while ((++page != end_page) && !has_code);
+
+	if (has_code) {
+		void *dst = (void*)((uptr)recRAM + (masked_ram_addr * REC_RAM_PTR_SIZE/4));
+		memset(dst, 0, Size*REC_RAM_PTR_SIZE);
+	}
+}
+
+
+/* Notification from emulator. */
+static void recNotify(int note, void *data __attribute__((unused)))
+{
+	switch (note)
+	{
+		/* R3000ACPU_NOTIFY_CACHE_ISOLATED,
+		 * R3000ACPU_NOTIFY_CACHE_UNISOLATED
+		 *  Sent from psxMemWrite32_CacheCtrlPort(). Also see notes there.
+		 */
+		case R3000ACPU_NOTIFY_CACHE_ISOLATED:
+			REC_LOG_V("R3000ACPU_NOTIFY_CACHE_ISOLATED\n");
+			break;
+		case R3000ACPU_NOTIFY_CACHE_UNISOLATED:
+			/* Flush entire code cache, game has loaded new code. */
+			recClear(0, 0x200000/4);
+			REC_LOG_V("R3000ACPU_NOTIFY_CACHE_UNISOLATED\n");
+			break;
+
+		/* Sent from psxDma3(). Also see notes there and in MIPS recompiler. */
+		case R3000ACPU_NOTIFY_DMA3_EXE_LOAD:
+			if (flush_code_on_dma3_exe_load) {
+				recClear(0, 0x200000/4);
+				REC_LOG_V("R3000ACPU_NOTIFY_DMA3_EXE_LOAD .. Flushing dynarec cache\n");
+			} else {
+				REC_LOG_V("R3000ACPU_NOTIFY_DMA3_EXE_LOAD\n");
+			}
+			break;
+
+		default:
+			break;
+	}
+}
+
+
+static void recReset()
+{
+	memset(code_pages, 0, sizeof(code_pages));
+	memset(recRAM, 0, REC_RAM_SIZE);
+	memset(recROM, 0, REC_ROM_SIZE);
+
+	recMem = recMemBase;
+
+	// Set default recompilation options and any per-game options
+	rec_set_options();
+}
+
+
+R3000Acpu psxRec =
+{
+	recInit,
+	recReset,
+	recExecute,
+	recExecuteBlock,
+	recClear,
+	recNotify,
+	recShutdown
+};
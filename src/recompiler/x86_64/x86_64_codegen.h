@@ -0,0 +1,437 @@
+/*
+ * x86_64_codegen.h
+ *
+ * Copyright (c) 2009 Ulrich Hecht
+ * Copyright (c) 2018 modified by Dmitry Smagin / Daniel Silsby
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef X86_64_CODEGEN_H
+#define X86_64_CODEGEN_H
+
+/* Host registers
+ *
+ *    USAGE RESTRICTIONS IN CODE EMITTERS:
+ *
+ * X86REG_RAX,
+ * X86REG_RCX,
+ * X86REG_RDX      Scratch regs. Any call to C code via CALL_FUNC() clobbers
+ *                  them, along with RSI,RDI,R8..R11 (SysV ABI).
+ *
+ * X86REG_RDI,
+ * X86REG_RSI      First and second argument of C functions called from
+ *                  emitted code.
+ *
+ * X86REG_RBX      Holds pointer to psxRegs struct, a.k.a. PERM_REG_1.
+ *
+ * X86REG_R12      Holds new PC of a conditional branch or indirect jump
+ *                  while its BD slot executes, a.k.a. BRANCH_REG. It is a
+ *                  'saved' reg, so it survives calls made from the BD slot.
+ *
+ * X86REG_R13      Saved by block prologue only to keep the stack 16-byte
+ *                  aligned for C calls. Free for use by emitters.
+ *
+ *  Unlike the MIPS recompiler, PS1 GPRs are not allocated to host regs:
+ *  emitted code operates directly on psxRegs.GPR in memory. x86 can use
+ *  memory operands for nearly all ALU ops, so this is still fast.
+ */
+typedef enum {
+	X86REG_RAX = 0,
+	X86REG_RCX,
+	X86REG_RDX,
+	X86REG_RBX,
+	X86REG_RSP,
+	X86REG_RBP,
+	X86REG_RSI,
+	X86REG_RDI,
+	X86REG_R8,
+	X86REG_R9,
+	X86REG_R10,
+	X86REG_R11,
+	X86REG_R12,
+	X86REG_R13,
+	X86REG_R14,
+	X86REG_R15
+} X86Reg;
+
+/* Free for use as temporaries in emitted code. */
+#define TEMP_0               X86REG_RAX
+#define TEMP_1               X86REG_RCX
+#define TEMP_2               X86REG_RDX
+
+/* Function call arguments (SysV AMD64 ABI) */
+#define ARG_1                X86REG_RDI
+#define ARG_2                X86REG_RSI
+
+/* PERM_REG_1 is pointer to psxRegs struct */
+#define PERM_REG_1           X86REG_RBX
+
+/* BRANCH_REG holds a branch's new PC across its BD slot */
+#define BRANCH_REG           X86REG_R12
+
+#if !defined(__x86_64__)
+ #error "This recompiler only supports x86-64 hosts."
+#endif
+
+extern u8 *recMem;
+
+/* Crazy macro to calculate offset of the field in the structure.
+ *  (Can't use standard offsetof() with non-const expressions)
+ */
+#ifndef OFFSET_OF
+#define OFFSET_OF(T,F) ((unsigned int)((char *)&((T *)0L)->F - (char *)0L))
+#endif
+
+/* GPR offset */
+#define offGPR(rx)	OFFSET_OF(psxRegisters, GPR.r[rx])
+
+/* CP0 offset */
+#define offCP0(rx)	OFFSET_OF(psxRegisters, CP0.r[rx])
+
+#define off(field)	OFFSET_OF(psxRegisters, field)
+
+/* Get u32 opcode val at location in PS1 code.
+ * See notes in psxMemWrite32_CacheCtrlPort() regarding why it is best
+ *  to read code here using PSXM*() macros, i.e. through psxMemRLUT[].
+ */
+#define OPCODE_AT(loc) PSXMu32(loc)
+
+
+/* x86 condition codes, used by JCC(), SETCC(), CMOVCC() */
+typedef enum {
+	CC_O  = 0x0, CC_NO = 0x1, CC_B  = 0x2, CC_AE = 0x3,
+	CC_E  = 0x4, CC_NE = 0x5, CC_BE = 0x6, CC_A  = 0x7,
+	CC_S  = 0x8, CC_NS = 0x9, CC_P  = 0xa, CC_NP = 0xb,
+	CC_L  = 0xc, CC_GE = 0xd, CC_LE = 0xe, CC_G  = 0xf
+} X86Cond;
+
+/* Group-1 ALU ops, used by ALU32_*() */
+typedef enum {
+	ALU_ADD = 0, ALU_OR  = 1, ALU_ADC = 2, ALU_SBB = 3,
+	ALU_AND = 4, ALU_SUB = 5, ALU_XOR = 6, ALU_CMP = 7
+} X86AluOp;
+
+/* Group-2 shift ops, used by SHIFT32_*() */
+typedef enum {
+	SHIFT_SHL = 4, SHIFT_SHR = 5, SHIFT_SAR = 7
+} X86ShiftOp;
+
+
+#define write8(i) \
+	do { *recMem++ = (u8)(i); } while (0)
+
+#define write32(i) \
+	do { *(u32 *)recMem = (u32)(i); recMem += 4; } while (0)
+
+#define write64(i) \
+	do { *(u64 *)recMem = (u64)(i); recMem += 8; } while (0)
+
+static inline bool x86_is_imm8(s32 imm) { return imm >= -128 && imm <= 127; }
+
+/* REX prefix. Emitted only if needed, or 'force' is set (byte regs SPL..DIL) */
+static inline void x86_rex(int w, int reg, int index, int base, bool force = false)
+{
+	u8 rex = 0x40 | (w ? 8 : 0) | ((reg & 8) ? 4 : 0) |
+	         ((index & 8) ? 2 : 0) | ((base & 8) ? 1 : 0);
+	if (rex != 0x40 || force)
+		write8(rex);
+}
+
+/* Opcodes are passed as an int holding one or two bytes, i.e. 0x8b, 0x0fb6 */
+static inline void x86_opcode(u32 op)
+{
+	if (op > 0xff)
+		write8(op >> 8);
+	write8(op);
+}
+
+/* Emit 'op' with ModRM operand [base + disp] */
+static inline void x86_op_mem(int w, u32 op, int reg, int base, s32 disp)
+{
+	x86_rex(w, reg, 0, base);
+	x86_opcode(op);
+
+	const int rm = base & 7;
+	if (disp == 0 && rm != X86REG_RBP) {
+		write8(0x00 | ((reg & 7) << 3) | rm);
+		if (rm == X86REG_RSP) write8(0x24);
+	} else if (x86_is_imm8(disp)) {
+		write8(0x40 | ((reg & 7) << 3) | rm);
+		if (rm == X86REG_RSP) write8(0x24);
+		write8(disp);
+	} else {
+		write8(0x80 | ((reg & 7) << 3) | rm);
+		if (rm == X86REG_RSP) write8(0x24);
+		write32(disp);
+	}
+}
+
+/* Emit 'op' with ModRM operand [base + index*(1 << scale)] */
+static inline void x86_op_mem_idx(int w, u32 op, int reg, int base, int index, int scale)
+{
+	x86_rex(w, reg, index, base);
+	x86_opcode(op);
+
+	if ((base & 7) == X86REG_RBP) {
+		write8(0x44 | ((reg & 7) << 3));
+		write8((scale << 6) | ((index & 7) << 3) | (base & 7));
+		write8(0);
+	} else {
+		write8(0x04 | ((reg & 7) << 3));
+		write8((scale << 6) | ((index & 7) << 3) | (base & 7));
+	}
+}
+
+/* Emit 'op' with register-direct ModRM operand */
+static inline void x86_op_reg(int w, u32 op, int reg, int rm, bool force_rex = false)
+{
+	x86_rex(w, reg, 0, rm, force_rex);
+	x86_opcode(op);
+	write8(0xc0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+
+#define MOV32RM(rd, base, disp)       x86_op_mem(0, 0x8b, rd, base, disp)   /* mov rd32, [base+disp]  */
+#define MOV32MR(base, disp, rs)       x86_op_mem(0, 0x89, rs, base, disp)   /* mov [base+disp], rs32  */
+#define MOV64RM(rd, base, disp)       x86_op_mem(1, 0x8b, rd, base, disp)   /* mov rd64, [base+disp]  */
+#define MOV32RR(rd, rs)               x86_op_reg(0, 0x89, rs, rd)           /* mov rd32, rs32         */
+#define MOV64RR(rd, rs)               x86_op_reg(1, 0x89, rs, rd)           /* mov rd64, rs64         */
+
+/* mov dword [base+disp], imm32 */
+#define MOV32MI(base, disp, imm) \
+do { \
+	x86_op_mem(0, 0xc7, 0, base, disp); \
+	write32(imm); \
+} while (0)
+
+/* mov rd32, imm32 (zero-extends into upper half of 64-bit reg) */
+#define MOV32RI(rd, imm) \
+do { \
+	if ((u32)(imm) == 0) { \
+		x86_op_reg(0, 0x31, rd, rd); /* xor rd32, rd32 */ \
+	} else { \
+		x86_rex(0, 0, 0, rd); \
+		write8(0xb8 | ((rd) & 7)); \
+		write32(imm); \
+	} \
+} while (0)
+
+/* mov rd64, imm64 */
+#define MOV64RI(rd, imm) \
+do { \
+	if ((u64)(imm) <= 0xffffffffULL) { \
+		MOV32RI(rd, (u32)(uptr)(imm)); \
+	} else { \
+		x86_rex(1, 0, 0, rd); \
+		write8(0xb8 | ((rd) & 7)); \
+		write64(imm); \
+	} \
+} while (0)
+
+/* Group-1 ALU op: rd32 = rd32 <op> [base+disp] */
+#define ALU32RM(aluop, rd, base, disp)  x86_op_mem(0, ((aluop) << 3) | 3, rd, base, disp)
+
+/* Group-1 ALU op: rd32 = rd32 <op> rs32 */
+#define ALU32RR(aluop, rd, rs)          x86_op_reg(0, ((aluop) << 3) | 1, rs, rd)
+
+/* Group-1 ALU op: rd32 = rd32 <op> imm32 */
+#define ALU32RI(aluop, rd, imm) \
+do { \
+	if (x86_is_imm8((s32)(imm))) { \
+		x86_op_reg(0, 0x83, aluop, rd); \
+		write8(imm); \
+	} else { \
+		x86_op_reg(0, 0x81, aluop, rd); \
+		write32(imm); \
+	} \
+} while (0)
+
+/* Group-1 ALU op: dword [base+disp] = [base+disp] <op> imm32 */
+#define ALU32MI(aluop, base, disp, imm) \
+do { \
+	if (x86_is_imm8((s32)(imm))) { \
+		x86_op_mem(0, 0x83, aluop, base, disp); \
+		write8(imm); \
+	} else { \
+		x86_op_mem(0, 0x81, aluop, base, disp); \
+		write32(imm); \
+	} \
+} while (0)
+
+/* Shift rd32 by const amount */
+#define SHIFT32RI(sop, rd, sa) \
+do { \
+	x86_op_reg(0, 0xc1, sop, rd); \
+	write8((sa) & 0x1f); \
+} while (0)
+
+/* Shift rd32 by amount in CL (x86 masks count to 5 bits, same as MIPS) */
+#define SHIFT32RCL(sop, rd)           x86_op_reg(0, 0xd3, sop, rd)
+
+#define NOT32R(rd)                    x86_op_reg(0, 0xf7, 2, rd)
+#define TEST32RR(ra, rb)              x86_op_reg(0, 0x85, rb, ra)
+#define TEST64RR(ra, rb)              x86_op_reg(1, 0x85, rb, ra)
+#define CDQ()                         write8(0x99)
+
+/* One-operand multiply/divide on EDX:EAX */
+#define MUL32M(base, disp)            x86_op_mem(0, 0xf7, 4, base, disp)
+#define IMUL32M(base, disp)           x86_op_mem(0, 0xf7, 5, base, disp)
+#define DIV32R(rs)                    x86_op_reg(0, 0xf7, 6, rs)
+#define IDIV32R(rs)                   x86_op_reg(0, 0xf7, 7, rs)
+
+/* Zero/sign extensions */
+#define MOVZX32R8(rd, rs)             x86_op_reg(0, 0x0fb6, rd, rs, ((rs) & 7) >= 4)
+#define MOVZX32R16(rd, rs)            x86_op_reg(0, 0x0fb7, rd, rs)
+#define MOVSX32R8(rd, rs)             x86_op_reg(0, 0x0fbe, rd, rs, ((rs) & 7) >= 4)
+#define MOVSX32R16(rd, rs)            x86_op_reg(0, 0x0fbf, rd, rs)
+
+/* Loads from [base + index] */
+#define MOV32RMIDX(rd, base, idx)     x86_op_mem_idx(0, 0x8b,   rd, base, idx, 0)
+#define MOVZX32RM8IDX(rd, base, idx)  x86_op_mem_idx(0, 0x0fb6, rd, base, idx, 0)
+#define MOVZX32RM16IDX(rd, base, idx) x86_op_mem_idx(0, 0x0fb7, rd, base, idx, 0)
+#define MOVSX32RM8IDX(rd, base, idx)  x86_op_mem_idx(0, 0x0fbe, rd, base, idx, 0)
+#define MOVSX32RM16IDX(rd, base, idx) x86_op_mem_idx(0, 0x0fbf, rd, base, idx, 0)
+
+/* Load 64-bit ptr from [base + index*8] */
+#define MOV64RMIDX8(rd, base, idx)    x86_op_mem_idx(1, 0x8b,   rd, base, idx, 3)
+
+/* Conditional set/move */
+#define SETCC8(cc, rd)                x86_op_reg(0, 0x0f90 | (cc), 0, rd, ((rd) & 7) >= 4)
+#define CMOVCC32RR(cc, rd, rs)        x86_op_reg(0, 0x0f40 | (cc), rd, rs)
+
+#define PUSH64R(r) \
+do { \
+	x86_rex(0, 0, 0, r); \
+	write8(0x50 | ((r) & 7)); \
+} while (0)
+
+#define POP64R(r) \
+do { \
+	x86_rex(0, 0, 0, r); \
+	write8(0x58 | ((r) & 7)); \
+} while (0)
+
+#define RET() \
+	write8(0xc3)
+
+/* Jumps with 32-bit displacement. They return address of the displacement
+ *  field, which must be filled in with fixup_branch() once target is known.
+ */
+static inline u8 *JCC32(X86Cond cc)
+{
+	write8(0x0f);
+	write8(0x80 | cc);
+	u8 *backpatch = recMem;
+	write32(0);
+	return backpatch;
+}
+
+static inline u8 *JMP32()
+{
+	write8(0xe9);
+	u8 *backpatch = recMem;
+	write32(0);
+	return backpatch;
+}
+
+#define fixup_branch(BACKPATCH) \
+do { \
+	*(s32 *)(BACKPATCH) = (s32)(recMem - ((u8 *)(BACKPATCH) + 4)); \
+} while (0)
+
+/* Call C function: uses a direct rel32 call if target lies within +/-2GB of
+ *  emitted code (the usual case for non-PIE builds), otherwise goes through
+ *  RAX. Clobbers all 'unsaved' regs of the SysV ABI.
+ */
+#define CALL_FUNC(fn) \
+do { \
+	s64 rel__ = (s64)((uptr)(fn) - ((uptr)recMem + 5)); \
+	if (rel__ >= INT32_MIN && rel__ <= INT32_MAX) { \
+		write8(0xe8); \
+		write32((s32)rel__); \
+	} else { \
+		MOV64RI(X86REG_RAX, (uptr)(fn)); \
+		write8(0xff); write8(0xd0); /* call rax */ \
+	} \
+} while (0)
+
+
+static inline u32 ADJUST_CLOCK(u32 cycles)
+{
+	extern u32 cycle_multiplier;
+	return (cycles * cycle_multiplier) >> 8;
+}
+
+/* start of the recompiled block
+ *
+ * Blocks are called from C dispatch loops as plain 'void fn(void)'. Three
+ *  pushes keep the stack 16-byte aligned for any C calls made by the block.
+ */
+#define rec_recompile_start()                                                  \
+do {                                                                           \
+    PUSH64R(X86REG_RBX);                                                       \
+    PUSH64R(X86REG_R12);                                                       \
+    PUSH64R(X86REG_R13);                                                       \
+    MOV64RI(PERM_REG_1, (uptr)&psxRegs);                                       \
+} while (0)
+
+/* end of the recompiled block
+ *
+ * Caller has already stored new value for psxRegs.pc. Block adds the
+ *  cycles it has taken to psxRegs.cycle itself, dispatch loop then checks
+ *  psxRegs.io_cycle_counter.
+ */
+#define rec_recompile_end()                                                    \
+do {                                                                           \
+    const u32 cycles = ADJUST_CLOCK((pc-oldpc)/4);                             \
+    ALU32MI(ALU_ADD, PERM_REG_1, off(cycle), cycles);                          \
+    POP64R(X86REG_R13);                                                        \
+    POP64R(X86REG_R12);                                                        \
+    POP64R(X86REG_RBX);                                                        \
+    RET();                                                                     \
+} while (0)
+
+
+static inline bool opcodeIsBranch(const u32 opcode)
+{
+	return (_fOp_(opcode) == 0x01 && (_fRt_(opcode) == 0x00 || // BLTZ
+	                                  _fRt_(opcode) == 0x01 || // BGEZ
+	                                  _fRt_(opcode) == 0x10 || // BLTZAL
+	                                  _fRt_(opcode) == 0x11))  // BGEZAL
+	       ||
+	       (_fOp_(opcode) >= 0x04 && _fOp_(opcode) <= 0x07);   // BEQ,BNE,BLEZ,BGTZ
+}
+
+static inline bool opcodeIsJump(const u32 opcode)
+{
+	return (_fOp_(opcode) == 0x00 && (_fFunct_(opcode) == 0x08 ||  // JR
+	                                  _fFunct_(opcode) == 0x09))   // JALR
+	       || _fOp_(opcode) == 0x02 || _fOp_(opcode) == 0x03;      // J,JAL
+}
+
+static inline bool opcodeIsBranchOrJump(const u32 opcode)
+{
+	return opcodeIsBranch(opcode) || opcodeIsJump(opcode);
+}
+
+#endif /* X86_64_CODEGEN_H */
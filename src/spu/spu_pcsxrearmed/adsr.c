@@ -63,7 +63,7 @@ INLINE void StartADSR(int ch)                          // MIX ADSR
 
 ////////////////////////////////////////////////////////////////////////
 
-static int MixADSR(ADSRInfoEx *adsr, int ns_to)
+static int MixADSR(int *ChanBuf, ADSRInfoEx *adsr, int ns_to)
 {
  int EnvelopeVol = adsr->EnvelopeVol;
  int ns = 0, val, rto, level;
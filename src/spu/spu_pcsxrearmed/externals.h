@@ -196,6 +196,7 @@ typedef struct
  unsigned int    dwNewChannel;         // flags for faster testing, if new channel starts
  unsigned int    dwChannelOn;          // not silent channels
  unsigned int    dwChannelDead;        // silent+not useful channels
+ unsigned int    dwPitchChanged;       // pitch writes not yet seen by the mixer
 
  unsigned char * pSpuBuffer;
  short         * pS;
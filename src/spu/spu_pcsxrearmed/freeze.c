@@ -333,6 +333,7 @@ void LoadStateV5(SPUFreeze_t * pF)
  spu.dwNewChannel=0;
  spu.dwChannelOn=0;
  spu.dwChannelDead=0;
+ spu.dwPitchChanged=0;
  for(i=0;i<MAXCHAN;i++)
   {
    load_channel(&spu.s_chan[i],&pFO->s_chan[i],i);
@@ -356,6 +357,7 @@ void LoadStateUnknown(SPUFreeze_t * pF, uint32_t cycles)
  spu.dwNewChannel=0;
  spu.dwChannelOn=0;
  spu.dwChannelDead=0;
+ spu.dwPitchChanged=0;
  spu.pSpuIrq=spu.spuMemC;
 
  for(i=0;i<0xc0;i++)
@@ -64,6 +64,9 @@ INLINE int rvb2ram_offs(int curr, int space, int iOff)
 ////////////////////////////////////////////////////////////////////////
 
 // portions based on spu2-x from PCSX2
+#ifdef SPU_USE_SIMD
+#define MixREVERB MixREVERB_simd
+#else
 static void MixREVERB(int *SSumLR, int *RVB, int ns_to, int curr_addr)
 {
  const REVERBInfo *rvb = spu.rvb;
@@ -144,6 +147,7 @@ static void MixREVERB(int *SSumLR, int *RVB, int ns_to, int curr_addr)
    if (curr_addr >= 0x40000) curr_addr = rvb->StartAddr;
   }
 }
+#endif
 
 static void MixREVERB_off(int *SSumLR, int ns_to, int curr_addr)
 {
@@ -45,6 +45,16 @@
  } while (0)
 #endif
 
+// SPU_USE_SIMD selects vector mixing, reverb and output scaling from
+//  spu_simd.h. It is set on little-endian platforms with 128-bit integer
+//  SIMD that includes byte shuffles, unless SPU_NO_SIMD is defined. ARMv5+
+//  builds keep the asm mix_chan() from arm_utils.S.
+#if !defined(SPU_NO_SIMD) && defined(__GNUC__) && !defined(__clang__) && \
+    defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ && \
+    (defined(__SSSE3__) || defined(__ARM_NEON__) || defined(__ARM_NEON))
+#define SPU_USE_SIMD
+#endif
+
 // intended to be ~1 frame
 #define IRQ_NEAR_BLOCKS 32
 
@@ -74,6 +84,8 @@ SPUConfig       spu_config;
 static int iFMod[NSSIZE];
 static int RVB[NSSIZE * 2];
 int ChanBuf[NSSIZE];
+// Functions that fill or mix a channel buffer take it as 'ChanBuf' argument,
+//  so worker threads can each use their own, see do_channel_group()
 
 #define CDDA_BUFFER_SIZE (16384 * sizeof(uint32_t)) // must be power of 2
 
@@ -83,6 +95,9 @@ int ChanBuf[NSSIZE];
 
 // dirty inline func includes
 
+#ifdef SPU_USE_SIMD
+#include "spu_simd.h"
+#endif
 #include "reverb.c"
 #include "adsr.c"
 
@@ -526,7 +541,7 @@ static void scan_for_irq(int ch, unsigned int *upd_samples)
 }
 
 #define make_do_samples(name, fmod_code, interp_start, interp1_code, interp2_code, interp_end) \
-static noinline int do_samples_##name( \
+static noinline int do_samples_##name(int *ChanBuf, \
  int (*decode_f)(void *context, int ch, int *SB), void *ctx, \
  int ch, int ns_to, int *SB, int sinc, int *spos, int *sbpos) \
 {                                            \
@@ -570,6 +585,9 @@ make_do_samples(default, fmod_recv_check, ,
   StoreInterpolationVal(SB, sinc, fa, spu.s_chan[ch].bFMod==2),
   ChanBuf[ns] = iGetInterpolationVal(SB, sinc, *spos, spu.s_chan[ch].bFMod==2), )
 make_do_samples(noint, , fa = SB[29], , ChanBuf[ns] = fa, SB[29] = fa)
+make_do_samples(nofmod, , ,
+  StoreInterpolationVal(SB, sinc, fa, 0),
+  ChanBuf[ns] = iGetInterpolationVal(SB, sinc, *spos, 0), )
 
 #define simple_interp_store \
   SB[28] = 0; \
@@ -614,7 +632,7 @@ static int do_samples_skip(int ch, int ns_to)
  return ret;
 }
 
-static void do_lsfr_samples(int ns_to, int ctrl,
+static void do_lsfr_samples(int *ChanBuf, int ns_to, int ctrl,
  unsigned int *dwNoiseCount, unsigned int *dwNoiseVal)
 {
  unsigned int counter = *dwNoiseCount;
@@ -651,17 +669,23 @@ static int do_samples_noise(int ch, int ns_to)
 
  ret = do_samples_skip(ch, ns_to);
 
- do_lsfr_samples(ns_to, spu.spuCtrl, &spu.dwNoiseCount, &spu.dwNoiseVal);
+ do_lsfr_samples(ChanBuf, ns_to, spu.spuCtrl, &spu.dwNoiseCount, &spu.dwNoiseVal);
 
  return ret;
 }
 
 #ifdef HAVE_ARMV5
-// asm code; lv and rv must be 0-3fff
+// asm code; lv and rv must be 0-3fff. It always mixes global ChanBuf,
+//  so there can only be one worker thread, see init_spu_thread().
 extern void mix_chan(int *SSumLR, int count, int lv, int rv);
 extern void mix_chan_rvb(int *SSumLR, int count, int lv, int rv, int *rvb);
+#define mix_chan(ChanBuf, ...) mix_chan(__VA_ARGS__)
+#define mix_chan_rvb(ChanBuf, ...) mix_chan_rvb(__VA_ARGS__)
+#elif defined(SPU_USE_SIMD)
+#define mix_chan mix_chan_simd
+#define mix_chan_rvb mix_chan_rvb_simd
 #else
-static void mix_chan(int *SSumLR, int count, int lv, int rv)
+static void mix_chan(const int *ChanBuf, int *SSumLR, int count, int lv, int rv)
 {
  const int *src = ChanBuf;
  int l, r;
@@ -677,7 +701,7 @@ static void mix_chan(int *SSumLR, int count, int lv, int rv)
   }
 }
 
-static void mix_chan_rvb(int *SSumLR, int count, int lv, int rv, int *rvb)
+static void mix_chan_rvb(const int *ChanBuf, int *SSumLR, int count, int lv, int rv, int *rvb)
 {
  const int *src = ChanBuf;
  int *dst = SSumLR;
@@ -700,7 +724,7 @@ static void mix_chan_rvb(int *SSumLR, int count, int lv, int rv, int *rvb)
 
 // 0x0800-0x0bff  Voice 1
 // 0x0c00-0x0fff  Voice 3
-static noinline void do_decode_bufs(unsigned short *mem, int which,
+static noinline void do_decode_bufs(const int *ChanBuf, unsigned short *mem, int which,
  int count, int decode_pos)
 {
  unsigned short *dst = &mem[0x800/2 + which*0x400/2];
@@ -755,6 +779,21 @@ static void do_silent_chans(int ns_to, int silentch)
   }
 }
 
+// freq change in simple interpolation mode: set flag. Done by whoever
+//  mixes the channel, so that worker threads see it in order.
+static void apply_pitch_changes(unsigned int mask)
+{
+ int ch;
+
+ if (spu_config.iUseInterpolation != 1)
+  return;
+
+ for (ch = 0; mask != 0; ch++, mask >>= 1) {
+  if (mask & 1)
+   spu.SB[ch * SB_SIZE + 32] = 1;
+ }
+}
+
 static void do_channels(int ns_to)
 {
  unsigned int mask;
@@ -766,6 +805,9 @@ static void do_channels(int ns_to)
  if (do_rvb)
   memset(RVB, 0, ns_to * sizeof(RVB[0]) * 2);
 
+ apply_pitch_changes(spu.dwPitchChanged);
+ spu.dwPitchChanged = 0;
+
  mask = spu.dwNewChannel & 0xffffff;
  for (ch = 0; mask != 0; ch++, mask >>= 1) {
   if (mask & 1)
@@ -785,16 +827,16 @@ static void do_channels(int ns_to)
     d = do_samples_noise(ch, ns_to);
    else if (s_chan->bFMod == 2
          || (s_chan->bFMod == 0 && spu_config.iUseInterpolation == 0))
-    d = do_samples_noint(decode_block, NULL, ch, ns_to,
+    d = do_samples_noint(ChanBuf, decode_block, NULL, ch, ns_to,
           SB, sinc, &s_chan->spos, &s_chan->iSBPos);
    else if (s_chan->bFMod == 0 && spu_config.iUseInterpolation == 1)
-    d = do_samples_simple(decode_block, NULL, ch, ns_to,
+    d = do_samples_simple(ChanBuf, decode_block, NULL, ch, ns_to,
           SB, sinc, &s_chan->spos, &s_chan->iSBPos);
    else
-    d = do_samples_default(decode_block, NULL, ch, ns_to,
+    d = do_samples_default(ChanBuf, decode_block, NULL, ch, ns_to,
           SB, sinc, &s_chan->spos, &s_chan->iSBPos);
 
-   d = MixADSR(&s_chan->ADSRX, d);
+   d = MixADSR(ChanBuf, &s_chan->ADSRX, d);
    if (d < ns_to) {
     spu.dwChannelOn &= ~(1 << ch);
     s_chan->ADSRX.EnvelopeVol = 0;
@@ -803,16 +845,16 @@ static void do_channels(int ns_to)
 
    if (ch == 1 || ch == 3)
     {
-     do_decode_bufs(spu.spuMem, ch/2, ns_to, spu.decode_pos);
+     do_decode_bufs(ChanBuf, spu.spuMem, ch/2, ns_to, spu.decode_pos);
      spu.decode_dirty_ch |= 1 << ch;
     }
 
    if (s_chan->bFMod == 2)                         // fmod freq channel
     memcpy(iFMod, &ChanBuf, ns_to * sizeof(iFMod[0]));
    if (s_chan->bRVBActive && do_rvb)
-    mix_chan_rvb(spu.SSumLR, ns_to, s_chan->iLeftVolume, s_chan->iRightVolume, RVB);
+    mix_chan_rvb(ChanBuf, spu.SSumLR, ns_to, s_chan->iLeftVolume, s_chan->iRightVolume, RVB);
    else
-    mix_chan(spu.SSumLR, ns_to, s_chan->iLeftVolume, s_chan->iRightVolume);
+    mix_chan(ChanBuf, spu.SSumLR, ns_to, s_chan->iLeftVolume, s_chan->iRightVolume);
   }
 
   if (spu.rvb->StartAddr) {
@@ -861,6 +903,9 @@ static struct spu_worker {
   unsigned int channels_new;
   unsigned int channels_on;
   unsigned int channels_silent;
+  unsigned int channels_noise;
+  unsigned int channels_rvb;
+  unsigned int pitch_changed;
   struct {
    int spos;
    int sbpos;
@@ -871,7 +916,6 @@ static struct spu_worker {
    short vol_l;
    short vol_r;
    ADSRInfoEx adsr;
-   // might also want to add fmod flags..
   } ch[24];
   int SSumLR[NSSIZE * 2];
  } i[4];
@@ -936,6 +980,13 @@ static void queue_channel_work(int ns_to, unsigned int silentch)
  mask = work->channels_on = spu.dwChannelOn & 0xffffff;
  spu.decode_dirty_ch |= mask & 0x0a;
 
+ // silent channels keep their pending pitch flag until they are mixed
+ work->pitch_changed = spu.dwPitchChanged & (mask | work->channels_new);
+ spu.dwPitchChanged &= ~work->pitch_changed;
+
+ // the emu thread may change these before the item is mixed
+ work->channels_noise = work->channels_rvb = 0;
+
  for (ch = 0; mask != 0; ch++, mask >>= 1)
   {
    if (!(mask & 1)) continue;
@@ -951,6 +1002,10 @@ static void queue_channel_work(int ns_to, unsigned int silentch)
    work->ch[ch].loop = s_chan->pLoop - spu.spuMemC;
    if (s_chan->prevflags & 1)
     work->ch[ch].start = work->ch[ch].loop;
+   if (s_chan->bNoise)
+    work->channels_noise |= 1 << ch;
+   if (s_chan->bRVBActive)
+    work->channels_rvb |= 1 << ch;
 
    d = do_samples_skip(ch, ns_to);
    work->ch[ch].ns_to = d;
@@ -977,11 +1032,14 @@ static void queue_channel_work(int ns_to, unsigned int silentch)
  thread_work_start();
 }
 
-static void do_channel_work(struct work_item *work)
+// Mix channels of 'work' that are set in 'group' to 'SSumLR', using
+//  'ChanBuf' and 'RVB' as scratch buffers. Reverb is not applied.
+// FMod steps are never queued, see do_samples().
+static void do_channel_group(struct work_item *work, unsigned int group,
+ int *ChanBuf, int *SSumLR, int *RVB)
 {
  unsigned int mask;
  unsigned int decode_dirty_ch = 0;
- const SPUCHAN *s_chan;
  int *SB, sinc, spos, sbpos;
  int d, ch, ns_to;
 
@@ -990,13 +1048,15 @@ static void do_channel_work(struct work_item *work)
  if (work->rvb_addr)
   memset(RVB, 0, ns_to * sizeof(RVB[0]) * 2);
 
- mask = work->channels_new;
+ mask = work->channels_new & group;
  for (ch = 0; mask != 0; ch++, mask >>= 1) {
   if (mask & 1)
    StartSoundSB(spu.SB + ch * SB_SIZE);
  }
 
- mask = work->channels_on;
+ apply_pitch_changes(work->pitch_changed & group);
+
+ mask = work->channels_on & group;
  for (ch = 0; mask != 0; ch++, mask >>= 1)
   {
    if (!(mask & 1)) continue;
@@ -1006,20 +1066,18 @@ static void do_channel_work(struct work_item *work)
    sbpos = work->ch[ch].sbpos;
    sinc = work->ch[ch].sinc;
 
-   s_chan = &spu.s_chan[ch];
    SB = spu.SB + ch * SB_SIZE;
 
-   if (s_chan->bNoise)
-    do_lsfr_samples(d, work->ctrl, &spu.dwNoiseCount, &spu.dwNoiseVal);
-   else if (s_chan->bFMod == 2
-         || (s_chan->bFMod == 0 && spu_config.iUseInterpolation == 0))
-    do_samples_noint(decode_block_work, work, ch, d, SB, sinc, &spos, &sbpos);
-   else if (s_chan->bFMod == 0 && spu_config.iUseInterpolation == 1)
-    do_samples_simple(decode_block_work, work, ch, d, SB, sinc, &spos, &sbpos);
+   if (work->channels_noise & (1 << ch))
+    do_lsfr_samples(ChanBuf, d, work->ctrl, &spu.dwNoiseCount, &spu.dwNoiseVal);
+   else if (spu_config.iUseInterpolation == 0)
+    do_samples_noint(ChanBuf, decode_block_work, work, ch, d, SB, sinc, &spos, &sbpos);
+   else if (spu_config.iUseInterpolation == 1)
+    do_samples_simple(ChanBuf, decode_block_work, work, ch, d, SB, sinc, &spos, &sbpos);
    else
-    do_samples_default(decode_block_work, work, ch, d, SB, sinc, &spos, &sbpos);
+    do_samples_nofmod(ChanBuf, decode_block_work, work, ch, d, SB, sinc, &spos, &sbpos);
 
-   d = MixADSR(&work->ch[ch].adsr, d);
+   d = MixADSR(ChanBuf, &work->ch[ch].adsr, d);
    if (d < ns_to) {
     work->ch[ch].adsr.EnvelopeVol = 0;
     memset(&ChanBuf[d], 0, (ns_to - d) * sizeof(ChanBuf[0]));
@@ -1027,22 +1085,28 @@ static void do_channel_work(struct work_item *work)
 
    if (ch == 1 || ch == 3)
     {
-     do_decode_bufs(spu.spuMem, ch/2, ns_to, work->decode_pos);
+     do_decode_bufs(ChanBuf, spu.spuMem, ch/2, ns_to, work->decode_pos);
      decode_dirty_ch |= 1 << ch;
     }
 
-   if (s_chan->bFMod == 2)                         // fmod freq channel
-    memcpy(iFMod, &ChanBuf, ns_to * sizeof(iFMod[0]));
-   if (s_chan->bRVBActive && work->rvb_addr)
-    mix_chan_rvb(work->SSumLR, ns_to,
+   if ((work->channels_rvb & (1 << ch)) && work->rvb_addr)
+    mix_chan_rvb(ChanBuf, SSumLR, ns_to,
       work->ch[ch].vol_l, work->ch[ch].vol_r, RVB);
    else
-    mix_chan(work->SSumLR, ns_to, work->ch[ch].vol_l, work->ch[ch].vol_r);
+    mix_chan(ChanBuf, SSumLR, ns_to, work->ch[ch].vol_l, work->ch[ch].vol_r);
   }
+}
 
-  if (work->rvb_addr)
-   REVERBDo(work->SSumLR, RVB, ns_to, work->rvb_addr);
+#if defined(C64X_DSP) || defined(WANT_THREAD_CODE)
+// Whole work item on one thread
+static void do_channel_work(struct work_item *work)
+{
+ do_channel_group(work, ~0u, ChanBuf, work->SSumLR, RVB);
+
+ if (work->rvb_addr)
+  REVERBDo(work->SSumLR, RVB, work->ns_to, work->rvb_addr);
 }
+#endif
 
 static void sync_worker_thread(int force)
 {
@@ -1082,6 +1146,22 @@ static const void * const worker = NULL;
 
 #endif // THREAD_ENABLED
 
+static void init_spu_thread(void);
+static void exit_spu_thread(void);
+
+// Start or stop worker threads when spu_config.iUseThread was changed
+static void restart_spu_thread(void)
+{
+ if (worker != NULL)
+  sync_worker_thread(1);
+ exit_spu_thread();
+ if (spu_config.iUseThread)
+  init_spu_thread();
+
+ // Fewer threads may have started
+ spu_config.iUseThread = spu_config.iThreadAvail;
+}
+
 ////////////////////////////////////////////////////////////////////////
 // MAIN SPU FUNCTION
 // here is the main job handler...
@@ -1101,11 +1181,22 @@ void do_samples(unsigned int cycles_to, int do_direct)
    return;
   }
 
+ if (unlikely(spu_config.iUseThread != spu_config.iThreadAvail))
+  restart_spu_thread();
+
  silentch = ~(spu.dwChannelOn | spu.dwNewChannel) & 0xffffff;
 
  do_direct |= (silentch == 0xffffff);
- if (worker != NULL)
+ if (worker != NULL) {
+  // fmod channels feed each other through iFMod, mix them here
+  unsigned int mask = ~silentch & 0xffffff;
+  int ch;
+  for (ch = 0; mask != 0 && !do_direct; ch++, mask >>= 1) {
+   if ((mask & 1) && spu.s_chan[ch].bFMod)
+    do_direct = 1;
+  }
   sync_worker_thread(do_direct);
+ }
 
  if (cycle_diff < 2 * 768)
   return;
@@ -1170,8 +1261,10 @@ static void do_samples_finish(int *SSumLR, int ns_to,
  int silentch, int decode_pos)
 {
   int volmult = spu_config.iVolume;
+#ifndef SPU_USE_SIMD
   int ns;
   int d;
+#endif
 
   // must clear silent channel decode buffers
   if(unlikely(silentch & spu.decode_dirty_ch & (1<<1)))
@@ -1193,6 +1286,12 @@ static void do_samples_finish(int *SSumLR, int ns_to,
     spu.pS += ns_to * 2;
    }
   else
+#ifdef SPU_USE_SIMD
+   {
+    spu_scale_out_simd(spu.pS, SSumLR, ns_to * 2, volmult);
+    spu.pS += ns_to * 2;
+   }
+#else
   for (ns = 0; ns < ns_to * 2; )
    {
     d = SSumLR[ns]; SSumLR[ns] = 0;
@@ -1207,6 +1306,7 @@ static void do_samples_finish(int *SSumLR, int ns_to,
     *spu.pS++ = d;
     ns++;
    }
+#endif
 }
 
 void schedule_next_irq(void)
@@ -1253,7 +1353,11 @@ void schedule_next_irq(void)
 
 void CALLBACK SPUasync(unsigned int cycle, unsigned int flags)
 {
- do_samples(cycle, spu_config.iUseFixedUpdates);
+ // With fixed updates, all samples up to 'cycle' must be in the buffer
+ //  fed to output below, but until then worker threads can mix them
+ do_samples(cycle, 0);
+ if (spu_config.iUseFixedUpdates && (flags & 1) && worker != NULL)
+  sync_worker_thread(1);
 
  if (spu.spuCtrl & CTRL_IRQ)
   schedule_next_irq();
@@ -1354,47 +1458,152 @@ static void RemoveStreams(void)
 #include <semaphore.h>
 #include <unistd.h>
 
+/* generic pthread implementation
+ *
+ * Channels of a work item are split into groups, one per thread, which are
+ * mixed in parallel. Threads claim groups by incrementing a shared counter,
+ * so there is no lock: semaphores only put idle threads to sleep. Last thread
+ * to finish a group of an item adds up all groups, applies reverb and then
+ * lets threads start on next item. Items are done one at a time, as channel
+ * state (SB) carries over from one to the next.
+ */
+
+// Scratch buffers of groups other than 0, which uses the global ones
+struct spu_group {
+ int ChanBuf[NSSIZE];
+ int SSumLR[NSSIZE * 2];
+ int RVB[NSSIZE * 2];
+};
+
 static struct {
- pthread_t thread;
- sem_t sem_avail;
- sem_t sem_done;
+ pthread_t thread[SPU_MAX_THREADS];
+ int count;                   // threads running, also number of groups
+ struct spu_group *groups;    // count - 1 of them
+ sem_t sem_avail;             // posted for each group ready to be mixed
+ sem_t sem_done;              // posted when an item is done, if 'waiting'
+ unsigned int group_next;     // next group to claim, counted from item 0
+ unsigned int groups_left;    // groups of current item not mixed yet
+ unsigned int pending;        // items queued and not done
+ unsigned int waiting;        // emu thread waits for sem_done
+ unsigned int mask[WORK_MAXCNT][SPU_MAX_THREADS]; // channels of each group
+ unsigned int done[WORK_MAXCNT]; // i + 1 once item i is done
 } t;
 
-/* generic pthread implementation */
+// Let threads mix groups of next item
+static void thread_release_item(void)
+{
+ int g;
+
+ __atomic_store_n(&t.groups_left, t.count, __ATOMIC_RELAXED);
+ for (g = 0; g < t.count; g++)
+  sem_post(&t.sem_avail);
+}
 
+// Split channels of item just queued into groups. Noise and FMod channels
+//  all go to group 0, as they share the noise generator and iFMod[] and
+//  must be mixed in order. Others are dealt out to balance the groups.
 static void thread_work_start(void)
 {
- sem_post(&t.sem_avail);
+ unsigned int i = worker->i_ready - 1;
+ const struct work_item *work = &worker->i[i & WORK_I_MASK];
+ unsigned int *mask = t.mask[i & WORK_I_MASK];
+ unsigned int left = work->channels_on | work->channels_new;
+ int ch, g = 0;
+
+ memset(mask, 0, sizeof(t.mask[0]));
+ for (ch = 0; left != 0; ch++, left >>= 1) {
+  if (!(left & 1)) continue;
+  if (work->channels_noise & (1 << ch))
+   mask[0] |= 1 << ch;
+  else {
+   mask[g] |= 1 << ch;
+   if (++g == t.count)
+    g = 0;
+  }
+ }
+
+ if (__atomic_fetch_add(&t.pending, 1, __ATOMIC_ACQ_REL) == 0)
+  thread_release_item();
 }
 
 static void thread_work_wait_sync(struct work_item *work, int force)
 {
- sem_wait(&t.sem_done);
+ unsigned int i = worker->i_reaped;
+
+ for (;;) {
+  __atomic_store_n(&t.waiting, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&t.done[i & WORK_I_MASK], __ATOMIC_SEQ_CST) == i + 1)
+   break;
+  sem_wait(&t.sem_done);
+ }
 }
 
 static int thread_get_i_done(void)
 {
- return worker->i_done;
+ unsigned int i = worker->i_reaped;
+
+ while (i != worker->i_ready
+        && __atomic_load_n(&t.done[i & WORK_I_MASK], __ATOMIC_ACQUIRE) == i + 1)
+  i++;
+ return i;
 }
 
 static void thread_sync_caches(void)
 {
 }
 
+// Add up groups of item 'i' and apply reverb. Called by last thread done.
+static void thread_finish_item(struct work_item *work, unsigned int i)
+{
+ int ns_to = work->ns_to;
+ int g, ns;
+
+ for (g = 1; g < t.count; g++) {
+  const struct spu_group *grp = &t.groups[g - 1];
+  for (ns = 0; ns < ns_to * 2; ns++)
+   work->SSumLR[ns] += grp->SSumLR[ns];
+  if (work->rvb_addr)
+   for (ns = 0; ns < ns_to * 2; ns++)
+    RVB[ns] += grp->RVB[ns];
+ }
+
+ if (work->rvb_addr)
+  REVERBDo(work->SSumLR, RVB, ns_to, work->rvb_addr);
+
+ __atomic_store_n(&t.done[i & WORK_I_MASK], i + 1, __ATOMIC_SEQ_CST);
+ if (__atomic_exchange_n(&t.waiting, 0, __ATOMIC_SEQ_CST))
+  sem_post(&t.sem_done);
+
+ if (__atomic_sub_fetch(&t.pending, 1, __ATOMIC_ACQ_REL) != 0)
+  thread_release_item();
+}
+
 static void *spu_worker_thread(void *unused)
 {
  struct work_item *work;
+ struct spu_group *grp;
+ unsigned int n, i, g;
 
  while (1) {
   sem_wait(&t.sem_avail);
   if (worker->exit_thread)
    break;
 
-  work = &worker->i[worker->i_done & WORK_I_MASK];
-  do_channel_work(work);
-  worker->i_done++;
+  n = __atomic_fetch_add(&t.group_next, 1, __ATOMIC_ACQ_REL);
+  i = n / t.count;
+  g = n % t.count;
+  work = &worker->i[i & WORK_I_MASK];
 
-  sem_post(&t.sem_done);
+  if (g == 0)
+   do_channel_group(work, t.mask[i & WORK_I_MASK][0], ChanBuf, work->SSumLR, RVB);
+  else {
+   grp = &t.groups[g - 1];
+   memset(grp->SSumLR, 0, work->ns_to * sizeof(grp->SSumLR[0]) * 2);
+   do_channel_group(work, t.mask[i & WORK_I_MASK][g], grp->ChanBuf, grp->SSumLR, grp->RVB);
+  }
+
+  if (__atomic_sub_fetch(&t.groups_left, 1, __ATOMIC_ACQ_REL) == 0)
+   thread_finish_item(work, i);
  }
 
  return NULL;
@@ -1402,7 +1611,7 @@ static void *spu_worker_thread(void *unused)
 
 static void init_spu_thread(void)
 {
- int ret;
+ int ret, i, count = spu_config.iUseThread;
 
  //senquack: allow creating thread even on single-core system, even though it
  //          likely will degrade performance. It can only be enabled via
@@ -1411,9 +1620,21 @@ static void init_spu_thread(void)
  //if (sysconf(_SC_NPROCESSORS_ONLN) <= 1)
  // return;
 
+ if (count > SPU_MAX_THREADS)
+  count = SPU_MAX_THREADS;
+#ifdef HAVE_ARMV5
+ count = 1; // see mix_chan()
+#endif
+
+ memset(&t, 0, sizeof(t));
  worker = calloc(1, sizeof(*worker));
  if (worker == NULL)
-  return;
+  goto fail_worker;
+ if (count > 1) {
+  t.groups = calloc(count - 1, sizeof(t.groups[0]));
+  if (t.groups == NULL)
+   goto fail_groups;
+ }
  ret = sem_init(&t.sem_avail, 0, 0);
  if (ret != 0)
   goto fail_sem_avail;
@@ -1421,13 +1642,20 @@ static void init_spu_thread(void)
  if (ret != 0)
   goto fail_sem_done;
 
- ret = pthread_create(&t.thread, NULL, spu_worker_thread, NULL);
- if (ret != 0)
+ // Threads only look at t.count once they get work
+ t.count = count;
+ for (i = 0; i < count; i++) {
+  ret = pthread_create(&t.thread[i], NULL, spu_worker_thread, NULL);
+  if (ret != 0)
+   break;
+ }
+ t.count = i;
+ if (t.count == 0)
   goto fail_thread;
 
- printf("Started spu_worker_thread()\n"); //senquack - print some status if started
+ printf("Started %d spu_worker_thread()\n", t.count); //senquack - print some status if started
 
- spu_config.iThreadAvail = 1;
+ spu_config.iThreadAvail = t.count;
  return;
 
 fail_thread:
@@ -1435,22 +1663,34 @@ fail_thread:
 fail_sem_done:
  sem_destroy(&t.sem_avail);
 fail_sem_avail:
+ free(t.groups);
+ t.groups = NULL;
+fail_groups:
  free(worker);
  worker = NULL;
+fail_worker:
  spu_config.iThreadAvail = 0;
 }
 
 static void exit_spu_thread(void)
 {
+ int i;
+
  if (worker == NULL)
   return;
  worker->exit_thread = 1;
- sem_post(&t.sem_avail);
- pthread_join(t.thread, NULL);
+ for (i = 0; i < t.count; i++)
+  sem_post(&t.sem_avail);
+ for (i = 0; i < t.count; i++)
+  pthread_join(t.thread[i], NULL);
  sem_destroy(&t.sem_done);
  sem_destroy(&t.sem_avail);
+ free(t.groups);
+ t.groups = NULL;
+ t.count = 0;
  free(worker);
  worker = NULL;
+ spu_config.iThreadAvail = 0;
 }
 
 #else // if !THREAD_ENABLED
@@ -1493,11 +1733,11 @@ long CALLBACK SPUinit(void)
  //if (spu_config.iVolume == 0)
  // spu_config.iVolume = 768; // 1024 is 1.0
 
- //senquack - only start thread if iUseThread==1:
- //           NOTE: if emulator eventually allows settings to be changed without retart,
- //                 init_spu_thread() will need to be called on setting change.
+ //senquack - only start thread if iUseThread!=0:
+ //           Threads are started or stopped by do_samples() when it changes later.
  if (spu_config.iUseThread)
   init_spu_thread();
+ spu_config.iUseThread = spu_config.iThreadAvail;
 
  for (i = 0; i < MAXCHAN; i++)                         // loop sound channels
   {
@@ -2,6 +2,8 @@
 #define SPU_CONFIG_H
 // user settings
 
+#define SPU_MAX_THREADS 4
+
 typedef struct
 {
  int        iVolume;
@@ -9,11 +11,11 @@ typedef struct
  int        iUseReverb;
  int        iUseInterpolation;
  int        iTempo;
- int        iUseThread;
+ int        iUseThread;        // worker threads mixing channels, 0..SPU_MAX_THREADS
  int        iUseFixedUpdates;  // output fixed number of samples/frame
 
  // status
- int        iThreadAvail;
+ int        iThreadAvail;      // worker threads running
 
  //senquack - added to disable audio (presumably from command line)
  int		iDisabled;
@@ -0,0 +1,227 @@
+// Vector versions of channel mixing, reverb and output scaling, included
+//  by spu.c when SPU_USE_SIMD is set. Results are identical to the scalar
+//  code in spu.c and reverb.c, which remains the reference.
+//
+// Written with GCC vector extensions, like mdec_simd.h, so the same code
+//  compiles to SSE on x86 and NEON on ARM. Reverb depends on the previous
+//  sample, so only the work within a sample is done in vectors there: the
+//  four IIR, ACC and mix lanes. ADPCM decode is left scalar for the same
+//  reason, its predictor is most of the work.
+//
+// NOTE: this does not make the SPU as a whole measurably faster. In
+//  bench/spu_bench these routines are about a tenth of the mixing time;
+//  the rest is the per-channel decode and interpolation, which stay
+//  scalar. With -mssse3 the whole mix is within 5% of SPU_NO_SIMD, about
+//  the run to run noise. Kept because the output is bit-exact and the
+//  routines themselves run faster.
+
+#ifndef SPU_SIMD_H
+#define SPU_SIMD_H
+
+typedef int            spu_v4s32 __attribute__((vector_size(16)));
+typedef short          spu_v8s16 __attribute__((vector_size(16)));
+
+#define SPU_V4(a,b,c,d) ((spu_v4s32){ a, b, c, d })
+
+INLINE spu_v4s32 spuSplatV(int x)
+{
+ return SPU_V4(x, x, x, x);
+}
+
+INLINE spu_v4s32 spuLoadV(const int *p)
+{
+ spu_v4s32 v;
+ memcpy(&v, p, sizeof(v));
+ return v;
+}
+
+INLINE void spuStoreV(int *p, spu_v4s32 v)
+{
+ memcpy(p, &v, sizeof(v));
+}
+
+// Saturate to 16 bits, see ssat32_to_16()
+INLINE spu_v4s32 spuSat16V(spu_v4s32 v)
+{
+ const spu_v4s32 lo = spuSplatV(-32768), hi = spuSplatV(32767);
+ spu_v4s32 m = v < lo;
+ v = (v & ~m) | (lo & m);
+ m = v > hi;
+ return (v & ~m) | (hi & m);
+}
+
+////////////////////////////////////////////////////////////////////////
+// channel mixing
+////////////////////////////////////////////////////////////////////////
+
+#ifndef HAVE_ARMV5
+// See mix_chan(). Each sample is duplicated into a left and right lane, so
+//  four samples give two vectors of interleaved output.
+static void mix_chan_simd(const int *ChanBuf, int *SSumLR, int count, int lv, int rv)
+{
+ const spu_v4s32 vol = SPU_V4(lv, rv, lv, rv);
+ const spu_v4s32 dup_lo = SPU_V4(0, 0, 1, 1), dup_hi = SPU_V4(2, 2, 3, 3);
+ int ns;
+
+ for (ns = 0; ns + 4 <= count; ns += 4, SSumLR += 8)
+  {
+   spu_v4s32 s = spuLoadV(ChanBuf + ns);
+   spu_v4s32 a = (__builtin_shuffle(s, dup_lo) * vol) >> 14;
+   spu_v4s32 b = (__builtin_shuffle(s, dup_hi) * vol) >> 14;
+   spuStoreV(SSumLR,     spuLoadV(SSumLR)     + a);
+   spuStoreV(SSumLR + 4, spuLoadV(SSumLR + 4) + b);
+  }
+
+ for (; ns < count; ns++)
+  {
+   int sval = ChanBuf[ns];
+   *SSumLR++ += (sval * lv) >> 14;
+   *SSumLR++ += (sval * rv) >> 14;
+  }
+}
+
+// See mix_chan_rvb()
+static void mix_chan_rvb_simd(const int *ChanBuf, int *SSumLR, int count, int lv, int rv, int *rvb)
+{
+ const spu_v4s32 vol = SPU_V4(lv, rv, lv, rv);
+ const spu_v4s32 dup_lo = SPU_V4(0, 0, 1, 1), dup_hi = SPU_V4(2, 2, 3, 3);
+ int ns;
+
+ for (ns = 0; ns + 4 <= count; ns += 4, SSumLR += 8, rvb += 8)
+  {
+   spu_v4s32 s = spuLoadV(ChanBuf + ns);
+   spu_v4s32 a = (__builtin_shuffle(s, dup_lo) * vol) >> 14;
+   spu_v4s32 b = (__builtin_shuffle(s, dup_hi) * vol) >> 14;
+   spuStoreV(SSumLR,     spuLoadV(SSumLR)     + a);
+   spuStoreV(SSumLR + 4, spuLoadV(SSumLR + 4) + b);
+   spuStoreV(rvb,        spuLoadV(rvb)        + a);
+   spuStoreV(rvb + 4,    spuLoadV(rvb + 4)    + b);
+  }
+
+ for (; ns < count; ns++)
+  {
+   int sval = ChanBuf[ns];
+   int l = (sval * lv) >> 14;
+   int r = (sval * rv) >> 14;
+   *SSumLR++ += l;
+   *SSumLR++ += r;
+   *rvb++ += l;
+   *rvb++ += r;
+  }
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////
+// reverb
+////////////////////////////////////////////////////////////////////////
+
+// Four reverb area offsets from 'curr', see rvb2ram_offs()
+INLINE spu_v4s32 spuRvbOffsV(spu_v4s32 offs, spu_v4s32 curr, spu_v4s32 space)
+{
+ spu_v4s32 a = offs + curr;
+ return a - (space & (a >= spuSplatV(0x40000)));
+}
+
+INLINE spu_v4s32 spuRvbLoadV(spu_v4s32 a)
+{
+ const signed short *mem = (const signed short *)spu.spuMem;
+ return SPU_V4(mem[a[0]], mem[a[1]], mem[a[2]], mem[a[3]]);
+}
+
+// Stored in lane order, so the last lane wins if offsets are the same,
+//  like the scalar code
+INLINE void spuRvbStoreV(spu_v4s32 a, spu_v4s32 v)
+{
+ unsigned short *mem = spu.spuMem;
+ mem[a[0]] = v[0];
+ mem[a[1]] = v[1];
+ mem[a[2]] = v[2];
+ mem[a[3]] = v[3];
+}
+
+// See MixREVERB(). Lanes hold the A0, A1, B0, B1 values of each stage,
+//  with ACC0 and ACC1 in both halves.
+static void MixREVERB_simd(int *SSumLR, int *RVB, int ns_to, int curr_addr)
+{
+ const REVERBInfo *rvb = spu.rvb;
+ const spu_v4s32 space = spuSplatV(0x40000 - rvb->StartAddr);
+ const spu_v4s32 iir_src  = SPU_V4(rvb->IIR_SRC_A0, rvb->IIR_SRC_A1, rvb->IIR_SRC_B0, rvb->IIR_SRC_B1);
+ const spu_v4s32 iir_dest = SPU_V4(rvb->IIR_DEST_A0, rvb->IIR_DEST_A1, rvb->IIR_DEST_B0, rvb->IIR_DEST_B1);
+ const spu_v4s32 acc_ab   = SPU_V4(rvb->ACC_SRC_A0, rvb->ACC_SRC_A1, rvb->ACC_SRC_B0, rvb->ACC_SRC_B1);
+ const spu_v4s32 acc_cd   = SPU_V4(rvb->ACC_SRC_C0, rvb->ACC_SRC_C1, rvb->ACC_SRC_D0, rvb->ACC_SRC_D1);
+ const spu_v4s32 fb_src   = SPU_V4(rvb->FB_SRC_A0, rvb->FB_SRC_A1, rvb->FB_SRC_B0, rvb->FB_SRC_B1);
+ const spu_v4s32 mix_dest = SPU_V4(rvb->MIX_DEST_A0, rvb->MIX_DEST_A1, rvb->MIX_DEST_B0, rvb->MIX_DEST_B1);
+ const spu_v4s32 in_coef  = SPU_V4(rvb->IN_COEF_L, rvb->IN_COEF_R, rvb->IN_COEF_L, rvb->IN_COEF_R);
+ const spu_v4s32 coef_ab  = SPU_V4(rvb->ACC_COEF_A, rvb->ACC_COEF_A, rvb->ACC_COEF_B, rvb->ACC_COEF_B);
+ const spu_v4s32 coef_cd  = SPU_V4(rvb->ACC_COEF_C, rvb->ACC_COEF_C, rvb->ACC_COEF_D, rvb->ACC_COEF_D);
+ const spu_v4s32 vol      = SPU_V4(rvb->VolLeft, rvb->VolRight, rvb->VolLeft, rvb->VolRight);
+ const spu_v4s32 iir_coef = spuSplatV(rvb->IIR_COEF);
+ const spu_v4s32 iir_alpha = spuSplatV(rvb->IIR_ALPHA);
+ const spu_v4s32 fb_alpha = spuSplatV(rvb->FB_ALPHA);
+ const spu_v4s32 fb_x     = spuSplatV(rvb->FB_X);
+ const spu_v4s32 swap = SPU_V4(2, 3, 0, 1);
+ int ns;
+
+ for (ns = 0; ns < ns_to * 2; ns += 4)
+  {
+   const spu_v4s32 curr = spuSplatV(curr_addr);
+   spu_v4s32 input, iir_in, d, iir, acc, fb, fa, fbb, mix_a, mix_b, mix, out;
+
+   input = SPU_V4(RVB[ns], RVB[ns+1], RVB[ns], RVB[ns+1]) * in_coef;
+   iir_in = (spuRvbLoadV(spuRvbOffsV(iir_src, curr, space)) * iir_coef + input) >> 15;
+   d = spuRvbLoadV(spuRvbOffsV(iir_dest, curr, space));
+   iir = d + (((iir_in - d) * iir_alpha) >> 15);
+   spuRvbStoreV(spuRvbOffsV(iir_dest + 1, curr, space), spuSat16V(iir));
+
+   acc = spuRvbLoadV(spuRvbOffsV(acc_ab, curr, space)) * coef_ab +
+         spuRvbLoadV(spuRvbOffsV(acc_cd, curr, space)) * coef_cd;
+   acc = (acc + __builtin_shuffle(acc, swap)) >> 15;
+
+   fb = spuRvbLoadV(spuRvbOffsV(fb_src, curr, space));
+   fa = __builtin_shuffle(fb, SPU_V4(0, 1, 0, 1));
+   fbb = __builtin_shuffle(fb, SPU_V4(2, 3, 2, 3));
+   mix_a = acc - ((fa * fb_alpha) >> 15);
+   mix_b = fa + (((acc - fa) * fb_alpha - fbb * fb_x) >> 15);
+   mix = spuSat16V(__builtin_shuffle(mix_a, mix_b, SPU_V4(0, 1, 6, 7)));
+   spuRvbStoreV(spuRvbOffsV(mix_dest, curr, space), mix);
+
+   out = ((mix + __builtin_shuffle(mix, swap)) / 2 * vol) >> 15;
+   spuStoreV(SSumLR + ns, spuLoadV(SSumLR + ns) + out);
+
+   curr_addr++;
+   if (curr_addr >= 0x40000) curr_addr = rvb->StartAddr;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////
+// output
+////////////////////////////////////////////////////////////////////////
+
+// Scale 'count' values of 'SSumLR' by 'volmult' and saturate them into
+//  'dst', clearing SSumLR, see do_samples_finish()
+static void spu_scale_out_simd(short *dst, int *SSumLR, int count, int volmult)
+{
+ const spu_v8s16 pack = { 0, 2, 4, 6, 8, 10, 12, 14 };
+ const spu_v4s32 vm = spuSplatV(volmult), zero = spuSplatV(0);
+ int ns, d;
+
+ for (ns = 0; ns + 8 <= count; ns += 8)
+  {
+   spu_v4s32 a = spuSat16V((spuLoadV(SSumLR + ns)     * vm) >> 10);
+   spu_v4s32 b = spuSat16V((spuLoadV(SSumLR + ns + 4) * vm) >> 10);
+   spu_v8s16 o = __builtin_shuffle((spu_v8s16)a, (spu_v8s16)b, pack);
+   spuStoreV(SSumLR + ns, zero);
+   spuStoreV(SSumLR + ns + 4, zero);
+   memcpy(dst + ns, &o, sizeof(o));
+  }
+
+ for (; ns < count; ns++)
+  {
+   d = SSumLR[ns]; SSumLR[ns] = 0;
+   d = d * volmult >> 10;
+   ssat32_to_16(d);
+   dst[ns] = d;
+  }
+}
+
+#endif // SPU_SIMD_H